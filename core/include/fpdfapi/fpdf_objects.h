@@ -7,10 +7,17 @@
 #ifndef CORE_INCLUDE_FPDFAPI_FPDF_OBJECTS_H_
 #define CORE_INCLUDE_FPDFAPI_FPDF_OBJECTS_H_
 
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "core/include/fxcrt/fx_coordinates.h"
+#include "core/include/fxcrt/fx_lock.h"
 #include "core/include/fxcrt/fx_system.h"
 
 class CPDF_Array;
@@ -118,15 +125,18 @@ class CPDF_Object {
 
  protected:
   explicit CPDF_Object(FX_DWORD type)
-      : m_Type(type), m_ObjNum(0), m_GenNum(0) {}
+      : m_Type(type), m_ObjNum(0), m_GenNum(0), m_bPooled(false) {}
   ~CPDF_Object() {}
   void Destroy();
 
   static const int kObjectRefMaxDepth = 128;
-  static int s_nCurRefDepth;
+  static thread_local int s_nCurRefDepth;
   FX_DWORD m_Type;
   FX_DWORD m_ObjNum;
   FX_DWORD m_GenNum;
+  // Set for objects living in a CPDF_IndirectObjectHolder's object pool,
+  // whose storage is freed with the pool rather than by Destroy().
+  bool m_bPooled;
 
   friend class CPDF_IndirectObjectHolder;
   friend class CPDF_Parser;
@@ -134,6 +144,8 @@ class CPDF_Object {
 
  private:
   CPDF_Object(const CPDF_Object& src) {}
+  template <typename T>
+  void DestroyAs(T* pObj);
   CPDF_Object* CloneInternal(FX_BOOL bDirect,
                              std::set<FX_DWORD>* visited) const;
 };
@@ -338,10 +350,14 @@ inline const CPDF_Array* ToArray(const CPDF_Object* obj) {
   return obj ? obj->AsArray() : nullptr;
 }
 
+// Entries are kept in a vector sorted by key, so iteration order matches the
+// old std::map layout while lookups avoid per-node allocations and temporary
+// key strings.
 class CPDF_Dictionary : public CPDF_Object {
  public:
-  using iterator = std::map<CFX_ByteString, CPDF_Object*>::iterator;
-  using const_iterator = std::map<CFX_ByteString, CPDF_Object*>::const_iterator;
+  using Entry = std::pair<CFX_ByteString, CPDF_Object*>;
+  using iterator = std::vector<Entry>::iterator;
+  using const_iterator = std::vector<Entry>::const_iterator;
 
   CPDF_Dictionary() : CPDF_Object(PDFOBJ_DICTIONARY) {}
 
@@ -385,8 +401,10 @@ class CPDF_Dictionary : public CPDF_Object {
 
   FX_BOOL KeyExist(const CFX_ByteStringC& key) const;
 
-  // Set* functions invalidate iterators for the element with the key |key|.
-  void SetAt(const CFX_ByteStringC& key, CPDF_Object* pObj);
+  // Set* functions invalidate iterators when |key| is added or removed.
+  // SetAt() keeps |key| itself, so keys interned through
+  // CPDF_IndirectObjectHolder::InternName() share one buffer.
+  void SetAt(const CFX_ByteString& key, CPDF_Object* pObj);
 
   void SetAtName(const CFX_ByteStringC& key, const CFX_ByteString& name);
 
@@ -416,10 +434,10 @@ class CPDF_Dictionary : public CPDF_Object {
 
   void SetAtBoolean(const CFX_ByteStringC& key, FX_BOOL bValue);
 
-  // Invalidates iterators for the element with the key |key|.
+  // Invalidates iterators.
   void RemoveAt(const CFX_ByteStringC& key);
 
-  // Invalidates iterators for the element with the key |oldkey|.
+  // Invalidates iterators.
   void ReplaceKey(const CFX_ByteStringC& oldkey, const CFX_ByteStringC& newkey);
 
   FX_BOOL Identical(CPDF_Dictionary* pDict) const;
@@ -437,7 +455,14 @@ class CPDF_Dictionary : public CPDF_Object {
  protected:
   ~CPDF_Dictionary();
 
-  std::map<CFX_ByteString, CPDF_Object*> m_Map;
+  // Returns the first entry whose key is not less than |key|.
+  iterator LowerBound(const CFX_ByteStringC& key);
+  const_iterator LowerBound(const CFX_ByteStringC& key) const;
+
+  iterator Find(const CFX_ByteStringC& key);
+  const_iterator Find(const CFX_ByteStringC& key) const;
+
+  std::vector<Entry> m_Map;
 
   friend class CPDF_Object;
 };
@@ -463,6 +488,10 @@ class CPDF_Stream : public CPDF_Object {
 
   void InitStreamFromFile(IFX_FileRead* pFile, CPDF_Dictionary* pDict);
 
+  // Makes the stream refer to |pData| without copying or owning it. The
+  // caller must keep |pData| valid and unchanged for the stream's lifetime.
+  void SetBorrowedData(const uint8_t* pData, FX_DWORD size);
+
   FX_BOOL Identical(CPDF_Stream* pOther) const;
 
   FX_DWORD GetRawSize() const { return m_dwSize; }
@@ -473,6 +502,10 @@ class CPDF_Stream : public CPDF_Object {
 
   FX_BOOL IsMemoryBased() const { return m_GenNum == kMemoryBasedGenNum; }
 
+  // Changes whenever the stream data is replaced, so that caches built from
+  // the contents can tell when they are stale.
+  FX_DWORD GetDataVersion() const { return m_dwDataVersion; }
+
  protected:
   friend class CPDF_Object;
   friend class CPDF_StreamAcc;
@@ -482,6 +515,8 @@ class CPDF_Stream : public CPDF_Object {
 
   void InitStreamInternal(CPDF_Dictionary* pDict);
 
+  void FreeDataBuf();
+
   CPDF_Dictionary* m_pDict;
 
   FX_DWORD m_dwSize;
@@ -493,6 +528,11 @@ class CPDF_Stream : public CPDF_Object {
 
     IFX_FileRead* m_pFile;
   };
+
+  // Whether |m_pDataBuf| is owned by someone else, see SetBorrowedData().
+  bool m_bBorrowedData;
+
+  FX_DWORD m_dwDataVersion;
 };
 inline CPDF_Stream* ToStream(CPDF_Object* obj) {
   return obj ? obj->AsStream() : nullptr;
@@ -594,6 +634,60 @@ class CPDF_IndirectObjectHolder {
   FX_BOOL InsertIndirectObject(FX_DWORD objnum, CPDF_Object* pObj);
 
   FX_DWORD GetLastObjNum() const { return m_LastObjNum; }
+
+  // Returns a copy of |name| sharing its buffer with every equal name interned
+  // earlier, so repeated keys and name values cost one allocation per spelling.
+  CFX_ByteString InternName(const CFX_ByteStringC& name);
+
+  // Makes objects created through NewParsedObject() come from an arena that
+  // is released in bulk with this holder. Objects created by editing keep
+  // individual heap ownership. Memory of pooled objects released early is
+  // only reclaimed when the holder goes away.
+  void EnableObjectPool();
+  bool HasObjectPool() const { return !!m_pObjectPool; }
+
+  // While suspended, NewParsedObject() uses the heap. For objects the parser
+  // inspects and releases straight away.
+  void SuspendObjectPool(bool bSuspend) { m_bObjectPoolSuspended = bSuspend; }
+
+  template <typename T, typename... Args>
+  T* NewParsedObject(Args&&... args) {
+    if (!m_pObjectPool || m_bObjectPoolSuspended)
+      return new T(std::forward<Args>(args)...);
+    T* pObj = new (m_pObjectPool->Alloc(sizeof(T)))
+        T(std::forward<Args>(args)...);
+    pObj->m_bPooled = true;
+    return pObj;
+  }
+
+  // Caps the estimated memory of the objects loaded from the file that
+  // TrimIndirectObjects() keeps. The default of 0 disables tracking.
+  void SetObjectBudget(FX_DWORD dwBytes);
+  FX_DWORD GetObjectBudget() const { return m_dwObjectBudget; }
+
+  // Whether a budget is set and the tracked objects exceed it.
+  bool IsOverObjectBudget() const {
+    return m_dwObjectBudget && m_dwLoadedSize > m_dwObjectBudget;
+  }
+
+  // Evicts the least recently used objects loaded from the file until the
+  // rest fit in the budget. Objects that no longer match the file, objects
+  // in |pinned| and objects added by editing are kept. Evicted objects are
+  // parsed again on next use, so callers must ensure that no pointers to
+  // them are held outside of this holder.
+  void TrimIndirectObjects(const std::set<FX_DWORD>& pinned);
+
+  // Makes the methods above take a lock, so that the holder can be read from
+  // several threads. Objects are no longer evicted once this is enabled.
+  void EnableSharedLock();
+
+  // Returns the lock that guards this holder, and any cache built on its
+  // objects, while it is shared between threads, or null otherwise.
+  std::recursive_mutex* GetSharedLock() const { return m_pSharedLock.get(); }
+
+  FX_DWORD GetEvictionCount() const { return m_nEvictions; }
+  FX_DWORD GetReloadCount() const { return m_nReloads; }
+
   iterator begin() { return m_IndirectObjs.begin(); }
   const_iterator begin() const { return m_IndirectObjs.cbegin(); }
   iterator end() { return m_IndirectObjs.end(); }
@@ -602,7 +696,30 @@ class CPDF_IndirectObjectHolder {
  protected:
   CPDF_Parser* m_pParser;
   FX_DWORD m_LastObjNum;
+  struct LoadedObject {
+    std::list<FX_DWORD>::iterator lru_pos;
+    FX_DWORD size;
+  };
+
+  void ForgetLoadedObject(FX_DWORD objnum);
+
   std::map<FX_DWORD, CPDF_Object*> m_IndirectObjs;
+  std::map<CFX_ByteStringC, CFX_ByteString> m_NameAtoms;
+  // Objects loaded from the file while a budget is set, most recently used
+  // first in |m_LoadedLRU|.
+  FX_DWORD m_dwObjectBudget;
+  FX_DWORD m_dwLoadedSize;
+  std::list<FX_DWORD> m_LoadedLRU;
+  std::map<FX_DWORD, LoadedObject> m_LoadedObjs;
+  std::set<FX_DWORD> m_EvictedObjNums;
+  FX_DWORD m_nEvictions;
+  FX_DWORD m_nReloads;
+  std::unique_ptr<std::recursive_mutex> m_pSharedLock;
+  // Members are destroyed after the destructor body has destroyed the
+  // objects, so the pool outlives the objects it backs wherever it is
+  // declared.
+  std::unique_ptr<CFX_GrowOnlyPool> m_pObjectPool;
+  bool m_bObjectPoolSuspended;
 };
 
 #endif  // CORE_INCLUDE_FPDFAPI_FPDF_OBJECTS_H_
@@ -7,6 +7,9 @@
 #ifndef CORE_INCLUDE_FPDFAPI_FPDF_PAGE_H_
 #define CORE_INCLUDE_FPDFAPI_FPDF_PAGE_H_
 
+#include <memory>
+#include <vector>
+
 #include "core/include/fxge/fx_dib.h"
 #include "fpdf_parser.h"
 #include "fpdf_resource.h"
@@ -16,6 +19,7 @@ class CPDF_Page;
 class CPDF_Form;
 class CPDF_ParseOptions;
 class CPDF_PageObject;
+class CPDF_PageObjectIndex;
 class CPDF_PageRenderCache;
 class CPDF_StreamFilter;
 class CPDF_AllStates;
@@ -34,27 +38,35 @@ class CPDF_PageObjects {
 
   FX_BOOL IsParsed() const { return m_ParseState == CONTENT_PARSED; }
 
+  // Positions stay valid while objects are appended, but inserting an object
+  // shifts the positions of the objects after it.
   FX_POSITION GetFirstObjectPosition() const {
-    return m_ObjectList.GetHeadPosition();
+    return m_ObjectList.empty() ? nullptr : IndexToPosition(0);
   }
 
   FX_POSITION GetLastObjectPosition() const {
-    return m_ObjectList.GetTailPosition();
+    return m_ObjectList.empty() ? nullptr
+                                : IndexToPosition(m_ObjectList.size() - 1);
   }
 
   CPDF_PageObject* GetNextObject(FX_POSITION& pos) const {
-    return (CPDF_PageObject*)m_ObjectList.GetNext(pos);
+    size_t index = PositionToIndex(pos);
+    pos = index + 1 < m_ObjectList.size() ? IndexToPosition(index + 1)
+                                          : nullptr;
+    return m_ObjectList[index];
   }
 
   CPDF_PageObject* GetPrevObject(FX_POSITION& pos) const {
-    return (CPDF_PageObject*)m_ObjectList.GetPrev(pos);
+    size_t index = PositionToIndex(pos);
+    pos = index ? IndexToPosition(index - 1) : nullptr;
+    return m_ObjectList[index];
   }
 
   CPDF_PageObject* GetObjectAt(FX_POSITION pos) const {
-    return (CPDF_PageObject*)m_ObjectList.GetAt(pos);
+    return m_ObjectList[PositionToIndex(pos)];
   }
 
-  FX_DWORD CountObjects() const { return m_ObjectList.GetCount(); }
+  FX_DWORD CountObjects() const { return (FX_DWORD)m_ObjectList.size(); }
 
   int GetObjectIndex(CPDF_PageObject* pObj) const;
 
@@ -63,12 +75,39 @@ class CPDF_PageObjects {
   FX_POSITION InsertObject(FX_POSITION posInsertAfter,
                            CPDF_PageObject* pNewObject);
 
+  // Turns on an R-tree over the bounding boxes of the objects, which
+  // GetObjectsInRect() and the renderer use to skip objects outside the area
+  // of interest. Fails if the objects are not parsed yet. The tree is built
+  // by the next query, and built again by the first query after the objects
+  // change.
+  FX_BOOL BuildObjectIndex();
+
+  FX_BOOL HasObjectIndex() const { return m_bObjectIndex; }
+
+  // Drops the R-tree after the bounds of objects in this list change.
+  // Inserting or transforming objects through this class does so itself, and
+  // CPDF_PageObject::InvalidateObjectIndex() does for a single object.
+  void InvalidateObjectIndex();
+
+  // Builds the R-tree now if it is on and out of date. Queries that follow
+  // only read it, so they may run on several threads at once.
+  void UpdateObjectIndex() const;
+
+  // Appends the positions of the objects whose bounding boxes intersect
+  // |rect| to |pPositions|, in paint order.
+  void GetObjectsInRect(const CFX_FloatRect& rect,
+                        std::vector<FX_POSITION>* pPositions) const;
+
   void Transform(const CFX_Matrix& matrix);
 
   FX_BOOL BackgroundAlphaNeeded() const { return m_bBackgroundAlphaNeeded; }
 
   FX_BOOL HasImageMask() const { return m_bHasImageMask; }
 
+  // Whether parsing looked up resources in the page's resource dictionary
+  // because the form's own ones lacked them.
+  FX_BOOL UsesPageResources() const { return m_bUsesPageResources; }
+
   CFX_FloatRect CalcBoundingBox() const;
 
   CPDF_Dictionary* m_pFormDict;
@@ -81,17 +120,29 @@ class CPDF_PageObjects {
 
  protected:
   friend class CPDF_ContentParser;
+  friend class CPDF_DisplayListReader;
   friend class CPDF_StreamContentParser;
   friend class CPDF_AllStates;
 
   enum ParseState { CONTENT_NOT_PARSED, CONTENT_PARSING, CONTENT_PARSED };
 
+  static FX_POSITION IndexToPosition(size_t index) {
+    return reinterpret_cast<FX_POSITION>(index + 1);
+  }
+  static size_t PositionToIndex(FX_POSITION pos) {
+    return reinterpret_cast<uintptr_t>(pos) - 1;
+  }
+
   void LoadTransInfo();
   void ClearCacheObjects();
 
-  CFX_PtrList m_ObjectList;
+  std::vector<CPDF_PageObject*> m_ObjectList;
+  FX_BOOL m_bObjectIndex;
+  // Built on demand by UpdateObjectIndex().
+  mutable std::unique_ptr<CPDF_PageObjectIndex> m_pObjectIndex;
   FX_BOOL m_bBackgroundAlphaNeeded;
   FX_BOOL m_bHasImageMask;
+  FX_BOOL m_bUsesPageResources;
   FX_BOOL m_bReleaseMembers;
   CPDF_ContentParser* m_pParser;
   ParseState m_ParseState;
@@ -110,6 +161,15 @@ class CPDF_Page : public CPDF_PageObjects, public CFX_PrivateData {
   void ParseContent(CPDF_ParseOptions* pOptions = NULL,
                     FX_BOOL bReParse = FALSE);
 
+  // Writes the parsed objects of the page to |pFile|, so that
+  // LoadDisplayList() can restore them later without parsing the contents.
+  // Fails if the page is not parsed or uses objects the document can't name.
+  FX_BOOL SaveDisplayList(IFX_FileWrite* pFile);
+  // Restores the objects written by SaveDisplayList() into a page that is not
+  // parsed yet. Fails, leaving the page unparsed, if |pFile| was written for
+  // other contents or a different revision of the file.
+  FX_BOOL LoadDisplayList(IFX_FileRead* pFile);
+
   void GetDisplayMatrix(CFX_Matrix& matrix,
                         int xPos,
                         int yPos,
@@ -142,6 +202,14 @@ class CPDF_ParseOptions {
   FX_BOOL m_bSeparateForm;
 
   FX_BOOL m_bDecodeInlineImage;
+
+  // Whether objects whose graphic states hold equal values share them.
+  FX_BOOL m_bShareStates;
+
+  // Whether the next of several large content streams is decoded on a
+  // worker thread while the current one is parsed. On by default when there
+  // is more than one processor.
+  FX_BOOL m_bDecodeAhead;
 };
 class CPDF_Form : public CPDF_PageObjects {
  public:
@@ -7,6 +7,8 @@
 #ifndef CORE_INCLUDE_FPDFAPI_FPDF_PAGEOBJ_H_
 #define CORE_INCLUDE_FPDFAPI_FPDF_PAGEOBJ_H_
 
+#include <memory>
+
 #include "core/include/fxge/fx_ge.h"
 #include "fpdf_resource.h"
 
@@ -23,6 +25,7 @@ class CPDF_GraphicStates;
 class CPDF_GraphState;
 class CPDF_ImageObject;
 class CPDF_PageObject;
+class CPDF_PageObjects;
 class CPDF_Path;
 class CPDF_PathObject;
 class CPDF_ShadingObject;
@@ -376,6 +379,10 @@ class CPDF_PageObject : public CPDF_GraphicStates {
 
   FX_RECT GetBBox(const CFX_Matrix* pMatrix) const;
 
+  // Drops the R-tree of the object list indexing this object, if any, after
+  // its bounds change.
+  void InvalidateObjectIndex();
+
   int m_Type;
 
   FX_FLOAT m_Left;
@@ -393,7 +400,13 @@ class CPDF_PageObject : public CPDF_GraphicStates {
 
   void RecalcBBox();
 
-  CPDF_PageObject() {}
+  CPDF_PageObject() : m_pIndexOwner(nullptr) {}
+
+ private:
+  friend class CPDF_PageObjects;
+
+  // The object list whose R-tree holds this object.
+  const CPDF_PageObjects* m_pIndexOwner;
 };
 
 struct CPDF_TextObjectItem {
@@ -463,6 +476,7 @@ class CPDF_TextObject : public CPDF_PageObject {
   void RecalcPositionData() { CalcPositionData(nullptr, nullptr, 1); }
 
  protected:
+  friend class CPDF_DisplayListReader;
   friend class CPDF_RenderStatus;
   friend class CPDF_StreamContentParser;
   friend class CPDF_TextRenderer;
@@ -543,18 +557,21 @@ class CPDF_ShadingObject : public CPDF_PageObject {
 
  protected:
   void CopyData(const CPDF_PageObject* pSrcObject) override;
+
+ private:
+  // Set when |m_pForm| is a copy of a form that is not in the cache, which
+  // this object owns instead of sharing.
+  std::unique_ptr<CPDF_Form> m_pOwnedForm;
 };
 
 class CPDF_FormObject : public CPDF_PageObject {
  public:
-  CPDF_FormObject() {
-    m_Type = PDFPAGE_FORM;
-    m_pForm = NULL;
-  }
+  CPDF_FormObject();
   ~CPDF_FormObject() override;
 
   void Transform(const CFX_Matrix& matrix) override;
 
+  // Shared with other uses of the form, see CPDF_DocPageData::GetForm().
   CPDF_Form* m_pForm;
 
   CFX_Matrix m_FormMatrix;
@@ -563,6 +580,11 @@ class CPDF_FormObject : public CPDF_PageObject {
 
  protected:
   void CopyData(const CPDF_PageObject* pSrcObject) override;
+
+ private:
+  // Set when |m_pForm| is a copy of a form that is not in the cache, which
+  // this object owns instead of sharing.
+  std::unique_ptr<CPDF_Form> m_pOwnedForm;
 };
 
 #endif  // CORE_INCLUDE_FPDFAPI_FPDF_PAGEOBJ_H_
@@ -7,9 +7,11 @@
 #ifndef CORE_INCLUDE_FPDFAPI_FPDF_PARSER_H_
 #define CORE_INCLUDE_FPDFAPI_FPDF_PARSER_H_
 
+#include <list>
 #include <map>
 #include <memory>
 #include <set>
+#include <vector>
 
 #include "core/include/fpdfapi/fpdf_objects.h"
 #include "core/include/fxcrt/fx_system.h"
@@ -61,6 +63,12 @@ inline bool PDFCharIsLineEnding(uint8_t c) {
   return c == '\r' || c == '\n';
 }
 
+// Return the offset of the first whitespace or delimiter byte, or of the first
+// line ending, in |pData|. Both return |size| when there is none, and scan 16
+// bytes at a time where SSE2 is available.
+FX_DWORD PDF_FindWordEnd(const uint8_t* pData, FX_DWORD size);
+FX_DWORD PDF_FindLineEnding(const uint8_t* pData, FX_DWORD size);
+
 // Indexed by 8-bit char code, contains unicode code points.
 extern const FX_WORD PDFDocEncoding[256];
 
@@ -104,8 +112,26 @@ class CPDF_Document : public CFX_PrivateData, public CPDF_IndirectObjectHolder {
 
   void ClearRenderFont();
 
+  // Releases unused page and render data, then evicts parsed objects over the
+  // budget, see CPDF_IndirectObjectHolder::TrimIndirectObjects(). Objects
+  // reachable from the catalog outside of the page tree, the info and
+  // encrypt dictionaries and the loaded pages are kept. Only safe while
+  // nothing else outside the document holds pointers to its objects.
+  void TrimMemory();
+
+  // Called by CPDF_Page, so that TrimMemory() keeps the objects of the pages
+  // that are loaded.
+  void AddLoadedPage(CPDF_Dictionary* pPageDict);
+  void RemoveLoadedPage(CPDF_Dictionary* pPageDict);
+
   FX_BOOL IsFormStream(FX_DWORD objnum, FX_BOOL& bForm) const;
 
+  // Makes it safe for several threads to load and render pages of the
+  // document at once. Shared resources such as objects, fonts, color spaces
+  // and images are then guarded by GetSharedLock(). The document must not be
+  // edited or trimmed afterwards. Cannot be undone.
+  void EnableSharedAccess();
+
   // |pFontDict| must not be null.
   CPDF_Font* LoadFont(CPDF_Dictionary* pFontDict);
 
@@ -179,6 +205,11 @@ class CPDF_Document : public CFX_PrivateData, public CPDF_IndirectObjectHolder {
                      int& index,
                      int level = 0);
   FX_BOOL IsContentUsedElsewhere(FX_DWORD objnum, CPDF_Dictionary* pPageDict);
+  // Adds the loaded objects that |pObj| refers to, directly or through other
+  // loaded objects, to |pObjNums|. Page dictionaries are added but only
+  // walked when they are |pObj|, and the page tree is only walked upwards.
+  void AddReachableObjects(CPDF_Object* pObj,
+                           std::set<FX_DWORD>* pObjNums) const;
   FX_BOOL CheckOCGVisible(CPDF_Dictionary* pOCG, FX_BOOL bPrinting);
   CPDF_DocPageData* GetValidatePageData();
   CPDF_DocRenderData* GetValidateRenderData();
@@ -190,6 +221,9 @@ class CPDF_Document : public CFX_PrivateData, public CPDF_IndirectObjectHolder {
   CPDF_DocPageData* m_pDocPage;
 
   CPDF_DocRenderData* m_pDocRender;
+
+  // The dictionaries of the pages loaded, once per CPDF_Page.
+  std::multiset<CPDF_Dictionary*> m_LoadedPages;
 };
 
 #define PDFWORD_EOF 0
@@ -297,7 +331,7 @@ class CPDF_SyntaxParser {
   friend class fpdf_parser_parser_ReadHexString_Test;
 
   static const int kParserMaxRecursionDepth = 64;
-  static int s_CurrentRecursionDepth;
+  static thread_local int s_CurrentRecursionDepth;
 
   virtual FX_BOOL GetNextChar(uint8_t& ch);
 
@@ -305,6 +339,14 @@ class CPDF_SyntaxParser {
 
   void GetNextWordInternal(bool* bIsNumber);
 
+  // Returns the bytes from the current position that can be read without
+  // going to the file, or nullptr if the next read needs a refill.
+  const uint8_t* PeekBuffer(FX_DWORD* pSize) const;
+
+  // Appends the rest of the current word that is already in memory to
+  // |m_WordBuffer| and moves past it.
+  void ScanWord(bool* bIsNumber);
+
   bool IsWholeWord(FX_FILESIZE startpos,
                    FX_FILESIZE limit,
                    const CFX_ByteStringC& tag,
@@ -335,6 +377,10 @@ class CPDF_SyntaxParser {
 
   uint8_t* m_pFileBuf;
 
+  // The whole file when |m_pFileAccess| exposes it in memory, in which case
+  // |m_pFileBuf| is not used.
+  const uint8_t* m_pFileData;
+
   FX_DWORD m_BufSize;
 
   FX_FILESIZE m_BufOffset;
@@ -350,6 +396,9 @@ class CPDF_SyntaxParser {
 
 #define PDFPARSE_TYPEONLY 1
 #define PDFPARSE_NOSTREAM 2
+// Parse streams without reading their data, for callers that only need the
+// stream dictionary and the position after the stream.
+#define PDFPARSE_NOSTREAMDATA 4
 struct PARSE_CONTEXT {
   uint32_t m_Flags;
   FX_FILESIZE m_DictStart;
@@ -376,6 +425,43 @@ class CPDF_Parser {
 
   void CloseParser(FX_BOOL bReParse = FALSE);
 
+  // Makes the next StartParse() take the cross-reference data from |pIndex|,
+  // as written by SaveXRefIndex() for the same file, instead of parsing it.
+  // The index is ignored if it does not match the file. |pIndex| is not owned
+  // and must stay valid until StartParse() returns.
+  void SetXRefIndex(IFX_FileRead* pIndex) { m_pXRefIndex = pIndex; }
+
+  // Sets the modification time of the file given to the next StartParse(),
+  // which SaveXRefIndex() records and LoadXRefIndex() must find unchanged.
+  // Zero when the time is not known.
+  void SetFileModifiedTime(int64_t time) { m_FileModifiedTime = time; }
+
+  // Whether the last StartParse() used the index given to SetXRefIndex().
+  FX_BOOL IsXRefIndexUsed() const { return m_bXRefIndexUsed; }
+
+  // Writes the cross-reference data loaded by StartParse() to |pFile|.
+  FX_BOOL SaveXRefIndex(IFX_FileWrite* pFile);
+
+  // Makes documents created by later StartParse() calls allocate their parsed
+  // objects from a per-document pool. See
+  // CPDF_IndirectObjectHolder::EnableObjectPool().
+  void SetUseObjectPool(FX_BOOL bUse) { m_bUseObjectPool = bUse; }
+
+  // Makes documents created by later StartParse() calls safe to read from
+  // several threads at once. See CPDF_Document::EnableSharedAccess(). Builds
+  // without PDF_ENABLE_SHARED_DOCUMENTS ignore this, as their reference
+  // counts are not atomic.
+  void SetSharedAccess(FX_BOOL bShared) {
+#ifdef PDF_ENABLE_SHARED_DOCUMENTS
+    m_bSharedAccess = bShared;
+#endif
+  }
+
+  // Sets the most threads, including the calling one, that scan a damaged
+  // file for its objects. The objects found do not depend on it. Defaults
+  // to the number of cores.
+  void SetRebuildThreads(int nThreads) { m_nRebuildThreads = nThreads; }
+
   FX_DWORD GetPermissions(FX_BOOL bCheckRevision = FALSE);
 
   FX_BOOL IsOwner();
@@ -403,6 +489,15 @@ class CPDF_Parser {
 
   CPDF_Dictionary* GetEncryptDict() { return m_pEncryptDict; }
 
+  // Drops the decoded object streams cached by ParseIndirectObject().
+  void ReleaseObjectStreams();
+
+  // Limits the decoded bytes kept for object streams. The least recently used
+  // streams are dropped first; the most recent one is always kept.
+  void SetObjectStreamCacheLimit(FX_DWORD size);
+  FX_DWORD GetObjectStreamCacheLimit() const { return m_dwObjStreamLimit; }
+  size_t GetCachedObjectStreamCount() const { return m_ObjectStreams.size(); }
+
   CPDF_Object* ParseIndirectObject(CPDF_IndirectObjectHolder* pObjList,
                                    FX_DWORD objnum,
                                    PARSE_CONTEXT* pContext = NULL);
@@ -452,8 +547,14 @@ class CPDF_Parser {
 
   CPDF_Dictionary* LoadTrailerV4();
 
+  // Applies the objects and trailers RebuildCrossRef() finds. Defined in
+  // fpdf_parser_parser.cpp.
+  class CrossRefRebuilder;
+
   FX_BOOL RebuildCrossRef();
 
+  FX_BOOL LoadXRefIndex(IFX_FileRead* pIndex);
+
   FX_DWORD SetEncryptHandler();
 
   void ReleaseEncryptHandler();
@@ -466,21 +567,43 @@ class CPDF_Parser {
 
   FX_DWORD LoadLinearizedMainXRefTable();
 
-  CPDF_StreamAcc* GetObjectStream(FX_DWORD number);
+  // A decoded object stream and the offsets of the objects it holds, relative
+  // to its /First. The offsets are read from the stream header only once.
+  struct ObjectStream {
+    ObjectStream();
+    ~ObjectStream();
+
+    std::unique_ptr<CPDF_StreamAcc> pAcc;
+    FX_DWORD first;
+    std::map<FX_DWORD, FX_DWORD> offsets;
+    std::vector<FX_DWORD> sorted_offsets;
+    std::list<FX_DWORD>::iterator lru_pos;
+  };
+
+  const ObjectStream* GetObjectStream(FX_DWORD number);
+  void TrimObjectStreams(FX_DWORD keep);
 
   FX_BOOL IsLinearizedFile(IFX_FileRead* pFileAccess, FX_DWORD offset);
 
-  bool FindPosInOffsets(FX_FILESIZE pos) const;
-
   void SetEncryptDictionary(CPDF_Dictionary* pDict);
 
   FX_FILESIZE GetObjectPositionOrZero(FX_DWORD objnum) const;
+  void SetObjectPosition(FX_DWORD objnum, FX_FILESIZE pos);
   void ShrinkObjectMap(FX_DWORD size);
 
+  // Sorts |m_SortedOffset| and drops duplicates. Offsets are appended to it
+  // unordered while the cross-reference data is loaded.
+  void SortOffsets();
+
   CPDF_Document* m_pDocument;
 
   CPDF_SyntaxParser m_Syntax;
   FX_BOOL m_bOwnFileRead;
+
+  // Files replaced by a reparse while their direct buffers may still back
+  // borrowed stream data in |m_pDocument|. Released with the document.
+  std::vector<IFX_FileRead*> m_RetiredFiles;
+
   int m_FileVersion;
 
   CPDF_Dictionary* m_pTrailer;
@@ -491,6 +614,16 @@ class CPDF_Parser {
 
   FX_BOOL m_bXRefStream;
 
+  IFX_FileRead* m_pXRefIndex;
+
+  FX_BOOL m_bXRefIndexUsed;
+
+  int64_t m_FileModifiedTime;
+
+  FX_BOOL m_bUseObjectPool;
+  FX_BOOL m_bSharedAccess;
+  int m_nRebuildThreads;
+
   std::unique_ptr<CPDF_SecurityHandler> m_pSecurityHandler;
 
   FX_BOOL m_bForceUseSecurityHandler;
@@ -511,7 +644,8 @@ class CPDF_Parser {
     uint16_t gennum;
 #endif
   };
-  std::map<FX_DWORD, ObjectInfo> m_ObjectInfo;
+  // Indexed by object number, up to the last object number in use.
+  std::vector<ObjectInfo> m_ObjectInfo;
 
   CFX_ByteArray m_V5Type;
   CFX_WordArray m_ObjVersion;
@@ -528,16 +662,12 @@ class CPDF_Parser {
 
   FX_DWORD m_dwXrefStartObjNum;
 
-  // A map of object numbers to indirect streams. Map owns the streams.
-  CFX_MapPtrToPtr m_ObjectStreamMap;
-
-  // Mapping of object numbers to offsets. The offsets are relative to the first
-  // object in the stream.
-  using StreamObjectCache = std::map<FX_DWORD, FX_DWORD>;
-
-  // Mapping of streams to their object caches. This is valid as long as the
-  // streams in |m_ObjectStreamMap| are valid.
-  std::map<CPDF_StreamAcc*, StreamObjectCache> m_ObjCache;
+  // Decoded object streams keyed by their object numbers, with the most
+  // recently used stream at the front of |m_ObjectStreamLRU|.
+  std::map<FX_DWORD, ObjectStream> m_ObjectStreams;
+  std::list<FX_DWORD> m_ObjectStreamLRU;
+  FX_DWORD m_dwObjStreamSize;
+  FX_DWORD m_dwObjStreamLimit;
 
   // All indirect object numbers that are being parsed.
   std::set<FX_DWORD> m_ParsingObjNums;
@@ -987,4 +1117,38 @@ FX_BOOL PDF_DataDecode(const uint8_t* src_buf,
                        FX_DWORD estimated_size,
                        FX_BOOL bImageAcc);
 
+// Decodes the filter chain of a stream a block at a time, so callers can
+// consume the data without holding the raw and decoded copies in full.
+// Chains the streaming decoders can't handle (LZW, predictors, image filters)
+// are decoded in one go by a CPDF_StreamAcc on the first read instead.
+class CPDF_StreamFilter {
+ public:
+  explicit CPDF_StreamFilter(const CPDF_Stream* pStream);
+  ~CPDF_StreamFilter();
+
+  // Returns the number of bytes written to |buffer|, or 0 at the end.
+  FX_DWORD ReadBlock(uint8_t* buffer, FX_DWORD size);
+
+  const CPDF_Stream* GetStream() const { return m_pStream; }
+
+  // Whether the data is decoded a block at a time. Otherwise the first
+  // ReadBlock() decodes all of it through a CPDF_StreamAcc, which reads the
+  // stream's dictionary again.
+  bool IsIncremental() const { return !m_pFallback; }
+
+  class Decoder;
+
+ private:
+  void FillBuffer();
+  void Finish();
+
+  const CPDF_Stream* const m_pStream;
+  std::vector<std::unique_ptr<Decoder>> m_Decoders;
+  std::unique_ptr<CPDF_StreamAcc> m_pFallback;
+  CFX_BinaryBuf m_Buffer;
+  FX_DWORD m_BufOffset;
+  FX_DWORD m_SrcOffset;
+  bool m_bFinished;
+};
+
 #endif  // CORE_INCLUDE_FPDFAPI_FPDF_PARSER_H_
@@ -7,8 +7,12 @@
 #ifndef CORE_INCLUDE_FPDFAPI_FPDF_RENDER_H_
 #define CORE_INCLUDE_FPDFAPI_FPDF_RENDER_H_
 
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
 #include "core/include/fpdfapi/fpdf_page.h"
 #include "core/include/fxge/fx_ge.h"
@@ -102,6 +106,22 @@ class CPDF_RenderContext {
                      const CPDF_RenderOptions* pOptions,
                      CFX_Matrix* pFinalMatrix);
 
+  // Renders the layers into |pBitmap| within |clip|, giving the same pixels
+  // as a CPDF_ProgressiveRenderer on a device attached to |pBitmap| and
+  // clipped to |clip|. The area is split into horizontal bands that up to
+  // |nThreads| threads render at once, each through its own device clipped
+  // to the band and its own image cache. The threads share the parsed
+  // objects, so this takes one thread unless the document has shared access
+  // enabled and every layer has been parsed. Pages drawing transparency
+  // groups or soft masks, whose offscreen bitmaps depend on the clip box,
+  // render in one piece too. Returns the number of bands, 1 for one piece
+  // and 0 if |clip| misses the bitmap.
+  int RenderTiled(CFX_DIBitmap* pBitmap,
+                  FX_BOOL bRgbByteOrder,
+                  const FX_RECT& clip,
+                  const CPDF_RenderOptions* pOptions,
+                  int nThreads);
+
   CPDF_PageRenderCache* GetPageCache() const { return m_pPageCache; }
 
  protected:
@@ -110,6 +130,12 @@ class CPDF_RenderContext {
               const CPDF_RenderOptions* pOptions,
               const CFX_Matrix* pFinalMatrix);
 
+  void RenderBand(CFX_DIBitmap* pBitmap,
+                  FX_BOOL bRgbByteOrder,
+                  const FX_RECT& rect,
+                  const CPDF_RenderOptions* pOptions,
+                  CPDF_PageRenderCache* pPageCache) const;
+
   CPDF_Document* const m_pDocument;
   CPDF_Dictionary* m_pPageResources;
   CPDF_PageRenderCache* m_pPageCache;
@@ -146,6 +172,7 @@ class CPDF_ProgressiveRenderer {
 
  private:
   void RenderStep();
+  FX_POSITION GetNextIndexedPosition();
 
   Status m_Status;
   CPDF_RenderContext* const m_pContext;
@@ -157,6 +184,11 @@ class CPDF_ProgressiveRenderer {
   FX_DWORD m_ObjectIndex;
   FX_POSITION m_ObjectPos;
   FX_POSITION m_PrevLastPos;
+  // Set when the current layer has an object index, in which case the
+  // objects are visited in |m_IndexedPositions| order.
+  bool m_bIndexed;
+  std::vector<FX_POSITION> m_IndexedPositions;
+  size_t m_NextIndexed;
 };
 
 class CPDF_TextRenderer {
@@ -267,6 +299,109 @@ class CPDF_PageRenderCache {
   FX_DWORD m_nCacheSize;
   FX_BOOL m_bCurFindCache;
 };
+
+// A decoded image and its mask, owned by the pages drawing it and by
+// CPDF_DocImageCache.
+struct CPDF_DecodedImage {
+  CPDF_DecodedImage(CFX_DIBSource* pBitmap,
+                    CFX_DIBSource* pMask,
+                    FX_DWORD MatteColor)
+      : m_pBitmap(pBitmap), m_pMask(pMask), m_MatteColor(MatteColor) {}
+  ~CPDF_DecodedImage();
+
+  CFX_DIBSource* const m_pBitmap;
+  CFX_DIBSource* const m_pMask;
+  const FX_DWORD m_MatteColor;
+};
+
+// Decoded images kept across the pages of a document, or of every document,
+// so that an image drawn on many pages is decoded once. The least recently
+// used images are dropped to stay within a byte budget; pages that hold one
+// keep it until their CPDF_PageRenderCache lets go. Safe to use from several
+// threads.
+class CPDF_DocImageCache {
+ public:
+  // The document and object number of the image stream, the object numbers
+  // of the form and page resources its colour space name was looked up in,
+  // the group family, and the bStdCS and bLoadMask flags it was decoded
+  // with. Object numbers stay valid when the object cache drops the objects.
+  typedef std::tuple<CPDF_Document*,
+                     FX_DWORD,
+                     FX_DWORD,
+                     FX_DWORD,
+                     FX_DWORD,
+                     FX_BOOL,
+                     FX_BOOL>
+      Key;
+
+  // Shared by the documents without a budget of their own. It is off until
+  // given a budget.
+  static CPDF_DocImageCache* GetProcessCache();
+
+  // The cache |pDoc| keeps for itself, created on first use.
+  static CPDF_DocImageCache* GetDocumentCache(CPDF_Document* pDoc);
+
+  // The cache the pages of |pDoc| use: its own if that has a budget, else the
+  // process cache if that has one, else null.
+  static CPDF_DocImageCache* ForDocument(CPDF_Document* pDoc);
+
+  // Sets |pKey| for an image decoded from |pStream| with the given
+  // parameters. Fails for inline images, which have no object number, and
+  // for images that name a colour space in resources that have none.
+  static FX_BOOL GetKey(CPDF_Document* pDoc,
+                        const CPDF_Stream* pStream,
+                        CPDF_Dictionary* pFormResources,
+                        CPDF_Dictionary* pPageResources,
+                        FX_BOOL bStdCS,
+                        FX_DWORD GroupFamily,
+                        FX_BOOL bLoadMask,
+                        Key* pKey);
+
+  CPDF_DocImageCache();
+  ~CPDF_DocImageCache();
+
+  // Sets the bytes the cached images may take, dropping the least recently
+  // used ones to fit. 0 turns the cache off.
+  void SetBudget(FX_DWORD dwBudget);
+  FX_DWORD GetBudget() const;
+  FX_DWORD GetSize() const;
+  FX_DWORD GetHitCount() const;
+  FX_DWORD GetMissCount() const;
+
+  // Returns the image cached for |key|, counting a hit, or null, counting a
+  // miss.
+  std::shared_ptr<CPDF_DecodedImage> Find(const Key& key);
+
+  // Caches |pImage| of |dwSize| bytes for |key|, unless it is larger than
+  // the budget.
+  void Add(const Key& key,
+           const std::shared_ptr<CPDF_DecodedImage>& pImage,
+           FX_DWORD dwSize);
+
+  // Drops the images decoded from object |objnum| of |pDoc|, or from any
+  // object of |pDoc| if |objnum| is 0.
+  void Remove(CPDF_Document* pDoc, FX_DWORD objnum);
+
+ private:
+  struct Entry {
+    std::shared_ptr<CPDF_DecodedImage> m_pImage;
+    FX_DWORD m_dwSize;
+    std::list<Key>::iterator m_LRUPos;
+  };
+
+  void TrimToBudget();
+  void Erase(std::map<Key, Entry>::iterator it);
+
+  mutable std::mutex m_Lock;
+  std::map<Key, Entry> m_Images;
+  // The least recently used key last.
+  std::list<Key> m_LRU;
+  FX_DWORD m_dwBudget;
+  FX_DWORD m_dwSize;
+  FX_DWORD m_nHits;
+  FX_DWORD m_nMisses;
+};
+
 class CPDF_RenderConfig {
  public:
   CPDF_RenderConfig();
@@ -265,6 +265,22 @@ class CPDF_Font {
  private:
   const int m_FontType;
 };
+
+// Guards the glyph data that a font loads on demand while its document is
+// shared between threads. Type3 glyphs are content streams in the document,
+// and the other font types call into FreeType, so the document lock is taken
+// first and then the global lock.
+class CPDF_FontLock {
+ public:
+  explicit CPDF_FontLock(const CPDF_Font* pFont)
+      : m_DocLock(pFont->m_pDocument ? pFont->m_pDocument->GetSharedLock()
+                                     : nullptr),
+        m_GlobalLock(FX_GetGlobalLock()) {}
+
+ private:
+  CFX_AutoLock m_DocLock;
+  CFX_AutoLock m_GlobalLock;
+};
 #define PDFFONT_ENCODING_BUILTIN 0
 #define PDFFONT_ENCODING_WINANSI 1
 #define PDFFONT_ENCODING_MACROMAN 2
@@ -632,6 +648,8 @@ class CPDF_Color {
   CPDF_ColorSpace* m_pCS;
 
  protected:
+  friend class CPDF_DisplayListWriter;
+
   void ReleaseBuffer();
   void ReleaseColorSpace();
   FX_FLOAT* m_pBuffer;
@@ -259,9 +259,12 @@ class ICodec_JpxModule {
  public:
   virtual ~ICodec_JpxModule() {}
 
+  // |reduce|, if not NULL, is how many times to halve the size of the decoded
+  // image, and receives how many times it will be.
   virtual CJPX_Decoder* CreateDecoder(const uint8_t* src_buf,
                                       FX_DWORD src_size,
-                                      CPDF_ColorSpace* cs) = 0;
+                                      CPDF_ColorSpace* cs,
+                                      uint32_t* reduce) = 0;
 
   virtual void GetImageInfo(CJPX_Decoder* pDecoder,
                             FX_DWORD* width,
@@ -532,6 +535,35 @@ class ICodec_IccModule {
   virtual void SetComponents(FX_DWORD nComponents) = 0;
 };
 
+// Averages |scale| by |scale| blocks of an image with 8 bits per component,
+// or a single component of 1 bit, into 8 bits per component, a line of
+// blocks at a time.
+class CCodec_BoxDownsampler {
+ public:
+  CCodec_BoxDownsampler(int src_width, int nComps, int bpc, int scale);
+  ~CCodec_BoxDownsampler();
+
+  int GetScale() const { return m_Scale; }
+  int GetWidth() const { return m_Width; }
+
+  // Starts a new line of blocks.
+  void Reset();
+  void AddLine(const uint8_t* src_line);
+  // Averages the lines added since Reset().
+  const uint8_t* Finish();
+  const uint8_t* GetOutput() const { return m_Output.data(); }
+
+ private:
+  const int m_SrcWidth;
+  const int m_nComps;
+  const int m_bpc;
+  const int m_Scale;
+  const int m_Width;
+  int m_nLines;
+  std::vector<FX_DWORD> m_Sums;
+  std::vector<uint8_t> m_Output;
+};
+
 void AdobeCMYK_to_sRGB(FX_FLOAT c,
                        FX_FLOAT m,
                        FX_FLOAT y,
@@ -546,6 +578,10 @@ void AdobeCMYK_to_sRGB1(uint8_t c,
                         uint8_t& R,
                         uint8_t& G,
                         uint8_t& B);
+// Converts |pixels| 8-bit CMYK pixels to BGR, as AdobeCMYK_to_sRGB1() would.
+void AdobeCMYK_to_sRGBLine(uint8_t* pDestBuf,
+                           const uint8_t* pSrcBuf,
+                           int pixels);
 FX_BOOL MD5ComputeID(const void* buf, FX_DWORD dwSize, uint8_t ID[16]);
 void FaxG4Decode(const uint8_t* src_buf,
                  FX_DWORD src_size,
@@ -555,4 +591,12 @@ void FaxG4Decode(const uint8_t* src_buf,
                  int height,
                  int pitch);
 
+// The power of two, up to 8, by which an image of |originWidth| by
+// |originHeight| can be reduced and still cover |downsampleWidth| by
+// |downsampleHeight|.
+extern "C" int32_t FX_GetDownsampleRatio(int32_t originWidth,
+                                         int32_t originHeight,
+                                         int32_t downsampleWidth,
+                                         int32_t downsampleHeight);
+
 #endif  // CORE_INCLUDE_FXCODEC_FX_CODEC_H_
@@ -942,7 +942,7 @@ class CFX_CountRef {
 
     CountedObj(const CountedObj& src) : ObjClass(src) {}
 
-    int m_RefCount;
+    FX_REFCOUNT m_RefCount;
   };
 
   CFX_CountRef() { m_pObject = NULL; }
@@ -958,16 +958,14 @@ class CFX_CountRef {
     if (!m_pObject) {
       return;
     }
-    m_pObject->m_RefCount--;
-    if (m_pObject->m_RefCount <= 0) {
+    if (--m_pObject->m_RefCount <= 0) {
       delete m_pObject;
     }
   }
 
   ObjClass* New() {
     if (m_pObject) {
-      m_pObject->m_RefCount--;
-      if (m_pObject->m_RefCount <= 0) {
+      if (--m_pObject->m_RefCount <= 0) {
         delete m_pObject;
       }
     }
@@ -981,8 +979,7 @@ class CFX_CountRef {
       ref.m_pObject->m_RefCount++;
     }
     if (m_pObject) {
-      m_pObject->m_RefCount--;
-      if (m_pObject->m_RefCount <= 0) {
+      if (--m_pObject->m_RefCount <= 0) {
         delete m_pObject;
       }
     }
@@ -994,8 +991,7 @@ class CFX_CountRef {
     if (!m_pObject) {
       return;
     }
-    m_pObject->m_RefCount--;
-    if (m_pObject->m_RefCount <= 0) {
+    if (--m_pObject->m_RefCount <= 0) {
       delete m_pObject;
     }
     m_pObject = NULL;
@@ -1026,8 +1022,7 @@ class CFX_CountRef {
     if (!m_pObject) {
       return;
     }
-    m_pObject->m_RefCount--;
-    if (m_pObject->m_RefCount <= 0) {
+    if (--m_pObject->m_RefCount <= 0) {
       delete m_pObject;
     }
     m_pObject = NULL;
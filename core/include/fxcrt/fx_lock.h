@@ -0,0 +1,39 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CORE_INCLUDE_FXCRT_FX_LOCK_H_
+#define CORE_INCLUDE_FXCRT_FX_LOCK_H_
+
+#include <mutex>
+
+// Holds |pLock| until it goes out of scope. A null lock is not taken, so code
+// that is only shared between threads in some modes can lock regardless.
+class CFX_AutoLock {
+ public:
+  explicit CFX_AutoLock(std::recursive_mutex* pLock) : m_pLock(pLock) {
+    if (m_pLock)
+      m_pLock->lock();
+  }
+  ~CFX_AutoLock() {
+    if (m_pLock)
+      m_pLock->unlock();
+  }
+
+ private:
+  CFX_AutoLock(const CFX_AutoLock&) = delete;
+  CFX_AutoLock& operator=(const CFX_AutoLock&) = delete;
+
+  std::recursive_mutex* const m_pLock;
+};
+
+// Turns on FX_GetGlobalLock() for the rest of the process. Called before a
+// document is first shared between threads.
+void FX_EnableGlobalLock();
+
+// Returns the lock for process-wide caches, such as the font manager, glyph
+// caches and codec state, or null until FX_EnableGlobalLock() is called. It
+// must be taken after any document lock and never held while taking one.
+std::recursive_mutex* FX_GetGlobalLock();
+
+#endif  // CORE_INCLUDE_FXCRT_FX_LOCK_H_
@@ -86,11 +86,20 @@ class IFX_FileRead : IFX_StreamRead {
 
   virtual FX_BOOL ReadBlock(void* buffer, FX_FILESIZE offset, size_t size) = 0;
   virtual FX_FILESIZE GetSize() = 0;
+
+  // Returns the whole contents of the file if they are resident in memory
+  // and stay valid and unchanged until this object is released. Returns NULL
+  // otherwise, in which case the contents must be read with ReadBlock().
+  virtual const uint8_t* GetDirectBuffer() { return nullptr; }
 };
 
 IFX_FileRead* FX_CreateFileRead(const FX_CHAR* filename);
 IFX_FileRead* FX_CreateFileRead(const FX_WCHAR* filename);
 
+// Maps |filename| into memory read-only. Returns NULL if the file cannot be
+// opened or mapped, or if the platform does not support mapping.
+IFX_FileRead* FX_CreateMappedFileRead(const FX_CHAR* filename);
+
 class IFX_FileStream : public IFX_FileRead, public IFX_FileWrite {
  public:
   virtual IFX_FileStream* Retain() = 0;
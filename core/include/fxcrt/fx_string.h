@@ -13,11 +13,24 @@
 #include "fx_memory.h"
 #include "fx_system.h"
 
+#ifdef PDF_ENABLE_SHARED_DOCUMENTS
+#include <atomic>
+#endif
+
 class CFX_BinaryBuf;
 class CFX_ByteString;
 class CFX_WideString;
 struct CFX_CharMap;
 
+// The reference count of string data and of CFX_CountRef objects. Builds
+// that let documents be shared between threads (see FPDF_LOAD_SHARED) copy
+// these from several threads at once, so the count is atomic there.
+#ifdef PDF_ENABLE_SHARED_DOCUMENTS
+typedef std::atomic<intptr_t> FX_REFCOUNT;
+#else
+typedef intptr_t FX_REFCOUNT;
+#endif
+
 // An immutable string with caller-provided storage which must outlive the
 // string itself.
 class CFX_ByteStringC {
@@ -316,7 +329,7 @@ class CFX_ByteString {
         FX_Free(this);
     }
 
-    intptr_t m_nRefs;  // Would prefer ssize_t, but no windows support.
+    FX_REFCOUNT m_nRefs;  // Would prefer ssize_t, but no windows support.
     FX_STRSIZE m_nDataLength;
     FX_STRSIZE m_nAllocLength;
     FX_CHAR m_String[1];
@@ -697,7 +710,7 @@ class CFX_WideString {
         FX_Free(this);
     }
 
-    intptr_t m_nRefs;  // Would prefer ssize_t, but no windows support.
+    FX_REFCOUNT m_nRefs;  // Would prefer ssize_t, but no windows support.
     FX_STRSIZE m_nDataLength;
     FX_STRSIZE m_nAllocLength;
     FX_WCHAR m_String[1];
@@ -317,4 +317,12 @@ int FXSYS_round(FX_FLOAT f);
 #define NEVER_INLINE __attribute__((__noinline__))
 #endif  // _FXM_PLATFORM_ == _FXM_PLATFORM_WINDOWS_
 
+// Defined when the target always has SSE2, so that code may use the
+// intrinsics without a runtime check.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDF_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #endif  // CORE_INCLUDE_FXCRT_FX_SYSTEM_H_
@@ -91,9 +91,11 @@ LOCAL_SRC_FILES := \
     src/fpdfapi/fpdf_page/fpdf_page.cpp \
     src/fpdfapi/fpdf_page/fpdf_page_colors.cpp \
     src/fpdfapi/fpdf_page/fpdf_page_doc.cpp \
+    src/fpdfapi/fpdf_page/fpdf_page_displaylist.cpp \
     src/fpdfapi/fpdf_page/fpdf_page_func.cpp \
     src/fpdfapi/fpdf_page/fpdf_page_graph_state.cpp \
     src/fpdfapi/fpdf_page/fpdf_page_image.cpp \
+    src/fpdfapi/fpdf_page/fpdf_page_objectindex.cpp \
     src/fpdfapi/fpdf_page/fpdf_page_parser.cpp \
     src/fpdfapi/fpdf_page/fpdf_page_parser_old.cpp \
     src/fpdfapi/fpdf_page/fpdf_page_path.cpp \
@@ -102,9 +104,11 @@ LOCAL_SRC_FILES := \
     src/fpdfapi/fpdf_parser/fpdf_parser_document.cpp \
     src/fpdfapi/fpdf_parser/fpdf_parser_encrypt.cpp \
     src/fpdfapi/fpdf_parser/fpdf_parser_fdf.cpp \
+    src/fpdfapi/fpdf_parser/fpdf_parser_filters.cpp \
     src/fpdfapi/fpdf_parser/fpdf_parser_objects.cpp \
     src/fpdfapi/fpdf_parser/fpdf_parser_parser.cpp \
     src/fpdfapi/fpdf_parser/fpdf_parser_utility.cpp \
+    src/fpdfapi/fpdf_parser/fpdf_parser_xrefindex.cpp \
     src/fpdfapi/fpdf_render/fpdf_render.cpp \
     src/fpdfapi/fpdf_render/fpdf_render_cache.cpp \
     src/fpdfapi/fpdf_render/fpdf_render_image.cpp \
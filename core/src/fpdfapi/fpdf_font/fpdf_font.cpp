@@ -358,6 +358,7 @@ CPDF_Font* CPDF_Font::GetStockFont(CPDF_Document* pDoc,
   if (font_id < 0) {
     return nullptr;
   }
+  CFX_AutoLock lock(FX_GetGlobalLock());
   CPDF_FontGlobals* pFontGlobals =
       CPDF_ModuleMgr::Get()->GetPageModule()->GetFontGlobals();
   CPDF_Font* pFont = pFontGlobals->Find(pDoc, font_id);
@@ -432,6 +433,7 @@ FX_BOOL CPDF_Font::Load() {
   if (!m_pFontDict) {
     return FALSE;
   }
+  CPDF_FontLock lock(this);
   CFX_ByteString type = m_pFontDict->GetString("Subtype");
   m_BaseFont = m_pFontDict->GetString("BaseFont");
   if (type == "MMType1") {
@@ -6,6 +6,9 @@
 
 #include "pageint.h"
 
+#include <algorithm>
+#include <thread>
+
 #include "core/include/fpdfapi/fpdf_module.h"
 #include "core/include/fpdfapi/fpdf_page.h"
 
@@ -41,6 +44,10 @@ void CPDF_PageObject::Copy(const CPDF_PageObject* pSrc) {
   m_Top = pSrc->m_Top;
   m_Bottom = pSrc->m_Bottom;
 }
+void CPDF_PageObject::InvalidateObjectIndex() {
+  if (m_pIndexOwner)
+    const_cast<CPDF_PageObjects*>(m_pIndexOwner)->InvalidateObjectIndex();
+}
 void CPDF_PageObject::AppendClipPath(CPDF_Path path,
                                      int type,
                                      FX_BOOL bAutoMerge) {
@@ -315,6 +322,7 @@ void CPDF_TextObject::SetText(int nChars,
 FX_FLOAT CPDF_TextObject::GetCharWidth(FX_DWORD charcode) const {
   FX_FLOAT fontsize = m_TextState.GetFontSize() / 1000;
   CPDF_Font* pFont = m_TextState.GetFont();
+  CPDF_FontLock lock(pFont);
   FX_BOOL bVertWriting = FALSE;
   CPDF_CIDFont* pCIDFont = pFont->GetCIDFont();
   if (pCIDFont) {
@@ -348,6 +356,7 @@ FX_FLOAT CPDF_TextObject::GetSpaceCharWidth() const {
 
 void CPDF_TextObject::GetCharRect(int index, CFX_FloatRect& rect) const {
   CPDF_Font* pFont = m_TextState.GetFont();
+  CPDF_FontLock lock(pFont);
   FX_BOOL bVertWriting = FALSE;
   CPDF_CIDFont* pCIDFont = pFont->GetCIDFont();
   if (pCIDFont) {
@@ -400,6 +409,7 @@ void CPDF_TextObject::CalcPositionData(FX_FLOAT* pTextAdvanceX,
   FX_FLOAT min_y = 10000 * 1.0f;
   FX_FLOAT max_y = -10000 * 1.0f;
   CPDF_Font* pFont = m_TextState.GetFont();
+  CPDF_FontLock lock(pFont);
   FX_BOOL bVertWriting = FALSE;
   CPDF_CIDFont* pCIDFont = pFont->GetCIDFont();
   if (pCIDFont) {
@@ -528,6 +538,7 @@ void CPDF_TextObject::CalcPositionData(FX_FLOAT* pTextAdvanceX,
 
 void CPDF_TextObject::CalcCharPos(FX_FLOAT* pPosArray) const {
   CPDF_Font* pFont = m_TextState.GetFont();
+  CPDF_FontLock lock(pFont);
   FX_BOOL bVertWriting = FALSE;
   CPDF_CIDFont* pCIDFont = pFont->GetCIDFont();
   if (pCIDFont) {
@@ -645,8 +656,13 @@ void CPDF_ShadingObject::CalcBoundingBox() {
   m_Right = rect.right;
   m_Top = rect.top;
 }
+CPDF_FormObject::CPDF_FormObject() {
+  m_Type = PDFPAGE_FORM;
+  m_pForm = NULL;
+}
 CPDF_FormObject::~CPDF_FormObject() {
-  delete m_pForm;
+  if (m_pForm && !m_pOwnedForm)
+    m_pForm->m_pDocument->GetPageData()->ReleaseForm(m_pForm);
 }
 void CPDF_FormObject::Transform(const CFX_Matrix& matrix) {
   m_FormMatrix.Concat(matrix);
@@ -654,8 +670,18 @@ void CPDF_FormObject::Transform(const CFX_Matrix& matrix) {
 }
 void CPDF_FormObject::CopyData(const CPDF_PageObject* pSrc) {
   const CPDF_FormObject* pSrcObj = (const CPDF_FormObject*)pSrc;
-  delete m_pForm;
-  m_pForm = pSrcObj->m_pForm->Clone();
+  // Parsed forms are shared and never change, so copies share them too.
+  CPDF_DocPageData* pPageData = pSrcObj->m_pForm->m_pDocument->GetPageData();
+  CPDF_Form* pOldForm = m_pForm;
+  std::unique_ptr<CPDF_Form> pOldOwnedForm(std::move(m_pOwnedForm));
+  m_pForm = pPageData->AddFormRef(pSrcObj->m_pForm);
+  if (!m_pForm) {
+    // A form the cache does not hold, such as a copy, is copied again.
+    m_pOwnedForm.reset(pSrcObj->m_pForm->Clone());
+    m_pForm = m_pOwnedForm.get();
+  }
+  if (!pOldOwnedForm)
+    pPageData->ReleaseForm(pOldForm);
   m_FormMatrix = pSrcObj->m_FormMatrix;
 }
 void CPDF_FormObject::CalcBoundingBox() {
@@ -673,21 +699,21 @@ CPDF_PageObjects::CPDF_PageObjects(FX_BOOL bReleaseMembers)
       m_pPageResources(nullptr),
       m_pResources(nullptr),
       m_Transparency(0),
-      m_ObjectList(128),
+      m_bObjectIndex(FALSE),
       m_bBackgroundAlphaNeeded(FALSE),
       m_bHasImageMask(FALSE),
+      m_bUsesPageResources(FALSE),
       m_bReleaseMembers(bReleaseMembers),
       m_pParser(nullptr),
       m_ParseState(CONTENT_NOT_PARSED) {}
 CPDF_PageObjects::~CPDF_PageObjects() {
   delete m_pParser;
   if (!m_bReleaseMembers) {
+    InvalidateObjectIndex();
     return;
   }
-  FX_POSITION pos = m_ObjectList.GetHeadPosition();
-  while (pos) {
-    delete (CPDF_PageObject*)m_ObjectList.GetNext(pos);
-  }
+  for (CPDF_PageObject* pObj : m_ObjectList)
+    delete pObj;
 }
 void CPDF_PageObjects::ContinueParse(IFX_Pause* pPause) {
   if (!m_pParser) {
@@ -702,44 +728,80 @@ void CPDF_PageObjects::ContinueParse(IFX_Pause* pPause) {
 }
 FX_POSITION CPDF_PageObjects::InsertObject(FX_POSITION posInsertAfter,
                                            CPDF_PageObject* pNewObject) {
-  if (!posInsertAfter) {
-    return m_ObjectList.AddHead(pNewObject);
-  }
-  return m_ObjectList.InsertAfter(posInsertAfter, pNewObject);
+  size_t index = posInsertAfter ? PositionToIndex(posInsertAfter) + 1 : 0;
+  m_ObjectList.insert(m_ObjectList.begin() + index, pNewObject);
+  InvalidateObjectIndex();
+  return IndexToPosition(index);
 }
 int CPDF_PageObjects::GetObjectIndex(CPDF_PageObject* pObj) const {
-  int index = 0;
-  FX_POSITION pos = m_ObjectList.GetHeadPosition();
-  while (pos) {
-    CPDF_PageObject* pThisObj = (CPDF_PageObject*)m_ObjectList.GetNext(pos);
-    if (pThisObj == pObj) {
-      return index;
-    }
-    index++;
-  }
-  return -1;
+  auto it = std::find(m_ObjectList.begin(), m_ObjectList.end(), pObj);
+  return it != m_ObjectList.end() ? it - m_ObjectList.begin() : -1;
 }
 CPDF_PageObject* CPDF_PageObjects::GetObjectByIndex(int index) const {
-  FX_POSITION pos = m_ObjectList.FindIndex(index);
-  return pos ? static_cast<CPDF_PageObject*>(m_ObjectList.GetAt(pos)) : nullptr;
+  if (index < 0 || (size_t)index >= m_ObjectList.size())
+    return nullptr;
+  return m_ObjectList[index];
+}
+FX_BOOL CPDF_PageObjects::BuildObjectIndex() {
+  if (!IsParsed())
+    return FALSE;
+
+  m_bObjectIndex = TRUE;
+  return TRUE;
+}
+void CPDF_PageObjects::InvalidateObjectIndex() {
+  if (!m_pObjectIndex)
+    return;
+
+  // Objects this list does not own may outlive it.
+  for (CPDF_PageObject* pObj : m_ObjectList) {
+    if (pObj->m_pIndexOwner == this)
+      pObj->m_pIndexOwner = nullptr;
+  }
+  m_pObjectIndex.reset();
+}
+void CPDF_PageObjects::UpdateObjectIndex() const {
+  if (!m_bObjectIndex || m_pObjectIndex)
+    return;
+
+  m_pObjectIndex.reset(new CPDF_PageObjectIndex(m_ObjectList));
+  for (CPDF_PageObject* pObj : m_ObjectList)
+    pObj->m_pIndexOwner = this;
+}
+void CPDF_PageObjects::GetObjectsInRect(
+    const CFX_FloatRect& rect,
+    std::vector<FX_POSITION>* pPositions) const {
+  if (!m_bObjectIndex) {
+    for (size_t i = 0; i < m_ObjectList.size(); ++i) {
+      const CPDF_PageObject* pObj = m_ObjectList[i];
+      if (pObj->m_Left > rect.right || pObj->m_Right < rect.left ||
+          pObj->m_Bottom > rect.top || pObj->m_Top < rect.bottom) {
+        continue;
+      }
+      pPositions->push_back(IndexToPosition(i));
+    }
+    return;
+  }
+  UpdateObjectIndex();
+  std::vector<FX_DWORD> indices;
+  m_pObjectIndex->Query(rect, &indices);
+  std::sort(indices.begin(), indices.end());
+  for (FX_DWORD index : indices)
+    pPositions->push_back(IndexToPosition(index));
 }
 void CPDF_PageObjects::Transform(const CFX_Matrix& matrix) {
-  FX_POSITION pos = m_ObjectList.GetHeadPosition();
-  while (pos) {
-    CPDF_PageObject* pObj = (CPDF_PageObject*)m_ObjectList.GetNext(pos);
+  for (CPDF_PageObject* pObj : m_ObjectList)
     pObj->Transform(matrix);
-  }
+  InvalidateObjectIndex();
 }
 CFX_FloatRect CPDF_PageObjects::CalcBoundingBox() const {
-  if (m_ObjectList.GetCount() == 0) {
+  if (m_ObjectList.empty()) {
     return CFX_FloatRect(0, 0, 0, 0);
   }
   FX_FLOAT left, right, top, bottom;
   left = bottom = 1000000 * 1.0f;
   right = top = -1000000 * 1.0f;
-  FX_POSITION pos = m_ObjectList.GetHeadPosition();
-  while (pos) {
-    CPDF_PageObject* pObj = (CPDF_PageObject*)m_ObjectList.GetNext(pos);
+  for (CPDF_PageObject* pObj : m_ObjectList) {
     if (left > pObj->m_Left) {
       left = pObj->m_Left;
     }
@@ -778,13 +840,13 @@ void CPDF_PageObjects::ClearCacheObjects() {
   m_ParseState = CONTENT_NOT_PARSED;
   delete m_pParser;
   m_pParser = NULL;
+  InvalidateObjectIndex();
+  m_bObjectIndex = FALSE;
   if (m_bReleaseMembers) {
-    FX_POSITION pos = m_ObjectList.GetHeadPosition();
-    while (pos) {
-      delete (CPDF_PageObject*)m_ObjectList.GetNext(pos);
-    }
+    for (CPDF_PageObject* pObj : m_ObjectList)
+      delete pObj;
   }
-  m_ObjectList.RemoveAll();
+  m_ObjectList.clear();
 }
 CPDF_Page::CPDF_Page() {
   m_pPageRender = NULL;
@@ -803,6 +865,8 @@ void CPDF_Page::Load(CPDF_Document* pDocument,
     m_pPageResources = m_pResources = NULL;
     return;
   }
+  if (m_pDocument)
+    m_pDocument->AddLoadedPage(pPageDict);
   CPDF_Object* pageAttr = GetPageAttr("Resources");
   m_pResources = pageAttr ? pageAttr->GetDict() : NULL;
   m_pPageResources = m_pResources;
@@ -874,6 +938,8 @@ void CPDF_Page::ParseContent(CPDF_ParseOptions* pOptions, FX_BOOL bReParse) {
   ContinueParse(NULL);
 }
 CPDF_Page::~CPDF_Page() {
+  if (m_pDocument && m_pFormDict)
+    m_pDocument->RemoveLoadedPage(m_pFormDict);
   if (m_pPageRender) {
     IPDF_RenderModule* pModule = CPDF_ModuleMgr::Get()->GetRenderModule();
     pModule->DestroyPageCache(m_pPageRender);
@@ -944,11 +1010,8 @@ void CPDF_Form::ParseContent(CPDF_AllStates* pGraphicStates,
 CPDF_Form* CPDF_Form::Clone() const {
   CPDF_Form* pClone =
       new CPDF_Form(m_pDocument, m_pPageResources, m_pFormStream, m_pResources);
-  FX_POSITION pos = m_ObjectList.GetHeadPosition();
-  while (pos) {
-    CPDF_PageObject* pObj = (CPDF_PageObject*)m_ObjectList.GetNext(pos);
-    pClone->m_ObjectList.AddTail(pObj->Clone());
-  }
+  for (CPDF_PageObject* pObj : m_ObjectList)
+    pClone->m_ObjectList.push_back(pObj->Clone());
   return pClone;
 }
 void CPDF_Page::GetDisplayMatrix(CFX_Matrix& matrix,
@@ -1010,4 +1073,6 @@ CPDF_ParseOptions::CPDF_ParseOptions() {
   m_bMarkedContent = TRUE;
   m_bSeparateForm = TRUE;
   m_bDecodeInlineImage = FALSE;
+  m_bShareStates = TRUE;
+  m_bDecodeAhead = std::thread::hardware_concurrency() > 1;
 }
@@ -13,6 +13,7 @@
 #include "core/include/fpdfapi/fpdf_page.h"
 #include "core/include/fpdfapi/fpdf_module.h"
 #include "core/include/fxcodec/fx_codec.h"
+#include "core/include/fxcrt/fx_lock.h"
 
 namespace {
 
@@ -61,6 +62,88 @@ void ReverseRGB(uint8_t* pDestBuf, const uint8_t* pSrcBuf, int pixels) {
   }
 }
 
+// The std conversion of CMYK: each of C, M and Y added to K and inverted.
+void StdCMYK_to_BGR(uint8_t* pDestBuf, const uint8_t* pSrcBuf, int pixels) {
+  int i = 0;
+#ifdef PDF_USE_SSE2
+  const __m128i ones = _mm_set1_epi8((char)0xff);
+  for (; i + 4 <= pixels; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrcBuf));
+    __m128i k = _mm_srli_epi32(v, 24);
+    k = _mm_or_si128(k, _mm_slli_epi32(k, 8));
+    k = _mm_or_si128(k, _mm_slli_epi32(k, 16));
+    // 255 - min(255, c + k) == max(0, (255 - c) - k).
+    uint8_t rgbx[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgbx),
+                     _mm_subs_epu8(_mm_xor_si128(v, ones), k));
+    for (int j = 0; j < 16; j += 4) {
+      *pDestBuf++ = rgbx[j + 2];
+      *pDestBuf++ = rgbx[j + 1];
+      *pDestBuf++ = rgbx[j];
+    }
+    pSrcBuf += 16;
+  }
+#endif
+  for (; i < pixels; i++) {
+    uint8_t k = pSrcBuf[3];
+    pDestBuf[2] = 255 - std::min(255, pSrcBuf[0] + k);
+    pDestBuf[1] = 255 - std::min(255, pSrcBuf[1] + k);
+    pDestBuf[0] = 255 - std::min(255, pSrcBuf[2] + k);
+    pSrcBuf += 4;
+    pDestBuf += 3;
+  }
+}
+
+// The BGR value of each 8-bit value of a single component colour space, as
+// CPDF_ColorSpace::TranslateImageLine() computes it, built on first use.
+// For Separation and DeviceN this saves running the tint transform for
+// every pixel. EnableStdConversion() changes what the alternate space
+// returns, so there is one table with the std conversion and one without.
+class CPDF_ComponentLUT {
+ public:
+  CPDF_ComponentLUT() : m_pTables() {}
+  ~CPDF_ComponentLUT() {
+    FX_Free(m_pTables[0]);
+    FX_Free(m_pTables[1]);
+  }
+
+  void Translate(const CPDF_ColorSpace* pCS,
+                 FX_BOOL bStdConversion,
+                 uint8_t* pDestBuf,
+                 const uint8_t* pSrcBuf,
+                 int pixels) {
+    uint8_t*& pTable = m_pTables[bStdConversion ? 1 : 0];
+    {
+      CFX_AutoLock lock(FX_GetGlobalLock());
+      if (!pTable)
+        pTable = Build(pCS);
+    }
+    for (int i = 0; i < pixels; i++) {
+      const uint8_t* pColor = pTable + pSrcBuf[i] * 3;
+      *pDestBuf++ = pColor[0];
+      *pDestBuf++ = pColor[1];
+      *pDestBuf++ = pColor[2];
+    }
+  }
+
+ private:
+  static uint8_t* Build(const CPDF_ColorSpace* pCS) {
+    uint8_t* pTable = FX_Alloc2D(uint8_t, 256, 3);
+    FX_BOOL bIndexed = pCS->GetFamily() == PDFCS_INDEXED;
+    for (int i = 0; i < 256; i++) {
+      FX_FLOAT value = bIndexed ? (FX_FLOAT)i : (FX_FLOAT)i / 255;
+      FX_FLOAT R = 0, G = 0, B = 0;
+      pCS->GetRGB(&value, R, G, B);
+      pTable[i * 3] = (int32_t)(B * 255);
+      pTable[i * 3 + 1] = (int32_t)(G * 255);
+      pTable[i * 3 + 2] = (int32_t)(R * 255);
+    }
+    return pTable;
+  }
+
+  uint8_t* m_pTables[2];
+};
+
 }  // namespace
 
 CPDF_DeviceCS::CPDF_DeviceCS(CPDF_Document* pDoc, int family)
@@ -194,20 +277,10 @@ void CPDF_DeviceCS::TranslateImageLine(uint8_t* pDestBuf,
       *pDestBuf++ = pSrcBuf[i];
       *pDestBuf++ = pSrcBuf[i];
     }
+  } else if (!m_dwStdConversion) {
+    AdobeCMYK_to_sRGBLine(pDestBuf, pSrcBuf, pixels);
   } else {
-    for (int i = 0; i < pixels; i++) {
-      if (!m_dwStdConversion) {
-        AdobeCMYK_to_sRGB1(pSrcBuf[0], pSrcBuf[1], pSrcBuf[2], pSrcBuf[3],
-                           pDestBuf[2], pDestBuf[1], pDestBuf[0]);
-      } else {
-        uint8_t k = pSrcBuf[3];
-        pDestBuf[2] = 255 - std::min(255, pSrcBuf[0] + k);
-        pDestBuf[1] = 255 - std::min(255, pSrcBuf[1] + k);
-        pDestBuf[0] = 255 - std::min(255, pSrcBuf[2] + k);
-      }
-      pSrcBuf += 4;
-      pDestBuf += 3;
-    }
+    StdCMYK_to_BGR(pDestBuf, pSrcBuf, pixels);
   }
 }
 const uint8_t g_sRGBSamples1[] = {
@@ -604,19 +677,107 @@ FX_BOOL CPDF_LabCS::SetRGB(FX_FLOAT* pBuf,
                            FX_FLOAT B) const {
   return FALSE;
 }
+#ifdef PDF_USE_SSE2
+namespace {
+
+// (int32_t)(RGB_Conversion(c) * 255) by the scale RGB_Conversion() computes.
+class CPDF_sRGBByteTable {
+ public:
+  CPDF_sRGBByteTable() {
+    for (int scale = 0; scale < 1024; scale++) {
+      FX_FLOAT c = scale < 192 ? g_sRGBSamples1[scale] / 255.0f
+                               : g_sRGBSamples2[scale / 4 - 48] / 255.0f;
+      m_Bytes[scale] = (int32_t)(c * 255);
+    }
+  }
+
+  uint8_t operator[](int scale) const { return m_Bytes[scale]; }
+
+ private:
+  uint8_t m_Bytes[1024];
+};
+
+// The clamped RGB_Conversion() scale of four linear components.
+__m128i sRGBScale(__m128 c) {
+  c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+  return _mm_cvttps_epi32(_mm_mul_ps(c, _mm_set1_ps(1023.0f)));
+}
+
+// f^-1 of CIELAB for four values, as in CPDF_LabCS::GetRGB(): |scale| * t^3
+// above the knee and linear below it.
+__m128 LabInverse(__m128 t, FX_FLOAT scale) {
+  __m128 cube = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(scale), t), t), t);
+  __m128 linear = _mm_mul_ps(_mm_set1_ps(scale * 0.12842f),
+                             _mm_sub_ps(t, _mm_set1_ps(0.1379f)));
+  __m128 knee = _mm_cmplt_ps(t, _mm_set1_ps(0.2069f));
+  return _mm_or_ps(_mm_and_ps(knee, linear), _mm_andnot_ps(knee, cube));
+}
+
+// Converts four 8-bit Lab pixels to BGR with the same float arithmetic as
+// CPDF_LabCS::TranslateImageLine() does one pixel at a time.
+void Lab_to_BGR4(uint8_t* pDestBuf, const uint8_t* pSrcBuf) {
+  static const CPDF_sRGBByteTable s_Bytes;
+  __m128 lstar = _mm_div_ps(
+      _mm_cvtepi32_ps(_mm_setr_epi32(pSrcBuf[0] * 100, pSrcBuf[3] * 100,
+                                     pSrcBuf[6] * 100, pSrcBuf[9] * 100)),
+      _mm_set1_ps(255.0f));
+  __m128 astar = _mm_cvtepi32_ps(
+      _mm_setr_epi32(pSrcBuf[1] - 128, pSrcBuf[4] - 128, pSrcBuf[7] - 128,
+                     pSrcBuf[10] - 128));
+  __m128 bstar = _mm_cvtepi32_ps(
+      _mm_setr_epi32(pSrcBuf[2] - 128, pSrcBuf[5] - 128, pSrcBuf[8] - 128,
+                     pSrcBuf[11] - 128));
+  __m128 M = _mm_div_ps(_mm_add_ps(lstar, _mm_set1_ps(16.0f)),
+                        _mm_set1_ps(116.0f));
+  __m128 L = _mm_add_ps(M, _mm_div_ps(astar, _mm_set1_ps(500.0f)));
+  __m128 N = _mm_sub_ps(M, _mm_div_ps(bstar, _mm_set1_ps(200.0f)));
+  __m128 X = LabInverse(L, 0.957f);
+  __m128 Y = LabInverse(M, 1.0f);
+  __m128 Z = LabInverse(N, 1.0889f);
+  __m128 R1 = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.2410f), X),
+                                    _mm_mul_ps(_mm_set1_ps(1.5374f), Y)),
+                         _mm_mul_ps(_mm_set1_ps(0.4986f), Z));
+  __m128 G1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(-0.9692f), X),
+                                    _mm_mul_ps(_mm_set1_ps(1.8760f), Y)),
+                         _mm_mul_ps(_mm_set1_ps(0.0416f), Z));
+  __m128 B1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(0.0556f), X),
+                                    _mm_mul_ps(_mm_set1_ps(0.2040f), Y)),
+                         _mm_mul_ps(_mm_set1_ps(1.0570f), Z));
+  int32_t scales[3][4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(scales[0]), sRGBScale(B1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(scales[1]), sRGBScale(G1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(scales[2]), sRGBScale(R1));
+  for (int i = 0; i < 4; i++) {
+    *pDestBuf++ = s_Bytes[scales[0][i]];
+    *pDestBuf++ = s_Bytes[scales[1][i]];
+    *pDestBuf++ = s_Bytes[scales[2][i]];
+  }
+}
+
+}  // namespace
+#endif  // PDF_USE_SSE2
+
 void CPDF_LabCS::TranslateImageLine(uint8_t* pDestBuf,
                                     const uint8_t* pSrcBuf,
                                     int pixels,
                                     int image_width,
                                     int image_height,
                                     FX_BOOL bTransMask) const {
-  for (int i = 0; i < pixels; i++) {
+  int i = 0;
+#ifdef PDF_USE_SSE2
+  for (; i + 4 <= pixels; i += 4) {
+    Lab_to_BGR4(pDestBuf, pSrcBuf);
+    pDestBuf += 12;
+    pSrcBuf += 12;
+  }
+#endif
+  for (; i < pixels; i++) {
     FX_FLOAT lab[3];
     FX_FLOAT R, G, B;
     lab[0] = (pSrcBuf[0] * 100 / 255.0f);
     lab[1] = (FX_FLOAT)(pSrcBuf[1] - 128);
     lab[2] = (FX_FLOAT)(pSrcBuf[2] - 128);
-    GetRGB(lab, R, G, B);
+    CPDF_LabCS::GetRGB(lab, R, G, B);
     pDestBuf[0] = (int32_t)(B * 255);
     pDestBuf[1] = (int32_t)(G * 255);
     pDestBuf[2] = (int32_t)(R * 255);
@@ -777,6 +938,7 @@ FX_BOOL CPDF_ICCBasedCS::GetRGB(FX_FLOAT* pBuf,
     return TRUE;
   }
   FX_FLOAT rgb[3];
+  CFX_AutoLock lock(FX_GetGlobalLock());
   pIccModule->SetComponents(m_nComponents);
   pIccModule->Translate(m_pProfile->m_pTransform, pBuf, rgb);
   R = rgb[0];
@@ -824,25 +986,30 @@ void CPDF_ICCBasedCS::TranslateImageLine(uint8_t* pDestBuf,
       nMaxColors *= 52;
     }
     if (m_nComponents > 3 || image_width * image_height < nMaxColors * 3 / 2) {
+      CFX_AutoLock lock(FX_GetGlobalLock());
       CPDF_ModuleMgr::Get()->GetIccModule()->TranslateScanline(
           m_pProfile->m_pTransform, pDestBuf, pSrcBuf, pixels);
     } else {
-      if (!m_pCache) {
-        ((CPDF_ICCBasedCS*)this)->m_pCache = FX_Alloc2D(uint8_t, nMaxColors, 3);
-        uint8_t* temp_src = FX_Alloc2D(uint8_t, nMaxColors, m_nComponents);
-        uint8_t* pSrc = temp_src;
-        for (int i = 0; i < nMaxColors; i++) {
-          FX_DWORD color = i;
-          FX_DWORD order = nMaxColors / 52;
-          for (int c = 0; c < m_nComponents; c++) {
-            *pSrc++ = (uint8_t)(color / order * 5);
-            color %= order;
-            order /= 52;
+      {
+        CFX_AutoLock lock(FX_GetGlobalLock());
+        if (!m_pCache) {
+          ((CPDF_ICCBasedCS*)this)->m_pCache =
+              FX_Alloc2D(uint8_t, nMaxColors, 3);
+          uint8_t* temp_src = FX_Alloc2D(uint8_t, nMaxColors, m_nComponents);
+          uint8_t* pSrc = temp_src;
+          for (int i = 0; i < nMaxColors; i++) {
+            FX_DWORD color = i;
+            FX_DWORD order = nMaxColors / 52;
+            for (int c = 0; c < m_nComponents; c++) {
+              *pSrc++ = (uint8_t)(color / order * 5);
+              color %= order;
+              order /= 52;
+            }
           }
+          CPDF_ModuleMgr::Get()->GetIccModule()->TranslateScanline(
+              m_pProfile->m_pTransform, m_pCache, temp_src, nMaxColors);
+          FX_Free(temp_src);
         }
-        CPDF_ModuleMgr::Get()->GetIccModule()->TranslateScanline(
-            m_pProfile->m_pTransform, m_pCache, temp_src, nMaxColors);
-        FX_Free(temp_src);
       }
       for (int i = 0; i < pixels; i++) {
         int index = 0;
@@ -877,6 +1044,12 @@ class CPDF_IndexedCS : public CPDF_ColorSpace {
                  FX_FLOAT& B) const override;
   CPDF_ColorSpace* GetBaseCS() const override;
   void EnableStdConversion(FX_BOOL bEnabled) override;
+  void TranslateImageLine(uint8_t* pDestBuf,
+                          const uint8_t* pSrcBuf,
+                          int pixels,
+                          int image_width,
+                          int image_height,
+                          FX_BOOL bTransMask = FALSE) const override;
 
   CPDF_ColorSpace* m_pBaseCS;
   CPDF_CountedColorSpace* m_pCountedBaseCS;
@@ -884,6 +1057,7 @@ class CPDF_IndexedCS : public CPDF_ColorSpace {
   int m_MaxIndex;
   CFX_ByteString m_Table;
   FX_FLOAT* m_pCompMinMax;
+  mutable CPDF_ComponentLUT m_LUT;
 };
 CPDF_IndexedCS::~CPDF_IndexedCS() {
   FX_Free(m_pCompMinMax);
@@ -964,6 +1138,14 @@ void CPDF_IndexedCS::EnableStdConversion(FX_BOOL bEnabled) {
     m_pBaseCS->EnableStdConversion(bEnabled);
   }
 }
+void CPDF_IndexedCS::TranslateImageLine(uint8_t* pDestBuf,
+                                        const uint8_t* pSrcBuf,
+                                        int pixels,
+                                        int image_width,
+                                        int image_height,
+                                        FX_BOOL bTransMask) const {
+  m_LUT.Translate(this, !!m_dwStdConversion, pDestBuf, pSrcBuf, pixels);
+}
 #define MAX_PATTERN_COLORCOMPS 16
 typedef struct _PatternValue {
   CPDF_Pattern* m_pPattern;
@@ -1034,10 +1216,17 @@ class CPDF_SeparationCS : public CPDF_ColorSpace {
                  FX_FLOAT& G,
                  FX_FLOAT& B) const override;
   void EnableStdConversion(FX_BOOL bEnabled) override;
+  void TranslateImageLine(uint8_t* pDestBuf,
+                          const uint8_t* pSrcBuf,
+                          int pixels,
+                          int image_width,
+                          int image_height,
+                          FX_BOOL bTransMask = FALSE) const override;
 
   CPDF_ColorSpace* m_pAltCS;
   CPDF_Function* m_pFunc;
   enum { None, All, Colorant } m_Type;
+  mutable CPDF_ComponentLUT m_LUT;
 };
 CPDF_SeparationCS::~CPDF_SeparationCS() {
   if (m_pAltCS) {
@@ -1114,6 +1303,14 @@ void CPDF_SeparationCS::EnableStdConversion(FX_BOOL bEnabled) {
     m_pAltCS->EnableStdConversion(bEnabled);
   }
 }
+void CPDF_SeparationCS::TranslateImageLine(uint8_t* pDestBuf,
+                                           const uint8_t* pSrcBuf,
+                                           int pixels,
+                                           int image_width,
+                                           int image_height,
+                                           FX_BOOL bTransMask) const {
+  m_LUT.Translate(this, !!m_dwStdConversion, pDestBuf, pSrcBuf, pixels);
+}
 class CPDF_DeviceNCS : public CPDF_ColorSpace {
  public:
   explicit CPDF_DeviceNCS(CPDF_Document* pDoc)
@@ -1133,9 +1330,16 @@ class CPDF_DeviceNCS : public CPDF_ColorSpace {
                  FX_FLOAT& G,
                  FX_FLOAT& B) const override;
   void EnableStdConversion(FX_BOOL bEnabled) override;
+  void TranslateImageLine(uint8_t* pDestBuf,
+                          const uint8_t* pSrcBuf,
+                          int pixels,
+                          int image_width,
+                          int image_height,
+                          FX_BOOL bTransMask = FALSE) const override;
 
   CPDF_ColorSpace* m_pAltCS;
   CPDF_Function* m_pFunc;
+  mutable CPDF_ComponentLUT m_LUT;
 };
 CPDF_DeviceNCS::~CPDF_DeviceNCS() {
   delete m_pFunc;
@@ -1192,6 +1396,50 @@ void CPDF_DeviceNCS::EnableStdConversion(FX_BOOL bEnabled) {
     m_pAltCS->EnableStdConversion(bEnabled);
   }
 }
+void CPDF_DeviceNCS::TranslateImageLine(uint8_t* pDestBuf,
+                                        const uint8_t* pSrcBuf,
+                                        int pixels,
+                                        int image_width,
+                                        int image_height,
+                                        FX_BOOL bTransMask) const {
+  if (m_nComponents == 1) {
+    m_LUT.Translate(this, !!m_dwStdConversion, pDestBuf, pSrcBuf, pixels);
+    return;
+  }
+  if (m_nComponents > 4) {
+    CPDF_ColorSpace::TranslateImageLine(pDestBuf, pSrcBuf, pixels, image_width,
+                                        image_height, bTransMask);
+    return;
+  }
+  // Too many colours for a table, but tint transformed images tend to use
+  // few of them: remember the recent ones by their packed components.
+  const int kCacheSize = 256;
+  FX_DWORD keys[kCacheSize];
+  uint8_t colors[kCacheSize][3];
+  bool filled[kCacheSize] = {};
+  FX_FLOAT comps[4];
+  for (int i = 0; i < pixels; i++) {
+    FX_DWORD key = 0;
+    for (int j = 0; j < m_nComponents; j++)
+      key = (key << 8) | pSrcBuf[j];
+    int slot = (key * 2654435761u) >> 24;
+    if (!filled[slot] || keys[slot] != key) {
+      for (int j = 0; j < m_nComponents; j++)
+        comps[j] = (FX_FLOAT)pSrcBuf[j] / 255;
+      FX_FLOAT R = 0, G = 0, B = 0;
+      GetRGB(comps, R, G, B);
+      keys[slot] = key;
+      colors[slot][0] = (int32_t)(B * 255);
+      colors[slot][1] = (int32_t)(G * 255);
+      colors[slot][2] = (int32_t)(R * 255);
+      filled[slot] = true;
+    }
+    *pDestBuf++ = colors[slot][0];
+    *pDestBuf++ = colors[slot][1];
+    *pDestBuf++ = colors[slot][2];
+    pSrcBuf += m_nComponents;
+  }
+}
 
 CPDF_ColorSpace* CPDF_ColorSpace::GetStockCS(int family) {
   return CPDF_ModuleMgr::Get()->GetPageModule()->GetStockCS(family);
@@ -0,0 +1,260 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/include/fpdfapi/fpdf_module.h"
+#include "core/include/fpdfapi/fpdf_page.h"
+#include "core/include/fpdfapi/fpdf_parser.h"
+#include "core/include/fpdfapi/fpdf_resource.h"
+#include "core/include/fxcodec/fx_codec.h"
+#include "core/include/fxge/fx_dib.h"
+#include "testing/embedder_test.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/utils/path_service.h"
+
+class FPDFPageColorsEmbeddertest : public EmbedderTest {};
+
+namespace {
+
+using ScopedFileStream =
+    std::unique_ptr<IFX_FileStream, ReleaseDeleter<IFX_FileStream>>;
+using ScopedObject = std::unique_ptr<CPDF_Object, ReleaseDeleter<CPDF_Object>>;
+
+struct ReleaseCSDeleter {
+  void operator()(CPDF_ColorSpace* pCS) const { pCS->ReleaseCS(); }
+};
+using ScopedColorSpace = std::unique_ptr<CPDF_ColorSpace, ReleaseCSDeleter>;
+
+ScopedObject ParseObject(CPDF_Document* pDoc, std::string text) {
+  ScopedFileStream stream(FX_CreateMemoryStream(
+      reinterpret_cast<uint8_t*>(&text[0]), text.size(), FALSE));
+  CPDF_SyntaxParser parser;
+  parser.InitParser(stream.get(), 0);
+  return ScopedObject(parser.GetObject(pDoc, 0, 0, nullptr, FALSE));
+}
+
+// Adds a type 4 function mapping two inputs to three outputs, and returns a
+// reference to it.
+std::string AddTwoInputFunction(CPDF_Document* pDoc) {
+  static const char kCode[] = "{ 2 copy add 2 div }";
+  ScopedObject pDict = ParseObject(
+      pDoc, "<< /FunctionType 4 /Domain [0 1 0 1] /Range [0 1 0 1 0 1] >>");
+  uint8_t* pData = FX_Alloc(uint8_t, sizeof(kCode) - 1);
+  FXSYS_memcpy(pData, kCode, sizeof(kCode) - 1);
+  FX_DWORD objnum = pDoc->AddIndirectObject(
+      new CPDF_Stream(pData, sizeof(kCode) - 1,
+                      ToDictionary(pDict.release())));
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%u 0 R", objnum);
+  return buf;
+}
+
+// Pseudo-random pixels with |nComps| components below |limit|, every other
+// run of eight repeating its first pixel.
+std::vector<uint8_t> MakePixels(int pixels, int nComps, int limit) {
+  std::vector<uint8_t> data(pixels * nComps);
+  unsigned seed = 1;
+  for (int i = 0; i < pixels; ++i) {
+    for (int j = 0; j < nComps; ++j) {
+      seed = seed * 1103515245 + 12345;
+      data[i * nComps + j] = (seed >> 16) % limit;
+    }
+    if (i % 16 >= 9)
+      std::copy_n(&data[(i - 1) * nComps], nComps, &data[i * nComps]);
+  }
+  return data;
+}
+
+// TranslateImageLine() as it was before the batch converters: a GetRGB()
+// call for every pixel.
+std::vector<uint8_t> TranslatePerPixel(const CPDF_ColorSpace* pCS,
+                                       const std::vector<uint8_t>& src,
+                                       bool bStdConversion) {
+  int nComps = pCS->CountComponents();
+  int pixels = src.size() / nComps;
+  std::vector<uint8_t> dest(pixels * 3);
+  for (int i = 0; i < pixels; ++i) {
+    const uint8_t* pSrc = &src[i * nComps];
+    uint8_t* pDest = &dest[i * 3];
+    if (pCS->GetFamily() == PDFCS_DEVICECMYK) {
+      if (bStdConversion) {
+        pDest[2] = 255 - std::min(255, pSrc[0] + pSrc[3]);
+        pDest[1] = 255 - std::min(255, pSrc[1] + pSrc[3]);
+        pDest[0] = 255 - std::min(255, pSrc[2] + pSrc[3]);
+      } else {
+        AdobeCMYK_to_sRGB1(pSrc[0], pSrc[1], pSrc[2], pSrc[3], pDest[2],
+                           pDest[1], pDest[0]);
+      }
+      continue;
+    }
+    FX_FLOAT comps[4];
+    for (int j = 0; j < nComps; ++j) {
+      if (pCS->GetFamily() == PDFCS_INDEXED)
+        comps[j] = (FX_FLOAT)pSrc[j];
+      else
+        comps[j] = (FX_FLOAT)pSrc[j] / 255;
+    }
+    if (pCS->GetFamily() == PDFCS_LAB) {
+      comps[0] = pSrc[0] * 100 / 255.0f;
+      comps[1] = (FX_FLOAT)(pSrc[1] - 128);
+      comps[2] = (FX_FLOAT)(pSrc[2] - 128);
+    }
+    FX_FLOAT R = 0, G = 0, B = 0;
+    pCS->GetRGB(comps, R, G, B);
+    pDest[0] = (int32_t)(B * 255);
+    pDest[1] = (int32_t)(G * 255);
+    pDest[2] = (int32_t)(R * 255);
+  }
+  return dest;
+}
+
+std::vector<uint8_t> TranslateLine(const CPDF_ColorSpace* pCS,
+                                   const std::vector<uint8_t>& src) {
+  int pixels = src.size() / pCS->CountComponents();
+  std::vector<uint8_t> dest(pixels * 3);
+  pCS->TranslateImageLine(dest.data(), src.data(), pixels, pixels, 1);
+  return dest;
+}
+
+// An 8-bit image XObject of |width| x |height| pixels in |cs|.
+std::unique_ptr<CPDF_Stream, ReleaseDeleter<CPDF_Stream>> MakeImageStream(
+    CPDF_Document* pDoc,
+    const std::string& cs,
+    int nComps,
+    int width,
+    int height) {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "<< /Type /XObject /Subtype /Image /Width %d /Height %d "
+           "/BitsPerComponent 8 /ColorSpace %s >>",
+           width, height, cs.c_str());
+  ScopedObject pDict = ParseObject(pDoc, buf);
+  std::vector<uint8_t> pixels = MakePixels(width * height, nComps, 256);
+  uint8_t* pData = FX_Alloc(uint8_t, pixels.size());
+  FXSYS_memcpy(pData, pixels.data(), pixels.size());
+  return std::unique_ptr<CPDF_Stream, ReleaseDeleter<CPDF_Stream>>(
+      new CPDF_Stream(pData, pixels.size(), ToDictionary(pDict.release())));
+}
+
+// Decodes every scanline of the image in |pStream|; returns the time taken.
+long long DecodeImage(CPDF_Document* pDoc, CPDF_Stream* pStream) {
+  CPDF_Image image(pDoc);
+  image.LoadImageF(pStream, FALSE);
+  auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<CFX_DIBSource> pDIB(image.LoadDIBSource());
+  for (int row = 0; row < pDIB->GetHeight(); ++row)
+    pDIB->GetScanline(row);
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+TEST_F(FPDFPageColorsEmbeddertest, TranslateImageLine) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &file_path));
+  CPDF_Parser parser;
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+  CPDF_Document* pDoc = parser.GetDocument();
+
+  struct {
+    std::string cs;
+    int limit;
+  } tests[] = {
+      {"/DeviceCMYK", 256},
+      {"[/Lab << /WhitePoint [0.9505 1 1.089] >>]", 256},
+      {"[/Separation /Spot /DeviceCMYK << /FunctionType 2 /Domain [0 1] "
+       "/C0 [0 0 0 0] /C1 [0.1 0.8 0.3 0.05] /N 1 >>]",
+       256},
+      {"[/DeviceN [/Spot] /DeviceCMYK << /FunctionType 2 /Domain [0 1] "
+       "/C0 [0 0 0 0] /C1 [0.7 0.2 0 0.1] /N 1.5 >>]",
+       256},
+      {"[/DeviceN [/A /B] /DeviceRGB " + AddTwoInputFunction(pDoc) + "]",
+       256},
+      {"[/Indexed /DeviceRGB 3 <ff000000ff000000ff808080>]", 4},
+  };
+  // Not a multiple of the four pixels the vector paths take at a time.
+  const int kPixels = 1001;
+  for (const auto& test : tests) {
+    ScopedObject pObj = ParseObject(pDoc, test.cs);
+    ScopedColorSpace pCS(CPDF_ColorSpace::Load(pDoc, pObj.get()));
+    ASSERT_TRUE(pCS) << test.cs;
+    std::vector<uint8_t> src =
+        MakePixels(kPixels, pCS->CountComponents(), test.limit);
+    EXPECT_EQ(TranslatePerPixel(pCS.get(), src, false),
+              TranslateLine(pCS.get(), src))
+        << test.cs;
+    // Again, from the table built by the first call.
+    EXPECT_EQ(TranslatePerPixel(pCS.get(), src, false),
+              TranslateLine(pCS.get(), src))
+        << test.cs;
+  }
+
+  CPDF_ColorSpace* pCMYK = CPDF_ColorSpace::GetStockCS(PDFCS_DEVICECMYK);
+  std::vector<uint8_t> src = MakePixels(kPixels, 4, 256);
+  pCMYK->EnableStdConversion(TRUE);
+  EXPECT_EQ(TranslatePerPixel(pCMYK, src, true), TranslateLine(pCMYK, src));
+  pCMYK->EnableStdConversion(FALSE);
+
+  // The tables of a Separation space follow the std conversion of the
+  // alternate space, whichever the first call built.
+  ScopedObject pObj = ParseObject(
+      pDoc,
+      "[/Separation /Spot /DeviceCMYK << /FunctionType 2 /Domain [0 1] "
+      "/C0 [0 0 0 0] /C1 [0.1 0.8 0.3 0.05] /N 1 >>]");
+  ScopedColorSpace pCS(CPDF_ColorSpace::Load(pDoc, pObj.get()));
+  ASSERT_TRUE(pCS);
+  src = MakePixels(kPixels, 1, 256);
+  std::vector<uint8_t> adobe = TranslateLine(pCS.get(), src);
+  pCS->EnableStdConversion(TRUE);
+  std::vector<uint8_t> std_line = TranslateLine(pCS.get(), src);
+  EXPECT_EQ(TranslatePerPixel(pCS.get(), src, true), std_line);
+  EXPECT_NE(adobe, std_line);
+  pCS->EnableStdConversion(FALSE);
+  EXPECT_EQ(adobe, TranslateLine(pCS.get(), src));
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests. Decodes CMYK and Lab
+// images, and times the same conversion done a pixel at a time.
+TEST_F(FPDFPageColorsEmbeddertest, DISABLED_BenchmarkDecodeImages) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &file_path));
+  CPDF_Parser parser;
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+  CPDF_Document* pDoc = parser.GetDocument();
+
+  const int kSize = 2000;
+  struct {
+    const char* name;
+    std::string cs;
+    int nComps;
+  } images[] = {
+      {"CMYK", "/DeviceCMYK", 4},
+      {"Lab", "[/Lab << /WhitePoint [0.9505 1 1.089] >>]", 3},
+  };
+  for (const auto& image : images) {
+    auto pStream = MakeImageStream(pDoc, image.cs, image.nComps, kSize, kSize);
+    long long decode_ms = DecodeImage(pDoc, pStream.get());
+
+    ScopedObject pObj = ParseObject(pDoc, image.cs);
+    ScopedColorSpace pCS(CPDF_ColorSpace::Load(pDoc, pObj.get()));
+    std::vector<uint8_t> src = MakePixels(kSize, image.nComps, 256);
+    auto start = std::chrono::steady_clock::now();
+    for (int row = 0; row < kSize; ++row)
+      TranslatePerPixel(pCS.get(), src, false);
+    long long per_pixel_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    printf("%s %dx%d: decode %lld ms, per pixel conversion %lld ms\n",
+           image.name, kSize, kSize, decode_ms, per_pixel_ms);
+  }
+}
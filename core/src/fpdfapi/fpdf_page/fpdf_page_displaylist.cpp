@@ -0,0 +1,1424 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "core/include/fpdfapi/fpdf_page.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "core/include/fpdfapi/fpdf_pageobj.h"
+#include "core/include/fpdfapi/fpdf_serial.h"
+#include "core/include/fxcrt/fx_ext.h"
+#include "core/src/fpdfapi/fpdf_page/pageint.h"
+
+// A display list records the objects that parsing the contents of a page
+// produced, so that reloading the page can restore them without parsing the
+// contents again. All integers are stored in little-endian order:
+//
+//   magic "PDFDLIST", format version,
+//   page object number, last xref offset, hash of the content streams,
+//   object list, hash of everything above.
+//
+// An object list is a set of flags, an object count and the objects. Each
+// object has its type, bounding box, graphic states and content marks, then
+// the data of its type. States, paths and forms shared by several objects are
+// written where first used and referred to by index afterwards. Fonts, color
+// spaces, patterns, images and other resources are referred to by object
+// number, or by their place inside an indirect object or the page resources,
+// and are loaded from the document again.
+
+namespace {
+
+using ScopedFileStream =
+    std::unique_ptr<IFX_FileStream, ReleaseDeleter<IFX_FileStream>>;
+using ScopedObject = std::unique_ptr<CPDF_Object, ReleaseDeleter<CPDF_Object>>;
+
+const char kDisplayListMagic[] = "PDFDLIST";
+const FX_DWORD kDisplayListMagicSize = 8;
+const FX_DWORD kDisplayListVersion = 1;
+
+// Refuse to load display lists beyond this size.
+const FX_FILESIZE kMaxDisplayListSize = 256 * 1024 * 1024;
+
+// Objects nest inside forms and text clips no deeper than this.
+const int kMaxNestingLevel = 64;
+
+// A shared entry is written as 0 for none, 1 for a new entry that follows,
+// or the index of an earlier entry plus 2.
+const FX_DWORD kEntryNull = 0;
+const FX_DWORD kEntryNew = 1;
+const FX_DWORD kEntryFirstIndex = 2;
+
+const FX_DWORD kRefNull = 0;
+const FX_DWORD kRefIndirect = 1;
+const FX_DWORD kRefPath = 2;
+const FX_DWORD kRefStockFont = 3;
+
+const FX_DWORD kStepKey = 0;
+const FX_DWORD kStepIndex = 1;
+const FX_DWORD kStepStreamDict = 2;
+
+const FX_DWORD kListFlagBackgroundAlpha = 1;
+const FX_DWORD kListFlagImageMask = 2;
+const FX_DWORD kListFlagPageResources = 4;
+
+const FX_DWORD kOptionTextOnly = 1;
+const FX_DWORD kOptionMarkedContent = 2;
+const FX_DWORD kOptionSeparateForm = 4;
+const FX_DWORD kOptionDecodeInlineImage = 8;
+
+const FX_DWORD kMarkParamNone = 0;
+const FX_DWORD kMarkParamProperties = 1;
+const FX_DWORD kMarkParamDirect = 2;
+
+// The pattern of a pattern color keeps at most this many components.
+const FX_DWORD kMaxPatternComps = 16;
+
+// The most text render mode, line cap and line join the parser sets.
+const int kMaxTextMode = 7;
+const FX_DWORD kMaxLineCap = CFX_GraphStateData::LineCapSquare;
+const FX_DWORD kMaxLineJoin = CFX_GraphStateData::LineJoinBevel;
+
+bool IsValidBlendType(int blend_type) {
+  return (blend_type >= FXDIB_BLEND_NORMAL &&
+          blend_type <= FXDIB_BLEND_EXCLUSION) ||
+         (blend_type >= FXDIB_BLEND_HUE &&
+          blend_type <= FXDIB_BLEND_LUMINOSITY);
+}
+
+FX_DWORD HashBytes(const uint8_t* pData, FX_DWORD size) {
+  return FX_HashCode_String_GetA(reinterpret_cast<const FX_CHAR*>(pData),
+                                 size);
+}
+
+FX_DWORD HashStreamData(CPDF_Stream* pStream) {
+  FX_DWORD size = pStream->GetRawSize();
+  std::vector<uint8_t> data(size);
+  if (size && !pStream->ReadRawData(0, data.data(), size))
+    return 0;
+  return HashBytes(data.data(), size);
+}
+
+FX_DWORD HashPageContents(CPDF_Dictionary* pPageDict) {
+  CPDF_Object* pContent = pPageDict->GetElementValue("Contents");
+  if (CPDF_Stream* pStream = ToStream(pContent))
+    return HashStreamData(pStream);
+
+  FX_DWORD hash = 0;
+  if (CPDF_Array* pArray = ToArray(pContent)) {
+    for (FX_DWORD i = 0; i < pArray->GetCount(); ++i) {
+      CPDF_Stream* pStream = ToStream(pArray->GetElementValue(i));
+      hash = hash * 31 + (pStream ? HashStreamData(pStream) : 0);
+    }
+  }
+  return hash;
+}
+
+FX_FILESIZE GetLastXRefOffset(CPDF_Document* pDoc) {
+  CPDF_Parser* pParser = pDoc->GetParser();
+  return pParser ? pParser->GetLastXRefOffset() : 0;
+}
+
+FX_DWORD GetOptionFlags(const CPDF_ParseOptions& options) {
+  FX_DWORD flags = 0;
+  if (options.m_bTextOnly)
+    flags |= kOptionTextOnly;
+  if (options.m_bMarkedContent)
+    flags |= kOptionMarkedContent;
+  if (options.m_bSeparateForm)
+    flags |= kOptionSeparateForm;
+  if (options.m_bDecodeInlineImage)
+    flags |= kOptionDecodeInlineImage;
+  return flags;
+}
+
+}  // namespace
+
+class CPDF_DisplayListWriter {
+ public:
+  explicit CPDF_DisplayListWriter(CPDF_Page* pPage)
+      : m_pPage(pPage),
+        m_pDocument(pPage->m_pDocument),
+        m_bIndexed(false),
+        m_bError(false) {}
+
+  // Writes the display list of the page, checksum included.
+  FX_BOOL WritePage();
+  const CFX_BinaryBuf& GetBuffer() const { return m_Buf; }
+
+ private:
+  struct Step {
+    FX_DWORD m_Type;
+    CFX_ByteString m_Key;
+    FX_DWORD m_Index;
+  };
+  struct Location {
+    FX_DWORD m_dwObjNum;
+    std::vector<Step> m_Steps;
+  };
+  using EntryMap = std::map<const void*, FX_DWORD>;
+
+  void WriteDWord(FX_DWORD value) {
+    for (int i = 0; i < 4; ++i)
+      m_Buf.AppendByte((uint8_t)(value >> (i * 8)));
+  }
+  void WriteFileSize(FX_FILESIZE value) {
+    uint64_t v = (uint64_t)value;
+    for (int i = 0; i < 8; ++i)
+      m_Buf.AppendByte((uint8_t)(v >> (i * 8)));
+  }
+  void WriteFloat(FX_FLOAT value) {
+    FX_DWORD bits;
+    FXSYS_memcpy(&bits, &value, sizeof(bits));
+    WriteDWord(bits);
+  }
+  void WriteFloats(const FX_FLOAT* pValues, int count) {
+    for (int i = 0; i < count; ++i)
+      WriteFloat(pValues[i]);
+  }
+  void WriteMatrix(const CFX_Matrix& matrix) {
+    WriteFloat(matrix.a);
+    WriteFloat(matrix.b);
+    WriteFloat(matrix.c);
+    WriteFloat(matrix.d);
+    WriteFloat(matrix.e);
+    WriteFloat(matrix.f);
+  }
+  void WriteString(const CFX_ByteStringC& str) {
+    WriteDWord(str.GetLength());
+    m_Buf.AppendBlock(str.GetPtr(), str.GetLength());
+  }
+  void WriteSyntax(const CPDF_Object* pObj) {
+    CFX_ByteTextBuf syntax;
+    syntax << pObj;
+    WriteDWord(syntax.GetSize());
+    m_Buf.AppendBlock(syntax.GetBuffer(), syntax.GetSize());
+  }
+
+  // Writes a reference to a shared entry. Returns true if |p| is new, in
+  // which case the caller writes it and then calls EndEntry().
+  bool BeginEntry(const EntryMap& entries, const void* p);
+  void EndEntry(EntryMap* pEntries, const void* p);
+
+  void WriteObjectList(CPDF_PageObjects* pList);
+  void WriteObject(CPDF_PageObject* pObj);
+  void WriteStates(const CPDF_GraphicStates& states);
+  void WriteClipPath(const CPDF_ClipPathData* pData);
+  void WritePath(const CFX_PathData* pData);
+  void WriteGraphState(const CFX_GraphStateData* pData);
+  void WriteColorState(const CPDF_ColorStateData* pData);
+  void WriteColor(const CPDF_Color& color);
+  void WriteTextState(const CPDF_TextStateData* pData);
+  void WriteGeneralState(const CPDF_GeneralStateData* pData);
+  void WriteContentMark(const CPDF_ContentMarkData* pData);
+  void WriteForm(CPDF_Form* pForm);
+  void WriteFont(CPDF_Font* pFont);
+  void WriteRef(CPDF_Object* pObj);
+
+  // Finds where a direct object lives, indexing the page resources first.
+  const Location* FindLocation(CPDF_Object* pObj);
+  void IndexContents(CPDF_Object* pObj,
+                     FX_DWORD objnum,
+                     std::vector<Step>* pSteps);
+  void IndexChild(CPDF_Object* pChild,
+                  FX_DWORD objnum,
+                  std::vector<Step>* pSteps);
+
+  CPDF_Page* const m_pPage;
+  CPDF_Document* const m_pDocument;
+  CFX_BinaryBuf m_Buf;
+  bool m_bIndexed;
+  bool m_bError;
+  EntryMap m_ClipPaths;
+  EntryMap m_Paths;
+  EntryMap m_GraphStates;
+  EntryMap m_ColorStates;
+  EntryMap m_TextStates;
+  EntryMap m_GeneralStates;
+  EntryMap m_ContentMarks;
+  EntryMap m_Forms;
+  std::map<const CPDF_Object*, Location> m_Locations;
+  std::set<FX_DWORD> m_IndexedObjNums;
+  std::vector<FX_DWORD> m_PendingObjNums;
+};
+
+FX_BOOL CPDF_DisplayListWriter::WritePage() {
+  m_Buf.AppendBlock(kDisplayListMagic, kDisplayListMagicSize);
+  WriteDWord(kDisplayListVersion);
+  WriteDWord(m_pPage->m_pFormDict->GetObjNum());
+  WriteFileSize(GetLastXRefOffset(m_pDocument));
+  WriteDWord(HashPageContents(m_pPage->m_pFormDict));
+  WriteObjectList(m_pPage);
+  if (m_bError)
+    return FALSE;
+
+  WriteDWord(HashBytes(m_Buf.GetBuffer(), m_Buf.GetSize()));
+  return TRUE;
+}
+
+bool CPDF_DisplayListWriter::BeginEntry(const EntryMap& entries,
+                                        const void* p) {
+  if (!p) {
+    WriteDWord(kEntryNull);
+    return false;
+  }
+  auto it = entries.find(p);
+  if (it != entries.end()) {
+    WriteDWord(it->second + kEntryFirstIndex);
+    return false;
+  }
+  WriteDWord(kEntryNew);
+  return true;
+}
+
+void CPDF_DisplayListWriter::EndEntry(EntryMap* pEntries, const void* p) {
+  // Entries are numbered once complete, as the reader does.
+  FX_DWORD index = (FX_DWORD)pEntries->size();
+  (*pEntries)[p] = index;
+}
+
+void CPDF_DisplayListWriter::WriteObjectList(CPDF_PageObjects* pList) {
+  FX_DWORD flags = 0;
+  if (pList->BackgroundAlphaNeeded())
+    flags |= kListFlagBackgroundAlpha;
+  if (pList->HasImageMask())
+    flags |= kListFlagImageMask;
+  if (pList->UsesPageResources())
+    flags |= kListFlagPageResources;
+  WriteDWord(flags);
+  WriteDWord(pList->CountObjects());
+  FX_POSITION pos = pList->GetFirstObjectPosition();
+  while (pos && !m_bError)
+    WriteObject(pList->GetNextObject(pos));
+}
+
+void CPDF_DisplayListWriter::WriteObject(CPDF_PageObject* pObj) {
+  WriteDWord(pObj->m_Type);
+  WriteFloat(pObj->m_Left);
+  WriteFloat(pObj->m_Right);
+  WriteFloat(pObj->m_Top);
+  WriteFloat(pObj->m_Bottom);
+  WriteStates(*pObj);
+  WriteContentMark(pObj->m_ContentMark.GetObject());
+  switch (pObj->m_Type) {
+    case PDFPAGE_TEXT: {
+      CPDF_TextObject* pText = static_cast<CPDF_TextObject*>(pObj);
+      int nChars;
+      FX_DWORD* pCharCodes;
+      FX_FLOAT* pCharPos;
+      pText->GetData(nChars, pCharCodes, pCharPos);
+      WriteFloat(pText->GetPosX());
+      WriteFloat(pText->GetPosY());
+      WriteDWord(nChars);
+      if (nChars == 1) {
+        WriteDWord((FX_DWORD)(uintptr_t)pCharCodes);
+      } else if (nChars > 1) {
+        for (int i = 0; i < nChars; ++i)
+          WriteDWord(pCharCodes[i]);
+        WriteFloats(pCharPos, nChars - 1);
+      }
+      break;
+    }
+    case PDFPAGE_PATH: {
+      CPDF_PathObject* pPath = static_cast<CPDF_PathObject*>(pObj);
+      WritePath(pPath->m_Path.GetObject());
+      WriteDWord(pPath->m_FillType);
+      WriteDWord(pPath->m_bStroke);
+      WriteMatrix(pPath->m_Matrix);
+      break;
+    }
+    case PDFPAGE_IMAGE: {
+      CPDF_ImageObject* pImage = static_cast<CPDF_ImageObject*>(pObj);
+      CPDF_Stream* pStream =
+          pImage->m_pImage ? pImage->m_pImage->GetStream() : nullptr;
+      if (!pStream) {
+        m_bError = true;
+        return;
+      }
+      if (pStream->GetObjNum()) {
+        WriteDWord(FALSE);
+        WriteRef(pStream);
+      } else if (pImage->m_pImage->IsInline()) {
+        FX_DWORD size = pStream->GetRawSize();
+        std::vector<uint8_t> data(size);
+        if (size && !pStream->ReadRawData(0, data.data(), size)) {
+          m_bError = true;
+          return;
+        }
+        WriteDWord(TRUE);
+        WriteSyntax(pStream->GetDict());
+        WriteDWord(size);
+        m_Buf.AppendBlock(data.data(), size);
+      } else {
+        m_bError = true;
+        return;
+      }
+      WriteMatrix(pImage->m_Matrix);
+      break;
+    }
+    case PDFPAGE_SHADING: {
+      CPDF_ShadingObject* pShading = static_cast<CPDF_ShadingObject*>(pObj);
+      if (!pShading->m_pShading) {
+        m_bError = true;
+        return;
+      }
+      WriteRef(pShading->m_pShading->m_pShadingObj);
+      WriteMatrix(pShading->m_pShading->m_ParentMatrix);
+      WriteMatrix(pShading->m_Matrix);
+      break;
+    }
+    case PDFPAGE_FORM: {
+      CPDF_FormObject* pForm = static_cast<CPDF_FormObject*>(pObj);
+      if (!pForm->m_pForm) {
+        m_bError = true;
+        return;
+      }
+      WriteForm(pForm->m_pForm);
+      WriteMatrix(pForm->m_FormMatrix);
+      break;
+    }
+  }
+}
+
+void CPDF_DisplayListWriter::WriteStates(const CPDF_GraphicStates& states) {
+  WriteClipPath(states.m_ClipPath.GetObject());
+  WriteGraphState(states.m_GraphState.GetObject());
+  WriteColorState(states.m_ColorState.GetObject());
+  WriteTextState(states.m_TextState.GetObject());
+  WriteGeneralState(states.m_GeneralState.GetObject());
+}
+
+void CPDF_DisplayListWriter::WriteClipPath(const CPDF_ClipPathData* pData) {
+  if (!BeginEntry(m_ClipPaths, pData))
+    return;
+
+  WriteDWord(pData->m_PathCount);
+  for (int i = 0; i < pData->m_PathCount; ++i) {
+    WritePath(pData->m_pPathList[i].GetObject());
+    WriteDWord(pData->m_pTypeList[i]);
+  }
+  // Texts used as clips come in groups, each ended by a null entry.
+  WriteDWord(pData->m_TextCount);
+  for (int i = 0; i < pData->m_TextCount; ++i) {
+    CPDF_TextObject* pText = pData->m_pTextList[i];
+    WriteDWord(!!pText);
+    if (pText)
+      WriteObject(pText);
+  }
+  EndEntry(&m_ClipPaths, pData);
+}
+
+void CPDF_DisplayListWriter::WritePath(const CFX_PathData* pData) {
+  if (!BeginEntry(m_Paths, pData))
+    return;
+
+  WriteDWord(pData->GetPointCount());
+  for (int i = 0; i < pData->GetPointCount(); ++i) {
+    WriteFloat(pData->GetPointX(i));
+    WriteFloat(pData->GetPointY(i));
+    WriteDWord(pData->GetFlag(i));
+  }
+  EndEntry(&m_Paths, pData);
+}
+
+void CPDF_DisplayListWriter::WriteGraphState(
+    const CFX_GraphStateData* pData) {
+  if (!BeginEntry(m_GraphStates, pData))
+    return;
+
+  WriteDWord(pData->m_LineCap);
+  WriteDWord(pData->m_DashCount);
+  WriteFloats(pData->m_DashArray, pData->m_DashCount);
+  WriteFloat(pData->m_DashPhase);
+  WriteDWord(pData->m_LineJoin);
+  WriteFloat(pData->m_MiterLimit);
+  WriteFloat(pData->m_LineWidth);
+  EndEntry(&m_GraphStates, pData);
+}
+
+void CPDF_DisplayListWriter::WriteColorState(
+    const CPDF_ColorStateData* pData) {
+  if (!BeginEntry(m_ColorStates, pData))
+    return;
+
+  WriteColor(pData->m_FillColor);
+  WriteDWord(pData->m_FillRGB);
+  WriteColor(pData->m_StrokeColor);
+  WriteDWord(pData->m_StrokeRGB);
+  EndEntry(&m_ColorStates, pData);
+}
+
+void CPDF_DisplayListWriter::WriteColor(const CPDF_Color& color) {
+  CPDF_ColorSpace* pCS = color.m_pCS;
+  if (!pCS || color.IsNull()) {
+    WriteDWord(0);
+    return;
+  }
+
+  // Stock color spaces have no array.
+  WriteDWord(pCS->GetFamily());
+  WriteRef(pCS->GetArray());
+  if (pCS->GetFamily() == PDFCS_PATTERN) {
+    CPDF_Pattern* pPattern = color.GetPattern();
+    WriteRef(pPattern ? pPattern->m_pPatternObj : nullptr);
+    WriteMatrix(pPattern ? pPattern->m_ParentMatrix : CFX_Matrix());
+    FX_FLOAT* pComps = color.GetPatternColor();
+    CPDF_ColorSpace* pBaseCS = pCS->GetBaseCS();
+    FX_DWORD nComps = pComps && pBaseCS ? pBaseCS->CountComponents() : 0;
+    nComps = std::min(nComps, kMaxPatternComps);
+    WriteDWord(nComps);
+    WriteFloats(pComps, nComps);
+    return;
+  }
+  WriteDWord(pCS->CountComponents());
+  WriteFloats(color.m_pBuffer, pCS->CountComponents());
+}
+
+void CPDF_DisplayListWriter::WriteTextState(const CPDF_TextStateData* pData) {
+  if (!BeginEntry(m_TextStates, pData))
+    return;
+
+  WriteFont(pData->m_pFont);
+  WriteFloat(pData->m_FontSize);
+  WriteFloat(pData->m_CharSpace);
+  WriteFloat(pData->m_WordSpace);
+  WriteFloats(pData->m_Matrix, 4);
+  WriteDWord(pData->m_TextMode);
+  WriteFloats(pData->m_CTM, 4);
+  EndEntry(&m_TextStates, pData);
+}
+
+void CPDF_DisplayListWriter::WriteGeneralState(
+    const CPDF_GeneralStateData* pData) {
+  if (!BeginEntry(m_GeneralStates, pData))
+    return;
+
+  // The transfer function is loaded again when rendering.
+  m_Buf.AppendBlock(pData->m_BlendMode, sizeof(pData->m_BlendMode));
+  WriteDWord(pData->m_BlendType);
+  WriteRef(pData->m_pSoftMask);
+  WriteFloats(pData->m_SMaskMatrix, 6);
+  WriteFloat(pData->m_StrokeAlpha);
+  WriteFloat(pData->m_FillAlpha);
+  WriteRef(pData->m_pTR);
+  WriteMatrix(pData->m_Matrix);
+  WriteDWord(pData->m_RenderIntent);
+  WriteDWord(pData->m_StrokeAdjust);
+  WriteDWord(pData->m_AlphaSource);
+  WriteDWord(pData->m_TextKnockout);
+  WriteDWord(pData->m_StrokeOP);
+  WriteDWord(pData->m_FillOP);
+  WriteDWord(pData->m_OPMode);
+  WriteRef(pData->m_pBG);
+  WriteRef(pData->m_pUCR);
+  WriteRef(pData->m_pHT);
+  WriteFloat(pData->m_Flatness);
+  WriteFloat(pData->m_Smoothness);
+  EndEntry(&m_GeneralStates, pData);
+}
+
+void CPDF_DisplayListWriter::WriteContentMark(
+    const CPDF_ContentMarkData* pData) {
+  if (!BeginEntry(m_ContentMarks, pData))
+    return;
+
+  WriteDWord(pData->CountItems());
+  for (int i = 0; i < pData->CountItems(); ++i) {
+    const CPDF_ContentMarkItem& item = pData->GetItem(i);
+    CPDF_Object* pParam = static_cast<CPDF_Object*>(item.GetParam());
+    WriteString(item.GetName());
+    if (item.GetParamType() == CPDF_ContentMarkItem::PropertiesDict) {
+      WriteDWord(kMarkParamProperties);
+      WriteRef(pParam);
+    } else if (item.GetParamType() == CPDF_ContentMarkItem::DirectDict) {
+      WriteDWord(kMarkParamDirect);
+      WriteSyntax(pParam);
+    } else {
+      WriteDWord(kMarkParamNone);
+    }
+  }
+  EndEntry(&m_ContentMarks, pData);
+}
+
+void CPDF_DisplayListWriter::WriteForm(CPDF_Form* pForm) {
+  if (!BeginEntry(m_Forms, pForm))
+    return;
+
+  // Restored forms go back into the form cache under the same key.
+  const CPDF_CachedForm* pCachedForm =
+      m_pDocument->GetPageData()->GetCachedForm(pForm);
+  if (!pCachedForm) {
+    m_bError = true;
+    return;
+  }
+  WriteRef(pForm->m_pFormStream);
+  WriteDWord(HashStreamData(pForm->m_pFormStream));
+  WriteRef(pForm->m_pPageResources);
+  WriteRef(pForm->m_pResources);
+  WriteDWord(pCachedForm->m_Level);
+  WriteDWord(GetOptionFlags(pCachedForm->m_Options));
+  WriteStates(pCachedForm->m_States);
+  WriteObjectList(pForm);
+  EndEntry(&m_Forms, pForm);
+}
+
+void CPDF_DisplayListWriter::WriteFont(CPDF_Font* pFont) {
+  CPDF_Dictionary* pFontDict = pFont ? pFont->GetFontDict() : nullptr;
+  if (!pFontDict || pFontDict->GetObjNum() || FindLocation(pFontDict)) {
+    WriteRef(pFontDict);
+    return;
+  }
+  // Stand-ins for missing fonts are not part of the document.
+  if (CPDF_Font::GetStockFont(m_pDocument, pFont->GetBaseFont()) != pFont) {
+    m_bError = true;
+    return;
+  }
+  WriteDWord(kRefStockFont);
+  WriteString(pFont->GetBaseFont());
+}
+
+void CPDF_DisplayListWriter::WriteRef(CPDF_Object* pObj) {
+  if (!pObj) {
+    WriteDWord(kRefNull);
+    return;
+  }
+  if (pObj->GetObjNum()) {
+    WriteDWord(kRefIndirect);
+    WriteDWord(pObj->GetObjNum());
+    return;
+  }
+  const Location* pLocation = FindLocation(pObj);
+  if (!pLocation) {
+    m_bError = true;
+    return;
+  }
+  WriteDWord(kRefPath);
+  WriteDWord(pLocation->m_dwObjNum);
+  WriteDWord((FX_DWORD)pLocation->m_Steps.size());
+  for (const Step& step : pLocation->m_Steps) {
+    WriteDWord(step.m_Type);
+    if (step.m_Type == kStepKey)
+      WriteString(step.m_Key);
+    else if (step.m_Type == kStepIndex)
+      WriteDWord(step.m_Index);
+  }
+}
+
+const CPDF_DisplayListWriter::Location* CPDF_DisplayListWriter::FindLocation(
+    CPDF_Object* pObj) {
+  if (!m_bIndexed) {
+    // Direct objects are found from the page resources, which are either an
+    // indirect object themselves or reached as object number 0.
+    m_bIndexed = true;
+    CPDF_Dictionary* pResources = m_pPage->m_pPageResources;
+    if (pResources && pResources->GetObjNum()) {
+      m_PendingObjNums.push_back(pResources->GetObjNum());
+    } else if (pResources) {
+      std::vector<Step> steps;
+      IndexContents(pResources, 0, &steps);
+    }
+    while (!m_PendingObjNums.empty()) {
+      FX_DWORD objnum = m_PendingObjNums.back();
+      m_PendingObjNums.pop_back();
+      CPDF_Object* pIndirect = m_pDocument->GetIndirectObject(objnum, nullptr);
+      if (pIndirect) {
+        std::vector<Step> steps;
+        IndexContents(pIndirect, objnum, &steps);
+      }
+    }
+  }
+  auto it = m_Locations.find(pObj);
+  return it != m_Locations.end() ? &it->second : nullptr;
+}
+
+void CPDF_DisplayListWriter::IndexContents(CPDF_Object* pObj,
+                                           FX_DWORD objnum,
+                                           std::vector<Step>* pSteps) {
+  Step step;
+  step.m_Index = 0;
+  if (CPDF_Dictionary* pDict = pObj->AsDictionary()) {
+    step.m_Type = kStepKey;
+    for (const auto& it : *pDict) {
+      // Stay out of the page tree.
+      if (it.first == "Parent")
+        continue;
+      step.m_Key = it.first;
+      pSteps->push_back(step);
+      IndexChild(it.second, objnum, pSteps);
+      pSteps->pop_back();
+    }
+  } else if (CPDF_Array* pArray = pObj->AsArray()) {
+    step.m_Type = kStepIndex;
+    for (FX_DWORD i = 0; i < pArray->GetCount(); ++i) {
+      step.m_Index = i;
+      pSteps->push_back(step);
+      IndexChild(pArray->GetElement(i), objnum, pSteps);
+      pSteps->pop_back();
+    }
+  } else if (CPDF_Stream* pStream = pObj->AsStream()) {
+    step.m_Type = kStepStreamDict;
+    pSteps->push_back(step);
+    IndexChild(pStream->GetDict(), objnum, pSteps);
+    pSteps->pop_back();
+  }
+}
+
+void CPDF_DisplayListWriter::IndexChild(CPDF_Object* pChild,
+                                        FX_DWORD objnum,
+                                        std::vector<Step>* pSteps) {
+  if (!pChild)
+    return;
+  if (CPDF_Reference* pRef = pChild->AsReference()) {
+    if (m_IndexedObjNums.insert(pRef->GetRefObjNum()).second)
+      m_PendingObjNums.push_back(pRef->GetRefObjNum());
+    return;
+  }
+  if (!pChild->IsDictionary() && !pChild->IsArray() && !pChild->IsName())
+    return;
+
+  Location& location = m_Locations[pChild];
+  location.m_dwObjNum = objnum;
+  location.m_Steps = *pSteps;
+  IndexContents(pChild, objnum, pSteps);
+}
+
+class CPDF_DisplayListReader {
+ public:
+  CPDF_DisplayListReader(CPDF_Page* pPage, const uint8_t* pData, FX_DWORD size)
+      : m_pPage(pPage),
+        m_pDocument(pPage->m_pDocument),
+        m_pResources(nullptr),
+        m_pData(pData),
+        m_dwSize(size),
+        m_dwPos(0),
+        m_Level(0) {}
+
+  // Reads the objects of the page, checksum excluded.
+  FX_BOOL ReadPage();
+
+ private:
+  bool ReadDWord(FX_DWORD* pValue) {
+    if (m_dwSize - m_dwPos < 4)
+      return false;
+    FX_DWORD value = 0;
+    for (int i = 0; i < 4; ++i)
+      value |= (FX_DWORD)m_pData[m_dwPos++] << (i * 8);
+    *pValue = value;
+    return true;
+  }
+  bool ReadFileSize(FX_FILESIZE* pValue) {
+    if (m_dwSize - m_dwPos < 8)
+      return false;
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i)
+      value |= (uint64_t)m_pData[m_dwPos++] << (i * 8);
+    *pValue = (FX_FILESIZE)value;
+    return true;
+  }
+  bool ReadInt(int* pValue) {
+    FX_DWORD value;
+    if (!ReadDWord(&value))
+      return false;
+    *pValue = (int)value;
+    return true;
+  }
+  bool ReadFloat(FX_FLOAT* pValue) {
+    FX_DWORD bits;
+    if (!ReadDWord(&bits))
+      return false;
+    FXSYS_memcpy(pValue, &bits, sizeof(bits));
+    return true;
+  }
+  bool ReadFloats(FX_FLOAT* pValues, int count) {
+    for (int i = 0; i < count; ++i) {
+      if (!ReadFloat(&pValues[i]))
+        return false;
+    }
+    return true;
+  }
+  bool ReadMatrix(CFX_Matrix* pMatrix) {
+    return ReadFloat(&pMatrix->a) && ReadFloat(&pMatrix->b) &&
+           ReadFloat(&pMatrix->c) && ReadFloat(&pMatrix->d) &&
+           ReadFloat(&pMatrix->e) && ReadFloat(&pMatrix->f);
+  }
+  bool ReadBlock(const uint8_t** ppData, FX_DWORD size) {
+    if (m_dwSize - m_dwPos < size)
+      return false;
+    *ppData = m_pData + m_dwPos;
+    m_dwPos += size;
+    return true;
+  }
+  // Reads an element count, checking that |element_size| bytes are left for
+  // each element.
+  bool ReadCount(FX_DWORD* pCount, FX_DWORD element_size) {
+    return ReadDWord(pCount) &&
+           *pCount <= (m_dwSize - m_dwPos) / element_size;
+  }
+  bool ReadString(CFX_ByteString* pStr) {
+    FX_DWORD size;
+    const uint8_t* pStrData;
+    if (!ReadDWord(&size) || !ReadBlock(&pStrData, size))
+      return false;
+    *pStr = CFX_ByteString(pStrData, size);
+    return true;
+  }
+  ScopedObject ReadSyntax();
+
+  // Reads a reference to a shared entry of |entries| into |pEntry|, setting
+  // |pbNew| if the entry follows.
+  template <typename T>
+  bool ReadEntry(const std::vector<T>& entries, T* pEntry, bool* pbNew) {
+    FX_DWORD value;
+    if (!ReadDWord(&value))
+      return false;
+    *pbNew = value == kEntryNew;
+    if (value == kEntryNull || value == kEntryNew)
+      return true;
+    if (value - kEntryFirstIndex >= entries.size())
+      return false;
+    *pEntry = entries[value - kEntryFirstIndex];
+    return true;
+  }
+
+  bool ReadObjectList(CPDF_PageObjects* pList);
+  CPDF_PageObject* ReadObject();
+  bool ReadObjectData(CPDF_PageObject* pObj);
+  bool ReadStates(CPDF_GraphicStates* pStates);
+  bool ReadClipPath(CPDF_ClipPath* pClipPath);
+  bool ReadPath(CPDF_Path* pPath);
+  bool ReadGraphState(CPDF_GraphState* pGraphState);
+  bool ReadColorState(CPDF_ColorState* pColorState);
+  bool ReadColor(CPDF_Color* pColor);
+  bool ReadTextState(CPDF_TextState* pTextState);
+  bool ReadGeneralState(CPDF_GeneralState* pGeneralState);
+  bool ReadContentMark(CPDF_ContentMark* pContentMark);
+  bool ReadForm(CPDF_Form** ppForm);
+  bool ReadFont(CPDF_Font** ppFont);
+  bool ReadRef(CPDF_Object** ppObj);
+  bool ResolveRef(FX_DWORD type, CPDF_Object** ppObj);
+
+  CPDF_Page* const m_pPage;
+  CPDF_Document* const m_pDocument;
+  // The resources of the object list being read.
+  CPDF_Dictionary* m_pResources;
+  const uint8_t* const m_pData;
+  const FX_DWORD m_dwSize;
+  FX_DWORD m_dwPos;
+  int m_Level;
+  std::vector<CPDF_ClipPath> m_ClipPaths;
+  std::vector<CPDF_Path> m_Paths;
+  std::vector<CPDF_GraphState> m_GraphStates;
+  std::vector<CPDF_ColorState> m_ColorStates;
+  std::vector<CPDF_TextState> m_TextStates;
+  std::vector<CPDF_GeneralState> m_GeneralStates;
+  std::vector<CPDF_ContentMark> m_ContentMarks;
+  std::vector<CPDF_Form*> m_Forms;
+};
+
+FX_BOOL CPDF_DisplayListReader::ReadPage() {
+  // Make sure the list was saved for this page, as it is now.
+  const uint8_t* magic;
+  FX_DWORD version;
+  FX_DWORD objnum;
+  FX_FILESIZE xref_offset;
+  FX_DWORD contents_hash;
+  if (!ReadBlock(&magic, kDisplayListMagicSize) ||
+      FXSYS_memcmp(magic, kDisplayListMagic, kDisplayListMagicSize) != 0 ||
+      !ReadDWord(&version) || version != kDisplayListVersion ||
+      !ReadDWord(&objnum) || objnum != m_pPage->m_pFormDict->GetObjNum() ||
+      !ReadFileSize(&xref_offset) ||
+      xref_offset != GetLastXRefOffset(m_pDocument) ||
+      !ReadDWord(&contents_hash) ||
+      contents_hash != HashPageContents(m_pPage->m_pFormDict)) {
+    return FALSE;
+  }
+  return ReadObjectList(m_pPage) && m_dwPos == m_dwSize;
+}
+
+ScopedObject CPDF_DisplayListReader::ReadSyntax() {
+  FX_DWORD size;
+  const uint8_t* pSyntax;
+  if (!ReadDWord(&size) || !ReadBlock(&pSyntax, size))
+    return ScopedObject();
+
+  ScopedFileStream stream(
+      FX_CreateMemoryStream(const_cast<uint8_t*>(pSyntax), size, FALSE));
+  CPDF_SyntaxParser parser;
+  parser.InitParser(stream.get(), 0);
+  return ScopedObject(parser.GetObject(m_pDocument, 0, 0, nullptr, false));
+}
+
+bool CPDF_DisplayListReader::ReadObjectList(CPDF_PageObjects* pList) {
+  FX_DWORD flags;
+  FX_DWORD count;
+  if (!ReadDWord(&flags) || !ReadCount(&count, 4))
+    return false;
+
+  pList->m_bBackgroundAlphaNeeded = !!(flags & kListFlagBackgroundAlpha);
+  pList->m_bHasImageMask = !!(flags & kListFlagImageMask);
+  pList->m_bUsesPageResources = !!(flags & kListFlagPageResources);
+  CPDF_Dictionary* pOldResources = m_pResources;
+  m_pResources = pList->m_pResources;
+  for (FX_DWORD i = 0; i < count; ++i) {
+    CPDF_PageObject* pObj = ReadObject();
+    if (!pObj) {
+      m_pResources = pOldResources;
+      return false;
+    }
+    pList->m_ObjectList.push_back(pObj);
+  }
+  m_pResources = pOldResources;
+  return true;
+}
+
+CPDF_PageObject* CPDF_DisplayListReader::ReadObject() {
+  FX_DWORD type;
+  if (m_Level >= kMaxNestingLevel || !ReadDWord(&type))
+    return nullptr;
+
+  std::unique_ptr<CPDF_PageObject> pObj(CPDF_PageObject::Create(type));
+  if (!pObj)
+    return nullptr;
+
+  ++m_Level;
+  bool bRead = ReadObjectData(pObj.get());
+  --m_Level;
+  return bRead ? pObj.release() : nullptr;
+}
+
+bool CPDF_DisplayListReader::ReadObjectData(CPDF_PageObject* pObj) {
+  if (!ReadFloat(&pObj->m_Left) || !ReadFloat(&pObj->m_Right) ||
+      !ReadFloat(&pObj->m_Top) || !ReadFloat(&pObj->m_Bottom) ||
+      !ReadStates(pObj) || !ReadContentMark(&pObj->m_ContentMark)) {
+    return false;
+  }
+  switch (pObj->m_Type) {
+    case PDFPAGE_TEXT: {
+      CPDF_TextObject* pText = static_cast<CPDF_TextObject*>(pObj);
+      FX_DWORD nChars;
+      if (!ReadFloat(&pText->m_PosX) || !ReadFloat(&pText->m_PosY) ||
+          !ReadCount(&nChars, 4)) {
+        return false;
+      }
+      if (nChars == 1) {
+        FX_DWORD charcode;
+        if (!ReadDWord(&charcode))
+          return false;
+        pText->m_pCharCodes = (FX_DWORD*)(uintptr_t)charcode;
+        pText->m_nChars = 1;
+      } else if (nChars > 1) {
+        pText->m_pCharCodes = FX_Alloc(FX_DWORD, nChars);
+        pText->m_pCharPos = FX_Alloc(FX_FLOAT, nChars - 1);
+        pText->m_nChars = nChars;
+        for (FX_DWORD i = 0; i < nChars; ++i) {
+          if (!ReadDWord(&pText->m_pCharCodes[i]))
+            return false;
+        }
+        if (!ReadFloats(pText->m_pCharPos, nChars - 1))
+          return false;
+      }
+      return true;
+    }
+    case PDFPAGE_PATH: {
+      CPDF_PathObject* pPath = static_cast<CPDF_PathObject*>(pObj);
+      return ReadPath(&pPath->m_Path) && ReadInt(&pPath->m_FillType) &&
+             ReadInt(&pPath->m_bStroke) && ReadMatrix(&pPath->m_Matrix);
+    }
+    case PDFPAGE_IMAGE: {
+      CPDF_ImageObject* pImage = static_cast<CPDF_ImageObject*>(pObj);
+      FX_DWORD bInline;
+      if (!ReadDWord(&bInline))
+        return false;
+      if (!bInline) {
+        CPDF_Object* pStream;
+        if (!ReadRef(&pStream) || !ToStream(pStream) || !pStream->GetObjNum())
+          return false;
+        pImage->m_pImage = m_pDocument->LoadImageF(pStream);
+      } else {
+        ScopedObject pDict = ReadSyntax();
+        FX_DWORD size;
+        const uint8_t* pImageData;
+        if (!ToDictionary(pDict.get()) || !ReadDWord(&size) ||
+            !ReadBlock(&pImageData, size)) {
+          return false;
+        }
+        uint8_t* pStreamData = FX_Alloc(uint8_t, std::max<FX_DWORD>(size, 1));
+        FXSYS_memcpy(pStreamData, pImageData, size);
+        CPDF_Stream* pStream =
+            new CPDF_Stream(pStreamData, size, pDict.release()->AsDictionary());
+        pImage->m_pImage = new CPDF_Image(m_pDocument);
+        pImage->m_pImage->LoadImageF(pStream, TRUE);
+      }
+      return pImage->m_pImage && ReadMatrix(&pImage->m_Matrix);
+    }
+    case PDFPAGE_SHADING: {
+      CPDF_ShadingObject* pShading = static_cast<CPDF_ShadingObject*>(pObj);
+      CPDF_Object* pPatternObj;
+      CFX_Matrix parent_matrix;
+      if (!ReadRef(&pPatternObj) || !pPatternObj ||
+          !ReadMatrix(&parent_matrix)) {
+        return false;
+      }
+      CPDF_Pattern* pPattern =
+          m_pDocument->LoadPattern(pPatternObj, TRUE, &parent_matrix);
+      if (!pPattern)
+        return false;
+      CPDF_ShadingPattern* pShadingPattern =
+          pPattern->m_PatternType == CPDF_Pattern::SHADING
+              ? static_cast<CPDF_ShadingPattern*>(pPattern)
+              : nullptr;
+      if (!pShadingPattern || !pShadingPattern->m_bShadingObj ||
+          !pShadingPattern->Load()) {
+        m_pDocument->GetPageData()->ReleasePattern(pPatternObj);
+        return false;
+      }
+      pShading->m_pShading = pShadingPattern;
+      return ReadMatrix(&pShading->m_Matrix);
+    }
+    case PDFPAGE_FORM: {
+      CPDF_FormObject* pForm = static_cast<CPDF_FormObject*>(pObj);
+      return ReadForm(&pForm->m_pForm) && ReadMatrix(&pForm->m_FormMatrix);
+    }
+  }
+  return false;
+}
+
+bool CPDF_DisplayListReader::ReadStates(CPDF_GraphicStates* pStates) {
+  return ReadClipPath(&pStates->m_ClipPath) &&
+         ReadGraphState(&pStates->m_GraphState) &&
+         ReadColorState(&pStates->m_ColorState) &&
+         ReadTextState(&pStates->m_TextState) &&
+         ReadGeneralState(&pStates->m_GeneralState);
+}
+
+bool CPDF_DisplayListReader::ReadClipPath(CPDF_ClipPath* pClipPath) {
+  bool bNew;
+  if (!ReadEntry(m_ClipPaths, pClipPath, &bNew))
+    return false;
+  if (!bNew)
+    return true;
+
+  FX_DWORD path_count;
+  if (!ReadCount(&path_count, 8))
+    return false;
+  std::vector<CPDF_Path> paths(path_count);
+  std::vector<uint8_t> types(path_count);
+  for (FX_DWORD i = 0; i < path_count; ++i) {
+    FX_DWORD type;
+    if (!ReadPath(&paths[i]) || !ReadDWord(&type))
+      return false;
+    types[i] = (uint8_t)type;
+  }
+  FX_DWORD text_count;
+  if (!ReadCount(&text_count, 4))
+    return false;
+
+  CPDF_ClipPathData* pData = pClipPath->New();
+  pData->SetCount(path_count, text_count);
+  for (FX_DWORD i = 0; i < path_count; ++i) {
+    pData->m_pPathList[i] = paths[i];
+    pData->m_pTypeList[i] = types[i];
+  }
+  for (FX_DWORD i = 0; i < text_count; ++i)
+    pData->m_pTextList[i] = nullptr;
+  for (FX_DWORD i = 0; i < text_count; ++i) {
+    FX_DWORD bText;
+    if (!ReadDWord(&bText))
+      return false;
+    if (!bText)
+      continue;
+    CPDF_PageObject* pText = ReadObject();
+    if (!pText)
+      return false;
+    if (pText->m_Type != PDFPAGE_TEXT) {
+      delete pText;
+      return false;
+    }
+    pData->m_pTextList[i] = static_cast<CPDF_TextObject*>(pText);
+  }
+  m_ClipPaths.push_back(*pClipPath);
+  return true;
+}
+
+bool CPDF_DisplayListReader::ReadPath(CPDF_Path* pPath) {
+  bool bNew;
+  if (!ReadEntry(m_Paths, pPath, &bNew))
+    return false;
+  if (!bNew)
+    return true;
+
+  FX_DWORD count;
+  if (!ReadCount(&count, 12))
+    return false;
+  CFX_PathData* pData = pPath->New();
+  pData->SetPointCount(count);
+  for (FX_DWORD i = 0; i < count; ++i) {
+    FX_FLOAT x;
+    FX_FLOAT y;
+    FX_DWORD flag;
+    if (!ReadFloat(&x) || !ReadFloat(&y) || !ReadDWord(&flag))
+      return false;
+    pData->SetPoint(i, x, y, flag);
+  }
+  m_Paths.push_back(*pPath);
+  return true;
+}
+
+bool CPDF_DisplayListReader::ReadGraphState(CPDF_GraphState* pGraphState) {
+  bool bNew;
+  if (!ReadEntry(m_GraphStates, pGraphState, &bNew))
+    return false;
+  if (!bNew)
+    return true;
+
+  CFX_GraphStateData* pData = pGraphState->New();
+  FX_DWORD line_cap;
+  FX_DWORD dash_count;
+  FX_DWORD line_join;
+  if (!ReadDWord(&line_cap) || !ReadCount(&dash_count, 4))
+    return false;
+  pData->SetDashCount(dash_count);
+  if (!ReadFloats(pData->m_DashArray, dash_count) ||
+      !ReadFloat(&pData->m_DashPhase) || !ReadDWord(&line_join) ||
+      !ReadFloat(&pData->m_MiterLimit) || !ReadFloat(&pData->m_LineWidth) ||
+      line_cap > kMaxLineCap || line_join > kMaxLineJoin) {
+    return false;
+  }
+  pData->m_LineCap = (CFX_GraphStateData::LineCap)line_cap;
+  pData->m_LineJoin = (CFX_GraphStateData::LineJoin)line_join;
+  m_GraphStates.push_back(*pGraphState);
+  return true;
+}
+
+bool CPDF_DisplayListReader::ReadColorState(CPDF_ColorState* pColorState) {
+  bool bNew;
+  if (!ReadEntry(m_ColorStates, pColorState, &bNew))
+    return false;
+  if (!bNew)
+    return true;
+
+  CPDF_ColorStateData* pData = pColorState->New();
+  if (!ReadColor(&pData->m_FillColor) || !ReadDWord(&pData->m_FillRGB) ||
+      !ReadColor(&pData->m_StrokeColor) || !ReadDWord(&pData->m_StrokeRGB)) {
+    return false;
+  }
+  m_ColorStates.push_back(*pColorState);
+  return true;
+}
+
+bool CPDF_DisplayListReader::ReadColor(CPDF_Color* pColor) {
+  FX_DWORD family;
+  if (!ReadDWord(&family))
+    return false;
+  if (family == 0)
+    return true;
+
+  CPDF_Object* pArray;
+  if (!ReadRef(&pArray))
+    return false;
+  CPDF_ColorSpace* pCS = pArray ? m_pDocument->LoadColorSpace(pArray)
+                                : CPDF_ColorSpace::GetStockCS(family);
+  if (!pCS)
+    return false;
+  pColor->SetColorSpace(pCS);
+  if (pCS->GetFamily() != (int)family)
+    return false;
+
+  if (family == PDFCS_PATTERN) {
+    CPDF_Object* pPatternObj;
+    CFX_Matrix parent_matrix;
+    FX_DWORD count;
+    FX_FLOAT comps[kMaxPatternComps];
+    if (!ReadRef(&pPatternObj) || !ReadMatrix(&parent_matrix) ||
+        !ReadDWord(&count) || count > kMaxPatternComps ||
+        !ReadFloats(comps, count)) {
+      return false;
+    }
+    CPDF_Pattern* pPattern =
+        pPatternObj
+            ? m_pDocument->LoadPattern(pPatternObj, FALSE, &parent_matrix)
+            : nullptr;
+    pColor->SetValue(pPattern, comps, count);
+    return true;
+  }
+
+  FX_DWORD count;
+  if (!ReadDWord(&count) || count != (FX_DWORD)pCS->CountComponents())
+    return false;
+  std::vector<FX_FLOAT> comps(count);
+  if (!ReadFloats(comps.data(), count))
+    return false;
+  pColor->SetValue(comps.data());
+  return true;
+}
+
+bool CPDF_DisplayListReader::ReadTextState(CPDF_TextState* pTextState) {
+  bool bNew;
+  if (!ReadEntry(m_TextStates, pTextState, &bNew))
+    return false;
+  if (!bNew)
+    return true;
+
+  CPDF_Font* pFont;
+  if (!ReadFont(&pFont))
+    return false;
+  CPDF_TextStateData* pData = pTextState->New();
+  pTextState->SetFont(pFont);
+  if (!ReadFloat(&pData->m_FontSize) || !ReadFloat(&pData->m_CharSpace) ||
+      !ReadFloat(&pData->m_WordSpace) || !ReadFloats(pData->m_Matrix, 4) ||
+      !ReadInt(&pData->m_TextMode) || !ReadFloats(pData->m_CTM, 4) ||
+      pData->m_TextMode < 0 || pData->m_TextMode > kMaxTextMode) {
+    return false;
+  }
+  m_TextStates.push_back(*pTextState);
+  return true;
+}
+
+bool CPDF_DisplayListReader::ReadGeneralState(
+    CPDF_GeneralState* pGeneralState) {
+  bool bNew;
+  if (!ReadEntry(m_GeneralStates, pGeneralState, &bNew))
+    return false;
+  if (!bNew)
+    return true;
+
+  CPDF_GeneralStateData* pData = pGeneralState->New();
+  const uint8_t* pBlendMode;
+  if (!ReadBlock(&pBlendMode, sizeof(pData->m_BlendMode)))
+    return false;
+  FXSYS_memcpy(pData->m_BlendMode, pBlendMode, sizeof(pData->m_BlendMode));
+  pData->m_BlendMode[sizeof(pData->m_BlendMode) - 1] = 0;
+  if (!ReadInt(&pData->m_BlendType) || !IsValidBlendType(pData->m_BlendType) ||
+      !ReadRef(&pData->m_pSoftMask) || !ReadFloats(pData->m_SMaskMatrix, 6) ||
+      !ReadFloat(&pData->m_StrokeAlpha) || !ReadFloat(&pData->m_FillAlpha) ||
+      !ReadRef(&pData->m_pTR) || !ReadMatrix(&pData->m_Matrix) ||
+      !ReadInt(&pData->m_RenderIntent) || !ReadInt(&pData->m_StrokeAdjust) ||
+      !ReadInt(&pData->m_AlphaSource) || !ReadInt(&pData->m_TextKnockout) ||
+      !ReadInt(&pData->m_StrokeOP) || !ReadInt(&pData->m_FillOP) ||
+      !ReadInt(&pData->m_OPMode) || !ReadRef(&pData->m_pBG) ||
+      !ReadRef(&pData->m_pUCR) || !ReadRef(&pData->m_pHT) ||
+      !ReadFloat(&pData->m_Flatness) || !ReadFloat(&pData->m_Smoothness)) {
+    return false;
+  }
+  m_GeneralStates.push_back(*pGeneralState);
+  return true;
+}
+
+bool CPDF_DisplayListReader::ReadContentMark(CPDF_ContentMark* pContentMark) {
+  bool bNew;
+  if (!ReadEntry(m_ContentMarks, pContentMark, &bNew))
+    return false;
+  if (!bNew)
+    return true;
+
+  FX_DWORD count;
+  if (!ReadCount(&count, 8))
+    return false;
+  CPDF_ContentMarkData* pData = pContentMark->New();
+  for (FX_DWORD i = 0; i < count; ++i) {
+    CFX_ByteString name;
+    FX_DWORD param_type;
+    if (!ReadString(&name) || !ReadDWord(&param_type))
+      return false;
+    if (param_type == kMarkParamProperties) {
+      CPDF_Object* pDict;
+      if (!ReadRef(&pDict) || !ToDictionary(pDict))
+        return false;
+      pData->AddMark(name, pDict->AsDictionary(), FALSE);
+    } else if (param_type == kMarkParamDirect) {
+      ScopedObject pDict = ReadSyntax();
+      if (!ToDictionary(pDict.get()))
+        return false;
+      pData->AddMark(name, pDict->AsDictionary(), TRUE);
+    } else {
+      pData->AddMark(name, nullptr, FALSE);
+    }
+  }
+  m_ContentMarks.push_back(*pContentMark);
+  return true;
+}
+
+bool CPDF_DisplayListReader::ReadForm(CPDF_Form** ppForm) {
+  CPDF_DocPageData* pPageData = m_pDocument->GetPageData();
+  CPDF_Form* pForm = nullptr;
+  bool bNew;
+  if (!ReadEntry(m_Forms, &pForm, &bNew))
+    return false;
+  if (!bNew) {
+    *ppForm = pForm ? pPageData->AddFormRef(pForm) : nullptr;
+    return !!*ppForm;
+  }
+
+  CPDF_Object* pFormStream;
+  FX_DWORD data_hash;
+  CPDF_Object* pPageResources;
+  CPDF_Object* pResources;
+  int level;
+  FX_DWORD option_flags;
+  if (!ReadRef(&pFormStream) || !ToStream(pFormStream) ||
+      !ReadDWord(&data_hash) ||
+      data_hash != HashStreamData(pFormStream->AsStream()) ||
+      !ReadRef(&pPageResources) || !ReadRef(&pResources) ||
+      !ReadInt(&level) || !ReadDWord(&option_flags)) {
+    return false;
+  }
+  // The parser makes forms one level below the most it parses.
+  if (level < 0 || level > _FPDF_MAX_FORM_LEVEL_ + 1)
+    return false;
+  if ((pPageResources && !pPageResources->IsDictionary()) ||
+      (pResources && !pResources->IsDictionary())) {
+    return false;
+  }
+  CPDF_ParseOptions options;
+  options.m_bTextOnly = !!(option_flags & kOptionTextOnly);
+  options.m_bMarkedContent = !!(option_flags & kOptionMarkedContent);
+  options.m_bSeparateForm = !!(option_flags & kOptionSeparateForm);
+  options.m_bDecodeInlineImage = !!(option_flags & kOptionDecodeInlineImage);
+  CPDF_GraphicStates states;
+  if (!ReadStates(&states))
+    return false;
+
+  std::unique_ptr<CPDF_Form> pNewForm(new CPDF_Form(
+      m_pDocument, ToDictionary(pPageResources), pFormStream->AsStream(),
+      ToDictionary(pResources)));
+  if (pNewForm->m_pResources != pResources || !ReadObjectList(pNewForm.get()))
+    return false;
+
+  pNewForm->m_ParseState = CPDF_PageObjects::CONTENT_PARSED;
+  pForm = pPageData->AddForm(pNewForm.release(), states, &options, level);
+  m_Forms.push_back(pForm);
+  *ppForm = pForm;
+  return true;
+}
+
+bool CPDF_DisplayListReader::ReadFont(CPDF_Font** ppFont) {
+  FX_DWORD type;
+  if (!ReadDWord(&type))
+    return false;
+  if (type == kRefStockFont) {
+    CFX_ByteString name;
+    if (!ReadString(&name))
+      return false;
+    *ppFont = CPDF_Font::GetStockFont(m_pDocument, name);
+    return !!*ppFont;
+  }
+
+  CPDF_Object* pFontDict;
+  if (!ResolveRef(type, &pFontDict))
+    return false;
+  *ppFont = nullptr;
+  if (!pFontDict)
+    return true;
+  if (!pFontDict->IsDictionary())
+    return false;
+
+  // As CPDF_StreamContentParser::FindFont() does.
+  CPDF_Font* pFont = m_pDocument->LoadFont(pFontDict->AsDictionary());
+  if (pFont && pFont->GetType3Font()) {
+    pFont->GetType3Font()->SetPageResources(m_pResources);
+    pFont->GetType3Font()->CheckType3FontMetrics();
+  }
+  *ppFont = pFont;
+  return !!pFont;
+}
+
+bool CPDF_DisplayListReader::ReadRef(CPDF_Object** ppObj) {
+  FX_DWORD type;
+  return ReadDWord(&type) && ResolveRef(type, ppObj);
+}
+
+bool CPDF_DisplayListReader::ResolveRef(FX_DWORD type, CPDF_Object** ppObj) {
+  *ppObj = nullptr;
+  if (type == kRefNull)
+    return true;
+
+  FX_DWORD objnum;
+  if (!ReadDWord(&objnum))
+    return false;
+  if (type == kRefIndirect) {
+    *ppObj = m_pDocument->GetIndirectObject(objnum, nullptr);
+    return !!*ppObj;
+  }
+  if (type != kRefPath)
+    return false;
+
+  CPDF_Object* pObj = objnum ? m_pDocument->GetIndirectObject(objnum, nullptr)
+                             : m_pPage->m_pPageResources;
+  FX_DWORD step_count;
+  if (!pObj || !ReadCount(&step_count, 4))
+    return false;
+  for (FX_DWORD i = 0; i < step_count; ++i) {
+    FX_DWORD step_type;
+    if (!ReadDWord(&step_type))
+      return false;
+    if (step_type == kStepKey) {
+      CFX_ByteString key;
+      if (!ReadString(&key) || !pObj->IsDictionary())
+        return false;
+      pObj = pObj->AsDictionary()->GetElement(key);
+    } else if (step_type == kStepIndex) {
+      FX_DWORD index;
+      if (!ReadDWord(&index) || !pObj->IsArray())
+        return false;
+      pObj = pObj->AsArray()->GetElement(index);
+    } else if (step_type == kStepStreamDict) {
+      if (!pObj->IsStream())
+        return false;
+      pObj = pObj->AsStream()->GetDict();
+    } else {
+      return false;
+    }
+    if (!pObj || pObj->IsReference())
+      return false;
+  }
+  *ppObj = pObj;
+  return true;
+}
+
+FX_BOOL CPDF_Page::SaveDisplayList(IFX_FileWrite* pFile) {
+  if (!pFile || !m_pFormDict || !IsParsed())
+    return FALSE;
+
+  CPDF_DisplayListWriter writer(this);
+  if (!writer.WritePage())
+    return FALSE;
+
+  const CFX_BinaryBuf& buf = writer.GetBuffer();
+  return pFile->WriteBlock(buf.GetBuffer(), 0, buf.GetSize()) &&
+         pFile->Flush();
+}
+
+FX_BOOL CPDF_Page::LoadDisplayList(IFX_FileRead* pFile) {
+  if (!pFile || !m_pFormDict || m_ParseState != CONTENT_NOT_PARSED)
+    return FALSE;
+
+  FX_FILESIZE list_size = pFile->GetSize();
+  if (list_size <= 4 || list_size > kMaxDisplayListSize)
+    return FALSE;
+
+  std::vector<uint8_t> data((size_t)list_size);
+  if (!pFile->ReadBlock(data.data(), 0, data.size()))
+    return FALSE;
+
+  FX_DWORD payload_size = (FX_DWORD)list_size - 4;
+  FX_DWORD checksum = 0;
+  for (int i = 0; i < 4; ++i)
+    checksum |= (FX_DWORD)data[payload_size + i] << (i * 8);
+  if (checksum != HashBytes(data.data(), payload_size))
+    return FALSE;
+
+  CPDF_DisplayListReader reader(this, data.data(), payload_size);
+  if (!reader.ReadPage()) {
+    ClearCacheObjects();
+    m_bBackgroundAlphaNeeded = FALSE;
+    m_bHasImageMask = FALSE;
+    m_bUsesPageResources = FALSE;
+    return FALSE;
+  }
+  m_ParseState = CONTENT_PARSED;
+  return TRUE;
+}
@@ -9,8 +9,37 @@
 #include "core/include/fdrm/fx_crypt.h"
 #include "core/include/fpdfapi/fpdf_module.h"
 #include "core/include/fpdfapi/fpdf_page.h"
+#include "core/include/fxcrt/fx_lock.h"
 #include "core/src/fpdfapi/fpdf_font/font_int.h"
 
+namespace {
+
+template <typename T>
+FX_BOOL IsSameState(const CFX_CountRef<T>& a, const CFX_CountRef<T>& b) {
+  const T* pA = a.GetObject();
+  const T* pB = b.GetObject();
+  return pA == pB || (pA && pB && PDF_IsSameStateValue(*pA, *pB));
+}
+
+// Whether a form parsed with states |a| inherited is the same as one parsed
+// with |b|. The clip path is not inherited by forms.
+FX_BOOL IsSameStates(const CPDF_GraphicStates& a,
+                     const CPDF_GraphicStates& b) {
+  return IsSameState(a.m_GeneralState, b.m_GeneralState) &&
+         IsSameState(a.m_GraphState, b.m_GraphState) &&
+         IsSameState(a.m_ColorState, b.m_ColorState) &&
+         IsSameState(a.m_TextState, b.m_TextState);
+}
+
+FX_BOOL IsSameOptions(const CPDF_ParseOptions& a, const CPDF_ParseOptions& b) {
+  return a.m_bTextOnly == b.m_bTextOnly &&
+         a.m_bMarkedContent == b.m_bMarkedContent &&
+         a.m_bSeparateForm == b.m_bSeparateForm &&
+         a.m_bDecodeInlineImage == b.m_bDecodeInlineImage;
+}
+
+}  // namespace
+
 class CPDF_PageModule : public IPDF_PageModule {
  public:
   CPDF_PageModule()
@@ -117,6 +146,11 @@ CPDF_DocPageData::~CPDF_DocPageData() {
   Clear(FALSE);
   Clear(TRUE);
 
+  // Forms left here are still drawn by pages that outlive the document.
+  for (auto& it : m_FormMap)
+    delete it.second;
+  m_FormMap.clear();
+
   for (auto& it : m_PatternMap)
     delete it.second;
   m_PatternMap.clear();
@@ -131,8 +165,12 @@ CPDF_DocPageData::~CPDF_DocPageData() {
 }
 
 void CPDF_DocPageData::Clear(FX_BOOL bForceRelease) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   m_bForceClear = bForceRelease;
 
+  // Forms hold on to the other resources, so they go first.
+  ReleaseUnusedForms();
+
   for (auto& it : m_PatternMap) {
     CPDF_CountedPattern* ptData = it.second;
     if (!ptData->get())
@@ -214,6 +252,7 @@ void CPDF_DocPageData::Clear(FX_BOOL bForceRelease) {
 
 CPDF_Font* CPDF_DocPageData::GetFont(CPDF_Dictionary* pFontDict,
                                      FX_BOOL findOnly) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pFontDict) {
     return NULL;
   }
@@ -249,6 +288,7 @@ CPDF_Font* CPDF_DocPageData::GetFont(CPDF_Dictionary* pFontDict,
 
 CPDF_Font* CPDF_DocPageData::GetStandardFont(const CFX_ByteStringC& fontName,
                                              CPDF_FontEncoding* pEncoding) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (fontName.IsEmpty())
     return nullptr;
 
@@ -291,6 +331,7 @@ CPDF_Font* CPDF_DocPageData::GetStandardFont(const CFX_ByteStringC& fontName,
 }
 
 void CPDF_DocPageData::ReleaseFont(CPDF_Dictionary* pFontDict) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pFontDict)
     return;
 
@@ -310,6 +351,7 @@ void CPDF_DocPageData::ReleaseFont(CPDF_Dictionary* pFontDict) {
 CPDF_ColorSpace* CPDF_DocPageData::GetColorSpace(
     CPDF_Object* pCSObj,
     const CPDF_Dictionary* pResources) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pCSObj)
     return nullptr;
 
@@ -374,6 +416,7 @@ CPDF_ColorSpace* CPDF_DocPageData::GetColorSpace(
 }
 
 CPDF_ColorSpace* CPDF_DocPageData::GetCopiedColorSpace(CPDF_Object* pCSObj) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pCSObj)
     return nullptr;
 
@@ -385,6 +428,7 @@ CPDF_ColorSpace* CPDF_DocPageData::GetCopiedColorSpace(CPDF_Object* pCSObj) {
 }
 
 void CPDF_DocPageData::ReleaseColorSpace(CPDF_Object* pColorSpace) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pColorSpace)
     return;
 
@@ -405,6 +449,7 @@ void CPDF_DocPageData::ReleaseColorSpace(CPDF_Object* pColorSpace) {
 CPDF_Pattern* CPDF_DocPageData::GetPattern(CPDF_Object* pPatternObj,
                                            FX_BOOL bShading,
                                            const CFX_Matrix* matrix) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pPatternObj)
     return nullptr;
 
@@ -445,6 +490,7 @@ CPDF_Pattern* CPDF_DocPageData::GetPattern(CPDF_Object* pPatternObj,
 }
 
 void CPDF_DocPageData::ReleasePattern(CPDF_Object* pPatternObj) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pPatternObj)
     return;
 
@@ -462,6 +508,7 @@ void CPDF_DocPageData::ReleasePattern(CPDF_Object* pPatternObj) {
 }
 
 CPDF_Image* CPDF_DocPageData::GetImage(CPDF_Object* pImageStream) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pImageStream)
     return nullptr;
 
@@ -480,6 +527,7 @@ CPDF_Image* CPDF_DocPageData::GetImage(CPDF_Object* pImageStream) {
 }
 
 void CPDF_DocPageData::ReleaseImage(CPDF_Object* pImageStream) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pImageStream || !pImageStream->GetObjNum())
     return;
 
@@ -501,6 +549,7 @@ void CPDF_DocPageData::ReleaseImage(CPDF_Object* pImageStream) {
 
 CPDF_IccProfile* CPDF_DocPageData::GetIccProfile(
     CPDF_Stream* pIccProfileStream) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pIccProfileStream)
     return NULL;
 
@@ -527,6 +576,7 @@ CPDF_IccProfile* CPDF_DocPageData::GetIccProfile(
 }
 
 void CPDF_DocPageData::ReleaseIccProfile(CPDF_IccProfile* pIccProfile) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   ASSERT(pIccProfile);
 
   for (auto it = m_IccProfileMap.begin(); it != m_IccProfileMap.end(); ++it) {
@@ -546,6 +596,7 @@ void CPDF_DocPageData::ReleaseIccProfile(CPDF_IccProfile* pIccProfile) {
 
 CPDF_StreamAcc* CPDF_DocPageData::GetFontFileStreamAcc(
     CPDF_Stream* pFontStream) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   ASSERT(pFontStream);
 
   auto it = m_FontFileMap.find(pFontStream);
@@ -569,6 +620,7 @@ CPDF_StreamAcc* CPDF_DocPageData::GetFontFileStreamAcc(
 
 void CPDF_DocPageData::ReleaseFontFileStreamAcc(CPDF_Stream* pFontStream,
                                                 FX_BOOL bForce) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pFontStream)
     return;
 
@@ -588,8 +640,172 @@ void CPDF_DocPageData::ReleaseFontFileStreamAcc(CPDF_Stream* pFontStream,
   }
 }
 
+CPDF_Form* CPDF_DocPageData::GetForm(CPDF_Stream* pFormStream,
+                                     CPDF_Dictionary* pPageResources,
+                                     CPDF_Dictionary* pParentResources,
+                                     CPDF_AllStates* pStates,
+                                     CPDF_ParseOptions* pOptions,
+                                     int level) {
+  {
+    CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
+    CPDF_Form* pForm = FindForm(pFormStream, pPageResources, pParentResources,
+                                *pStates, pOptions, level);
+    if (pForm)
+      return pForm;
+  }
+
+  // Parse without the lock, so that other threads sharing the document can
+  // carry on meanwhile.
+  std::unique_ptr<CPDF_Form> pNewForm(
+      new CPDF_Form(m_pPDFDoc, pPageResources, pFormStream, pParentResources));
+  pNewForm->ParseContent(pStates, nullptr, nullptr, pOptions, level);
+
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
+  CPDF_Form* pForm = FindForm(pFormStream, pPageResources, pParentResources,
+                              *pStates, pOptions, level);
+  if (pForm)
+    return pForm;
+
+  return InsertForm(pNewForm.release(), *pStates, pOptions, level);
+}
+
+CPDF_Form* CPDF_DocPageData::AddForm(CPDF_Form* pForm,
+                                     const CPDF_GraphicStates& states,
+                                     CPDF_ParseOptions* pOptions,
+                                     int level) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
+  CPDF_Form* pFound =
+      FindForm(pForm->m_pFormStream, pForm->m_pPageResources,
+               pForm->m_pResources, states, pOptions, level);
+  if (pFound) {
+    delete pForm;
+    return pFound;
+  }
+  return InsertForm(pForm, states, pOptions, level);
+}
+
+CPDF_Form* CPDF_DocPageData::InsertForm(CPDF_Form* pForm,
+                                        const CPDF_GraphicStates& states,
+                                        CPDF_ParseOptions* pOptions,
+                                        int level) {
+  CPDF_Stream* pFormStream = pForm->m_pFormStream;
+  CPDF_CachedForm* pCachedForm = new CPDF_CachedForm(pForm);
+  pCachedForm->m_dwObjNum = pFormStream->GetObjNum();
+  pCachedForm->m_dwDataVersion = pFormStream->GetDataVersion();
+  pCachedForm->m_pPageResources = pForm->m_pPageResources;
+  pCachedForm->m_States.CopyStates(states);
+  if (pOptions)
+    pCachedForm->m_Options = *pOptions;
+  pCachedForm->m_Level = level;
+  m_FormMap.insert(std::make_pair(pFormStream, pCachedForm));
+  return pCachedForm->m_Form.AddRef();
+}
+
+CPDF_Form* CPDF_DocPageData::FindForm(CPDF_Stream* pFormStream,
+                                      CPDF_Dictionary* pPageResources,
+                                      CPDF_Dictionary* pParentResources,
+                                      const CPDF_GraphicStates& states,
+                                      CPDF_ParseOptions* pOptions,
+                                      int level) {
+  // The resources a new CPDF_Form would use.
+  CPDF_Dictionary* pResources = pFormStream->GetDict()->GetDict("Resources");
+  if (!pResources)
+    pResources = pParentResources ? pParentResources : pPageResources;
+  CPDF_ParseOptions options;
+  if (pOptions)
+    options = *pOptions;
+
+  CPDF_Form* pFound = nullptr;
+  std::vector<CPDF_CachedForm*> stale_forms;
+  auto range = m_FormMap.equal_range(pFormStream);
+  for (auto it = range.first; it != range.second;) {
+    CPDF_CachedForm* pCachedForm = it->second;
+    CPDF_Form* pForm = pCachedForm->m_Form.get();
+    if (pCachedForm->m_dwObjNum != pFormStream->GetObjNum() ||
+        pCachedForm->m_dwDataVersion != pFormStream->GetDataVersion()) {
+      // The stream was edited after this parse. Pages that still draw it
+      // keep the old objects until they let go.
+      if (pCachedForm->m_Form.use_count() < 2) {
+        stale_forms.push_back(pCachedForm);
+        it = m_FormMap.erase(it);
+        continue;
+      }
+    } else if (!pFound && pForm->m_pResources == pResources &&
+               (!pForm->UsesPageResources() ||
+                pCachedForm->m_pPageResources == pPageResources) &&
+               pCachedForm->m_Level == level &&
+               IsSameOptions(pCachedForm->m_Options, options) &&
+               IsSameStates(pCachedForm->m_States, states)) {
+      pFound = pCachedForm->m_Form.AddRef();
+    }
+    ++it;
+  }
+  for (CPDF_CachedForm* pCachedForm : stale_forms) {
+    delete pCachedForm->m_Form.get();
+    delete pCachedForm;
+  }
+  return pFound;
+}
+
+CPDF_Form* CPDF_DocPageData::AddFormRef(CPDF_Form* pForm) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
+  auto range = m_FormMap.equal_range(pForm->m_pFormStream);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second->m_Form.get() == pForm)
+      return it->second->m_Form.AddRef();
+  }
+  return nullptr;
+}
+
+const CPDF_CachedForm* CPDF_DocPageData::GetCachedForm(
+    CPDF_Form* pForm) const {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
+  auto range = m_FormMap.equal_range(pForm->m_pFormStream);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second->m_Form.get() == pForm)
+      return it->second;
+  }
+  return nullptr;
+}
+
+void CPDF_DocPageData::ReleaseForm(CPDF_Form* pForm) {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
+  if (!pForm)
+    return;
+
+  auto range = m_FormMap.equal_range(pForm->m_pFormStream);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second->m_Form.get() == pForm) {
+      it->second->m_Form.RemoveRef();
+      return;
+    }
+  }
+}
+
+void CPDF_DocPageData::ReleaseUnusedForms() {
+  // Deleting a form releases the forms drawn inside it, which may leave those
+  // unused in turn.
+  std::vector<CPDF_CachedForm*> unused_forms;
+  do {
+    unused_forms.clear();
+    for (auto it = m_FormMap.begin(); it != m_FormMap.end();) {
+      if (it->second->m_Form.use_count() < 2) {
+        unused_forms.push_back(it->second);
+        it = m_FormMap.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (CPDF_CachedForm* pCachedForm : unused_forms) {
+      delete pCachedForm->m_Form.get();
+      delete pCachedForm;
+    }
+  } while (!unused_forms.empty());
+}
+
 CPDF_CountedColorSpace* CPDF_DocPageData::FindColorSpacePtr(
     CPDF_Object* pCSObj) const {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pCSObj)
     return nullptr;
 
@@ -599,6 +815,7 @@ CPDF_CountedColorSpace* CPDF_DocPageData::FindColorSpacePtr(
 
 CPDF_CountedPattern* CPDF_DocPageData::FindPatternPtr(
     CPDF_Object* pPatternObj) const {
+  CFX_AutoLock lock(m_pPDFDoc->GetSharedLock());
   if (!pPatternObj)
     return nullptr;
 
@@ -8,6 +8,7 @@
 
 #include <limits.h>
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -16,79 +17,6 @@
 #include "core/include/fxcrt/fx_safe_types.h"
 #include "third_party/base/numerics/safe_conversions_impl.h"
 
-class CPDF_PSEngine;
-typedef enum {
-  PSOP_ADD,
-  PSOP_SUB,
-  PSOP_MUL,
-  PSOP_DIV,
-  PSOP_IDIV,
-  PSOP_MOD,
-  PSOP_NEG,
-  PSOP_ABS,
-  PSOP_CEILING,
-  PSOP_FLOOR,
-  PSOP_ROUND,
-  PSOP_TRUNCATE,
-  PSOP_SQRT,
-  PSOP_SIN,
-  PSOP_COS,
-  PSOP_ATAN,
-  PSOP_EXP,
-  PSOP_LN,
-  PSOP_LOG,
-  PSOP_CVI,
-  PSOP_CVR,
-  PSOP_EQ,
-  PSOP_NE,
-  PSOP_GT,
-  PSOP_GE,
-  PSOP_LT,
-  PSOP_LE,
-  PSOP_AND,
-  PSOP_OR,
-  PSOP_XOR,
-  PSOP_NOT,
-  PSOP_BITSHIFT,
-  PSOP_TRUE,
-  PSOP_FALSE,
-  PSOP_IF,
-  PSOP_IFELSE,
-  PSOP_POP,
-  PSOP_EXCH,
-  PSOP_DUP,
-  PSOP_COPY,
-  PSOP_INDEX,
-  PSOP_ROLL,
-  PSOP_PROC,
-  PSOP_CONST
-} PDF_PSOP;
-class CPDF_PSProc {
- public:
-  ~CPDF_PSProc();
-  FX_BOOL Parse(CPDF_SimpleParser& parser);
-  FX_BOOL Execute(CPDF_PSEngine* pEngine);
-  CFX_PtrArray m_Operators;
-};
-#define PSENGINE_STACKSIZE 100
-class CPDF_PSEngine {
- public:
-  CPDF_PSEngine();
-  ~CPDF_PSEngine();
-  FX_BOOL Parse(const FX_CHAR* string, int size);
-  FX_BOOL Execute() { return m_MainProc.Execute(this); }
-  FX_BOOL DoOperator(PDF_PSOP op);
-  void Reset() { m_StackCount = 0; }
-  void Push(FX_FLOAT value);
-  void Push(int value) { Push((FX_FLOAT)value); }
-  FX_FLOAT Pop();
-  int GetStackSize() { return m_StackCount; }
-
- private:
-  FX_FLOAT m_Stack[PSENGINE_STACKSIZE];
-  int m_StackCount;
-  CPDF_PSProc m_MainProc;
-};
 CPDF_PSProc::~CPDF_PSProc() {
   int size = m_Operators.GetSize();
   for (int i = 0; i < size; i++) {
@@ -447,6 +375,560 @@ FX_BOOL CPDF_PSEngine::DoOperator(PDF_PSOP op) {
   }
   return TRUE;
 }
+namespace {
+
+// CPDF_PSProgram instruction codes beyond the PostScript operators.
+enum {
+  PSPROG_MOVE = PSOP_CONST + 1,  // Copies A to Dest.
+  PSPROG_JUMP,                   // Skips the next Dest instructions.
+  PSPROG_JUMPIFNOT,              // Skips the next Dest instructions if A is 0.
+};
+
+// A call's frame holds the registers followed by the constants. The stack
+// never holds more than PSENGINE_STACKSIZE values, and merging the stacks of
+// two branches needs at most three times that many registers.
+const int kPSRegisters = 4 * PSENGINE_STACKSIZE;
+const size_t kPSMaxConstants = 256;
+
+bool IsPSUnaryOperator(PDF_PSOP op) {
+  switch (op) {
+    case PSOP_NEG:
+    case PSOP_ABS:
+    case PSOP_CEILING:
+    case PSOP_FLOOR:
+    case PSOP_ROUND:
+    case PSOP_TRUNCATE:
+    case PSOP_SQRT:
+    case PSOP_SIN:
+    case PSOP_COS:
+    case PSOP_LN:
+    case PSOP_LOG:
+    case PSOP_CVI:
+    case PSOP_NOT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsPSBinaryOperator(PDF_PSOP op) {
+  switch (op) {
+    case PSOP_ADD:
+    case PSOP_SUB:
+    case PSOP_MUL:
+    case PSOP_DIV:
+    case PSOP_IDIV:
+    case PSOP_MOD:
+    case PSOP_ATAN:
+    case PSOP_EXP:
+    case PSOP_EQ:
+    case PSOP_NE:
+    case PSOP_GT:
+    case PSOP_GE:
+    case PSOP_LT:
+    case PSOP_LE:
+    case PSOP_AND:
+    case PSOP_OR:
+    case PSOP_XOR:
+    case PSOP_BITSHIFT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Computes |op| exactly as CPDF_PSEngine::DoOperator() does, where |d2| is
+// the top of the stack and |d1| the value below it. Unary operators take
+// |d1|.
+FX_FLOAT PDF_PSEvaluate(int op, FX_FLOAT d1, FX_FLOAT d2) {
+  switch (op) {
+    case PSPROG_MOVE:
+      return d1;
+    case PSOP_ADD:
+      return d2 + d1;
+    case PSOP_SUB:
+      return d1 - d2;
+    case PSOP_MUL:
+      return d2 * d1;
+    case PSOP_DIV:
+      return d1 / d2;
+    case PSOP_IDIV:
+      return (FX_FLOAT)((int)d1 / (int)d2);
+    case PSOP_MOD:
+      return (FX_FLOAT)((int)d1 % (int)d2);
+    case PSOP_NEG:
+      return -d1;
+    case PSOP_ABS:
+      return (FX_FLOAT)FXSYS_fabs(d1);
+    case PSOP_CEILING:
+      return (FX_FLOAT)FXSYS_ceil(d1);
+    case PSOP_FLOOR:
+      return (FX_FLOAT)FXSYS_floor(d1);
+    case PSOP_ROUND:
+      return (FX_FLOAT)FXSYS_round(d1);
+    case PSOP_TRUNCATE:
+    case PSOP_CVI:
+      return (FX_FLOAT)(int)d1;
+    case PSOP_SQRT:
+      return (FX_FLOAT)FXSYS_sqrt(d1);
+    case PSOP_SIN:
+      return (FX_FLOAT)FXSYS_sin(d1 * PI / 180.0f);
+    case PSOP_COS:
+      return (FX_FLOAT)FXSYS_cos(d1 * PI / 180.0f);
+    case PSOP_ATAN:
+      d1 = (FX_FLOAT)(FXSYS_atan2(d1, d2) * 180.0 / PI);
+      if (d1 < 0) {
+        d1 += 360;
+      }
+      return d1;
+    case PSOP_EXP:
+      return (FX_FLOAT)FXSYS_pow(d1, d2);
+    case PSOP_LN:
+      return (FX_FLOAT)FXSYS_log(d1);
+    case PSOP_LOG:
+      return (FX_FLOAT)FXSYS_log10(d1);
+    case PSOP_EQ:
+      return (FX_FLOAT)(int)(d1 == d2);
+    case PSOP_NE:
+      return (FX_FLOAT)(int)(d1 != d2);
+    case PSOP_GT:
+      return (FX_FLOAT)(int)(d1 > d2);
+    case PSOP_GE:
+      return (FX_FLOAT)(int)(d1 >= d2);
+    case PSOP_LT:
+      return (FX_FLOAT)(int)(d1 < d2);
+    case PSOP_LE:
+      return (FX_FLOAT)(int)(d1 <= d2);
+    case PSOP_AND:
+      return (FX_FLOAT)((int)d2 & (int)d1);
+    case PSOP_OR:
+      return (FX_FLOAT)((int)d2 | (int)d1);
+    case PSOP_XOR:
+      return (FX_FLOAT)((int)d2 ^ (int)d1);
+    case PSOP_NOT:
+      return (FX_FLOAT)(int)!(int)d1;
+    case PSOP_BITSHIFT: {
+      int shift = (int)d2;
+      int i = (int)d1;
+      return (FX_FLOAT)(shift > 0 ? i << shift : i >> -shift);
+    }
+    default:
+      return 0;
+  }
+}
+
+}  // namespace
+
+// Runs the program over a stack of frame slots instead of values. Operators
+// on constants are evaluated right away by a CPDF_PSEngine; the others emit
+// an instruction that writes a free register.
+class CPDF_PSProgram::Compiler {
+ public:
+  explicit Compiler(CPDF_PSProgram* pProgram)
+      : m_pProgram(pProgram), m_pCode(&pProgram->m_Code) {}
+
+  FX_BOOL Compile(const CPDF_PSProc* pProc, int nInputs) {
+    for (int i = 0; i < nInputs; i++) {
+      Push(i);
+    }
+    if (!CompileProc(pProc)) {
+      return FALSE;
+    }
+    m_pProgram->m_Results = m_Stack;
+    return m_pProgram->m_Constants.size() <= kPSMaxConstants;
+  }
+
+ private:
+  static bool IsRegister(int slot) { return slot < kPSRegisters; }
+
+  static int CountSlot(const std::vector<int>& stack, int slot) {
+    return (int)std::count(stack.begin(), stack.end(), slot);
+  }
+
+  FX_FLOAT GetConstant(int slot) const {
+    return m_pProgram->m_Constants[slot - kPSRegisters];
+  }
+
+  int AddConstant(FX_FLOAT value) {
+    std::vector<FX_FLOAT>& constants = m_pProgram->m_Constants;
+    for (size_t i = 0; i < constants.size(); i++) {
+      if (FXSYS_memcmp(&constants[i], &value, sizeof(value)) == 0) {
+        return kPSRegisters + (int)i;
+      }
+    }
+    constants.push_back(value);
+    return kPSRegisters + (int)constants.size() - 1;
+  }
+
+  // Same as CPDF_PSEngine::Push() and Pop().
+  void Push(int slot) {
+    if (m_Stack.size() < PSENGINE_STACKSIZE) {
+      m_Stack.push_back(slot);
+    }
+  }
+  int Pop() {
+    if (m_Stack.empty()) {
+      return AddConstant(0);
+    }
+    int slot = m_Stack.back();
+    m_Stack.pop_back();
+    return slot;
+  }
+
+  // Operands that change the stack layout have to be known up front.
+  FX_BOOL PopInteger(int* pValue) {
+    int slot = Pop();
+    if (IsRegister(slot)) {
+      return FALSE;
+    }
+    *pValue = (int)GetConstant(slot);
+    return TRUE;
+  }
+
+  // Returns -1 if every register is in use.
+  static int FirstFreeRegister(const std::vector<bool>& used) {
+    auto it = std::find(used.begin(), used.end(), false);
+    return it == used.end() ? -1 : (int)(it - used.begin());
+  }
+
+  int FindFreeRegister() const {
+    std::vector<bool> used(kPSRegisters, false);
+    for (int slot : m_Stack) {
+      if (IsRegister(slot)) {
+        used[slot] = true;
+      }
+    }
+    return FirstFreeRegister(used);
+  }
+
+  void Emit(int op, int dest, int a, int b) {
+    Instruction inst = {op, dest, a, b};
+    m_pCode->push_back(inst);
+  }
+
+  FX_BOOL CompileProc(const CPDF_PSProc* pProc) {
+    const CFX_PtrArray& ops = pProc->m_Operators;
+    int size = ops.GetSize();
+    for (int i = 0; i < size; i++) {
+      PDF_PSOP op = (PDF_PSOP)(uintptr_t)ops[i];
+      if (op == PSOP_PROC) {
+        i++;
+      } else if (op == PSOP_CONST) {
+        Push(AddConstant(*(FX_FLOAT*)ops[i + 1]));
+        i++;
+      } else if (op == PSOP_IF) {
+        // The interpreter leaves the procedure at a malformed if.
+        if (i < 2 || ops[i - 2] != (void*)PSOP_PROC) {
+          return TRUE;
+        }
+        if (!CompileBranch(Pop(), (CPDF_PSProc*)ops[i - 1], nullptr)) {
+          return FALSE;
+        }
+      } else if (op == PSOP_IFELSE) {
+        if (i < 4 || ops[i - 2] != (void*)PSOP_PROC ||
+            ops[i - 4] != (void*)PSOP_PROC) {
+          return TRUE;
+        }
+        if (!CompileBranch(Pop(), (CPDF_PSProc*)ops[i - 3],
+                           (CPDF_PSProc*)ops[i - 1])) {
+          return FALSE;
+        }
+      } else if (!CompileOperator(op)) {
+        return FALSE;
+      }
+    }
+    return TRUE;
+  }
+
+  FX_BOOL CompileInto(const CPDF_PSProc* pProc,
+                      std::vector<Instruction>* pCode) {
+    std::vector<Instruction>* pOldCode = m_pCode;
+    m_pCode = pCode;
+    FX_BOOL ret = CompileProc(pProc);
+    m_pCode = pOldCode;
+    return ret;
+  }
+
+  FX_BOOL CompileBranch(int cond,
+                        const CPDF_PSProc* pTrue,
+                        const CPDF_PSProc* pFalse) {
+    if (!IsRegister(cond)) {
+      const CPDF_PSProc* pProc = (int)GetConstant(cond) ? pTrue : pFalse;
+      return !pProc || CompileProc(pProc);
+    }
+    std::vector<int> start = m_Stack;
+    std::vector<Instruction> true_code;
+    if (!CompileInto(pTrue, &true_code)) {
+      return FALSE;
+    }
+    std::vector<int> true_stack;
+    true_stack.swap(m_Stack);
+    m_Stack = start;
+    std::vector<Instruction> false_code;
+    if (pFalse && !CompileInto(pFalse, &false_code)) {
+      return FALSE;
+    }
+    if (m_Stack.size() != true_stack.size()) {
+      return FALSE;
+    }
+    std::vector<int> merged;
+    if (!MergeStacks(true_stack, m_Stack, &merged)) {
+      return FALSE;
+    }
+    AddMoves(true_stack, merged, &true_code);
+    AddMoves(m_Stack, merged, &false_code);
+    if (!false_code.empty()) {
+      Instruction jump = {PSPROG_JUMP, (int)false_code.size(), 0, 0};
+      true_code.push_back(jump);
+    }
+    Emit(PSPROG_JUMPIFNOT, (int)true_code.size(), cond, cond);
+    m_pCode->insert(m_pCode->end(), true_code.begin(), true_code.end());
+    m_pCode->insert(m_pCode->end(), false_code.begin(), false_code.end());
+    m_Stack = merged;
+    return TRUE;
+  }
+
+  // Picks where each value lives after two branches join. Where the branches
+  // differ, the value goes to a register that neither branch uses for
+  // anything else, so the moves of a branch never overwrite their sources.
+  // Returns FALSE if the registers run out.
+  FX_BOOL MergeStacks(const std::vector<int>& a,
+                      const std::vector<int>& b,
+                      std::vector<int>* pMerged) const {
+    std::vector<int>& merged = *pMerged;
+    merged.assign(a.size(), -1);
+    std::vector<bool> used(kPSRegisters, false);
+    for (size_t i = 0; i < a.size(); i++) {
+      if (IsRegister(a[i])) {
+        used[a[i]] = true;
+      }
+      if (IsRegister(b[i])) {
+        used[b[i]] = true;
+      }
+      if (a[i] == b[i]) {
+        merged[i] = a[i];
+      }
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+      if (a[i] == b[i]) {
+        continue;
+      }
+      int reg;
+      if (IsRegister(a[i]) && CountSlot(a, a[i]) + CountSlot(b, a[i]) == 1 &&
+          CountSlot(merged, a[i]) == 0) {
+        reg = a[i];
+      } else if (IsRegister(b[i]) &&
+                 CountSlot(a, b[i]) + CountSlot(b, b[i]) == 1 &&
+                 CountSlot(merged, b[i]) == 0) {
+        reg = b[i];
+      } else {
+        reg = FirstFreeRegister(used);
+        if (reg < 0) {
+          return FALSE;
+        }
+      }
+      used[reg] = true;
+      merged[i] = reg;
+    }
+    return TRUE;
+  }
+
+  static void AddMoves(const std::vector<int>& from,
+                       const std::vector<int>& to,
+                       std::vector<Instruction>* pCode) {
+    for (size_t i = 0; i < from.size(); i++) {
+      if (from[i] != to[i]) {
+        Instruction move = {PSPROG_MOVE, to[i], from[i], from[i]};
+        pCode->push_back(move);
+      }
+    }
+  }
+
+  FX_BOOL CompileOperator(PDF_PSOP op) {
+    switch (op) {
+      case PSOP_TRUE:
+        Push(AddConstant(1));
+        return TRUE;
+      case PSOP_FALSE:
+        Push(AddConstant(0));
+        return TRUE;
+      case PSOP_POP:
+        Pop();
+        return TRUE;
+      case PSOP_EXCH: {
+        int d2 = Pop();
+        int d1 = Pop();
+        Push(d2);
+        Push(d1);
+        return TRUE;
+      }
+      case PSOP_DUP: {
+        int d1 = Pop();
+        Push(d1);
+        Push(d1);
+        return TRUE;
+      }
+      case PSOP_COPY: {
+        int n;
+        if (!PopInteger(&n)) {
+          return FALSE;
+        }
+        int count = (int)m_Stack.size();
+        if (n < 0 || n > PSENGINE_STACKSIZE ||
+            count + n > PSENGINE_STACKSIZE || n > count) {
+          return TRUE;
+        }
+        for (int i = 0; i < n; i++) {
+          m_Stack.push_back(m_Stack[count + i - n]);
+        }
+        return TRUE;
+      }
+      case PSOP_INDEX: {
+        int n;
+        if (!PopInteger(&n)) {
+          return FALSE;
+        }
+        int count = (int)m_Stack.size();
+        if (n < 0 || n >= count) {
+          return TRUE;
+        }
+        Push(m_Stack[count - n - 1]);
+        return TRUE;
+      }
+      case PSOP_ROLL: {
+        int j;
+        int n;
+        if (!PopInteger(&j) || !PopInteger(&n)) {
+          return FALSE;
+        }
+        int count = (int)m_Stack.size();
+        if (count == 0 || n < 0 || n > count) {
+          return TRUE;
+        }
+        // The interpreter reads past the stack for these; keep its result.
+        if ((n == 0 && j < 0) || j == INT_MIN) {
+          return FALSE;
+        }
+        if (n > 0) {
+          int shift = j % n;
+          if (shift < 0) {
+            shift += n;
+          }
+          std::rotate(m_Stack.end() - n, m_Stack.end() - shift, m_Stack.end());
+        }
+        return TRUE;
+      }
+      default:
+        break;
+    }
+    if (IsPSUnaryOperator(op)) {
+      int a = Pop();
+      if (!IsRegister(a)) {
+        Push(Fold(op, a, -1));
+        return TRUE;
+      }
+      int dest = FindFreeRegister();
+      if (dest < 0) {
+        return FALSE;
+      }
+      Emit(op, dest, a, a);
+      Push(dest);
+    } else if (IsPSBinaryOperator(op)) {
+      int b = Pop();
+      int a = Pop();
+      if (!IsRegister(a) && !IsRegister(b) && CanFold(op, a, b)) {
+        Push(Fold(op, a, b));
+        return TRUE;
+      }
+      int dest = FindFreeRegister();
+      if (dest < 0) {
+        return FALSE;
+      }
+      Emit(op, dest, a, b);
+      Push(dest);
+    }
+    return TRUE;
+  }
+
+  // Integer division errors are left to happen at run time, as they would
+  // in the interpreter.
+  FX_BOOL CanFold(PDF_PSOP op, int a, int b) const {
+    if (op != PSOP_IDIV && op != PSOP_MOD) {
+      return TRUE;
+    }
+    int i1 = (int)GetConstant(a);
+    int i2 = (int)GetConstant(b);
+    return i2 != 0 && !(i2 == -1 && i1 == INT_MIN);
+  }
+
+  int Fold(PDF_PSOP op, int a, int b) {
+    m_Engine.Reset();
+    m_Engine.Push(GetConstant(a));
+    if (b >= 0) {
+      m_Engine.Push(GetConstant(b));
+    }
+    m_Engine.DoOperator(op);
+    return AddConstant(m_Engine.Pop());
+  }
+
+  CPDF_PSProgram* const m_pProgram;
+  std::vector<Instruction>* m_pCode;
+  std::vector<int> m_Stack;
+  CPDF_PSEngine m_Engine;
+};
+
+CPDF_PSProgram::CPDF_PSProgram() : m_bCompiled(FALSE), m_nInputs(0) {}
+CPDF_PSProgram::~CPDF_PSProgram() {}
+FX_BOOL CPDF_PSProgram::Compile(const CPDF_PSEngine& engine, int nInputs) {
+  m_nInputs = nInputs;
+  m_Code.clear();
+  m_Constants.clear();
+  m_Results.clear();
+  Compiler compiler(this);
+  m_bCompiled = compiler.Compile(engine.GetMainProc(), nInputs);
+  if (!m_bCompiled) {
+    m_Code.clear();
+    m_Constants.clear();
+    m_Results.clear();
+  }
+  return m_bCompiled;
+}
+FX_BOOL CPDF_PSProgram::Run(const FX_FLOAT* inputs,
+                            FX_FLOAT* results,
+                            int nOutputs) const {
+  int count = (int)m_Results.size();
+  if (count < nOutputs) {
+    return FALSE;
+  }
+  FX_FLOAT frame[kPSRegisters + kPSMaxConstants];
+  int nInputs = std::min(m_nInputs, PSENGINE_STACKSIZE);
+  for (int i = 0; i < nInputs; i++) {
+    frame[i] = inputs[i];
+  }
+  if (!m_Constants.empty()) {
+    FXSYS_memcpy(frame + kPSRegisters, m_Constants.data(),
+                 m_Constants.size() * sizeof(FX_FLOAT));
+  }
+  const Instruction* pCode = m_Code.data();
+  int size = (int)m_Code.size();
+  for (int pc = 0; pc < size; pc++) {
+    const Instruction& inst = pCode[pc];
+    if (inst.m_Op == PSPROG_JUMP) {
+      pc += inst.m_Dest;
+    } else if (inst.m_Op == PSPROG_JUMPIFNOT) {
+      if (!(int)frame[inst.m_A]) {
+        pc += inst.m_Dest;
+      }
+    } else {
+      frame[inst.m_Dest] =
+          PDF_PSEvaluate(inst.m_Op, frame[inst.m_A], frame[inst.m_B]);
+    }
+  }
+  for (int i = 0; i < nOutputs; i++) {
+    results[i] = frame[m_Results[count - nOutputs + i]];
+  }
+  return TRUE;
+}
 static FX_FLOAT PDF_Interpolate(FX_FLOAT x,
                                 FX_FLOAT xmin,
                                 FX_FLOAT xmax,
@@ -633,15 +1115,27 @@ class CPDF_PSFunc : public CPDF_Function {
   FX_BOOL v_Call(FX_FLOAT* inputs, FX_FLOAT* results) const override;
 
   CPDF_PSEngine m_PS;
+  CPDF_PSProgram m_Program;
+  // Held while a program that did not compile runs through |m_PS|, whose
+  // stack every call writes.
+  mutable std::mutex m_PSLock;
 };
 
 FX_BOOL CPDF_PSFunc::v_Init(CPDF_Object* pObj) {
   CPDF_Stream* pStream = pObj->AsStream();
   CPDF_StreamAcc acc;
   acc.LoadAllData(pStream, FALSE);
-  return m_PS.Parse((const FX_CHAR*)acc.GetData(), acc.GetSize());
+  if (!m_PS.Parse((const FX_CHAR*)acc.GetData(), acc.GetSize())) {
+    return FALSE;
+  }
+  m_Program.Compile(m_PS, m_nInputs);
+  return TRUE;
 }
 FX_BOOL CPDF_PSFunc::v_Call(FX_FLOAT* inputs, FX_FLOAT* results) const {
+  if (m_Program.IsCompiled()) {
+    return m_Program.Run(inputs, results, m_nOutputs);
+  }
+  std::lock_guard<std::mutex> lock(m_PSLock);
   CPDF_PSEngine& PS = (CPDF_PSEngine&)m_PS;
   PS.Reset();
   int i;
@@ -906,6 +1400,10 @@ FX_BOOL CPDF_Function::Call(FX_FLOAT* inputs,
     return FALSE;
   }
   nresults = m_nOutputs;
+  Evaluate(inputs, results);
+  return TRUE;
+}
+FX_BOOL CPDF_Function::Evaluate(FX_FLOAT* inputs, FX_FLOAT* results) const {
   for (int i = 0; i < m_nInputs; i++) {
     if (inputs[i] < m_pDomains[i * 2]) {
       inputs[i] = m_pDomains[i * 2];
@@ -913,7 +1411,7 @@ FX_BOOL CPDF_Function::Call(FX_FLOAT* inputs,
       inputs[i] = m_pDomains[i * 2] + 1;
     }
   }
-  v_Call(inputs, results);
+  FX_BOOL ret = v_Call(inputs, results);
   if (m_pRanges) {
     for (int i = 0; i < m_nOutputs; i++) {
       if (results[i] < m_pRanges[i * 2]) {
@@ -923,5 +1421,89 @@ FX_BOOL CPDF_Function::Call(FX_FLOAT* inputs,
       }
     }
   }
-  return TRUE;
+  return ret;
+}
+
+namespace {
+
+// The number of sample tables kept per function, and the most values they
+// hold between them, 4 MB worth.
+const size_t kMaxSampleTables = 4;
+const size_t kMaxSampleValues = 1024 * 1024;
+
+}  // namespace
+
+bool CPDF_Function::SampleKey::operator==(const SampleKey& other) const {
+  return FXSYS_memcmp(m_Domain, other.m_Domain, sizeof(m_Domain)) == 0 &&
+         m_Steps[0] == other.m_Steps[0] && m_Steps[1] == other.m_Steps[1];
+}
+CPDF_Function::Samples CPDF_Function::GetSamples(FX_FLOAT xmin,
+                                                 FX_FLOAT xmax,
+                                                 int nSteps) const {
+  SampleKey key = {{xmin, xmax, 0, 0}, {nSteps, 1}};
+  return GetSamples(key, 1);
+}
+CPDF_Function::Samples CPDF_Function::GetSamples(FX_FLOAT xmin,
+                                                 FX_FLOAT xmax,
+                                                 int nx,
+                                                 FX_FLOAT ymin,
+                                                 FX_FLOAT ymax,
+                                                 int ny) const {
+  SampleKey key = {{xmin, xmax, ymin, ymax}, {nx, ny}};
+  return GetSamples(key, 2);
+}
+CPDF_Function::Samples CPDF_Function::GetSamples(const SampleKey& key,
+                                                 int nInputs) const {
+  int nx = key.m_Steps[0];
+  int ny = key.m_Steps[1];
+  if (m_nInputs != nInputs || nx <= 0 || ny <= 0 ||
+      (size_t)nx > kMaxSampleValues / ny / std::max(m_nOutputs, 1)) {
+    return Samples();
+  }
+  std::lock_guard<std::mutex> lock(m_SampleLock);
+  for (auto it = m_SampleCache.begin(); it != m_SampleCache.end(); ++it) {
+    if (it->first == key) {
+      m_SampleCache.splice(m_SampleCache.begin(), m_SampleCache, it);
+      return it->second;
+    }
+  }
+  std::unique_ptr<std::vector<FX_FLOAT>> pSamples(
+      new std::vector<FX_FLOAT>(nx * ny * m_nOutputs));
+  FX_FLOAT* pDest = pSamples->data();
+  CFX_FixedBufGrow<FX_FLOAT, 16> results(m_nOutputs);
+  FXSYS_memset(results, 0, m_nOutputs * sizeof(FX_FLOAT));
+  const FX_FLOAT* domain = key.m_Domain;
+  FX_FLOAT x_step = nx > 1 ? (domain[1] - domain[0]) / (nx - 1) : 0;
+  FX_FLOAT y_step = ny > 1 ? (domain[3] - domain[2]) / (ny - 1) : 0;
+  for (int row = 0; row < ny; row++) {
+    for (int column = 0; column < nx; column++) {
+      FX_FLOAT inputs[2];
+      if (nInputs == 1) {
+        // The steps axial and radial shadings take.
+        inputs[0] = (domain[1] - domain[0]) * column / nx + domain[0];
+      } else {
+        inputs[0] = domain[0] + x_step * column;
+        inputs[1] = domain[2] + y_step * row;
+      }
+      // Where a call fails, the caller's own results buffer decides what
+      // is drawn, so leave it to call the function itself.
+      if (!Evaluate(inputs, results)) {
+        return Samples();
+      }
+      FXSYS_memcpy(pDest, results, m_nOutputs * sizeof(FX_FLOAT));
+      pDest += m_nOutputs;
+    }
+  }
+  m_SampleCache.push_front(std::make_pair(key, Samples(pSamples.release())));
+  // The new table fits by itself, so it is never the one dropped.
+  size_t nValues = 0;
+  for (const auto& entry : m_SampleCache) {
+    nValues += entry.second->size();
+  }
+  while (m_SampleCache.size() > kMaxSampleTables ||
+         nValues > kMaxSampleValues) {
+    nValues -= m_SampleCache.back().second->size();
+    m_SampleCache.pop_back();
+  }
+  return m_SampleCache.front().second;
 }
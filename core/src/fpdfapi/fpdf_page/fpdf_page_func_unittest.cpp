@@ -0,0 +1,335 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "pageint.h"
+
+namespace {
+
+class PSProgramTest : public testing::Test {
+ public:
+  void SetUp() override { m_Seed = 1; }
+
+  // Parses |program| into both the interpreter and a compiled program.
+  bool Load(const std::string& program, int nInputs) {
+    m_nInputs = nInputs;
+    m_pEngine.reset(new CPDF_PSEngine);
+    if (!m_pEngine->Parse(program.c_str(), (int)program.size()))
+      return false;
+    return !!m_Program.Compile(*m_pEngine, nInputs);
+  }
+
+  // Same as CPDF_PSFunc::v_Call() without the compiled program.
+  bool Interpret(const FX_FLOAT* inputs,
+                 FX_FLOAT* results,
+                 int nOutputs) const {
+    m_pEngine->Reset();
+    for (int i = 0; i < m_nInputs; i++)
+      m_pEngine->Push(inputs[i]);
+    m_pEngine->Execute();
+    if (m_pEngine->GetStackSize() < nOutputs)
+      return false;
+    for (int i = 0; i < nOutputs; i++)
+      results[nOutputs - i - 1] = m_pEngine->Pop();
+    return true;
+  }
+
+  // Checks that the interpreter and the compiled program agree bit for bit.
+  void ExpectSameResults(const FX_FLOAT* inputs, int nOutputs) const {
+    FX_FLOAT expected[4] = {0, 0, 0, 0};
+    FX_FLOAT actual[4] = {0, 0, 0, 0};
+    ASSERT_GE(4, nOutputs);
+    bool ret = Interpret(inputs, expected, nOutputs);
+    EXPECT_EQ(ret, !!m_Program.Run(inputs, actual, nOutputs));
+    for (int i = 0; i < nOutputs; i++) {
+      if (std::isnan(expected[i]) && std::isnan(actual[i]))
+        continue;
+      EXPECT_EQ(0, memcmp(&expected[i], &actual[i], sizeof(FX_FLOAT)))
+          << expected[i] << " != " << actual[i];
+    }
+  }
+
+  int Random(int range) {
+    m_Seed = m_Seed * 1103515245 + 12345;
+    return (int)((m_Seed >> 8) % range);
+  }
+
+  // A random program of |length| words, with nested procedures.
+  std::string RandomProgram(int length, int depth) {
+    static const char* const kWords[] = {
+        "add", "sub", "mul", "div", "neg", "abs", "ceiling", "floor", "round",
+        "truncate", "sqrt", "sin", "cos", "atan", "exp", "ln", "log", "cvi",
+        "cvr", "eq", "ne", "gt", "ge", "lt", "le", "and", "or", "xor", "not",
+        "bitshift", "true", "false", "pop", "exch", "dup", "copy", "index",
+        "roll", "if", "0", "1", "2", "-1", "0.5", "3", "-2.5", "90", "1e10"};
+    std::string program = "{";
+    for (int i = 0; i < length; i++) {
+      program += " ";
+      int kind = Random(10);
+      if (depth < 3 && kind == 0) {
+        program += RandomProgram(Random(6), depth + 1);
+        if (Random(2))
+          program += " " + RandomProgram(Random(6), depth + 1) + " ifelse";
+        else
+          program += " if";
+      } else if (kind == 1) {
+        // Stack operators with a constant count, which can be compiled.
+        static const char* const kCounted[] = {"2 copy", "1 index",
+                                               "3 1 roll", "2 -1 roll"};
+        program += kCounted[Random(4)];
+      } else {
+        program += kWords[Random(sizeof(kWords) / sizeof(kWords[0]))];
+      }
+    }
+    return program + " }";
+  }
+
+ protected:
+  std::unique_ptr<CPDF_PSEngine> m_pEngine;
+  CPDF_PSProgram m_Program;
+  int m_nInputs;
+  uint32_t m_Seed;
+};
+
+}  // namespace
+
+TEST_F(PSProgramTest, FoldsConstants) {
+  ASSERT_TRUE(Load("{ 360 2 div mul sin }", 1));
+  EXPECT_EQ(2u, m_Program.CountInstructions());
+  FX_FLOAT inputs[] = {0.5f};
+  ExpectSameResults(inputs, 1);
+
+  // A branch on a constant takes no jump.
+  ASSERT_TRUE(Load("{ 1 2 lt { 2 mul } { pop 0 } ifelse }", 1));
+  EXPECT_EQ(1u, m_Program.CountInstructions());
+  ExpectSameResults(inputs, 1);
+
+  // Only the stack changes.
+  ASSERT_TRUE(Load("{ exch 3 1 roll dup 2 index pop }", 3));
+  EXPECT_EQ(0u, m_Program.CountInstructions());
+  FX_FLOAT three_inputs[] = {1, 2, 3};
+  ExpectSameResults(three_inputs, 4);
+}
+
+TEST_F(PSProgramTest, Branches) {
+  ASSERT_TRUE(Load("{ dup 0.5 gt { 1 exch sub } if 2 mul }", 1));
+  for (FX_FLOAT x : {0.0f, 0.25f, 0.5f, 0.75f, 1.0f})
+    ExpectSameResults(&x, 1);
+
+  ASSERT_TRUE(Load(
+      "{ 2 copy gt { exch 0 } { 1 } ifelse 3 1 roll dup 0 lt { neg } if }",
+      2));
+  FX_FLOAT inputs[][2] = {{1, 2}, {2, 1}, {-3, 0}, {0, -3}};
+  for (const auto& input : inputs)
+    ExpectSameResults(input, 3);
+}
+
+TEST_F(PSProgramTest, StackEdgeCases) {
+  FX_FLOAT inputs[] = {0.25f, 0.75f};
+
+  // Popping an empty stack gives 0.
+  ASSERT_TRUE(Load("{ pop pop pop 1 add }", 2));
+  ExpectSameResults(inputs, 1);
+
+  // Pushing onto a full stack drops the value.
+  std::string program = "{";
+  for (int i = 0; i < PSENGINE_STACKSIZE + 5; i++)
+    program += " " + std::to_string(i);
+  ASSERT_TRUE(Load(program + " add }", 2));
+  ExpectSameResults(inputs, 2);
+
+  // A malformed if ends the procedure.
+  ASSERT_TRUE(Load("{ 1 if 2 }", 2));
+  ExpectSameResults(inputs, 3);
+  ASSERT_TRUE(Load("{ { 3 1 if 4 } 1 exch if 5 }", 2));
+  ExpectSameResults(inputs, 4);
+
+  // Not enough values for the outputs.
+  ASSERT_TRUE(Load("{ pop }", 2));
+  ExpectSameResults(inputs, 2);
+}
+
+TEST_F(PSProgramTest, ManyRegisters) {
+  // As many computed values as leave room for the roll operands, each of
+  // which both branches replace, so joining them needs many registers.
+  const int kDepth = PSENGINE_STACKSIZE - 2;
+  const std::string roll = " " + std::to_string(kDepth) + " 1 roll";
+  std::string program = "{";
+  for (int i = 1; i < kDepth; i++)
+    program += " dup 1 add";
+  std::string true_proc = "{";
+  std::string false_proc = "{";
+  for (int i = 0; i < kDepth; i++) {
+    true_proc += " neg" + roll;
+    false_proc += " 2 mul" + roll;
+  }
+  // One branch rotates the stack once more, so no value stays put.
+  program += " dup 50 gt " + true_proc + roll + " } " + false_proc +
+             " } ifelse }";
+  ASSERT_TRUE(Load(program, 1));
+  for (FX_FLOAT x : {0.0f, 100.0f})
+    ExpectSameResults(&x, 4);
+}
+
+TEST_F(PSProgramTest, NotCompiled) {
+  // The stack layout depends on the inputs.
+  EXPECT_FALSE(Load("{ dup cvi index }", 1));
+  EXPECT_FALSE(Load("{ 0.5 gt { 1 2 } if }", 1));
+  // The interpreter reads past the stack.
+  EXPECT_FALSE(Load("{ 0 -1 roll }", 1));
+}
+
+TEST_F(PSProgramTest, MatchesInterpreter) {
+  int compiled = 0;
+  for (int i = 0; i < 2000; i++) {
+    std::string program = RandomProgram(Random(30), 0);
+    int nInputs = 1 + Random(3);
+    if (!Load(program, nInputs))
+      continue;
+    compiled++;
+    int nOutputs = 1 + Random(4);
+    for (int j = 0; j < 10; j++) {
+      FX_FLOAT inputs[3];
+      for (int k = 0; k < nInputs; k++)
+        inputs[k] = (Random(2001) - 1000) / 100.0f;
+      ExpectSameResults(inputs, nOutputs);
+    }
+  }
+  EXPECT_LT(500, compiled);
+}
+
+// Microbenchmark, run with --gtest_also_run_disabled_tests. Compares the
+// interpreter and the compiled program on typical shading functions.
+TEST_F(PSProgramTest, DISABLED_Benchmark) {
+  static const struct {
+    const char* name;
+    const char* program;
+    int inputs;
+    int outputs;
+  } kFunctions[] = {
+      {"Round dot", "{ dup mul exch dup mul add 1 exch sub }", 2, 1},
+      {"Sine wave",
+       "{ 360 mul sin 2 div 0.5 add exch 360 mul cos 2 div 0.5 add mul }", 2,
+       1},
+      {"Tint to CMYK",
+       "{ dup 0.5 lt { 2 mul 0 0 } { 0.5 sub 2 mul 1 exch 0 } ifelse "
+       "3 index 0.2 mul 4 1 roll 4 -1 roll pop 0.1 }",
+       1, 4},
+  };
+  const int kCalls = 1000000;
+  for (const auto& function : kFunctions) {
+    ASSERT_TRUE(Load(function.program, function.inputs));
+    FX_FLOAT results[4];
+    FX_FLOAT sum[2] = {0, 0};
+    double ms[2];
+    for (int compiled = 0; compiled < 2; compiled++) {
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < kCalls; i++) {
+        FX_FLOAT inputs[2] = {(i % 1000) / 1000.0f, (i % 777) / 777.0f};
+        if (compiled)
+          m_Program.Run(inputs, results, function.outputs);
+        else
+          Interpret(inputs, results, function.outputs);
+        sum[compiled] += results[0];
+      }
+      ms[compiled] = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    }
+    EXPECT_EQ(sum[0], sum[1]);
+    printf("%s: %zu instructions, interpreted %.1f ms, compiled %.1f ms\n",
+           function.name, m_Program.CountInstructions(), ms[0], ms[1]);
+  }
+}
+
+namespace {
+
+// Loads a Type 4 function over [0, 1] for each input, with one output.
+std::unique_ptr<CPDF_Function> LoadPSFunction(const char* program,
+                                              int nInputs) {
+  CPDF_Dictionary* pDict = new CPDF_Dictionary;
+  pDict->SetAtInteger("FunctionType", 4);
+  CPDF_Array* pDomain = new CPDF_Array;
+  for (int i = 0; i < nInputs; i++) {
+    pDomain->AddNumber(0);
+    pDomain->AddNumber(1);
+  }
+  pDict->SetAt("Domain", pDomain);
+  CPDF_Array* pRange = new CPDF_Array;
+  pRange->AddNumber(0);
+  pRange->AddNumber(1);
+  pDict->SetAt("Range", pRange);
+  size_t size = strlen(program);
+  uint8_t* pData = FX_Alloc(uint8_t, size);
+  memcpy(pData, program, size);
+  std::unique_ptr<CPDF_Stream, ReleaseDeleter<CPDF_Stream>> pStream(
+      new CPDF_Stream(pData, size, pDict));
+  return std::unique_ptr<CPDF_Function>(CPDF_Function::Load(pStream.get()));
+}
+
+}  // namespace
+
+TEST(fpdf_page_func, SampleSteps) {
+  std::unique_ptr<CPDF_Function> pFunc = LoadPSFunction("{ dup mul }", 1);
+  ASSERT_TRUE(pFunc);
+  CPDF_Function::Samples samples = pFunc->GetSamples(0.25f, 0.75f, 16);
+  ASSERT_TRUE(samples);
+  ASSERT_EQ(16u, samples->size());
+  for (int i = 0; i < 16; i++) {
+    FX_FLOAT input = (0.75f - 0.25f) * i / 16 + 0.25f;
+    FX_FLOAT result;
+    int nresults;
+    pFunc->Call(&input, 1, &result, nresults);
+    EXPECT_EQ(result, (*samples)[i]);
+  }
+
+  // The table is kept for the same domain and resolution.
+  EXPECT_EQ(samples, pFunc->GetSamples(0.25f, 0.75f, 16));
+  EXPECT_NE(samples, pFunc->GetSamples(0.25f, 0.75f, 32));
+  EXPECT_NE(samples, pFunc->GetSamples(0, 0.75f, 16));
+  EXPECT_EQ(samples, pFunc->GetSamples(0.25f, 0.75f, 16));
+
+  // Only 1-input grids.
+  EXPECT_FALSE(pFunc->GetSamples(0, 1, 4, 0, 1, 4));
+}
+
+TEST(fpdf_page_func, SampleGrid) {
+  std::unique_ptr<CPDF_Function> pFunc = LoadPSFunction("{ mul }", 2);
+  ASSERT_TRUE(pFunc);
+  CPDF_Function::Samples samples = pFunc->GetSamples(0, 1, 5, 0, 0.5f, 3);
+  ASSERT_TRUE(samples);
+  ASSERT_EQ(15u, samples->size());
+  for (int row = 0; row < 3; row++) {
+    for (int column = 0; column < 5; column++)
+      EXPECT_FLOAT_EQ(column / 4.0f * row / 4.0f, (*samples)[row * 5 + column]);
+  }
+  EXPECT_EQ(samples, pFunc->GetSamples(0, 1, 5, 0, 0.5f, 3));
+
+  EXPECT_FALSE(pFunc->GetSamples(0, 1, 16));
+  EXPECT_FALSE(pFunc->GetSamples(0, 1, 1024, 0, 1, 1025));
+
+  // The tables share one budget; a large one pushes the others out.
+  samples = pFunc->GetSamples(0, 1, 1024, 0, 1, 512);
+  ASSERT_TRUE(samples);
+  EXPECT_TRUE(pFunc->GetSamples(0, 1, 1024, 0, 1, 513));
+  EXPECT_NE(samples, pFunc->GetSamples(0, 1, 1024, 0, 1, 512));
+}
+
+TEST(fpdf_page_func, SampleFailure) {
+  // Below 0.5 the stack ends up empty and the call fails.
+  std::unique_ptr<CPDF_Function> pFunc =
+      LoadPSFunction("{ 0.5 gt { 1 } if }", 1);
+  ASSERT_TRUE(pFunc);
+  EXPECT_FALSE(pFunc->GetSamples(0, 1, 16));
+  EXPECT_TRUE(pFunc->GetSamples(0.75f, 1, 16));
+}
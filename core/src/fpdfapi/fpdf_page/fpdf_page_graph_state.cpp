@@ -680,3 +680,142 @@ FX_BOOL CPDF_ContentMark::LookupMark(const CFX_ByteStringC& mark,
   }
   return FALSE;
 }
+
+namespace {
+
+FX_BOOL IsSameColor(const CPDF_Color& a, const CPDF_Color& b) {
+  return a.IsNull() ? b.IsNull() : a.IsEqual(b);
+}
+
+// FNV-1a over the bytes of the values that equal blocks share.
+class StateHasher {
+ public:
+  StateHasher() : m_Hash(2166136261u) {}
+
+  template <typename T>
+  void Add(const T& value) {
+    AddBytes(&value, sizeof(value));
+  }
+  void AddBytes(const void* pData, size_t size) {
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    for (size_t i = 0; i < size; ++i)
+      m_Hash = (m_Hash ^ pBytes[i]) * 16777619u;
+  }
+  FX_DWORD GetHash() const { return m_Hash; }
+
+ private:
+  FX_DWORD m_Hash;
+};
+
+FX_DWORD HashStateValue(const CFX_GraphStateData& data) {
+  StateHasher hasher;
+  hasher.Add(data.m_LineCap);
+  hasher.Add(data.m_LineJoin);
+  hasher.Add(data.m_MiterLimit);
+  hasher.Add(data.m_LineWidth);
+  hasher.Add(data.m_DashPhase);
+  hasher.Add(data.m_DashCount);
+  if (data.m_DashCount > 0)
+    hasher.AddBytes(data.m_DashArray, data.m_DashCount * sizeof(FX_FLOAT));
+  return hasher.GetHash();
+}
+
+FX_DWORD HashStateValue(const CPDF_ColorStateData& data) {
+  // The RGB values stand in for the color components.
+  StateHasher hasher;
+  hasher.Add(data.m_FillRGB);
+  hasher.Add(data.m_StrokeRGB);
+  hasher.Add(data.m_FillColor.m_pCS);
+  hasher.Add(data.m_StrokeColor.m_pCS);
+  return hasher.GetHash();
+}
+
+FX_DWORD HashStateValue(const CPDF_TextStateData& data) {
+  StateHasher hasher;
+  hasher.Add(data.m_pFont);
+  hasher.Add(data.m_FontSize);
+  hasher.Add(data.m_CharSpace);
+  hasher.Add(data.m_WordSpace);
+  hasher.Add(data.m_TextMode);
+  hasher.Add(data.m_Matrix);
+  hasher.Add(data.m_CTM);
+  return hasher.GetHash();
+}
+
+FX_DWORD HashStateValue(const CPDF_GeneralStateData& data) {
+  StateHasher hasher;
+  hasher.Add(data);
+  return hasher.GetHash();
+}
+
+}  // namespace
+
+FX_BOOL PDF_IsSameStateValue(const CFX_GraphStateData& a,
+                             const CFX_GraphStateData& b) {
+  return a.m_LineCap == b.m_LineCap && a.m_DashCount == b.m_DashCount &&
+         a.m_DashPhase == b.m_DashPhase && a.m_LineJoin == b.m_LineJoin &&
+         a.m_MiterLimit == b.m_MiterLimit && a.m_LineWidth == b.m_LineWidth &&
+         (a.m_DashCount == 0 ||
+          FXSYS_memcmp(a.m_DashArray, b.m_DashArray,
+                       a.m_DashCount * sizeof(FX_FLOAT)) == 0);
+}
+
+FX_BOOL PDF_IsSameStateValue(const CPDF_ColorStateData& a,
+                             const CPDF_ColorStateData& b) {
+  return a.m_FillRGB == b.m_FillRGB && a.m_StrokeRGB == b.m_StrokeRGB &&
+         IsSameColor(a.m_FillColor, b.m_FillColor) &&
+         IsSameColor(a.m_StrokeColor, b.m_StrokeColor);
+}
+
+FX_BOOL PDF_IsSameStateValue(const CPDF_TextStateData& a,
+                             const CPDF_TextStateData& b) {
+  return a.m_pFont == b.m_pFont && a.m_FontSize == b.m_FontSize &&
+         a.m_CharSpace == b.m_CharSpace && a.m_WordSpace == b.m_WordSpace &&
+         a.m_TextMode == b.m_TextMode &&
+         FXSYS_memcmp(a.m_Matrix, b.m_Matrix, sizeof(a.m_Matrix)) == 0 &&
+         FXSYS_memcmp(a.m_CTM, b.m_CTM, sizeof(a.m_CTM)) == 0;
+}
+
+FX_BOOL PDF_IsSameStateValue(const CPDF_GeneralStateData& a,
+                             const CPDF_GeneralStateData& b) {
+  // The data is all plain values and is copied with memcpy(). Stray bytes
+  // left in the blend mode name can only cause a false mismatch.
+  return FXSYS_memcmp(&a, &b, sizeof(CPDF_GeneralStateData)) == 0;
+}
+
+CPDF_StatePool::CPDF_StatePool() {}
+
+CPDF_StatePool::~CPDF_StatePool() {}
+
+void CPDF_StatePool::Intern(CPDF_GraphicStates* pStates,
+                            FX_BOOL bColor,
+                            FX_BOOL bText,
+                            FX_BOOL bGraph) {
+  m_GeneralStates.Intern(&pStates->m_GeneralState);
+  if (bColor)
+    m_ColorStates.Intern(&pStates->m_ColorState);
+  if (bText)
+    m_TextStates.Intern(&pStates->m_TextState);
+  if (bGraph)
+    m_GraphStates.Intern(&pStates->m_GraphState);
+}
+
+template <typename T>
+void CPDF_StatePool::Table<T>::Intern(CFX_CountRef<T>* pState) {
+  const T* pData = pState->GetObject();
+  if (!pData || pData == m_pLast)
+    return;
+
+  FX_DWORD hash = HashStateValue(*pData);
+  auto range = m_Map.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const T* pPooled = it->second.GetObject();
+    if (pPooled == pData || PDF_IsSameStateValue(*pPooled, *pData)) {
+      *pState = it->second;
+      m_pLast = pPooled;
+      return;
+    }
+  }
+  m_Map.insert(std::make_pair(hash, *pState));
+  m_pLast = pData;
+}
@@ -0,0 +1,126 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "core/src/fpdfapi/fpdf_page/pageint.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "core/include/fpdfapi/fpdf_pageobj.h"
+
+namespace {
+
+// The number of children per node.
+const FX_DWORD kNodeSize = 16;
+
+// Same test as the culling in CPDF_RenderStatus::RenderObjectList().
+bool Intersects(const CFX_FloatRect& box, const CFX_FloatRect& rect) {
+  return !(box.left > rect.right || box.right < rect.left ||
+           box.bottom > rect.top || box.top < rect.bottom);
+}
+
+bool IsOrdered(const CFX_FloatRect& box) {
+  return !std::isnan(box.left) && !std::isnan(box.right) &&
+         !std::isnan(box.bottom) && !std::isnan(box.top);
+}
+
+// Orders |pItems| so that each run of kNodeSize items covers a compact tile:
+// vertical slices by box center, then by box center within each slice.
+template <typename T>
+void SortTiles(std::vector<T>* pItems) {
+  size_t count = pItems->size();
+  size_t node_count = (count + kNodeSize - 1) / kNodeSize;
+  size_t slice_size =
+      (size_t)std::ceil(std::sqrt((double)node_count)) * kNodeSize;
+  std::sort(pItems->begin(), pItems->end(), [](const T& a, const T& b) {
+    return a.m_Box.left + a.m_Box.right < b.m_Box.left + b.m_Box.right;
+  });
+  for (size_t i = 0; i < count; i += slice_size) {
+    std::sort(pItems->begin() + i,
+              pItems->begin() + std::min(count, i + slice_size),
+              [](const T& a, const T& b) {
+                return a.m_Box.bottom + a.m_Box.top <
+                       b.m_Box.bottom + b.m_Box.top;
+              });
+  }
+}
+
+// Groups |items| into nodes of kNodeSize, whose children start at |base|.
+template <typename T, typename Node>
+std::vector<Node> PackLevel(const std::vector<T>& items, FX_DWORD base) {
+  std::vector<Node> nodes;
+  for (FX_DWORD i = 0; i < items.size(); i += kNodeSize) {
+    Node node;
+    node.m_First = base + i;
+    node.m_Count = std::min<FX_DWORD>(kNodeSize, items.size() - i);
+    node.m_Box = items[i].m_Box;
+    for (FX_DWORD j = 1; j < node.m_Count; ++j)
+      node.m_Box.Union(items[i + j].m_Box);
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+}  // namespace
+
+CPDF_PageObjectIndex::CPDF_PageObjectIndex(
+    const std::vector<CPDF_PageObject*>& objects)
+    : m_LeafCount(0) {
+  for (FX_DWORD i = 0; i < objects.size(); ++i) {
+    CPDF_PageObject* pObj = objects[i];
+    Entry entry;
+    entry.m_Box = CFX_FloatRect(pObj->m_Left, pObj->m_Bottom, pObj->m_Right,
+                                pObj->m_Top);
+    entry.m_Index = i;
+    if (IsOrdered(entry.m_Box))
+      m_Entries.push_back(entry);
+    else
+      m_Unordered.push_back(entry);
+  }
+  if (m_Entries.empty())
+    return;
+
+  SortTiles(&m_Entries);
+  std::vector<Node> level = PackLevel<Entry, Node>(m_Entries, 0);
+  m_LeafCount = level.size();
+  while (level.size() > 1) {
+    SortTiles(&level);
+    FX_DWORD base = m_Nodes.size();
+    m_Nodes.insert(m_Nodes.end(), level.begin(), level.end());
+    level = PackLevel<Node, Node>(level, base);
+  }
+  m_Nodes.push_back(level[0]);
+}
+
+CPDF_PageObjectIndex::~CPDF_PageObjectIndex() {}
+
+void CPDF_PageObjectIndex::Query(const CFX_FloatRect& rect,
+                                 std::vector<FX_DWORD>* pIndices) const {
+  for (const Entry& entry : m_Unordered) {
+    if (Intersects(entry.m_Box, rect))
+      pIndices->push_back(entry.m_Index);
+  }
+  if (m_Nodes.empty())
+    return;
+
+  std::vector<FX_DWORD> stack(1, m_Nodes.size() - 1);
+  while (!stack.empty()) {
+    FX_DWORD index = stack.back();
+    stack.pop_back();
+    const Node& node = m_Nodes[index];
+    if (!Intersects(node.m_Box, rect))
+      continue;
+
+    FX_DWORD end = node.m_First + node.m_Count;
+    if (index >= m_LeafCount) {
+      for (FX_DWORD i = node.m_First; i < end; ++i)
+        stack.push_back(i);
+      continue;
+    }
+    for (FX_DWORD i = node.m_First; i < end; ++i) {
+      if (Intersects(m_Entries[i].m_Box, rect))
+        pIndices->push_back(m_Entries[i].m_Index);
+    }
+  }
+}
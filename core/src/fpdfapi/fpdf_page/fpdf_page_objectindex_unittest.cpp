@@ -0,0 +1,105 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "pageint.h"
+
+namespace {
+
+class PageObjectIndexTest : public testing::Test {
+ public:
+  void SetUp() override { m_Seed = 1; }
+  void TearDown() override {
+    for (CPDF_PageObject* pObj : m_Objects)
+      delete pObj;
+  }
+
+  void AddObject(FX_FLOAT left, FX_FLOAT bottom, FX_FLOAT right, FX_FLOAT top) {
+    CPDF_PathObject* pObj = new CPDF_PathObject;
+    pObj->m_Left = left;
+    pObj->m_Bottom = bottom;
+    pObj->m_Right = right;
+    pObj->m_Top = top;
+    m_Objects.push_back(pObj);
+  }
+
+  FX_FLOAT Random(FX_FLOAT range) {
+    m_Seed = m_Seed * 1103515245 + 12345;
+    return range * ((m_Seed >> 8) & 0xFFFF) / 0xFFFF;
+  }
+
+  // The objects the renderer would draw for |rect| without an index.
+  std::vector<FX_DWORD> LinearQuery(const CFX_FloatRect& rect) const {
+    std::vector<FX_DWORD> result;
+    for (FX_DWORD i = 0; i < m_Objects.size(); ++i) {
+      const CPDF_PageObject* pObj = m_Objects[i];
+      if (pObj->m_Left > rect.right || pObj->m_Right < rect.left ||
+          pObj->m_Bottom > rect.top || pObj->m_Top < rect.bottom) {
+        continue;
+      }
+      result.push_back(i);
+    }
+    return result;
+  }
+
+  std::vector<FX_DWORD> IndexQuery(const CPDF_PageObjectIndex& index,
+                                   const CFX_FloatRect& rect) const {
+    std::vector<FX_DWORD> result;
+    index.Query(rect, &result);
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+ protected:
+  std::vector<CPDF_PageObject*> m_Objects;
+  uint32_t m_Seed;
+};
+
+}  // namespace
+
+TEST_F(PageObjectIndexTest, Empty) {
+  CPDF_PageObjectIndex index(m_Objects);
+  EXPECT_TRUE(IndexQuery(index, CFX_FloatRect(0, 0, 100, 100)).empty());
+}
+
+TEST_F(PageObjectIndexTest, SingleNode) {
+  AddObject(0, 0, 10, 10);
+  AddObject(20, 20, 30, 30);
+  AddObject(5, 5, 25, 25);
+  CPDF_PageObjectIndex index(m_Objects);
+  EXPECT_EQ(std::vector<FX_DWORD>({0, 2}),
+            IndexQuery(index, CFX_FloatRect(0, 0, 6, 6)));
+  EXPECT_EQ(std::vector<FX_DWORD>({1, 2}),
+            IndexQuery(index, CFX_FloatRect(25, 25, 40, 40)));
+  EXPECT_TRUE(IndexQuery(index, CFX_FloatRect(40, 40, 50, 50)).empty());
+}
+
+TEST_F(PageObjectIndexTest, MatchesLinearScan) {
+  for (int i = 0; i < 5000; ++i) {
+    FX_FLOAT x = Random(1000);
+    FX_FLOAT y = Random(1000);
+    AddObject(x, y, x + Random(50), y + Random(50));
+  }
+  // Odd boxes: inverted, empty, huge and not a number.
+  AddObject(500, 500, 400, 400);
+  AddObject(300, 300, 300, 300);
+  AddObject(-1e6f, -1e6f, 1e6f, 1e6f);
+  AddObject(std::numeric_limits<FX_FLOAT>::quiet_NaN(), 0, 10, 10);
+
+  CPDF_PageObjectIndex index(m_Objects);
+  for (int i = 0; i < 200; ++i) {
+    FX_FLOAT x = Random(1100) - 50;
+    FX_FLOAT y = Random(1100) - 50;
+    CFX_FloatRect rect(x, y, x + Random(200), y + Random(200));
+    EXPECT_EQ(LinearQuery(rect), IndexQuery(index, rect));
+  }
+  CFX_FloatRect all(-1e7f, -1e7f, 1e7f, 1e7f);
+  EXPECT_EQ(m_Objects.size(), IndexQuery(index, all).size());
+}
@@ -104,7 +104,10 @@ CPDF_StreamContentParser::CPDF_StreamContentParser(
       m_pLastCloneImageDict(nullptr),
       m_bReleaseLastDict(TRUE),
       m_bColored(FALSE),
-      m_bResourceMissing(FALSE) {
+      m_bResourceMissing(FALSE),
+      m_bMoreData(FALSE),
+      m_bImageSplit(FALSE),
+      m_bSplitInImageData(FALSE) {
   if (pmtContentToUser) {
     m_mtContentToUser = *pmtContentToUser;
   }
@@ -280,6 +283,8 @@ void CPDF_StreamContentParser::SetGraphicStates(CPDF_PageObject* pObj,
                                                 FX_BOOL bColor,
                                                 FX_BOOL bText,
                                                 FX_BOOL bGraph) {
+  if (m_Options.m_bShareStates)
+    m_StatePool.Intern(m_pCurStates.get(), bColor, bText, bGraph);
   pObj->m_GeneralState = m_pCurStates->m_GeneralState;
   pObj->m_ClipPath = m_pCurStates->m_ClipPath;
   pObj->m_ContentMark = m_CurContentMark;
@@ -701,24 +706,27 @@ void CPDF_StreamContentParser::AddForm(CPDF_Stream* pStream) {
     parser.Parse(stream.GetData(), stream.GetSize(), 0);
     return;
   }
-  CPDF_FormObject* pFormObj = new CPDF_FormObject;
-  pFormObj->m_pForm =
-      new CPDF_Form(m_pDocument, m_pPageResources, pStream, m_pResources);
-  pFormObj->m_FormMatrix = m_pCurStates->m_CTM;
-  pFormObj->m_FormMatrix.Concat(m_mtContentToUser);
   CPDF_AllStates status;
   status.m_GeneralState = m_pCurStates->m_GeneralState;
   status.m_GraphState = m_pCurStates->m_GraphState;
   status.m_ColorState = m_pCurStates->m_ColorState;
   status.m_TextState = m_pCurStates->m_TextState;
-  pFormObj->m_pForm->ParseContent(&status, NULL, NULL, &m_Options, m_Level + 1);
+  // Forms drawn on many pages, such as letterheads, are parsed only once.
+  CPDF_FormObject* pFormObj = new CPDF_FormObject;
+  pFormObj->m_pForm = m_pDocument->GetPageData()->GetForm(
+      pStream, m_pPageResources, m_pResources, &status, &m_Options,
+      m_Level + 1);
+  pFormObj->m_FormMatrix = m_pCurStates->m_CTM;
+  pFormObj->m_FormMatrix.Concat(m_mtContentToUser);
   if (!m_pObjectList->m_bBackgroundAlphaNeeded &&
       pFormObj->m_pForm->m_bBackgroundAlphaNeeded) {
     m_pObjectList->m_bBackgroundAlphaNeeded = TRUE;
   }
+  if (pFormObj->m_pForm->m_bUsesPageResources)
+    m_pObjectList->m_bUsesPageResources = TRUE;
   pFormObj->CalcBoundingBox();
   SetGraphicStates(pFormObj, TRUE, TRUE, TRUE);
-  m_pObjectList->m_ObjectList.AddTail(pFormObj);
+  m_pObjectList->m_ObjectList.push_back(pFormObj);
 }
 CPDF_ImageObject* CPDF_StreamContentParser::AddImage(CPDF_Stream* pStream,
                                                      CPDF_Image* pImage,
@@ -742,7 +750,7 @@ CPDF_ImageObject* CPDF_StreamContentParser::AddImage(CPDF_Stream* pStream,
   SetGraphicStates(pImageObj, pImageObj->m_pImage->IsMask(), FALSE, FALSE);
   pImageObj->m_Matrix = ImageMatrix;
   pImageObj->CalcBoundingBox();
-  m_pObjectList->m_ObjectList.AddTail(pImageObj);
+  m_pObjectList->m_ObjectList.push_back(pImageObj);
   return pImageObj;
 }
 void CPDF_StreamContentParser::Handle_MarkPlace_Dictionary() {}
@@ -908,6 +916,7 @@ void CPDF_StreamContentParser::Handle_RestoreGraphState() {
 }
 void CPDF_StreamContentParser::Handle_Rectangle() {
   if (m_Options.m_bTextOnly) {
+    m_pSyntax->SkipPathObject();
     return;
   }
   FX_FLOAT x = GetNumber(3), y = GetNumber(2);
@@ -1094,7 +1103,7 @@ void CPDF_StreamContentParser::Handle_ShadeFill() {
   pObj->m_Right = bbox.right;
   pObj->m_Top = bbox.top;
   pObj->m_Bottom = bbox.bottom;
-  m_pObjectList->m_ObjectList.AddTail(pObj);
+  m_pObjectList->m_ObjectList.push_back(pObj);
 }
 void CPDF_StreamContentParser::Handle_SetCharSpace() {
   m_pCurStates->m_TextState.GetModify()->m_CharSpace = GetNumber(0);
@@ -1139,6 +1148,7 @@ CPDF_Object* CPDF_StreamContentParser::FindResourceObj(
     if (!m_pPageResources) {
       return NULL;
     }
+    m_pObjectList->m_bUsesPageResources = TRUE;
     CPDF_Dictionary* pList = m_pPageResources->GetDict(type);
     if (!pList) {
       return NULL;
@@ -1261,7 +1271,7 @@ void CPDF_StreamContentParser::AddTextObject(CFX_ByteString* pStrs,
     pCopy->Copy(pText);
     m_ClipTextList.Add(pCopy);
   }
-  m_pObjectList->m_ObjectList.AddTail(pText);
+  m_pObjectList->m_ObjectList.push_back(pText);
   if (pKerning && pKerning[nsegs - 1] != 0) {
     if (!pFont->IsVertWriting()) {
       m_pCurStates->m_TextX -=
@@ -1476,7 +1486,7 @@ void CPDF_StreamContentParser::AddPathObject(int FillType, FX_BOOL bStroke) {
     pPathObj->m_Matrix = matrix;
     SetGraphicStates(pPathObj, TRUE, FALSE, TRUE);
     pPathObj->CalcBoundingBox();
-    m_pObjectList->m_ObjectList.AddTail(pPathObj);
+    m_pObjectList->m_ObjectList.push_back(pPathObj);
   }
   if (PathClipType) {
     if (!matrix.IsIdentity()) {
@@ -0,0 +1,575 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "core/include/fpdfapi/fpdf_module.h"
+#include "core/include/fpdfapi/fpdf_page.h"
+#include "core/include/fpdfapi/fpdf_pageobj.h"
+#include "core/include/fpdfapi/fpdf_parser.h"
+#include "core/include/fxcodec/fx_codec.h"
+#include "core/include/fxge/fx_dib.h"
+#include "core/src/fpdfapi/fpdf_page/pageint.h"
+#include "testing/embedder_test.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/utils/path_service.h"
+
+// Parses hello_world.pdf, whose document and resources the tests build their
+// content against.
+class FPDFPageParserEmbeddertest : public EmbedderTest {
+ protected:
+  void SetUp() override {
+    EmbedderTest::SetUp();
+    std::string file_path;
+    ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &file_path));
+    parser_.reset(new CPDF_Parser);
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser_->StartParse(FX_CreateFileRead(file_path.c_str())));
+  }
+
+  void TearDown() override {
+    // The document goes before the library is shut down.
+    parser_.reset();
+    EmbedderTest::TearDown();
+  }
+
+  CPDF_Document* doc() { return parser_->GetDocument(); }
+
+ private:
+  std::unique_ptr<CPDF_Parser> parser_;
+};
+
+namespace {
+
+using ScopedStream = std::unique_ptr<CPDF_Stream, ReleaseDeleter<CPDF_Stream>>;
+
+// CAD-style content: short strokes and filled boxes, each setting its pen
+// inside q/Q, cycling through a handful of pens.
+std::string MakePathHeavyContent(int count) {
+  static const char* const kPens[] = {"0 0 0 RG 0.5 w", "1 0 0 RG 0.5 w",
+                                      "0 0 1 RG 1 w", "0 0.5 0 RG 0.25 w"};
+  std::string content;
+  char buf[128];
+  for (int i = 0; i < count; ++i) {
+    int x = i % 500;
+    int y = i / 500;
+    snprintf(buf, sizeof(buf), "q %s 1 J %d %d m %d %d l S Q\n",
+             kPens[i % 4], x, y, x + 3, y + 1);
+    content += buf;
+    if (i % 8 == 0) {
+      snprintf(buf, sizeof(buf), "q 0.9 0.9 0.6 rg %d %d 2 2 re f Q\n", x, y);
+      content += buf;
+    }
+  }
+  return content;
+}
+
+// Vector-heavy content: strokes, curves, closed shapes and clipped boxes.
+std::string MakeVectorContent(int count) {
+  std::string content;
+  char buf[256];
+  for (int i = 0; i < count; ++i) {
+    int x = i % 500;
+    int y = i / 500;
+    snprintf(buf, sizeof(buf),
+             "q %d %d m %d %d l %d %d %d %d %d %d c %d %d %d %d v h S\n"
+             "%d %d 4 4 re W n 0.5 g %d %d 2 2 re f* Q\n",
+             x, y, x + 3, y + 1, x + 4, y + 2, x + 5, y + 4, x + 2, y + 5, x,
+             y + 3, x, y + 1, x, y, x + 1, y + 1);
+    content += buf;
+  }
+  return content;
+}
+
+// An RGB gradient, encoded with |filter|: "" for none, "Fl" or "DCT".
+std::string MakeImageData(int width, int height, const std::string& filter) {
+  CFX_DIBitmap bitmap;
+  bitmap.Create(width, height, FXDIB_Rgb);
+  std::string raw;
+  for (int row = 0; row < height; ++row) {
+    uint8_t* scan = bitmap.GetBuffer() + row * bitmap.GetPitch();
+    for (int col = 0; col < width; ++col) {
+      uint8_t rgb[3] = {static_cast<uint8_t>(col * 255 / width),
+                        static_cast<uint8_t>(row * 255 / height),
+                        static_cast<uint8_t>((col + row) % 256)};
+      raw.append(reinterpret_cast<const char*>(rgb), 3);
+      scan[col * 3] = rgb[2];
+      scan[col * 3 + 1] = rgb[1];
+      scan[col * 3 + 2] = rgb[0];
+    }
+  }
+  if (filter.empty())
+    return raw;
+
+  uint8_t* pEncoded = nullptr;
+  std::string encoded;
+  if (filter == "Fl") {
+    FX_DWORD size = 0;
+    FlateEncode(reinterpret_cast<const uint8_t*>(raw.data()), raw.size(),
+                pEncoded, size);
+    encoded.assign(reinterpret_cast<char*>(pEncoded), size);
+  } else {
+    FX_STRSIZE size = 0;
+    CPDF_ModuleMgr::Get()->GetJpegModule()->Encode(&bitmap, pEncoded, size);
+    encoded.assign(reinterpret_cast<char*>(pEncoded), size);
+  }
+  FX_Free(pEncoded);
+  return encoded;
+}
+
+// Image-heavy content: |count| placed copies of one inline image.
+std::string MakeInlineImageContent(int count,
+                                   int width,
+                                   int height,
+                                   const std::string& filter) {
+  std::string data = MakeImageData(width, height, filter);
+  std::string content;
+  char buf[256];
+  for (int i = 0; i < count; ++i) {
+    snprintf(buf, sizeof(buf),
+             "q 10 0 0 10 %d %d cm BI /W %d /H %d /CS /RGB /BPC 8%s%s ID ",
+             i % 50 * 10, i / 50 * 10, width, height,
+             filter.empty() ? "" : " /F /", filter.c_str());
+    content += buf;
+    content += data;
+    content += "\nEI Q\n";
+  }
+  return content;
+}
+
+ScopedStream MakeContentStream(const std::string& content) {
+  uint8_t* pData = FX_Alloc(uint8_t, content.size());
+  FXSYS_memcpy(pData, content.data(), content.size());
+  return ScopedStream(
+      new CPDF_Stream(pData, content.size(), new CPDF_Dictionary));
+}
+
+std::unique_ptr<CPDF_Form> ParseForm(CPDF_Document* pDoc,
+                                     CPDF_Dictionary* pResources,
+                                     CPDF_Stream* pStream,
+                                     CPDF_ParseOptions* pOptions) {
+  std::unique_ptr<CPDF_Form> pForm(
+      new CPDF_Form(pDoc, pResources, pStream, nullptr));
+  pForm->ParseContent(nullptr, nullptr, nullptr, pOptions, 0);
+  return pForm;
+}
+
+std::unique_ptr<CPDF_Form> ParseForm(CPDF_Document* pDoc,
+                                     CPDF_Stream* pStream,
+                                     bool bShareStates) {
+  CPDF_ParseOptions options;
+  options.m_bShareStates = bShareStates;
+  return ParseForm(pDoc, nullptr, pStream, &options);
+}
+
+// Paths at pseudo-random positions, which compress poorly.
+std::string MakeScatteredContent(int count) {
+  std::string content;
+  char buf[128];
+  unsigned seed = 1;
+  for (int i = 0; i < count; ++i) {
+    int coords[4];
+    for (int& coord : coords) {
+      seed = seed * 1103515245 + 12345;
+      coord = (seed >> 8) % 100000;
+    }
+    snprintf(buf, sizeof(buf), "%d.%02d %d.%02d m %d.%02d %d.%02d l S\n",
+             coords[0] / 100, coords[0] % 100, coords[1] / 100,
+             coords[1] % 100, coords[2] / 100, coords[2] % 100,
+             coords[3] / 100, coords[3] % 100);
+    content += buf;
+  }
+  return content;
+}
+
+using ScopedDictionary =
+    std::unique_ptr<CPDF_Dictionary, ReleaseDeleter<CPDF_Dictionary>>;
+
+// Makes a page dictionary whose /Contents array holds a stream per entry of
+// |parts|, Flate encoded if |bFlate|.
+ScopedDictionary MakeMultiStreamPage(CPDF_Document* pDoc,
+                                     const std::vector<std::string>& parts,
+                                     bool bFlate) {
+  ScopedDictionary pPageDict(ToDictionary(pDoc->GetPage(0)->Clone()));
+  pPageDict->SetAtRect("MediaBox", CFX_FloatRect(0, 0, 1000, 1000));
+  CPDF_Array* pContents = new CPDF_Array;
+  for (const std::string& part : parts) {
+    CPDF_Stream* pStream;
+    if (bFlate) {
+      uint8_t* pData = nullptr;
+      FX_DWORD size = 0;
+      FlateEncode(reinterpret_cast<const uint8_t*>(part.data()), part.size(),
+                  pData, size);
+      CPDF_Dictionary* pDict = new CPDF_Dictionary;
+      pDict->SetAtName("Filter", "FlateDecode");
+      pStream = new CPDF_Stream(pData, size, pDict);
+    } else {
+      pStream = MakeContentStream(part).release();
+    }
+    pContents->AddReference(pDoc, pDoc->AddIndirectObject(pStream));
+  }
+  pPageDict->SetAt("Contents", pContents);
+  return pPageDict;
+}
+
+// One line per object: its type, rounded box and, for text, its characters
+// or, for images, the size and sum of their data.
+std::vector<std::string> DescribeObjects(const CPDF_PageObjects& objects) {
+  std::vector<std::string> lines;
+  FX_POSITION pos = objects.GetFirstObjectPosition();
+  while (pos) {
+    CPDF_PageObject* pObj = objects.GetNextObject(pos);
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%d [%.2f %.2f %.2f %.2f]", pObj->m_Type,
+             pObj->m_Left, pObj->m_Bottom, pObj->m_Right, pObj->m_Top);
+    std::string line = buf;
+    if (pObj->m_Type == PDFPAGE_TEXT) {
+      CPDF_TextObject* pText = static_cast<CPDF_TextObject*>(pObj);
+      for (int i = 0; i < pText->CountChars(); ++i) {
+        FX_DWORD charcode;
+        FX_FLOAT kerning;
+        pText->GetCharInfo(i, charcode, kerning);
+        line += charcode == (FX_DWORD)-1 ? '_' : static_cast<char>(charcode);
+      }
+    } else if (pObj->m_Type == PDFPAGE_IMAGE) {
+      CPDF_StreamAcc acc;
+      acc.LoadAllData(
+          static_cast<CPDF_ImageObject*>(pObj)->m_pImage->GetStream(), TRUE);
+      FX_DWORD sum = 0;
+      for (FX_DWORD i = 0; i < acc.GetSize(); ++i)
+        sum += acc.GetData()[i];
+      snprintf(buf, sizeof(buf), " %u %u", acc.GetSize(), sum);
+      line += buf;
+    }
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// Pauses after every step.
+class AlwaysPause : public IFX_Pause {
+ public:
+  FX_BOOL NeedToPauseNow() override { return TRUE; }
+};
+
+long long ElapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start).count();
+}
+
+// The distinct state blocks of a list of objects and their approximate size.
+struct StateUsage {
+  StateUsage() : blocks(0), bytes(0) {}
+
+  template <typename T>
+  void Add(const CFX_CountRef<T>& state, size_t extra_bytes) {
+    if (state.IsNull() || !seen.insert(state.GetObject()).second)
+      return;
+    ++blocks;
+    bytes += sizeof(T) + extra_bytes;
+  }
+
+  std::set<const void*> seen;
+  size_t blocks;
+  size_t bytes;
+};
+
+StateUsage MeasureStates(const CPDF_PageObjects& objects) {
+  StateUsage usage;
+  FX_POSITION pos = objects.GetFirstObjectPosition();
+  while (pos) {
+    CPDF_PageObject* pObj = objects.GetNextObject(pos);
+    const CFX_GraphStateData* pGraph = pObj->m_GraphState.GetObject();
+    usage.Add(pObj->m_GraphState,
+              pGraph ? pGraph->m_DashCount * sizeof(FX_FLOAT) : 0);
+    usage.Add(pObj->m_ColorState, 0);
+    usage.Add(pObj->m_TextState, 0);
+    usage.Add(pObj->m_GeneralState, 0);
+  }
+  return usage;
+}
+
+template <typename T>
+bool IsSameState(const CFX_CountRef<T>& a, const CFX_CountRef<T>& b) {
+  if (a.IsNull() || b.IsNull())
+    return a.IsNull() && b.IsNull();
+  return !!PDF_IsSameStateValue(*a.GetObject(), *b.GetObject());
+}
+
+}  // namespace
+
+TEST_F(FPDFPageParserEmbeddertest, ShareStates) {
+  CPDF_Document* pDoc = doc();
+
+  const int kPaths = 2000;
+  ScopedStream pStream = MakeContentStream(MakePathHeavyContent(kPaths));
+  std::unique_ptr<CPDF_Form> pCopied = ParseForm(pDoc, pStream.get(), false);
+  std::unique_ptr<CPDF_Form> pShared = ParseForm(pDoc, pStream.get(), true);
+  ASSERT_EQ(kPaths + kPaths / 8, (int)pCopied->CountObjects());
+  ASSERT_EQ(pCopied->CountObjects(), pShared->CountObjects());
+
+  // The objects see the same states either way.
+  FX_POSITION pos_copied = pCopied->GetFirstObjectPosition();
+  FX_POSITION pos_shared = pShared->GetFirstObjectPosition();
+  while (pos_copied && pos_shared) {
+    CPDF_PageObject* pCopiedObj = pCopied->GetNextObject(pos_copied);
+    CPDF_PageObject* pSharedObj = pShared->GetNextObject(pos_shared);
+    EXPECT_TRUE(
+        IsSameState(pCopiedObj->m_GraphState, pSharedObj->m_GraphState));
+    EXPECT_TRUE(
+        IsSameState(pCopiedObj->m_ColorState, pSharedObj->m_ColorState));
+    EXPECT_TRUE(
+        IsSameState(pCopiedObj->m_TextState, pSharedObj->m_TextState));
+    EXPECT_TRUE(
+        IsSameState(pCopiedObj->m_GeneralState, pSharedObj->m_GeneralState));
+  }
+
+  // Each stroke sets its pen again, which copies the states without sharing.
+  StateUsage copied = MeasureStates(*pCopied);
+  StateUsage shared = MeasureStates(*pShared);
+  EXPECT_LT((size_t)kPaths, copied.blocks);
+  EXPECT_GT(16u, shared.blocks);
+
+  // Editing one object's state leaves the others alone.
+  CPDF_PageObject* pFirst = pShared->GetObjectByIndex(0);
+  CPDF_PageObject* pFifth = pShared->GetObjectByIndex(5);
+  ASSERT_EQ(pFirst->m_GraphState.GetObject(),
+            pFifth->m_GraphState.GetObject());
+  pFirst->m_GraphState.GetModify()->m_LineWidth = 7;
+  EXPECT_EQ(0.5f, pFifth->m_GraphState.GetObject()->m_LineWidth);
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests. Compares the memory
+// held by the state blocks of a path-heavy page, and the parse time, with
+// and without sharing.
+TEST_F(FPDFPageParserEmbeddertest, DISABLED_BenchmarkShareStates) {
+  CPDF_Document* pDoc = doc();
+
+  ScopedStream pStream = MakeContentStream(MakePathHeavyContent(200000));
+  for (bool bShareStates : {false, true}) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<CPDF_Form> pForm =
+        ParseForm(pDoc, pStream.get(), bShareStates);
+    auto end = std::chrono::steady_clock::now();
+    StateUsage usage = MeasureStates(*pForm);
+    printf("%s: %u objects, %u state blocks, %u KB, %lld ms\n",
+           bShareStates ? "Shared" : "Copied", pForm->CountObjects(),
+           static_cast<unsigned>(usage.blocks),
+           static_cast<unsigned>(usage.bytes / 1024),
+           static_cast<long long>(
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   end - start).count()));
+  }
+}
+
+TEST_F(FPDFPageParserEmbeddertest, TextOnly) {
+  CPDF_Document* pDoc = doc();
+  CPDF_Dictionary* pResources = pDoc->GetPage(0)->GetDict("Resources");
+
+  // Text placed between paths and inline images, which the text-only parse
+  // skips without building them.
+  std::string content;
+  for (const char* filter : {"", "Fl", "DCT"}) {
+    content += MakeVectorContent(3);
+    content += "q 1 0 0 1 5 5 cm BT /F1 12 Tf 20 50 Td (Before) Tj ET\n";
+    content += MakeInlineImageContent(2, 16, 8, filter);
+    content += "0 0 m 10 10 l 20 0 l h\n1 0 0 1 3 4 cm\n";
+    content += "BT /F2 16 Tf 0 50 Td (After) Tj ET Q\n";
+    content += "10 10 20 20 re B 1 1 m 2 2 l\n";
+    content += "BT /F2 16 Tf 1 2 Td (Last) Tj ET\n";
+  }
+  // A path left unfinished at the end of the data.
+  content += "q 5 5 m 6 6 l";
+  ScopedStream pStream = MakeContentStream(content);
+
+  CPDF_ParseOptions options;
+  std::unique_ptr<CPDF_Form> pFull =
+      ParseForm(pDoc, pResources, pStream.get(), &options);
+  options.m_bTextOnly = TRUE;
+  std::unique_ptr<CPDF_Form> pText =
+      ParseForm(pDoc, pResources, pStream.get(), &options);
+
+  std::vector<CPDF_TextObject*> full_text;
+  int images = 0;
+  int paths = 0;
+  FX_POSITION pos = pFull->GetFirstObjectPosition();
+  while (pos) {
+    CPDF_PageObject* pObj = pFull->GetNextObject(pos);
+    if (pObj->m_Type == PDFPAGE_TEXT)
+      full_text.push_back(static_cast<CPDF_TextObject*>(pObj));
+    images += pObj->m_Type == PDFPAGE_IMAGE;
+    paths += pObj->m_Type == PDFPAGE_PATH;
+  }
+  EXPECT_EQ(6, images);
+  EXPECT_LT(0, paths);
+  ASSERT_EQ(9u, full_text.size());
+  ASSERT_EQ(full_text.size(), pText->CountObjects());
+
+  for (size_t i = 0; i < full_text.size(); ++i) {
+    CPDF_PageObject* pObj = pText->GetObjectByIndex(i);
+    ASSERT_EQ(PDFPAGE_TEXT, pObj->m_Type);
+    CPDF_TextObject* pExpected = full_text[i];
+    CPDF_TextObject* pActual = static_cast<CPDF_TextObject*>(pObj);
+    EXPECT_EQ(pExpected->CountChars(), pActual->CountChars());
+    EXPECT_EQ(pExpected->GetFont(), pActual->GetFont());
+    EXPECT_EQ(pExpected->GetFontSize(), pActual->GetFontSize());
+    EXPECT_EQ(pExpected->GetPosX(), pActual->GetPosX());
+    EXPECT_EQ(pExpected->GetPosY(), pActual->GetPosY());
+    EXPECT_EQ(pExpected->m_Left, pActual->m_Left);
+    EXPECT_EQ(pExpected->m_Bottom, pActual->m_Bottom);
+    EXPECT_EQ(pExpected->m_Right, pActual->m_Right);
+    EXPECT_EQ(pExpected->m_Top, pActual->m_Top);
+  }
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests. Compares full and
+// text-only parse times of vector-heavy and image-heavy content.
+TEST_F(FPDFPageParserEmbeddertest, DISABLED_BenchmarkTextOnly) {
+  CPDF_Document* pDoc = doc();
+
+  struct {
+    const char* name;
+    std::string content;
+  } cases[] = {
+      {"Vector", MakeVectorContent(100000)},
+      {"Raw images", MakeInlineImageContent(2000, 64, 64, "")},
+      {"Flate images", MakeInlineImageContent(2000, 64, 64, "Fl")},
+      {"DCT images", MakeInlineImageContent(2000, 64, 64, "DCT")},
+  };
+  for (const auto& test_case : cases) {
+    ScopedStream pStream = MakeContentStream(test_case.content);
+    CPDF_ParseOptions options;
+    auto start = std::chrono::steady_clock::now();
+    ParseForm(pDoc, nullptr, pStream.get(), &options);
+    long long full_ms = ElapsedMs(start);
+    options.m_bTextOnly = TRUE;
+    start = std::chrono::steady_clock::now();
+    ParseForm(pDoc, nullptr, pStream.get(), &options);
+    long long text_ms = ElapsedMs(start);
+    printf("%s: %u KB, full %lld ms, text-only %lld ms\n", test_case.name,
+           static_cast<unsigned>(test_case.content.size() / 1024), full_ms,
+           text_ms);
+  }
+}
+
+TEST_F(FPDFPageParserEmbeddertest, MultipleStreams) {
+  CPDF_Document* pDoc = doc();
+
+  // Operands, an array and a string each continue in the next stream. The
+  // fourth stream is large enough to be decoded ahead.
+  std::vector<std::string> parts = {
+      MakeVectorContent(50) + "BT /F1 12 Tf 20 50 Td [(Hel) -100",
+      "(lo)] TJ (abc",
+      "def) Tj ET 1 0 0",
+      "1 5 5 cm " + MakeScatteredContent(20000) + "BT /F2 9 Tf (x) Tj ET",
+      "",
+      MakeVectorContent(10) + "BT /F1 12 Tf (y) Tj ET",
+  };
+  std::string joined;
+  for (const std::string& part : parts)
+    joined += part + " ";
+  ScopedDictionary pExpectedDict = MakeMultiStreamPage(pDoc, {joined}, false);
+  CPDF_Page expected_page;
+  expected_page.Load(pDoc, pExpectedDict.get(), FALSE);
+  expected_page.ParseContent();
+  std::vector<std::string> expected = DescribeObjects(expected_page);
+  ASSERT_EQ(2u * 50 + 2u * 10 + 20000 + 4, expected.size());
+  EXPECT_EQ("Hello", expected[100].substr(expected[100].size() - 5));
+  EXPECT_EQ("abc def", expected[101].substr(expected[101].size() - 7));
+
+  for (bool bFlate : {false, true}) {
+    ScopedDictionary pPageDict = MakeMultiStreamPage(pDoc, parts, bFlate);
+    for (bool bDecodeAhead : {false, true}) {
+      CPDF_ParseOptions options;
+      options.m_bDecodeAhead = bDecodeAhead;
+      CPDF_Page page;
+      page.Load(pDoc, pPageDict.get(), FALSE);
+      page.ParseContent(&options);
+      EXPECT_EQ(expected, DescribeObjects(page)) << bFlate << bDecodeAhead;
+
+      // Progressive parsing, with a pause after each step, gives the same.
+      CPDF_Page progressive_page;
+      progressive_page.Load(pDoc, pPageDict.get(), FALSE);
+      progressive_page.StartParse(&options);
+      AlwaysPause pause;
+      while (!progressive_page.IsParsed())
+        progressive_page.ContinueParse(&pause);
+      EXPECT_EQ(expected, DescribeObjects(progressive_page))
+          << bFlate << bDecodeAhead;
+    }
+  }
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests. Parses a page with
+// several large Flate content streams, decoding them on the parsing thread
+// or each one ahead on a worker.
+TEST_F(FPDFPageParserEmbeddertest, DISABLED_BenchmarkMultipleStreams) {
+  CPDF_Document* pDoc = doc();
+
+  std::vector<std::string> parts(16, MakeScatteredContent(40000));
+  ScopedDictionary pPageDict = MakeMultiStreamPage(pDoc, parts, true);
+  for (FX_BOOL bTextOnly : {FALSE, TRUE}) {
+    for (bool bDecodeAhead : {false, true}) {
+      CPDF_ParseOptions options;
+      options.m_bTextOnly = bTextOnly;
+      options.m_bDecodeAhead = bDecodeAhead;
+      CPDF_Page page;
+      page.Load(pDoc, pPageDict.get(), FALSE);
+      auto start = std::chrono::steady_clock::now();
+      page.ParseContent(&options);
+      printf("%s, %s: %u objects, %lld ms\n",
+             bTextOnly ? "Text only" : "Full",
+             bDecodeAhead ? "decoded ahead" : "decoded inline",
+             page.CountObjects(), ElapsedMs(start));
+    }
+  }
+}
+
+TEST_F(FPDFPageParserEmbeddertest, InlineImageAcrossStreams) {
+  CPDF_Document* pDoc = doc();
+
+  for (const char* filter : {"", "Fl"}) {
+    std::string image = MakeInlineImageContent(1, 16, 8, filter);
+    size_t data_pos = image.find(" ID ") + 4;
+    size_t end_pos = image.rfind("EI");
+    // The image is split in its dictionary, right after ID, inside its data
+    // and just before EI.
+    std::vector<size_t> splits = {image.find(" /H"), data_pos - 1,
+                                  data_pos + (end_pos - data_pos) / 2,
+                                  end_pos};
+    std::string before = MakeVectorContent(5);
+    // Large enough to be decoded ahead.
+    std::string after = MakeScatteredContent(20000);
+    ScopedDictionary pExpectedDict =
+        MakeMultiStreamPage(pDoc, {before + image + after}, false);
+    CPDF_Page expected_page;
+    expected_page.Load(pDoc, pExpectedDict.get(), FALSE);
+    expected_page.ParseContent();
+    std::vector<std::string> expected = DescribeObjects(expected_page);
+    ASSERT_EQ(2u * 5 + 1 + 20000, expected.size());
+
+    for (size_t split : splits) {
+      std::vector<std::string> parts = {before + image.substr(0, split),
+                                        image.substr(split) + after};
+      ScopedDictionary pPageDict = MakeMultiStreamPage(pDoc, parts, true);
+      for (bool bDecodeAhead : {false, true}) {
+        CPDF_ParseOptions options;
+        options.m_bDecodeAhead = bDecodeAhead;
+        CPDF_Page page;
+        page.Load(pDoc, pPageDict.get(), FALSE);
+        page.StartParse(&options);
+        AlwaysPause pause;
+        while (!page.IsParsed())
+          page.ContinueParse(&pause);
+        EXPECT_EQ(expected, DescribeObjects(page))
+            << filter << " " << split << " " << bDecodeAhead;
+      }
+    }
+  }
+}
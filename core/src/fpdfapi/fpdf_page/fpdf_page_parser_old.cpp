@@ -8,6 +8,8 @@
 
 #include <limits.h>
 
+#include <algorithm>
+
 #include "core/include/fpdfapi/fpdf_module.h"
 #include "core/include/fpdfapi/fpdf_page.h"
 #include "core/include/fxcodec/fx_codec.h"
@@ -24,6 +26,26 @@ const char kPathOperatorCubicBezier3 = 'y';
 const char kPathOperatorClosePath = 'h';
 const char kPathOperatorRectangle[] = "re";
 
+// Path construction, painting and clipping operators: all of them are
+// no-ops when only text is parsed.
+bool IsPathOperator(const uint8_t* op, FX_DWORD len) {
+  if (len == 1)
+    return op[0] && FXSYS_strchr("mlcvyhSsfFBbnW", op[0]);
+  if (len != 2)
+    return false;
+  if (op[1] == '*')
+    return op[0] == 'f' || op[0] == 'B' || op[0] == 'b' || op[0] == 'W';
+  return op[0] == kPathOperatorRectangle[0] &&
+         op[1] == kPathOperatorRectangle[1];
+}
+
+// How much content stream data is decoded per CPDF_ContentParser step.
+const FX_DWORD kContentBlockSize = 16 * 1024;
+
+// Filtered content streams at least this large are decoded on a worker
+// thread while the stream before them is parsed.
+const FX_DWORD kDecodeAheadSize = 64 * 1024;
+
 }  // namespace
 
 class CPDF_StreamParserAutoClearer {
@@ -40,7 +62,8 @@ class CPDF_StreamParserAutoClearer {
 };
 FX_DWORD CPDF_StreamContentParser::Parse(const uint8_t* pData,
                                          FX_DWORD dwSize,
-                                         FX_DWORD max_cost) {
+                                         FX_DWORD max_cost,
+                                         FX_BOOL bMoreData) {
   if (m_Level > _FPDF_MAX_FORM_LEVEL_) {
     return dwSize;
   }
@@ -48,16 +71,30 @@ FX_DWORD CPDF_StreamContentParser::Parse(const uint8_t* pData,
   CPDF_StreamParser syntax(pData, dwSize);
   CPDF_StreamParserAutoClearer auto_clearer(&m_pSyntax, &syntax);
   m_CompatCount = 0;
+  m_bMoreData = bMoreData;
+  m_bSplitInImageData = FALSE;
   while (1) {
     FX_DWORD cost = m_pObjectList->CountObjects() - InitObjCount;
     if (max_cost && cost >= max_cost) {
       break;
     }
-    switch (syntax.ParseNextElement()) {
+    FX_DWORD element_pos = syntax.GetPos();
+    CPDF_StreamParser::SyntaxType type = syntax.ParseNextElement();
+    if (bMoreData && type == CPDF_StreamParser::Others &&
+        syntax.GetPos() == dwSize) {
+      // The object may continue in the next stream.
+      return element_pos;
+    }
+    switch (type) {
       case CPDF_StreamParser::EndOfData:
         return m_pSyntax->GetPos();
       case CPDF_StreamParser::Keyword:
         OnOperator((char*)syntax.GetWordBuf());
+        if (m_bImageSplit) {
+          // The inline image continues in the next stream.
+          m_bImageSplit = FALSE;
+          return element_pos;
+        }
         ClearAllParams();
         break;
       case CPDF_StreamParser::Number:
@@ -77,8 +114,10 @@ FX_DWORD CPDF_StreamContentParser::Parse(const uint8_t* pData,
 void CPDF_StreamContentParser::Handle_BeginImage() {
   FX_FILESIZE savePos = m_pSyntax->GetPos();
   CPDF_Dictionary* pDict = new CPDF_Dictionary;
+  FX_BOOL bInData = FALSE;
   while (1) {
     CPDF_StreamParser::SyntaxType type = m_pSyntax->ParseNextElement();
+    bInData = type == CPDF_StreamParser::Keyword;
     if (type == CPDF_StreamParser::Keyword) {
       CFX_ByteString bsKeyword(m_pSyntax->GetWordBuf(),
                                m_pSyntax->GetWordSize());
@@ -111,15 +150,20 @@ void CPDF_StreamContentParser::Handle_BeginImage() {
       CFX_ByteString name = pCSObj->GetString();
       if (name != "DeviceRGB" && name != "DeviceGray" && name != "DeviceCMYK") {
         pCSObj = FindResourceObj("ColorSpace", name);
-        if (pCSObj && !pCSObj->GetObjNum()) {
+        if (pCSObj && !pCSObj->GetObjNum() && !m_Options.m_bTextOnly) {
           pCSObj = pCSObj->Clone();
           pDict->SetAt("ColorSpace", pCSObj);
         }
       }
     }
   }
-  CPDF_Stream* pStream = m_pSyntax->ReadInlineStream(
-      m_pDocument, pDict, pCSObj, m_Options.m_bDecodeInlineImage);
+  CPDF_Stream* pStream = nullptr;
+  if (!m_Options.m_bTextOnly ||
+      !m_pSyntax->SkipInlineStream(m_pDocument, pDict, pCSObj)) {
+    pStream = m_pSyntax->ReadInlineStream(m_pDocument, pDict, pCSObj,
+                                          m_Options.m_bDecodeInlineImage);
+  }
+  FX_BOOL bFoundEnd = FALSE;
   while (1) {
     CPDF_StreamParser::SyntaxType type = m_pSyntax->ParseNextElement();
     if (type == CPDF_StreamParser::EndOfData) {
@@ -130,9 +174,21 @@ void CPDF_StreamContentParser::Handle_BeginImage() {
     }
     if (m_pSyntax->GetWordSize() == 2 && m_pSyntax->GetWordBuf()[0] == 'E' &&
         m_pSyntax->GetWordBuf()[1] == 'I') {
+      bFoundEnd = TRUE;
       break;
     }
   }
+  if (!bFoundEnd && m_bMoreData) {
+    // Leave the image for Parse to hand back whole with the next stream.
+    if (pStream) {
+      pStream->Release();
+    } else {
+      pDict->Release();
+    }
+    m_bImageSplit = TRUE;
+    m_bSplitInImageData = bInData;
+    return;
+  }
   if (m_Options.m_bTextOnly) {
     if (pStream) {
       pStream->Release();
@@ -323,30 +379,33 @@ FX_DWORD PDF_DecodeInlineStream(const uint8_t* src_buf,
   dest_buf = 0;
   return (FX_DWORD)-1;
 }
-CPDF_Stream* CPDF_StreamParser::ReadInlineStream(CPDF_Document* pDoc,
-                                                 CPDF_Dictionary* pDict,
-                                                 CPDF_Object* pCSObj,
-                                                 FX_BOOL bDecode) {
-  if (m_Pos == m_Size)
-    return nullptr;
-
-  if (PDFCharIsWhitespace(m_pBuf[m_Pos]))
-    m_Pos++;
+namespace {
 
-  CFX_ByteString Decoder;
-  CPDF_Dictionary* pParam = nullptr;
+// Returns the first filter of an inline image and sets |*ppParam| to its
+// parameters.
+CFX_ByteString GetInlineDecoder(CPDF_Dictionary* pDict,
+                                CPDF_Dictionary** ppParam) {
+  *ppParam = nullptr;
   CPDF_Object* pFilter = pDict->GetElementValue("Filter");
-  if (pFilter) {
-    if (CPDF_Array* pArray = pFilter->AsArray()) {
-      Decoder = pArray->GetString(0);
-      CPDF_Array* pParams = pDict->GetArray("DecodeParms");
-      if (pParams)
-        pParam = pParams->GetDict(0);
-    } else {
-      Decoder = pFilter->GetString();
-      pParam = pDict->GetDict("DecodeParms");
-    }
+  if (!pFilter)
+    return CFX_ByteString();
+
+  if (CPDF_Array* pArray = pFilter->AsArray()) {
+    CPDF_Array* pParams = pDict->GetArray("DecodeParms");
+    if (pParams)
+      *ppParam = pParams->GetDict(0);
+    return pArray->GetString(0);
   }
+  *ppParam = pDict->GetDict("DecodeParms");
+  return pFilter->GetString();
+}
+
+// Computes the size of the unfiltered data of an inline image. Returns FALSE
+// if it overflows.
+FX_BOOL GetInlineImageSize(CPDF_Document* pDoc,
+                           CPDF_Dictionary* pDict,
+                           CPDF_Object* pCSObj,
+                           FX_DWORD* pSize) {
   FX_DWORD width = pDict->GetInteger("Width");
   FX_DWORD height = pDict->GetInteger("Height");
   FX_DWORD OrigSize = 0;
@@ -362,29 +421,99 @@ CPDF_Stream* CPDF_StreamParser::ReadInlineStream(CPDF_Document* pDoc,
     }
     FX_DWORD pitch = width;
     if (bpc && pitch > INT_MAX / bpc) {
-      return NULL;
+      return FALSE;
     }
     pitch *= bpc;
     if (nComponents && pitch > INT_MAX / nComponents) {
-      return NULL;
+      return FALSE;
     }
     pitch *= nComponents;
     if (pitch > INT_MAX - 7) {
-      return NULL;
+      return FALSE;
     }
     pitch += 7;
     pitch /= 8;
     OrigSize = pitch;
   } else {
     if (width > INT_MAX - 7) {
-      return NULL;
+      return FALSE;
     }
     OrigSize = ((width + 7) / 8);
   }
   if (height && OrigSize > INT_MAX / height) {
-    return NULL;
+    return FALSE;
+  }
+  *pSize = OrigSize * height;
+  return TRUE;
+}
+
+// Returns the size of the JPEG data at |pData| up to and including its EOI
+// marker, found by walking the marker segments without decoding, or 0 if
+// the data is malformed or truncated.
+FX_DWORD GetJpegSize(const uint8_t* pData, FX_DWORD size) {
+  if (size < 2 || pData[0] != 0xff || pData[1] != 0xd8)
+    return 0;
+
+  FX_DWORD pos = 2;
+  while (pos + 1 < size) {
+    if (pData[pos] != 0xff)
+      return 0;
+
+    uint8_t marker = pData[pos + 1];
+    if (marker == 0xff) {
+      // Fill byte.
+      pos++;
+      continue;
+    }
+    pos += 2;
+    if (marker == 0xd9)
+      return pos;
+    if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+      continue;
+    if (pos + 1 >= size)
+      return 0;
+
+    FX_DWORD length = (pData[pos] << 8) | pData[pos + 1];
+    if (length < 2)
+      return 0;
+    pos += length;
+    if (marker != 0xda)
+      continue;
+
+    // Entropy-coded data runs up to the next marker other than a stuffed
+    // zero byte or a restart marker.
+    while (pos + 1 < size) {
+      uint8_t next = pData[pos + 1];
+      if (pData[pos] != 0xff || next == 0 || (next >= 0xd0 && next <= 0xd7))
+        pos += pData[pos] == 0xff ? 2 : 1;
+      else
+        break;
+    }
   }
-  OrigSize *= height;
+  return 0;
+}
+
+}  // namespace
+
+CPDF_Stream* CPDF_StreamParser::ReadInlineStream(CPDF_Document* pDoc,
+                                                 CPDF_Dictionary* pDict,
+                                                 CPDF_Object* pCSObj,
+                                                 FX_BOOL bDecode) {
+  if (m_Pos == m_Size)
+    return nullptr;
+
+  if (PDFCharIsWhitespace(m_pBuf[m_Pos]))
+    m_Pos++;
+
+  CPDF_Dictionary* pParam = nullptr;
+  CFX_ByteString Decoder = GetInlineDecoder(pDict, &pParam);
+  CPDF_Object* pFilter = pDict->GetElementValue("Filter");
+  FX_DWORD width = pDict->GetInteger("Width");
+  FX_DWORD height = pDict->GetInteger("Height");
+  FX_DWORD OrigSize = 0;
+  if (!GetInlineImageSize(pDoc, pDict, pCSObj, &OrigSize))
+    return NULL;
+
   uint8_t* pData = NULL;
   FX_DWORD dwStreamSize;
   if (Decoder.IsEmpty()) {
@@ -447,6 +576,52 @@ CPDF_Stream* CPDF_StreamParser::ReadInlineStream(CPDF_Document* pDoc,
   return new CPDF_Stream(pData, dwStreamSize, pDict);
 }
 
+FX_BOOL CPDF_StreamParser::SkipInlineStream(CPDF_Document* pDoc,
+                                            CPDF_Dictionary* pDict,
+                                            CPDF_Object* pCSObj) {
+  FX_DWORD start_pos = m_Pos;
+  if (m_Pos < m_Size && PDFCharIsWhitespace(m_pBuf[m_Pos]))
+    m_Pos++;
+
+  // PDF 2.0 gives the length of the data. Trust it only when EI follows.
+  int length = pDict->GetInteger("L");
+  if (length <= 0)
+    length = pDict->GetInteger("Length");
+  if (length > 0 && (FX_DWORD)length <= m_Size - m_Pos) {
+    FX_DWORD end_pos = m_Pos + length;
+    FX_DWORD pos = end_pos;
+    while (pos < m_Size && PDFCharIsWhitespace(m_pBuf[pos]))
+      pos++;
+    if (pos + 1 < m_Size && m_pBuf[pos] == 'E' && m_pBuf[pos + 1] == 'I' &&
+        (pos + 2 == m_Size || PDFCharIsWhitespace(m_pBuf[pos + 2]) ||
+         PDFCharIsDelimiter(m_pBuf[pos + 2]))) {
+      m_Pos = end_pos;
+      return TRUE;
+    }
+  }
+
+  CPDF_Dictionary* pParam = nullptr;
+  CFX_ByteString Decoder = GetInlineDecoder(pDict, &pParam);
+  if (Decoder.IsEmpty()) {
+    FX_DWORD OrigSize = 0;
+    if (!GetInlineImageSize(pDoc, pDict, pCSObj, &OrigSize)) {
+      m_Pos = start_pos;
+      return FALSE;
+    }
+    m_Pos += std::min(OrigSize, m_Size - m_Pos);
+    return TRUE;
+  }
+  if (Decoder == "DCTDecode" || Decoder == "DCT") {
+    FX_DWORD size = GetJpegSize(m_pBuf + m_Pos, m_Size - m_Pos);
+    if (size) {
+      m_Pos += size;
+      return TRUE;
+    }
+  }
+  m_Pos = start_pos;
+  return FALSE;
+}
+
 #define MAX_WORD_BUFFER 256
 #define MAX_STRING_LENGTH 32767
 #define FXDWORD_TRUE FXDWORD_FROM_LSBFIRST(0x65757274)
@@ -475,14 +650,10 @@ CPDF_StreamParser::SyntaxType CPDF_StreamParser::ParseNextElement() {
     if (ch != '%')
       break;
 
-    while (1) {
-      if (!PositionIsInBounds())
-        return EndOfData;
-
-      ch = m_pBuf[m_Pos++];
-      if (PDFCharIsLineEnding(ch))
-        break;
-    }
+    m_Pos += PDF_FindLineEnding(m_pBuf + m_Pos, m_Size - m_Pos);
+    if (!PositionIsInBounds())
+      return EndOfData;
+    ch = m_pBuf[m_Pos++];
   }
 
   if (PDFCharIsDelimiter(ch) && ch != '/') {
@@ -491,24 +662,9 @@ CPDF_StreamParser::SyntaxType CPDF_StreamParser::ParseNextElement() {
     return Others;
   }
 
-  while (1) {
-    if (m_WordSize < MAX_WORD_BUFFER)
-      m_WordBuffer[m_WordSize++] = ch;
-
-    if (!PDFCharIsNumeric(ch))
-      bIsNumber = FALSE;
-
-    if (!PositionIsInBounds())
-      break;
-
-    ch = m_pBuf[m_Pos++];
-
-    if (PDFCharIsDelimiter(ch) || PDFCharIsWhitespace(ch)) {
-      m_Pos--;
-      break;
-    }
-  }
-
+  FX_DWORD word_start = m_Pos - 1;
+  m_Pos += PDF_FindWordEnd(m_pBuf + m_Pos, m_Size - m_Pos);
+  bIsNumber = ReadWord(word_start);
   m_WordBuffer[m_WordSize] = 0;
   if (bIsNumber)
     return Number;
@@ -535,65 +691,29 @@ CPDF_StreamParser::SyntaxType CPDF_StreamParser::ParseNextElement() {
 
 void CPDF_StreamParser::SkipPathObject() {
   FX_DWORD command_startpos = m_Pos;
-  if (!PositionIsInBounds())
-    return;
-
-  int ch = m_pBuf[m_Pos++];
   while (1) {
-    while (PDFCharIsWhitespace(ch)) {
-      if (!PositionIsInBounds())
-        return;
-      ch = m_pBuf[m_Pos++];
-    }
-
-    if (!PDFCharIsNumeric(ch)) {
-      m_Pos = command_startpos;
+    while (m_Pos < m_Size && PDFCharIsWhitespace(m_pBuf[m_Pos]))
+      m_Pos++;
+    if (m_Pos == m_Size)
       return;
-    }
-
-    while (1) {
-      while (!PDFCharIsWhitespace(ch)) {
-        if (!PositionIsInBounds())
-          return;
-        ch = m_pBuf[m_Pos++];
-      }
 
-      while (PDFCharIsWhitespace(ch)) {
-        if (!PositionIsInBounds())
-          return;
-        ch = m_pBuf[m_Pos++];
-      }
+    FX_DWORD word_startpos = m_Pos;
+    while (m_Pos < m_Size && !PDFCharIsWhitespace(m_pBuf[m_Pos]) &&
+           !PDFCharIsDelimiter(m_pBuf[m_Pos])) {
+      m_Pos++;
+    }
+    if (m_Pos == word_startpos)
+      break;
 
-      if (PDFCharIsNumeric(ch))
-        continue;
+    if (PDFCharIsNumeric(m_pBuf[word_startpos]))
+      continue;
 
-      FX_DWORD op_startpos = m_Pos - 1;
-      while (!PDFCharIsWhitespace(ch) && !PDFCharIsDelimiter(ch)) {
-        if (!PositionIsInBounds())
-          return;
-        ch = m_pBuf[m_Pos++];
-      }
+    if (!IsPathOperator(m_pBuf + word_startpos, m_Pos - word_startpos))
+      break;
 
-      if (m_Pos - op_startpos == 2) {
-        int op = m_pBuf[op_startpos];
-        if (op == kPathOperatorSubpath || op == kPathOperatorLine ||
-            op == kPathOperatorCubicBezier1 ||
-            op == kPathOperatorCubicBezier2 ||
-            op == kPathOperatorCubicBezier3) {
-          command_startpos = m_Pos;
-          break;
-        }
-      } else if (m_Pos - op_startpos == 3) {
-        if (m_pBuf[op_startpos] == kPathOperatorRectangle[0] &&
-            m_pBuf[op_startpos + 1] == kPathOperatorRectangle[1]) {
-          command_startpos = m_Pos;
-          break;
-        }
-      }
-      m_Pos = command_startpos;
-      return;
-    }
+    command_startpos = m_Pos;
   }
+  m_Pos = command_startpos;
 }
 CPDF_Object* CPDF_StreamParser::ReadNextObject(FX_BOOL bAllowNestedArray,
                                                FX_BOOL bInArray) {
@@ -696,31 +816,20 @@ void CPDF_StreamParser::GetNextWord(FX_BOOL& bIsNumber) {
     if (ch != '%')
       break;
 
-    while (1) {
-      if (!PositionIsInBounds())
-        return;
-      ch = m_pBuf[m_Pos++];
-      if (PDFCharIsLineEnding(ch))
-        break;
-    }
+    m_Pos += PDF_FindLineEnding(m_pBuf + m_Pos, m_Size - m_Pos);
+    if (!PositionIsInBounds())
+      return;
+    ch = m_pBuf[m_Pos++];
   }
 
   if (PDFCharIsDelimiter(ch)) {
     bIsNumber = FALSE;
     m_WordBuffer[m_WordSize++] = ch;
     if (ch == '/') {
-      while (1) {
-        if (!PositionIsInBounds())
-          return;
-        ch = m_pBuf[m_Pos++];
-        if (!PDFCharIsOther(ch) && !PDFCharIsNumeric(ch)) {
-          m_Pos--;
-          return;
-        }
-
-        if (m_WordSize < MAX_WORD_BUFFER)
-          m_WordBuffer[m_WordSize++] = ch;
-      }
+      // A name runs up to the next whitespace or delimiter.
+      FX_DWORD word_start = m_Pos - 1;
+      m_Pos += PDF_FindWordEnd(m_pBuf + m_Pos, m_Size - m_Pos);
+      ReadWord(word_start);
     } else if (ch == '<') {
       if (!PositionIsInBounds())
         return;
@@ -741,20 +850,9 @@ void CPDF_StreamParser::GetNextWord(FX_BOOL& bIsNumber) {
     return;
   }
 
-  while (1) {
-    if (m_WordSize < MAX_WORD_BUFFER)
-      m_WordBuffer[m_WordSize++] = ch;
-    if (!PDFCharIsNumeric(ch))
-      bIsNumber = FALSE;
-
-    if (!PositionIsInBounds())
-      return;
-    ch = m_pBuf[m_Pos++];
-    if (PDFCharIsDelimiter(ch) || PDFCharIsWhitespace(ch)) {
-      m_Pos--;
-      break;
-    }
-  }
+  FX_DWORD word_start = m_Pos - 1;
+  m_Pos += PDF_FindWordEnd(m_pBuf + m_Pos, m_Size - m_Pos);
+  bIsNumber = ReadWord(word_start);
 }
 
 CFX_ByteString CPDF_StreamParser::ReadString() {
@@ -890,18 +988,33 @@ bool CPDF_StreamParser::PositionIsInBounds() const {
   return m_Pos < m_Size;
 }
 
+FX_BOOL CPDF_StreamParser::ReadWord(FX_DWORD start) {
+  FX_DWORD len = m_Pos - start;
+  m_WordSize = std::min<FX_DWORD>(len, MAX_WORD_BUFFER);
+  FXSYS_memcpy(m_WordBuffer, m_pBuf + start, m_WordSize);
+  for (FX_DWORD i = 0; i < len; ++i) {
+    if (!PDFCharIsNumeric(m_pBuf[start + i]))
+      return FALSE;
+  }
+  return TRUE;
+}
+
 CPDF_ContentParser::CPDF_ContentParser()
     : m_Status(Ready),
       m_InternalStage(STAGE_GETCONTENT),
       m_pObjects(nullptr),
       m_bForm(false),
       m_pType3Char(nullptr),
+      m_pContents(nullptr),
+      m_nStreams(0),
+      m_StreamIndex(0),
       m_pData(nullptr),
       m_Size(0),
-      m_CurrentOffset(0) {}
+      m_CurrentOffset(0),
+      m_bAheadDone(FALSE) {}
 CPDF_ContentParser::~CPDF_ContentParser() {
-  if (!m_pSingleStream)
-    FX_Free(m_pData);
+  if (m_AheadThread.joinable())
+    m_AheadThread.join();
 }
 void CPDF_ContentParser::Start(CPDF_Page* pPage, CPDF_ParseOptions* pOptions) {
   if (m_Status != Ready || !pPage || !pPage->m_pDocument ||
@@ -916,22 +1029,18 @@ void CPDF_ContentParser::Start(CPDF_Page* pPage, CPDF_ParseOptions* pOptions) {
   }
   m_Status = ToBeContinued;
   m_InternalStage = STAGE_GETCONTENT;
-  m_CurrentOffset = 0;
+  m_StreamIndex = 0;
 
-  CPDF_Object* pContent = pPage->m_pFormDict->GetElementValue("Contents");
-  if (!pContent) {
+  m_pContents = pPage->m_pFormDict->GetElementValue("Contents");
+  if (!m_pContents) {
     m_Status = Done;
     return;
   }
-  if (CPDF_Stream* pStream = pContent->AsStream()) {
-    m_nStreams = 0;
-    m_pSingleStream.reset(new CPDF_StreamAcc);
-    m_pSingleStream->LoadAllData(pStream, FALSE);
-  } else if (CPDF_Array* pArray = pContent->AsArray()) {
+  if (m_pContents->IsStream()) {
+    m_nStreams = 1;
+  } else if (CPDF_Array* pArray = m_pContents->AsArray()) {
     m_nStreams = pArray->GetCount();
-    if (m_nStreams)
-      m_StreamArray.resize(m_nStreams);
-    else
+    if (!m_nStreams)
       m_Status = Done;
   } else {
     m_Status = Done;
@@ -986,52 +1095,130 @@ void CPDF_ContentParser::Start(CPDF_Form* pForm,
     pData->m_FillAlpha = 1.0f;
     pData->m_pSoftMask = NULL;
   }
-  m_nStreams = 0;
-  m_pSingleStream.reset(new CPDF_StreamAcc);
-  m_pSingleStream->LoadAllData(pForm->m_pFormStream, FALSE);
-  m_pData = (uint8_t*)m_pSingleStream->GetData();
-  m_Size = m_pSingleStream->GetSize();
   m_Status = ToBeContinued;
-  m_InternalStage = STAGE_PARSE;
+  m_InternalStage = STAGE_GETCONTENT;
+  m_pContents = pForm->m_pFormStream;
+  m_nStreams = 1;
+  m_StreamIndex = 0;
+}
+CPDF_Stream* CPDF_ContentParser::GetStream(FX_DWORD index) const {
+  if (CPDF_Array* pArray = m_pContents->AsArray())
+    return ToStream(pArray->GetElementValue(index));
+  return m_pContents->AsStream();
+}
+FX_BOOL CPDF_ContentParser::LoadStream(IFX_Pause* pPause) {
+  if (m_AheadThread.joinable()) {
+    {
+      std::unique_lock<std::mutex> lock(m_AheadLock);
+      // Hand control back to a caller that wants to pause rather than block.
+      if (!m_bAheadDone && pPause && pPause->NeedToPauseNow())
+        return FALSE;
+      m_AheadCond.wait(lock, [this] { return !!m_bAheadDone; });
+    }
+    m_AheadThread.join();
+    m_pAheadFilter.reset();
+    m_pAheadStream.reset();
+    m_ContentBuf.TakeOver(m_AheadBuf);
+  } else if (!m_pStreamFilter) {
+    // Unfiltered data already in memory is parsed in place.
+    CPDF_Stream* pStream = GetStream(m_StreamIndex);
+    if (!pStream || (pStream->IsMemoryBased() &&
+                     !pStream->GetDict()->KeyExist("Filter"))) {
+      m_pStreamAcc.reset(new CPDF_StreamAcc);
+      m_pStreamAcc->LoadAllData(pStream, FALSE);
+    } else {
+      m_pStreamFilter.reset(new CPDF_StreamFilter(pStream));
+      return FALSE;
+    }
+  } else {
+    // Decode a block per step so that large streams can be paused. The
+    // block is decoded straight into the end of |m_ContentBuf|.
+    FX_STRSIZE old_size = m_ContentBuf.GetSize();
+    FX_SAFE_INT32 safeSize = old_size;
+    safeSize += kContentBlockSize;
+    safeSize += 1;
+    if (!safeSize.IsValid()) {
+      m_Status = Done;
+      return FALSE;
+    }
+    m_ContentBuf.AppendFill(0, kContentBlockSize);
+    FX_DWORD size = m_pStreamFilter->ReadBlock(
+        m_ContentBuf.GetBuffer() + old_size, kContentBlockSize);
+    m_ContentBuf.Delete(old_size + size, kContentBlockSize - size);
+    if (size)
+      return FALSE;
+    m_pStreamFilter.reset();
+  }
+
+  if (m_Carry.GetSize()) {
+    // The previous stream ended inside an object, so join the two.
+    if (m_pStreamAcc) {
+      m_Carry.AppendBlock(m_pStreamAcc->GetData(), m_pStreamAcc->GetSize());
+      m_pStreamAcc.reset();
+    } else {
+      m_Carry.AppendBlock(m_ContentBuf.GetBuffer(), m_ContentBuf.GetSize());
+    }
+    m_ContentBuf.TakeOver(m_Carry);
+  }
+  if (m_pStreamAcc) {
+    m_pData = const_cast<uint8_t*>(m_pStreamAcc->GetData());
+    m_Size = m_pStreamAcc->GetSize();
+  } else {
+    m_pData = m_ContentBuf.GetBuffer();
+    m_Size = m_ContentBuf.GetSize();
+  }
   m_CurrentOffset = 0;
+  DecodeAhead();
+  return TRUE;
+}
+void CPDF_ContentParser::DecodeAhead() {
+  if (!m_Options.m_bDecodeAhead || m_StreamIndex + 1 >= m_nStreams)
+    return;
+
+  CPDF_Stream* pStream = GetStream(m_StreamIndex + 1);
+  if (!pStream || pStream->GetRawSize() < kDecodeAheadSize ||
+      !pStream->GetDict()->KeyExist("Filter")) {
+    return;
+  }
+
+  // The worker only reads a copy of the raw data, through decoders set up
+  // here. It never touches the file, the document or the dictionary, whose
+  // names share their buffers and unsynchronized reference counts with the
+  // document's.
+  FX_DWORD raw_size = pStream->GetRawSize();
+  uint8_t* pRawData = FX_Alloc(uint8_t, raw_size);
+  if (!pStream->ReadRawData(0, pRawData, raw_size)) {
+    FX_Free(pRawData);
+    return;
+  }
+  m_pAheadStream.reset(new CPDF_Stream(
+      pRawData, raw_size, ToDictionary(pStream->GetDict()->Clone(TRUE))));
+  m_pAheadFilter.reset(new CPDF_StreamFilter(m_pAheadStream.get()));
+  if (!m_pAheadFilter->IsIncremental()) {
+    m_pAheadFilter.reset();
+    m_pAheadStream.reset();
+    return;
+  }
+  CPDF_StreamFilter* pFilter = m_pAheadFilter.get();
+  CFX_BinaryBuf* pBuf = &m_AheadBuf;
+  m_bAheadDone = FALSE;
+  m_AheadThread = std::thread([this, pFilter, pBuf]() {
+    uint8_t block[kContentBlockSize];
+    while (FX_DWORD size = pFilter->ReadBlock(block, sizeof(block)))
+      pBuf->AppendBlock(block, size);
+    std::lock_guard<std::mutex> lock(m_AheadLock);
+    m_bAheadDone = TRUE;
+    m_AheadCond.notify_one();
+  });
 }
 void CPDF_ContentParser::Continue(IFX_Pause* pPause) {
   int steps = 0;
   while (m_Status == ToBeContinued) {
     if (m_InternalStage == STAGE_GETCONTENT) {
-      if (m_CurrentOffset == m_nStreams) {
-        if (!m_StreamArray.empty()) {
-          FX_SAFE_DWORD safeSize = 0;
-          for (const auto& stream : m_StreamArray) {
-            safeSize += stream->GetSize();
-            safeSize += 1;
-          }
-          if (!safeSize.IsValid()) {
-            m_Status = Done;
-            return;
-          }
-          m_Size = safeSize.ValueOrDie();
-          m_pData = FX_Alloc(uint8_t, m_Size);
-          FX_DWORD pos = 0;
-          for (const auto& stream : m_StreamArray) {
-            FXSYS_memcpy(m_pData + pos, stream->GetData(), stream->GetSize());
-            pos += stream->GetSize();
-            m_pData[pos++] = ' ';
-          }
-          m_StreamArray.clear();
-        } else {
-          m_pData = (uint8_t*)m_pSingleStream->GetData();
-          m_Size = m_pSingleStream->GetSize();
-        }
+      if (m_StreamIndex == m_nStreams) {
+        m_InternalStage = STAGE_CHECKCLIP;
+      } else if (LoadStream(pPause)) {
         m_InternalStage = STAGE_PARSE;
-        m_CurrentOffset = 0;
-      } else {
-        CPDF_Array* pContent = m_pObjects->m_pFormDict->GetArray("Contents");
-        m_StreamArray[m_CurrentOffset].reset(new CPDF_StreamAcc);
-        CPDF_Stream* pStreamObj = ToStream(
-            pContent ? pContent->GetElementValue(m_CurrentOffset) : nullptr);
-        m_StreamArray[m_CurrentOffset]->LoadAllData(pStreamObj, FALSE);
-        m_CurrentOffset++;
       }
     }
     if (m_InternalStage == STAGE_PARSE) {
@@ -1042,12 +1229,30 @@ void CPDF_ContentParser::Continue(IFX_Pause* pPause) {
             &m_Options, nullptr, 0));
         m_pParser->GetCurStates()->m_ColorState.GetModify()->Default();
       }
-      if (m_CurrentOffset >= m_Size) {
-        m_InternalStage = STAGE_CHECKCLIP;
-      } else {
-        m_CurrentOffset +=
+      FX_BOOL bMoreData = m_StreamIndex + 1 < m_nStreams;
+      if (m_CurrentOffset < m_Size) {
+        FX_DWORD pos =
             m_pParser->Parse(m_pData + m_CurrentOffset,
-                             m_Size - m_CurrentOffset, PARSE_STEP_LIMIT);
+                             m_Size - m_CurrentOffset, PARSE_STEP_LIMIT,
+                             bMoreData);
+        if (pos == 0 && bMoreData) {
+          m_Carry.AppendBlock(m_pData + m_CurrentOffset,
+                              m_Size - m_CurrentOffset);
+          // Streams are separated by white space, but the data of an inline
+          // image carries on byte for byte.
+          if (!m_pParser->IsSplitInImageData())
+            m_Carry.AppendByte(' ');
+          pos = m_Size - m_CurrentOffset;
+        }
+        m_CurrentOffset += pos;
+      }
+      if (m_CurrentOffset >= m_Size) {
+        m_pStreamAcc.reset();
+        m_ContentBuf.Clear();
+        m_pData = nullptr;
+        m_Size = 0;
+        m_StreamIndex++;
+        m_InternalStage = STAGE_GETCONTENT;
       }
     }
     if (m_InternalStage == STAGE_CHECKCLIP) {
@@ -1064,10 +1269,7 @@ void CPDF_ContentParser::Continue(IFX_Pause* pPause) {
         m_pType3Char->m_BBox.top =
             FXSYS_round(m_pParser->GetType3Data()[5] * 1000);
       }
-      FX_POSITION pos = m_pObjects->m_ObjectList.GetHeadPosition();
-      while (pos) {
-        CPDF_PageObject* pObj =
-            (CPDF_PageObject*)m_pObjects->m_ObjectList.GetNext(pos);
+      for (CPDF_PageObject* pObj : m_pObjects->m_ObjectList) {
         if (pObj->m_ClipPath.IsNull()) {
           continue;
         }
@@ -46,3 +46,57 @@ TEST(fpdf_page_parser_old, ReadHexString) {
     EXPECT_EQ(1, parser.GetPos());
   }
 }
+
+TEST(fpdf_page_parser_old, ParseNextElement) {
+  uint8_t data[] =
+      "% a comment long enough to need more than one scan\n"
+      "0.5 -12 re /AVeryLongResourceNameThatSpansVectorChunks Do\r"
+      "1.5.5 BT%trailing";
+  CPDF_StreamParser parser(data, sizeof(data) - 1);
+
+  struct {
+    CPDF_StreamParser::SyntaxType type;
+    const char* word;
+  } expected[] = {
+      {CPDF_StreamParser::Number, "0.5"},
+      {CPDF_StreamParser::Number, "-12"},
+      {CPDF_StreamParser::Keyword, "re"},
+      {CPDF_StreamParser::Name, "/AVeryLongResourceNameThatSpansVectorChunks"},
+      {CPDF_StreamParser::Keyword, "Do"},
+      {CPDF_StreamParser::Number, "1.5.5"},
+      {CPDF_StreamParser::Keyword, "BT"},
+  };
+  for (const auto& item : expected) {
+    ASSERT_EQ(item.type, parser.ParseNextElement());
+    EXPECT_EQ(CFX_ByteStringC(item.word),
+              CFX_ByteStringC(parser.GetWordBuf(), parser.GetWordSize()));
+  }
+  EXPECT_EQ(CPDF_StreamParser::EndOfData, parser.ParseNextElement());
+}
+
+TEST(fpdf_page_parser_old, SkipPathObject) {
+  struct {
+    const char* data;
+    const char* rest;
+  } cases[] = {
+      // Stops before the operands of the next non-path operator.
+      {"1 2 l 3 4 5 6 re h S 1 0 0 1 5 5 cm", "1 0 0 1 5 5 cm"},
+      {"0 0 m 1 1 l W* n BT", "BT"},
+      {"1 2 3 4 5 6 c B* q", "q"},
+      {"1 2 /GS0 gs", "1 2 /GS0 gs"},
+      {"f % comment", "% comment"},
+      // Consumes a path that runs to the end of the data.
+      {"1 2 l S", ""},
+      {"1 2 l 3 4", ""},
+  };
+  for (const auto& test_case : cases) {
+    FX_DWORD size = FXSYS_strlen(test_case.data);
+    CPDF_StreamParser parser(
+        reinterpret_cast<const uint8_t*>(test_case.data), size);
+    parser.SkipPathObject();
+    FX_DWORD pos = parser.GetPos();
+    while (pos < size && test_case.data[pos] == ' ')
+      ++pos;
+    EXPECT_STREQ(test_case.rest, test_case.data + pos) << test_case.data;
+  }
+}
@@ -55,6 +55,7 @@ CPDF_TilingPattern::~CPDF_TilingPattern() {
   m_pForm = NULL;
 }
 FX_BOOL CPDF_TilingPattern::Load() {
+  CFX_AutoLock lock(m_pDocument->GetSharedLock());
   if (m_pForm)
     return TRUE;
 
@@ -110,6 +111,7 @@ CPDF_ShadingPattern::~CPDF_ShadingPattern() {
 }
 
 FX_BOOL CPDF_ShadingPattern::Load() {
+  CFX_AutoLock lock(m_pDocument->GetSharedLock());
   if (m_ShadingType != kInvalidShading)
     return TRUE;
 
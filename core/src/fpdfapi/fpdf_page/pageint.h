@@ -7,8 +7,13 @@
 #ifndef CORE_SRC_FPDFAPI_FPDF_PAGE_PAGEINT_H_
 #define CORE_SRC_FPDFAPI_FPDF_PAGE_PAGEINT_H_
 
+#include <condition_variable>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "core/include/fpdfapi/fpdf_page.h"
@@ -19,6 +24,53 @@ class CPDF_ParseOptions;
 
 #define PARSE_STEP_LIMIT 100
 
+// Whether two state blocks hold equal values. General states are compared
+// bytewise, which can give a false mismatch but never a false match.
+FX_BOOL PDF_IsSameStateValue(const CFX_GraphStateData& a,
+                             const CFX_GraphStateData& b);
+FX_BOOL PDF_IsSameStateValue(const CPDF_ColorStateData& a,
+                             const CPDF_ColorStateData& b);
+FX_BOOL PDF_IsSameStateValue(const CPDF_TextStateData& a,
+                             const CPDF_TextStateData& b);
+FX_BOOL PDF_IsSameStateValue(const CPDF_GeneralStateData& a,
+                             const CPDF_GeneralStateData& b);
+
+// Hash-conses the state blocks that content parsing gives page objects, so
+// that objects whose states hold equal values share one block instead of
+// each state change leaving its own copy behind. The pool keeps a reference
+// to every block, so pooled blocks are always copied before being modified.
+class CPDF_StatePool {
+ public:
+  CPDF_StatePool();
+  ~CPDF_StatePool();
+
+  // Points the general state of |pStates|, and the color, text and graph
+  // states if asked for, at equal blocks seen before, or adds them.
+  void Intern(CPDF_GraphicStates* pStates,
+              FX_BOOL bColor,
+              FX_BOOL bText,
+              FX_BOOL bGraph);
+
+ private:
+  template <typename T>
+  class Table {
+   public:
+    Table() : m_pLast(nullptr) {}
+
+    void Intern(CFX_CountRef<T>* pState);
+
+   private:
+    std::unordered_multimap<FX_DWORD, CFX_CountRef<T>> m_Map;
+    // The block interned last, which is usually the one that comes next.
+    const T* m_pLast;
+  };
+
+  Table<CFX_GraphStateData> m_GraphStates;
+  Table<CPDF_ColorStateData> m_ColorStates;
+  Table<CPDF_TextStateData> m_TextStates;
+  Table<CPDF_GeneralStateData> m_GeneralStates;
+};
+
 class CPDF_StreamParser {
  public:
   enum SyntaxType { EndOfData, Number, Keyword, Name, Others };
@@ -30,6 +82,12 @@ class CPDF_StreamParser {
                                 CPDF_Dictionary* pDict,
                                 CPDF_Object* pCSObj,
                                 FX_BOOL bDecode);
+  // Moves past the data of an inline image without copying or decoding it.
+  // Returns FALSE, leaving the position alone, when the end of the data can
+  // only be found by decoding it.
+  FX_BOOL SkipInlineStream(CPDF_Document* pDoc,
+                           CPDF_Dictionary* pDict,
+                           CPDF_Object* pCSObj);
   SyntaxType ParseNextElement();
   uint8_t* GetWordBuf() { return m_WordBuffer; }
   FX_DWORD GetWordSize() const { return m_WordSize; }
@@ -42,6 +100,8 @@ class CPDF_StreamParser {
   void SetPos(FX_DWORD pos) { m_Pos = pos; }
   CPDF_Object* ReadNextObject(FX_BOOL bAllowNestedArray = FALSE,
                               FX_BOOL bInArray = FALSE);
+  // Moves past a run of path construction, painting and clipping operators
+  // and their operands.
   void SkipPathObject();
 
  protected:
@@ -64,6 +124,10 @@ class CPDF_StreamParser {
 
  private:
   bool PositionIsInBounds() const;
+
+  // Copies the bytes from |start| to the current position into the word
+  // buffer, truncating long words, and returns whether they are all numeric.
+  FX_BOOL ReadWord(FX_DWORD start);
 };
 
 #define PARAM_BUF_SIZE 16
@@ -127,7 +191,17 @@ class CPDF_StreamContentParser {
   void ConvertUserSpace(FX_FLOAT& x, FX_FLOAT& y);
   void ConvertTextSpace(FX_FLOAT& x, FX_FLOAT& y);
   void OnChangeTextMatrix();
-  FX_DWORD Parse(const uint8_t* pData, FX_DWORD dwSize, FX_DWORD max_cost);
+  // Parses |pData| until |max_cost| objects have been added, if non-zero.
+  // Returns the position reached. When |bMoreData|, the data continues in
+  // another stream, so an object or inline image running to the end of
+  // |pData| is left unparsed for the caller to join with the rest.
+  FX_DWORD Parse(const uint8_t* pData,
+                 FX_DWORD dwSize,
+                 FX_DWORD max_cost,
+                 FX_BOOL bMoreData = FALSE);
+  // Whether the data left unparsed by the last Parse ends inside the data of
+  // an inline image, which must be joined to the next stream as it is.
+  FX_BOOL IsSplitInImageData() const { return m_bSplitInImageData; }
   void ParsePathObject();
   void AddPathPoint(FX_FLOAT x, FX_FLOAT y, int flag);
   void AddPathRect(FX_FLOAT x, FX_FLOAT y, FX_FLOAT w, FX_FLOAT h);
@@ -245,6 +319,7 @@ class CPDF_StreamContentParser {
   FX_DWORD m_ParamCount;
   CPDF_StreamParser* m_pSyntax;
   std::unique_ptr<CPDF_AllStates> m_pCurStates;
+  CPDF_StatePool m_StatePool;
   CPDF_ContentMark m_CurContentMark;
   CFX_ArrayTemplate<CPDF_TextObject*> m_ClipTextList;
   CPDF_TextObject* m_pLastTextObject;
@@ -270,6 +345,11 @@ class CPDF_StreamContentParser {
   FX_FLOAT m_Type3Data[6];
   FX_BOOL m_bResourceMissing;
   std::vector<std::unique_ptr<CPDF_AllStates>> m_StateStack;
+  // Whether the data being parsed continues in another stream.
+  FX_BOOL m_bMoreData;
+  // Set by Handle_BeginImage when the image continues in another stream.
+  FX_BOOL m_bImageSplit;
+  FX_BOOL m_bSplitInImageData;
 };
 class CPDF_ContentParser {
  public:
@@ -295,19 +375,78 @@ class CPDF_ContentParser {
     STAGE_CHECKCLIP,
   };
 
+  CPDF_Stream* GetStream(FX_DWORD index) const;
+
+  // Gets the data of stream |m_StreamIndex| into |m_pData|. Returns FALSE
+  // while it is still being decoded.
+  FX_BOOL LoadStream(IFX_Pause* pPause);
+
+  // Starts decoding the stream after |m_StreamIndex| on a worker thread.
+  void DecodeAhead();
+
   ParseStatus m_Status;
   InternalStage m_InternalStage;
   CPDF_PageObjects* m_pObjects;
   FX_BOOL m_bForm;
   CPDF_ParseOptions m_Options;
   CPDF_Type3Char* m_pType3Char;
+  // The content stream, or an array of them.
+  CPDF_Object* m_pContents;
   FX_DWORD m_nStreams;
-  std::unique_ptr<CPDF_StreamAcc> m_pSingleStream;
-  std::vector<std::unique_ptr<CPDF_StreamAcc>> m_StreamArray;
+  FX_DWORD m_StreamIndex;
+  // Holds an unfiltered stream in memory, which is parsed in place.
+  std::unique_ptr<CPDF_StreamAcc> m_pStreamAcc;
+  // Decodes stream |m_StreamIndex| into |m_ContentBuf|.
+  std::unique_ptr<CPDF_StreamFilter> m_pStreamFilter;
+  CFX_BinaryBuf m_ContentBuf;
+  // The end of the previous stream, holding an object that continues in
+  // this one.
+  CFX_BinaryBuf m_Carry;
   uint8_t* m_pData;
   FX_DWORD m_Size;
   FX_DWORD m_CurrentOffset;
   std::unique_ptr<CPDF_StreamContentParser> m_pParser;
+  // A copy of the next stream, made on this thread, which the worker
+  // decodes into |m_AheadBuf| while this stream is parsed.
+  std::unique_ptr<CPDF_Stream, ReleaseDeleter<CPDF_Stream>> m_pAheadStream;
+  std::unique_ptr<CPDF_StreamFilter> m_pAheadFilter;
+  CFX_BinaryBuf m_AheadBuf;
+  std::thread m_AheadThread;
+  // Guards |m_bAheadDone|, which the worker sets when it has finished.
+  std::mutex m_AheadLock;
+  std::condition_variable m_AheadCond;
+  FX_BOOL m_bAheadDone;
+};
+// A static R-tree over the bounding boxes of page objects, packed bottom-up
+// with the Sort-Tile-Recursive method. Objects whose boxes can't be ordered,
+// i.e. contain NaNs, are kept aside and tested on every query.
+class CPDF_PageObjectIndex {
+ public:
+  explicit CPDF_PageObjectIndex(
+      const std::vector<CPDF_PageObject*>& objects);
+  ~CPDF_PageObjectIndex();
+
+  // Appends the indices of the objects intersecting |rect| to |pIndices|, in
+  // no particular order.
+  void Query(const CFX_FloatRect& rect, std::vector<FX_DWORD>* pIndices) const;
+
+ private:
+  struct Entry {
+    CFX_FloatRect m_Box;
+    FX_DWORD m_Index;
+  };
+  struct Node {
+    CFX_FloatRect m_Box;
+    // Into |m_Entries| for leaves, else into |m_Nodes|.
+    FX_DWORD m_First;
+    FX_DWORD m_Count;
+  };
+
+  std::vector<Entry> m_Entries;
+  // Nodes level by level, leaves first and the root last.
+  std::vector<Node> m_Nodes;
+  FX_DWORD m_LeafCount;
+  std::vector<Entry> m_Unordered;
 };
 class CPDF_AllStates : public CPDF_GraphicStates {
  public:
@@ -321,6 +460,20 @@ class CPDF_AllStates : public CPDF_GraphicStates {
   FX_FLOAT m_TextLeading, m_TextRise, m_TextHorzScale;
 };
 
+// A form XObject parsed by CPDF_DocPageData::GetForm(), together with what
+// its objects depend on besides the form stream and resources.
+struct CPDF_CachedForm {
+  explicit CPDF_CachedForm(CPDF_Form* pForm) : m_Form(pForm) {}
+
+  CPDF_CountedObject<CPDF_Form> m_Form;
+  FX_DWORD m_dwObjNum;
+  FX_DWORD m_dwDataVersion;
+  CPDF_Dictionary* m_pPageResources;
+  CPDF_GraphicStates m_States;
+  CPDF_ParseOptions m_Options;
+  int m_Level;
+};
+
 class CPDF_DocPageData {
  public:
   explicit CPDF_DocPageData(CPDF_Document* pPDFDoc);
@@ -346,11 +499,41 @@ class CPDF_DocPageData {
   CPDF_StreamAcc* GetFontFileStreamAcc(CPDF_Stream* pFontStream);
   void ReleaseFontFileStreamAcc(CPDF_Stream* pFontStream,
                                 FX_BOOL bForce = FALSE);
+  // Returns |pFormStream| parsed with |pStates| inherited from the content
+  // that draws it. Pages that draw a form the same way share one parse.
+  CPDF_Form* GetForm(CPDF_Stream* pFormStream,
+                     CPDF_Dictionary* pPageResources,
+                     CPDF_Dictionary* pParentResources,
+                     CPDF_AllStates* pStates,
+                     CPDF_ParseOptions* pOptions,
+                     int level);
+  // Takes |pForm|, parsed elsewhere with |states| inherited, into the cache.
+  // Returns the cached form, which may be an equal one parsed before.
+  CPDF_Form* AddForm(CPDF_Form* pForm,
+                     const CPDF_GraphicStates& states,
+                     CPDF_ParseOptions* pOptions,
+                     int level);
+  CPDF_Form* AddFormRef(CPDF_Form* pForm);
+  void ReleaseForm(CPDF_Form* pForm);
+  // Returns the cache entry of |pForm|, or nullptr if it is not cached.
+  const CPDF_CachedForm* GetCachedForm(CPDF_Form* pForm) const;
   FX_BOOL IsForceClear() const { return m_bForceClear; }
   CPDF_CountedColorSpace* FindColorSpacePtr(CPDF_Object* pCSObj) const;
   CPDF_CountedPattern* FindPatternPtr(CPDF_Object* pPatternObj) const;
 
  private:
+  CPDF_Form* FindForm(CPDF_Stream* pFormStream,
+                      CPDF_Dictionary* pPageResources,
+                      CPDF_Dictionary* pParentResources,
+                      const CPDF_GraphicStates& states,
+                      CPDF_ParseOptions* pOptions,
+                      int level);
+  CPDF_Form* InsertForm(CPDF_Form* pForm,
+                        const CPDF_GraphicStates& states,
+                        CPDF_ParseOptions* pOptions,
+                        int level);
+  void ReleaseUnusedForms();
+
   using CPDF_CountedFont = CPDF_CountedObject<CPDF_Font>;
   using CPDF_CountedIccProfile = CPDF_CountedObject<CPDF_IccProfile>;
   using CPDF_CountedImage = CPDF_CountedObject<CPDF_Image>;
@@ -359,6 +542,7 @@ class CPDF_DocPageData {
   using CPDF_ColorSpaceMap = std::map<CPDF_Object*, CPDF_CountedColorSpace*>;
   using CPDF_FontFileMap = std::map<CPDF_Stream*, CPDF_CountedStreamAcc*>;
   using CPDF_FontMap = std::map<CPDF_Dictionary*, CPDF_CountedFont*>;
+  using CPDF_FormMap = std::multimap<CPDF_Stream*, CPDF_CachedForm*>;
   using CPDF_IccProfileMap = std::map<CPDF_Stream*, CPDF_CountedIccProfile*>;
   using CPDF_ImageMap = std::map<FX_DWORD, CPDF_CountedImage*>;
   using CPDF_PatternMap = std::map<CPDF_Object*, CPDF_CountedPattern*>;
@@ -369,6 +553,7 @@ class CPDF_DocPageData {
   CPDF_ColorSpaceMap m_ColorSpaceMap;
   CPDF_FontFileMap m_FontFileMap;
   CPDF_FontMap m_FontMap;
+  CPDF_FormMap m_FormMap;
   CPDF_IccProfileMap m_IccProfileMap;
   CPDF_ImageMap m_ImageMap;
   CPDF_PatternMap m_PatternMap;
@@ -376,6 +561,8 @@ class CPDF_DocPageData {
 
 class CPDF_Function {
  public:
+  typedef std::shared_ptr<const std::vector<FX_FLOAT>> Samples;
+
   static CPDF_Function* Load(CPDF_Object* pFuncObj);
   virtual ~CPDF_Function();
   FX_BOOL Call(FX_FLOAT* inputs,
@@ -385,6 +572,23 @@ class CPDF_Function {
   int CountInputs() { return m_nInputs; }
   int CountOutputs() { return m_nOutputs; }
 
+  // The results of a 1-input function at |nSteps| inputs spaced evenly from
+  // |xmin| up to, but not including, |xmax|; CountOutputs() values per step.
+  // Returns null if the function does not take 1 input, where Call() fails,
+  // or if it fails to evaluate at some step, where Call() leaves the results
+  // as they were.
+  Samples GetSamples(FX_FLOAT xmin, FX_FLOAT xmax, int nSteps) const;
+
+  // The results of a 2-input function on an |nx| by |ny| grid spanning
+  // [xmin, xmax] x [ymin, ymax], row by row. Returns null as above, or if
+  // the grid would hold over 1M values.
+  Samples GetSamples(FX_FLOAT xmin,
+                     FX_FLOAT xmax,
+                     int nx,
+                     FX_FLOAT ymin,
+                     FX_FLOAT ymax,
+                     int ny) const;
+
  protected:
   CPDF_Function();
   int m_nInputs, m_nOutputs;
@@ -393,7 +597,144 @@ class CPDF_Function {
   FX_BOOL Init(CPDF_Object* pObj);
   virtual FX_BOOL v_Init(CPDF_Object* pObj) = 0;
   virtual FX_BOOL v_Call(FX_FLOAT* inputs, FX_FLOAT* results) const = 0;
+
+ private:
+  // The domain and resolution of a sample table.
+  struct SampleKey {
+    bool operator==(const SampleKey& other) const;
+
+    FX_FLOAT m_Domain[4];
+    int m_Steps[2];
+  };
+
+  Samples GetSamples(const SampleKey& key, int nInputs) const;
+
+  // Call() without the input count check. Returns FALSE if the function
+  // failed to evaluate.
+  FX_BOOL Evaluate(FX_FLOAT* inputs, FX_FLOAT* results) const;
+
+  // Shadings drawn again at the same size reuse these; the latest first.
+  // Together they hold at most 1M values.
+  mutable std::mutex m_SampleLock;
+  mutable std::list<std::pair<SampleKey, Samples>> m_SampleCache;
+};
+
+class CPDF_PSEngine;
+
+typedef enum {
+  PSOP_ADD,
+  PSOP_SUB,
+  PSOP_MUL,
+  PSOP_DIV,
+  PSOP_IDIV,
+  PSOP_MOD,
+  PSOP_NEG,
+  PSOP_ABS,
+  PSOP_CEILING,
+  PSOP_FLOOR,
+  PSOP_ROUND,
+  PSOP_TRUNCATE,
+  PSOP_SQRT,
+  PSOP_SIN,
+  PSOP_COS,
+  PSOP_ATAN,
+  PSOP_EXP,
+  PSOP_LN,
+  PSOP_LOG,
+  PSOP_CVI,
+  PSOP_CVR,
+  PSOP_EQ,
+  PSOP_NE,
+  PSOP_GT,
+  PSOP_GE,
+  PSOP_LT,
+  PSOP_LE,
+  PSOP_AND,
+  PSOP_OR,
+  PSOP_XOR,
+  PSOP_NOT,
+  PSOP_BITSHIFT,
+  PSOP_TRUE,
+  PSOP_FALSE,
+  PSOP_IF,
+  PSOP_IFELSE,
+  PSOP_POP,
+  PSOP_EXCH,
+  PSOP_DUP,
+  PSOP_COPY,
+  PSOP_INDEX,
+  PSOP_ROLL,
+  PSOP_PROC,
+  PSOP_CONST
+} PDF_PSOP;
+class CPDF_PSProc {
+ public:
+  ~CPDF_PSProc();
+  FX_BOOL Parse(CPDF_SimpleParser& parser);
+  FX_BOOL Execute(CPDF_PSEngine* pEngine);
+  CFX_PtrArray m_Operators;
+};
+#define PSENGINE_STACKSIZE 100
+class CPDF_PSEngine {
+ public:
+  CPDF_PSEngine();
+  ~CPDF_PSEngine();
+  FX_BOOL Parse(const FX_CHAR* string, int size);
+  FX_BOOL Execute() { return m_MainProc.Execute(this); }
+  FX_BOOL DoOperator(PDF_PSOP op);
+  void Reset() { m_StackCount = 0; }
+  void Push(FX_FLOAT value);
+  void Push(int value) { Push((FX_FLOAT)value); }
+  FX_FLOAT Pop();
+  int GetStackSize() { return m_StackCount; }
+  const CPDF_PSProc* GetMainProc() const { return &m_MainProc; }
+
+ private:
+  FX_FLOAT m_Stack[PSENGINE_STACKSIZE];
+  int m_StackCount;
+  CPDF_PSProc m_MainProc;
+};
+
+// A PostScript calculator program lowered to flat register code for
+// CPDF_PSFunc. Stack slots are assigned registers at compile time, operators
+// whose operands are all constant are folded, and procedures run by if and
+// ifelse become jumps, so a call runs straight through the code. The results
+// are the same as running the program through CPDF_PSEngine.
+class CPDF_PSProgram {
+ public:
+  CPDF_PSProgram();
+  ~CPDF_PSProgram();
+
+  // Lowers the program parsed by |engine| for |nInputs| inputs. Returns FALSE
+  // if the stack layout depends on the input values, in which case the
+  // program has to be interpreted.
+  FX_BOOL Compile(const CPDF_PSEngine& engine, int nInputs);
+  FX_BOOL IsCompiled() const { return m_bCompiled; }
+
+  // Runs the program on |inputs| and stores the top |nOutputs| stack values
+  // in |results|. Returns FALSE if the stack ends up with fewer values.
+  FX_BOOL Run(const FX_FLOAT* inputs, FX_FLOAT* results, int nOutputs) const;
+
+  size_t CountInstructions() const { return m_Code.size(); }
+
+ private:
+  class Compiler;
+
+  struct Instruction {
+    int m_Op;    // A PDF_PSOP, or one of the codes in fpdf_page_func.cpp.
+    int m_Dest;  // The register written, or the offset of a jump.
+    int m_A;     // The frame slots of the operands.
+    int m_B;
+  };
+
+  FX_BOOL m_bCompiled;
+  int m_nInputs;
+  std::vector<Instruction> m_Code;
+  std::vector<FX_FLOAT> m_Constants;
+  // Where each value of the final stack is found, bottom first.
+  std::vector<int> m_Results;
 };
+
 class CPDF_IccProfile {
  public:
   CPDF_IccProfile(const uint8_t* pData, FX_DWORD dwSize);
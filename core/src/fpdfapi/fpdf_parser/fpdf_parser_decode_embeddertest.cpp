@@ -4,6 +4,7 @@
 
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "core/include/fpdfapi/fpdf_parser.h"
 #include "core/include/fxcrt/fx_basic.h"
@@ -11,6 +12,69 @@
 #include "testing/fx_string_testhelpers.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
+namespace {
+
+std::string HexEncode(const std::string& data) {
+  static const char kHex[] = "0123456789ABCDEF";
+  std::string result;
+  for (size_t i = 0; i < data.size(); ++i) {
+    uint8_t ch = data[i];
+    result += kHex[ch >> 4];
+    result += kHex[ch & 15];
+    if (i % 32 == 31)
+      result += '\n';
+  }
+  return result + ">";
+}
+
+std::string A85Encode(const std::string& data) {
+  std::string result;
+  for (size_t i = 0; i < data.size(); i += 4) {
+    size_t n = std::min<size_t>(4, data.size() - i);
+    uint32_t value = 0;
+    for (size_t j = 0; j < 4; ++j)
+      value = value << 8 | (j < n ? (uint8_t)data[i + j] : 0);
+    char group[5];
+    for (int j = 4; j >= 0; --j) {
+      group[j] = '!' + value % 85;
+      value /= 85;
+    }
+    result.append(group, n + 1);
+  }
+  return result + "~>";
+}
+
+std::string RunLengthEncode(const std::string& data) {
+  std::string result;
+  for (size_t i = 0; i < data.size();) {
+    size_t run = 1;
+    while (i + run < data.size() && run < 128 && data[i + run] == data[i])
+      ++run;
+    if (run > 1) {
+      result += (char)(257 - run);
+      result += data[i];
+    } else {
+      run = std::min<size_t>(100, data.size() - i);
+      result += (char)(run - 1);
+      result.append(data, i, run);
+    }
+    i += run;
+  }
+  return result + (char)128;
+}
+
+std::string FlateEncodeString(const std::string& data) {
+  uint8_t* buf;
+  FX_DWORD size;
+  FlateEncode(reinterpret_cast<const uint8_t*>(data.data()), data.size(), buf,
+              size);
+  std::string result(reinterpret_cast<char*>(buf), size);
+  FX_Free(buf);
+  return result;
+}
+
+}  // namespace
+
 class FPDFParserDecodeEmbeddertest : public EmbedderTest {};
 
 // NOTE: python's zlib.compress() and zlib.decompress() may be useful for
@@ -116,3 +180,63 @@ TEST_F(FPDFParserDecodeEmbeddertest, Bug_555784) {
 }
 
 #undef TEST_CASE
+
+TEST_F(FPDFParserDecodeEmbeddertest, StreamFilter) {
+  std::string content;
+  for (int i = 0; i < 5000; ++i) {
+    content += "q 1 0 0 1 " + std::to_string(i) + " 0 cm 0 0 m 10 10 l S Q\n";
+    if (i % 100 == 0)
+      content.append(300, ' ');
+  }
+  const std::string flate = FlateEncodeString(content);
+
+  struct {
+    std::vector<const char*> filters;
+    std::string data;
+    bool incremental;
+  } cases[] = {
+      {{"FlateDecode"}, flate, true},
+      {{"AHx"}, HexEncode(content), true},
+      {{"A85"}, A85Encode(content), true},
+      {{"RL"}, RunLengthEncode(content), true},
+      {{"AHx", "Fl"}, HexEncode(flate), true},
+      {{"A85", "RL"}, A85Encode(RunLengthEncode(content)), true},
+      {{"FlateDecode"}, flate.substr(0, flate.size() / 2), true},
+      {{"RL"}, RunLengthEncode(content).substr(0, 1001), true},
+      // Filters that are decoded in one go.
+      {{"LZWDecode"}, "\x80\x0b\x60\x50\x22\x0c\x0c\x85\x01", false},
+      {{"AHx", "DCTDecode"}, HexEncode("not really a jpeg"), false},
+  };
+  for (const auto& test_case : cases) {
+    CPDF_Dictionary* pDict = new CPDF_Dictionary;
+    if (test_case.filters.size() == 1) {
+      pDict->SetAtName("Filter", test_case.filters[0]);
+    } else {
+      CPDF_Array* pArray = new CPDF_Array;
+      for (const char* name : test_case.filters)
+        pArray->AddName(name);
+      pDict->SetAt("Filter", pArray);
+    }
+    uint8_t* pData = FX_Alloc(uint8_t, test_case.data.size());
+    memcpy(pData, test_case.data.data(), test_case.data.size());
+    CPDF_Stream* pStream =
+        new CPDF_Stream(pData, test_case.data.size(), pDict);
+
+    CPDF_StreamAcc acc;
+    acc.LoadAllData(pStream, FALSE);
+    std::string expected(reinterpret_cast<const char*>(acc.GetData()),
+                         acc.GetSize());
+
+    for (FX_DWORD block_size : {1u, 7u, 4096u, 100000u}) {
+      CPDF_StreamFilter filter(pStream);
+      EXPECT_EQ(test_case.incremental, filter.IsIncremental());
+      std::vector<uint8_t> block(block_size);
+      std::string result;
+      while (FX_DWORD size = filter.ReadBlock(block.data(), block_size))
+        result.append(reinterpret_cast<char*>(block.data()), size);
+      EXPECT_EQ(expected, result) << test_case.filters[0] << " " << block_size;
+      EXPECT_EQ(0u, filter.ReadBlock(block.data(), block_size));
+    }
+    pStream->Release();
+  }
+}
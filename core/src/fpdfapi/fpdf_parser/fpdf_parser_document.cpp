@@ -7,6 +7,7 @@
 #include "core/include/fpdfapi/fpdf_parser.h"
 
 #include "core/include/fpdfapi/fpdf_module.h"
+#include "core/include/fxcrt/fx_lock.h"
 
 CPDF_Document::CPDF_Document(CPDF_Parser* pParser)
     : CPDF_IndirectObjectHolder(pParser) {
@@ -33,6 +34,10 @@ CPDF_DocRenderData* CPDF_Document::GetValidateRenderData() {
   m_pDocRender = CPDF_ModuleMgr::Get()->GetRenderModule()->CreateDocData(this);
   return m_pDocRender;
 }
+void CPDF_Document::EnableSharedAccess() {
+  EnableSharedLock();
+  FX_EnableGlobalLock();
+}
 void CPDF_Document::LoadDoc() {
   m_LastObjNum = m_pParser->GetLastObjNum();
   CPDF_Object* pRootObj =
@@ -144,6 +149,8 @@ CPDF_Dictionary* CPDF_Document::GetPage(int iPage) {
   if (iPage < 0 || iPage >= m_PageList.GetSize())
     return nullptr;
 
+  CFX_AutoLock lock(GetSharedLock());
+
   if (m_bLinearized && (iPage == (int)m_dwFirstPageNo)) {
     if (CPDF_Dictionary* pDict =
             ToDictionary(GetIndirectObject(m_dwFirstPageObjNum, nullptr)))
@@ -229,6 +236,7 @@ int CPDF_Document::_FindPageIndex(CPDF_Dictionary* pNode,
   return -1;
 }
 int CPDF_Document::GetPageIndex(FX_DWORD objnum) {
+  CFX_AutoLock lock(GetSharedLock());
   FX_DWORD nPages = m_PageList.GetSize();
   FX_DWORD skip_count = 0;
   FX_BOOL bSkipped = FALSE;
@@ -332,6 +340,7 @@ FX_BOOL CPDF_Document::IsOwner() const {
   return !m_pParser || m_pParser->IsOwner();
 }
 FX_BOOL CPDF_Document::IsFormStream(FX_DWORD objnum, FX_BOOL& bForm) const {
+  CFX_AutoLock lock(GetSharedLock());
   auto it = m_IndirectObjs.find(objnum);
   if (it != m_IndirectObjs.end()) {
     CPDF_Stream* pStream = it->second->AsStream();
@@ -354,3 +363,76 @@ void CPDF_Document::ClearRenderData() {
     CPDF_ModuleMgr::Get()->GetRenderModule()->ClearDocData(m_pDocRender);
   }
 }
+void CPDF_Document::TrimMemory() {
+  if (GetSharedLock())
+    return;
+
+  ClearPageData();
+  ClearRenderData();
+  // The document and the security handler keep pointers to these, and
+  // bookmarks, forms and loaded pages to what they refer to.
+  std::set<FX_DWORD> pinned;
+  std::vector<CPDF_Dictionary*> roots(m_LoadedPages.begin(),
+                                      m_LoadedPages.end());
+  roots.push_back(m_pRootDict);
+  roots.push_back(m_pInfoDict);
+  if (m_pParser)
+    roots.push_back(m_pParser->GetEncryptDict());
+  for (CPDF_Dictionary* pDict : roots) {
+    if (!pDict)
+      continue;
+    pinned.insert(pDict->GetObjNum());
+    AddReachableObjects(pDict, &pinned);
+  }
+  // Cached object streams may point into the streams being evicted.
+  if (m_pParser)
+    m_pParser->ReleaseObjectStreams();
+  TrimIndirectObjects(pinned);
+}
+void CPDF_Document::AddLoadedPage(CPDF_Dictionary* pPageDict) {
+  CFX_AutoLock lock(GetSharedLock());
+  m_LoadedPages.insert(pPageDict);
+}
+void CPDF_Document::RemoveLoadedPage(CPDF_Dictionary* pPageDict) {
+  CFX_AutoLock lock(GetSharedLock());
+  auto it = m_LoadedPages.find(pPageDict);
+  if (it != m_LoadedPages.end())
+    m_LoadedPages.erase(it);
+}
+void CPDF_Document::AddReachableObjects(CPDF_Object* pObj,
+                                        std::set<FX_DWORD>* pObjNums) const {
+  std::vector<CPDF_Object*> pending(1, pObj);
+  while (!pending.empty()) {
+    CPDF_Object* pCurrent = pending.back();
+    pending.pop_back();
+    if (CPDF_Reference* pRef = pCurrent->AsReference()) {
+      auto it = m_IndirectObjs.find(pRef->GetRefObjNum());
+      if (it == m_IndirectObjs.end() || !pObjNums->insert(it->first).second)
+        continue;
+
+      // Other pages are only pointed at, e.g. by destinations.
+      CPDF_Dictionary* pDict = it->second->AsDictionary();
+      if (!pDict || pDict->GetString("Type") != "Page")
+        pending.push_back(it->second);
+      continue;
+    }
+    if (CPDF_Array* pArray = pCurrent->AsArray()) {
+      for (FX_DWORD i = 0; i < pArray->GetCount(); ++i)
+        pending.push_back(pArray->GetElement(i));
+      continue;
+    }
+    CPDF_Dictionary* pDict = pCurrent->IsStream()
+                                 ? pCurrent->AsStream()->GetDict()
+                                 : pCurrent->AsDictionary();
+    if (!pDict)
+      continue;
+
+    // Pages inherit from their parents, which list the other pages.
+    CFX_ByteString type = pDict->GetString("Type");
+    FX_BOOL bPageTree = type == "Page" || type == "Pages";
+    for (const auto& it : *pDict) {
+      if (!bPageTree || it.first != "Kids")
+        pending.push_back(it.second);
+    }
+  }
+}
@@ -0,0 +1,344 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "core/include/fpdfapi/fpdf_parser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+#include "core/include/fxcodec/fx_codec_flate.h"
+#include "core/include/fxcrt/fx_ext.h"
+
+class CPDF_StreamFilter::Decoder {
+ public:
+  Decoder() : m_bEOF(false) {}
+  virtual ~Decoder() {}
+
+  // Appends the data decoded from |src_buf| to |dest_buf|.
+  virtual void Input(const uint8_t* src_buf,
+                     FX_DWORD src_size,
+                     CFX_BinaryBuf& dest_buf) = 0;
+
+  // Flushes any partial output once the input has run out.
+  virtual void Finish(CFX_BinaryBuf& dest_buf) {}
+
+  bool IsEOF() const { return m_bEOF; }
+
+ protected:
+  bool m_bEOF;
+};
+
+namespace {
+
+// How much raw data is read from the stream at a time.
+const FX_DWORD kFilterBufferSize = 16 * 1024;
+
+void* FilterAlloc(void* opaque, unsigned int items, unsigned int size) {
+  return FX_Alloc2D(uint8_t, items, size);
+}
+
+void FilterFree(void* opaque, void* address) {
+  FX_Free(address);
+}
+
+class FlateDecoder : public CPDF_StreamFilter::Decoder {
+ public:
+  FlateDecoder() : m_pContext(FPDFAPI_FlateInit(FilterAlloc, FilterFree)) {
+    m_bEOF = !m_pContext;
+  }
+  ~FlateDecoder() override {
+    if (m_pContext)
+      FPDFAPI_FlateEnd(m_pContext);
+  }
+
+  void Input(const uint8_t* src_buf,
+             FX_DWORD src_size,
+             CFX_BinaryBuf& dest_buf) override {
+    if (m_bEOF)
+      return;
+
+    FPDFAPI_FlateInput(m_pContext, src_buf, src_size);
+    while (1) {
+      int ret = FPDFAPI_FlateOutput(m_pContext, m_Output, sizeof(m_Output));
+      int avail = FPDFAPI_FlateGetAvailOut(m_pContext);
+      dest_buf.AppendBlock(m_Output, sizeof(m_Output) - avail);
+      if (ret != Z_OK) {
+        // Z_BUF_ERROR only means the input ran out mid-stream.
+        m_bEOF = ret != Z_BUF_ERROR;
+        return;
+      }
+      if (avail != 0)
+        return;
+    }
+  }
+
+ private:
+  void* const m_pContext;
+  uint8_t m_Output[kFilterBufferSize];
+};
+
+class A85Decoder : public CPDF_StreamFilter::Decoder {
+ public:
+  A85Decoder() : m_State(0), m_Res(0) {}
+
+  void Input(const uint8_t* src_buf,
+             FX_DWORD src_size,
+             CFX_BinaryBuf& dest_buf) override {
+    for (FX_DWORD i = 0; i < src_size && !m_bEOF; ++i) {
+      uint8_t ch = src_buf[i];
+      if (PDFCharIsLineEnding(ch) || ch == ' ' || ch == '\t')
+        continue;
+
+      if (ch == 'z') {
+        dest_buf.AppendFill(0, 4);
+        m_State = 0;
+        m_Res = 0;
+      } else if (ch < '!' || ch > 'u') {
+        m_bEOF = true;
+      } else {
+        m_Res = m_Res * 85 + ch - 33;
+        if (++m_State == 5) {
+          for (int j = 0; j < 4; ++j)
+            dest_buf.AppendByte((uint8_t)(m_Res >> (3 - j) * 8));
+          m_State = 0;
+          m_Res = 0;
+        }
+      }
+    }
+  }
+
+  void Finish(CFX_BinaryBuf& dest_buf) override {
+    if (!m_State)
+      return;
+
+    for (int i = m_State; i < 5; ++i)
+      m_Res = m_Res * 85 + 84;
+    for (int i = 0; i < m_State - 1; ++i)
+      dest_buf.AppendByte((uint8_t)(m_Res >> (3 - i) * 8));
+    m_State = 0;
+  }
+
+ private:
+  int m_State;
+  uint32_t m_Res;
+};
+
+class HexDecoder : public CPDF_StreamFilter::Decoder {
+ public:
+  HexDecoder() : m_bFirst(true), m_Byte(0) {}
+
+  void Input(const uint8_t* src_buf,
+             FX_DWORD src_size,
+             CFX_BinaryBuf& dest_buf) override {
+    for (FX_DWORD i = 0; i < src_size && !m_bEOF; ++i) {
+      uint8_t ch = src_buf[i];
+      if (ch == '>') {
+        m_bEOF = true;
+        break;
+      }
+      if (!std::isxdigit(ch))
+        continue;
+
+      int digit = FXSYS_toHexDigit(ch);
+      if (m_bFirst) {
+        m_Byte = digit * 16;
+      } else {
+        dest_buf.AppendByte(m_Byte + digit);
+      }
+      m_bFirst = !m_bFirst;
+    }
+  }
+
+  void Finish(CFX_BinaryBuf& dest_buf) override {
+    if (!m_bFirst)
+      dest_buf.AppendByte(m_Byte);
+    m_bFirst = true;
+  }
+
+ private:
+  bool m_bFirst;
+  uint8_t m_Byte;
+};
+
+class RunLengthDecoder : public CPDF_StreamFilter::Decoder {
+ public:
+  RunLengthDecoder() : m_Literal(0), m_bRepeat(false), m_RepeatCount(0) {}
+
+  void Input(const uint8_t* src_buf,
+             FX_DWORD src_size,
+             CFX_BinaryBuf& dest_buf) override {
+    FX_DWORD i = 0;
+    while (i < src_size && !m_bEOF) {
+      if (m_Literal) {
+        FX_DWORD copy_len = std::min(m_Literal, src_size - i);
+        dest_buf.AppendBlock(src_buf + i, copy_len);
+        m_Literal -= copy_len;
+        i += copy_len;
+      } else if (m_bRepeat) {
+        dest_buf.AppendFill(src_buf[i++], m_RepeatCount);
+        m_bRepeat = false;
+      } else if (src_buf[i] < 128) {
+        m_Literal = src_buf[i++] + 1;
+      } else if (src_buf[i] > 128) {
+        m_RepeatCount = 257 - src_buf[i++];
+        m_bRepeat = true;
+      } else {
+        m_bEOF = true;
+      }
+    }
+  }
+
+  void Finish(CFX_BinaryBuf& dest_buf) override {
+    // Runs cut short by the end of the data are padded with zeros.
+    if (m_Literal)
+      dest_buf.AppendFill(0, m_Literal);
+    if (m_bRepeat)
+      dest_buf.AppendFill(0, m_RepeatCount);
+    m_Literal = 0;
+    m_bRepeat = false;
+  }
+
+ private:
+  FX_DWORD m_Literal;
+  bool m_bRepeat;
+  FX_DWORD m_RepeatCount;
+};
+
+// Returns the decoder for |name|, or nullptr if the filter can't be decoded
+// incrementally.
+CPDF_StreamFilter::Decoder* CreateDecoder(const CFX_ByteString& name,
+                                          const CPDF_Object* pParam) {
+  if (name == "FlateDecode" || name == "Fl")
+    return pParam ? nullptr : new FlateDecoder;
+  if (name == "ASCII85Decode" || name == "A85")
+    return new A85Decoder;
+  if (name == "ASCIIHexDecode" || name == "AHx")
+    return new HexDecoder;
+  if (name == "RunLengthDecode" || name == "RL")
+    return new RunLengthDecoder;
+  return nullptr;
+}
+
+}  // namespace
+
+CPDF_StreamFilter::CPDF_StreamFilter(const CPDF_Stream* pStream)
+    : m_pStream(pStream), m_BufOffset(0), m_SrcOffset(0), m_bFinished(false) {
+  CPDF_Dictionary* pDict = pStream ? pStream->GetDict() : nullptr;
+  CPDF_Object* pDecoder = pDict ? pDict->GetElementValue("Filter") : nullptr;
+  if (!pDecoder)
+    return;
+
+  // Mirror the filter list that PDF_DataDecode() builds.
+  CPDF_Object* pParams = pDict->GetElementValue("DecodeParms");
+  bool bSupported = true;
+  if (CPDF_Array* pDecoders = pDecoder->AsArray()) {
+    CPDF_Array* pParamsArray = ToArray(pParams);
+    for (FX_DWORD i = 0; i < pDecoders->GetCount() && bSupported; ++i) {
+      CFX_ByteString name = pDecoders->GetConstString(i);
+      if (name == "Crypt")
+        continue;
+
+      Decoder* pNew = CreateDecoder(
+          name, pParamsArray ? pParamsArray->GetDict(i) : nullptr);
+      bSupported = !!pNew;
+      m_Decoders.push_back(std::unique_ptr<Decoder>(pNew));
+    }
+  } else if (pDecoder->IsName()) {
+    CFX_ByteString name = pDecoder->GetConstString();
+    if (name != "Crypt") {
+      Decoder* pNew =
+          CreateDecoder(name, pParams ? pParams->GetDict() : nullptr);
+      bSupported = !!pNew;
+      m_Decoders.push_back(std::unique_ptr<Decoder>(pNew));
+    }
+  } else {
+    bSupported = false;
+  }
+  if (!bSupported) {
+    m_Decoders.clear();
+    m_pFallback.reset(new CPDF_StreamAcc);
+  }
+}
+
+CPDF_StreamFilter::~CPDF_StreamFilter() {}
+
+FX_DWORD CPDF_StreamFilter::ReadBlock(uint8_t* buffer, FX_DWORD size) {
+  if (!m_pStream)
+    return 0;
+
+  if (m_pFallback) {
+    if (!m_pFallback->GetStream())
+      m_pFallback->LoadAllData(m_pStream, FALSE);
+    FX_DWORD total = m_pFallback->GetSize();
+    FX_DWORD read_size = std::min(size, total - std::min(total, m_BufOffset));
+    if (read_size)
+      FXSYS_memcpy(buffer, m_pFallback->GetData() + m_BufOffset, read_size);
+    m_BufOffset += read_size;
+    return read_size;
+  }
+
+  FX_DWORD read_size = 0;
+  while (read_size < size) {
+    FX_DWORD avail = m_Buffer.GetSize() - m_BufOffset;
+    if (avail == 0) {
+      m_Buffer.Clear();
+      m_BufOffset = 0;
+      if (m_bFinished)
+        break;
+      FillBuffer();
+      continue;
+    }
+    FX_DWORD copy_len = std::min(avail, size - read_size);
+    FXSYS_memcpy(buffer + read_size, m_Buffer.GetBuffer() + m_BufOffset,
+                 copy_len);
+    m_BufOffset += copy_len;
+    read_size += copy_len;
+  }
+  return read_size;
+}
+
+void CPDF_StreamFilter::FillBuffer() {
+  FX_DWORD src_size =
+      std::min(kFilterBufferSize, m_pStream->GetRawSize() - m_SrcOffset);
+  bool bDone = src_size == 0;
+  for (const auto& pDecoder : m_Decoders)
+    bDone = bDone || pDecoder->IsEOF();
+  if (bDone) {
+    Finish();
+    return;
+  }
+
+  std::vector<uint8_t> src_buf(src_size);
+  if (!m_pStream->ReadRawData(m_SrcOffset, src_buf.data(), src_size)) {
+    Finish();
+    return;
+  }
+  m_SrcOffset += src_size;
+
+  // Push the block through the chain, each decoder feeding the next.
+  CFX_BinaryBuf data;
+  data.AppendBlock(src_buf.data(), src_size);
+  for (const auto& pDecoder : m_Decoders) {
+    CFX_BinaryBuf output;
+    pDecoder->Input(data.GetBuffer(), data.GetSize(), output);
+    data.TakeOver(output);
+  }
+  m_Buffer.AppendBlock(data.GetBuffer(), data.GetSize());
+}
+
+void CPDF_StreamFilter::Finish() {
+  // Flush each decoder in turn, passing its tail through the rest.
+  for (size_t i = 0; i < m_Decoders.size(); ++i) {
+    CFX_BinaryBuf tail;
+    m_Decoders[i]->Finish(tail);
+    for (size_t j = i + 1; j < m_Decoders.size(); ++j) {
+      CFX_BinaryBuf next;
+      m_Decoders[j]->Input(tail.GetBuffer(), tail.GetSize(), next);
+      tail.TakeOver(next);
+    }
+    m_Buffer.AppendBlock(tail.GetBuffer(), tail.GetSize());
+  }
+  m_bFinished = true;
+}
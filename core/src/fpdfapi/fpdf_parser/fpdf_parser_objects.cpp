@@ -7,19 +7,80 @@
 #include "core/include/fpdfapi/fpdf_objects.h"
 
 #include <algorithm>
+#include <iterator>
 
 #include "core/include/fpdfapi/fpdf_parser.h"
+#include "core/include/fpdfapi/fpdf_serial.h"
+#include "core/include/fxcrt/fx_ext.h"
 #include "core/include/fxcrt/fx_string.h"
 #include "third_party/base/stl_util.h"
 
 namespace {
 
 const FX_DWORD kBlockSize = 1024;
+const size_t kObjectPoolTrunkSize = 64 * 1024;
+
+// Hashes |pObj| so that TrimIndirectObjects() can tell whether it still
+// matches the file. Stream data is only hashed when it is held in memory.
+FX_DWORD GetObjectFingerprint(const CPDF_Object* pObj) {
+  const CPDF_Stream* pStream = pObj->AsStream();
+  CFX_ByteTextBuf buf;
+  if (pStream)
+    buf << pStream->GetDict();
+  else
+    buf << pObj;
+  FX_DWORD hash = FX_HashCode_String_GetA(
+      reinterpret_cast<const FX_CHAR*>(buf.GetBuffer()), buf.GetSize());
+  if (!pStream)
+    return hash;
+
+  hash = hash * 31 + pStream->GetRawSize();
+  if (pStream->IsMemoryBased()) {
+    CPDF_StreamAcc acc;
+    acc.LoadAllData(pStream, TRUE);
+    hash = hash * 31 + FX_HashCode_String_GetA(
+                           reinterpret_cast<const FX_CHAR*>(acc.GetData()),
+                           acc.GetSize());
+  }
+  return hash;
+}
+
+// Estimates the memory |pObj| holds, about the size it would take written
+// out plus the stream data it keeps in memory, without writing it out.
+FX_DWORD EstimateObjectSize(const CPDF_Object* pObj) {
+  switch (pObj->GetType()) {
+    case PDFOBJ_STRING:
+    case PDFOBJ_NAME:
+      return 2 + pObj->GetString().GetLength();
+    case PDFOBJ_ARRAY: {
+      const CPDF_Array* pArray = pObj->AsArray();
+      FX_DWORD size = 2;
+      for (FX_DWORD i = 0; i < pArray->GetCount(); ++i)
+        size += 1 + EstimateObjectSize(pArray->GetElement(i));
+      return size;
+    }
+    case PDFOBJ_DICTIONARY: {
+      FX_DWORD size = 4;
+      for (const auto& it : *pObj->AsDictionary())
+        size += 2 + it.first.GetLength() + EstimateObjectSize(it.second);
+      return size;
+    }
+    case PDFOBJ_STREAM: {
+      const CPDF_Stream* pStream = pObj->AsStream();
+      FX_DWORD size = EstimateObjectSize(pStream->GetDict());
+      if (pStream->IsMemoryBased())
+        size += pStream->GetRawSize();
+      return size;
+    }
+    default:
+      return 8;
+  }
+}
 
 }  // namespace
 
 // static
-int CPDF_Object::s_nCurRefDepth = 0;
+thread_local int CPDF_Object::s_nCurRefDepth = 0;
 
 void CPDF_Object::Release() {
   if (m_ObjNum) {
@@ -27,25 +88,32 @@ void CPDF_Object::Release() {
   }
   Destroy();
 }
+template <typename T>
+void CPDF_Object::DestroyAs(T* pObj) {
+  if (m_bPooled)
+    pObj->~T();
+  else
+    delete pObj;
+}
 void CPDF_Object::Destroy() {
   switch (m_Type) {
     case PDFOBJ_STRING:
-      delete AsString();
+      DestroyAs(AsString());
       break;
     case PDFOBJ_NAME:
-      delete AsName();
+      DestroyAs(AsName());
       break;
     case PDFOBJ_ARRAY:
-      delete AsArray();
+      DestroyAs(AsArray());
       break;
     case PDFOBJ_DICTIONARY:
-      delete AsDictionary();
+      DestroyAs(AsDictionary());
       break;
     case PDFOBJ_STREAM:
-      delete AsStream();
+      DestroyAs(AsStream());
       break;
     default:
-      delete this;
+      DestroyAs(this);
   }
 }
 CFX_ByteString CPDF_Object::GetString() const {
@@ -269,8 +337,9 @@ CPDF_Object* CPDF_Object::CloneInternal(FX_BOOL bDirect,
     case PDFOBJ_DICTIONARY: {
       CPDF_Dictionary* pCopy = new CPDF_Dictionary();
       const CPDF_Dictionary* pThis = AsDictionary();
+      pCopy->m_Map.reserve(pThis->m_Map.size());
       for (const auto& it : *pThis) {
-        pCopy->m_Map.insert(std::make_pair(
+        pCopy->m_Map.push_back(std::make_pair(
             it.first, it.second->CloneInternal(bDirect, visited)));
       }
       return pCopy;
@@ -582,8 +651,35 @@ CPDF_Dictionary::~CPDF_Dictionary() {
     it.second->Release();
   }
 }
+CPDF_Dictionary::iterator CPDF_Dictionary::LowerBound(
+    const CFX_ByteStringC& key) {
+  return std::lower_bound(m_Map.begin(), m_Map.end(), key,
+                          [](const Entry& entry, const CFX_ByteStringC& key) {
+                            return CFX_ByteStringC(entry.first) < key;
+                          });
+}
+CPDF_Dictionary::const_iterator CPDF_Dictionary::LowerBound(
+    const CFX_ByteStringC& key) const {
+  return std::lower_bound(m_Map.begin(), m_Map.end(), key,
+                          [](const Entry& entry, const CFX_ByteStringC& key) {
+                            return CFX_ByteStringC(entry.first) < key;
+                          });
+}
+CPDF_Dictionary::iterator CPDF_Dictionary::Find(const CFX_ByteStringC& key) {
+  auto it = LowerBound(key);
+  if (it == m_Map.end() || it->first != key)
+    return m_Map.end();
+  return it;
+}
+CPDF_Dictionary::const_iterator CPDF_Dictionary::Find(
+    const CFX_ByteStringC& key) const {
+  auto it = LowerBound(key);
+  if (it == m_Map.end() || it->first != key)
+    return m_Map.end();
+  return it;
+}
 CPDF_Object* CPDF_Dictionary::GetElement(const CFX_ByteStringC& key) const {
-  auto it = m_Map.find(key);
+  auto it = Find(key);
   if (it == m_Map.end())
     return nullptr;
   return it->second;
@@ -691,18 +787,15 @@ CFX_Matrix CPDF_Dictionary::GetMatrix(const CFX_ByteStringC& key) const {
   return matrix;
 }
 FX_BOOL CPDF_Dictionary::KeyExist(const CFX_ByteStringC& key) const {
-  return pdfium::ContainsKey(m_Map, key);
+  return Find(key) != m_Map.end();
 }
 
-void CPDF_Dictionary::SetAt(const CFX_ByteStringC& key, CPDF_Object* pObj) {
+void CPDF_Dictionary::SetAt(const CFX_ByteString& key, CPDF_Object* pObj) {
   ASSERT(IsDictionary());
-  // Avoid 2 constructions of CFX_ByteString.
-  CFX_ByteString key_bytestring = key;
-  auto it = m_Map.find(key_bytestring);
-  if (it == m_Map.end()) {
-    if (pObj) {
-      m_Map.insert(std::make_pair(key_bytestring, pObj));
-    }
+  auto it = LowerBound(key);
+  if (it == m_Map.end() || it->first != key) {
+    if (pObj)
+      m_Map.insert(it, std::make_pair(key, pObj));
     return;
   }
 
@@ -717,7 +810,7 @@ void CPDF_Dictionary::SetAt(const CFX_ByteStringC& key, CPDF_Object* pObj) {
 }
 void CPDF_Dictionary::RemoveAt(const CFX_ByteStringC& key) {
   ASSERT(m_Type == PDFOBJ_DICTIONARY);
-  auto it = m_Map.find(key);
+  auto it = Find(key);
   if (it == m_Map.end())
     return;
 
@@ -727,23 +820,26 @@ void CPDF_Dictionary::RemoveAt(const CFX_ByteStringC& key) {
 void CPDF_Dictionary::ReplaceKey(const CFX_ByteStringC& oldkey,
                                  const CFX_ByteStringC& newkey) {
   ASSERT(m_Type == PDFOBJ_DICTIONARY);
-  auto old_it = m_Map.find(oldkey);
+  auto old_it = Find(oldkey);
   if (old_it == m_Map.end())
     return;
 
-  // Avoid 2 constructions of CFX_ByteString.
-  CFX_ByteString newkey_bytestring = newkey;
-  auto new_it = m_Map.find(newkey_bytestring);
+  auto new_it = Find(newkey);
   if (new_it == old_it)
     return;
 
+  CPDF_Object* pObj = old_it->second;
   if (new_it != m_Map.end()) {
     new_it->second->Release();
-    new_it->second = old_it->second;
-  } else {
-    m_Map.insert(std::make_pair(newkey_bytestring, old_it->second));
+    new_it->second = pObj;
+    m_Map.erase(old_it);
+    return;
   }
+  // |oldkey| may point into the erased entry, so copy |newkey| first.
+  CFX_ByteString newkey_bytestring = newkey;
   m_Map.erase(old_it);
+  m_Map.insert(LowerBound(newkey_bytestring),
+               std::make_pair(newkey_bytestring, pObj));
 }
 FX_BOOL CPDF_Dictionary::Identical(CPDF_Dictionary* pOther) const {
   if (!pOther) {
@@ -813,24 +909,31 @@ CPDF_Stream::CPDF_Stream(uint8_t* pData, FX_DWORD size, CPDF_Dictionary* pDict)
       m_pDict(pDict),
       m_dwSize(size),
       m_GenNum(kMemoryBasedGenNum),
-      m_pDataBuf(pData) {}
+      m_pDataBuf(pData),
+      m_bBorrowedData(false),
+      m_dwDataVersion(0) {}
 
 CPDF_Stream::~CPDF_Stream() {
-  if (IsMemoryBased())
-    FX_Free(m_pDataBuf);
+  FreeDataBuf();
 
   if (m_pDict)
     m_pDict->Release();
 }
 
+void CPDF_Stream::FreeDataBuf() {
+  if (IsMemoryBased() && !m_bBorrowedData)
+    FX_Free(m_pDataBuf);
+  m_bBorrowedData = false;
+}
+
 void CPDF_Stream::InitStreamInternal(CPDF_Dictionary* pDict) {
   if (pDict) {
     if (m_pDict)
       m_pDict->Release();
     m_pDict = pDict;
   }
-  if (IsMemoryBased())
-    FX_Free(m_pDataBuf);
+  FreeDataBuf();
+  ++m_dwDataVersion;
 
   m_GenNum = 0;
   m_pFile = nullptr;
@@ -854,8 +957,8 @@ void CPDF_Stream::SetData(const uint8_t* pData,
                           FX_DWORD size,
                           FX_BOOL bCompressed,
                           FX_BOOL bKeepBuf) {
-  if (IsMemoryBased())
-    FX_Free(m_pDataBuf);
+  FreeDataBuf();
+  ++m_dwDataVersion;
   m_GenNum = kMemoryBasedGenNum;
 
   if (bKeepBuf) {
@@ -885,6 +988,14 @@ FX_BOOL CPDF_Stream::ReadRawData(FX_FILESIZE offset,
     FXSYS_memcpy(buf, m_pDataBuf + offset, size);
   return TRUE;
 }
+void CPDF_Stream::SetBorrowedData(const uint8_t* pData, FX_DWORD size) {
+  FreeDataBuf();
+  ++m_dwDataVersion;
+  m_GenNum = kMemoryBasedGenNum;
+  m_pDataBuf = const_cast<uint8_t*>(pData);
+  m_dwSize = size;
+  m_bBorrowedData = true;
+}
 void CPDF_Stream::InitStreamFromFile(IFX_FileRead* pFile,
                                      CPDF_Dictionary* pDict) {
   InitStreamInternal(pDict);
@@ -1060,7 +1171,13 @@ void CPDF_Reference::SetRef(CPDF_IndirectObjectHolder* pDoc, FX_DWORD objnum) {
   m_RefObjNum = objnum;
 }
 CPDF_IndirectObjectHolder::CPDF_IndirectObjectHolder(CPDF_Parser* pParser)
-    : m_pParser(pParser), m_LastObjNum(0) {
+    : m_pParser(pParser),
+      m_LastObjNum(0),
+      m_dwObjectBudget(0),
+      m_dwLoadedSize(0),
+      m_nEvictions(0),
+      m_nReloads(0),
+      m_bObjectPoolSuspended(false) {
   if (pParser)
     m_LastObjNum = m_pParser->GetLastObjNum();
 }
@@ -1069,15 +1186,44 @@ CPDF_IndirectObjectHolder::~CPDF_IndirectObjectHolder() {
     pair.second->Destroy();
   }
 }
+void CPDF_IndirectObjectHolder::EnableObjectPool() {
+  if (!m_pObjectPool)
+    m_pObjectPool.reset(new CFX_GrowOnlyPool(kObjectPoolTrunkSize));
+}
+void CPDF_IndirectObjectHolder::EnableSharedLock() {
+  if (!m_pSharedLock)
+    m_pSharedLock.reset(new std::recursive_mutex);
+}
+CFX_ByteString CPDF_IndirectObjectHolder::InternName(
+    const CFX_ByteStringC& name) {
+  CFX_AutoLock lock(GetSharedLock());
+  auto it = m_NameAtoms.find(name);
+  if (it != m_NameAtoms.end())
+    return it->second;
+
+  // The key views the value's buffer, which the table keeps alive.
+  CFX_ByteString atom = name;
+  m_NameAtoms.insert(std::make_pair(CFX_ByteStringC(atom), atom));
+  return atom;
+}
 CPDF_Object* CPDF_IndirectObjectHolder::GetIndirectObject(
     FX_DWORD objnum,
     PARSE_CONTEXT* pContext) {
   if (objnum == 0)
     return nullptr;
 
+  CFX_AutoLock lock(GetSharedLock());
   auto it = m_IndirectObjs.find(objnum);
-  if (it != m_IndirectObjs.end())
+  if (it != m_IndirectObjs.end()) {
+    if (m_dwObjectBudget) {
+      auto loaded_it = m_LoadedObjs.find(objnum);
+      if (loaded_it != m_LoadedObjs.end()) {
+        m_LoadedLRU.splice(m_LoadedLRU.begin(), m_LoadedLRU,
+                           loaded_it->second.lru_pos);
+      }
+    }
     return it->second->GetObjNum() != -1 ? it->second : nullptr;
+  }
 
   if (!m_pParser)
     return nullptr;
@@ -1092,9 +1238,83 @@ CPDF_Object* CPDF_IndirectObjectHolder::GetIndirectObject(
     m_IndirectObjs[objnum]->Destroy();
 
   m_IndirectObjs[objnum] = pObj;
+  if (m_EvictedObjNums.erase(objnum))
+    ++m_nReloads;
+  if (m_dwObjectBudget) {
+    LoadedObject& loaded = m_LoadedObjs[objnum];
+    loaded.size = EstimateObjectSize(pObj);
+    loaded.lru_pos = m_LoadedLRU.insert(m_LoadedLRU.begin(), objnum);
+    m_dwLoadedSize += loaded.size;
+  }
   return pObj;
 }
+void CPDF_IndirectObjectHolder::SetObjectBudget(FX_DWORD dwBytes) {
+  m_dwObjectBudget = dwBytes;
+  if (m_dwObjectBudget)
+    return;
+
+  m_LoadedLRU.clear();
+  m_LoadedObjs.clear();
+  m_dwLoadedSize = 0;
+}
+void CPDF_IndirectObjectHolder::ForgetLoadedObject(FX_DWORD objnum) {
+  auto it = m_LoadedObjs.find(objnum);
+  if (it == m_LoadedObjs.end())
+    return;
+
+  m_dwLoadedSize -= it->second.size;
+  m_LoadedLRU.erase(it->second.lru_pos);
+  m_LoadedObjs.erase(it);
+}
+void CPDF_IndirectObjectHolder::TrimIndirectObjects(
+    const std::set<FX_DWORD>& pinned) {
+  // Other threads may hold pointers to any object of a shared holder.
+  if (m_pSharedLock)
+    return;
+
+  auto lru_it = m_LoadedLRU.end();
+  while (m_dwLoadedSize > m_dwObjectBudget && lru_it != m_LoadedLRU.begin()) {
+    --lru_it;
+    FX_DWORD objnum = *lru_it;
+    if (pdfium::ContainsKey(pinned, objnum))
+      continue;
+
+    auto obj_it = m_IndirectObjs.find(objnum);
+    auto next_it = std::next(lru_it);
+    ForgetLoadedObject(objnum);
+    lru_it = next_it;
+    if (obj_it == m_IndirectObjs.end())
+      continue;
+
+    // Objects edited in place cannot be parsed back, so stop tracking them.
+    // Only the objects about to go are compared with the file, as that
+    // writes them out and parses them again.
+    bool bSuspended = m_bObjectPoolSuspended;
+    m_bObjectPoolSuspended = true;
+    CPDF_Object* pFileObj =
+        m_pParser->ParseIndirectObject(this, objnum, nullptr);
+    m_bObjectPoolSuspended = bSuspended;
+    if (!pFileObj)
+      continue;
+
+    FX_BOOL bUnchanged = GetObjectFingerprint(pFileObj) ==
+                         GetObjectFingerprint(obj_it->second);
+    pFileObj->Destroy();
+    if (!bUnchanged)
+      continue;
+
+    FX_BOOL bStream = obj_it->second->IsStream();
+    obj_it->second->Destroy();
+    m_IndirectObjs.erase(obj_it);
+    m_EvictedObjNums.insert(objnum);
+    ++m_nEvictions;
+    // Parsing objects kept in object streams caches the streams' data.
+    if (bStream)
+      m_pParser->ReleaseObjectStreams();
+  }
+}
 int CPDF_IndirectObjectHolder::GetIndirectType(FX_DWORD objnum) {
+  CFX_AutoLock lock(GetSharedLock());
   auto it = m_IndirectObjs.find(objnum);
   if (it != m_IndirectObjs.end())
     return it->second->GetType();
@@ -1108,6 +1328,7 @@ int CPDF_IndirectObjectHolder::GetIndirectType(FX_DWORD objnum) {
   return (int)(uintptr_t)m_pParser->ParseIndirectObject(this, objnum, &context);
 }
 FX_DWORD CPDF_IndirectObjectHolder::AddIndirectObject(CPDF_Object* pObj) {
+  CFX_AutoLock lock(GetSharedLock());
   if (pObj->m_ObjNum) {
     return pObj->m_ObjNum;
   }
@@ -1117,16 +1338,19 @@ FX_DWORD CPDF_IndirectObjectHolder::AddIndirectObject(CPDF_Object* pObj) {
   return m_LastObjNum;
 }
 void CPDF_IndirectObjectHolder::ReleaseIndirectObject(FX_DWORD objnum) {
+  CFX_AutoLock lock(GetSharedLock());
   auto it = m_IndirectObjs.find(objnum);
   if (it == m_IndirectObjs.end() || it->second->GetObjNum() == -1)
     return;
   it->second->Destroy();
   m_IndirectObjs.erase(it);
+  ForgetLoadedObject(objnum);
 }
 FX_BOOL CPDF_IndirectObjectHolder::InsertIndirectObject(FX_DWORD objnum,
                                                         CPDF_Object* pObj) {
   if (!objnum || !pObj)
     return FALSE;
+  CFX_AutoLock lock(GetSharedLock());
   auto it = m_IndirectObjs.find(objnum);
   if (it != m_IndirectObjs.end()) {
     if (pObj->GetGenNum() <= it->second->GetGenNum()) {
@@ -1138,5 +1362,6 @@ FX_BOOL CPDF_IndirectObjectHolder::InsertIndirectObject(FX_DWORD objnum,
   pObj->m_ObjNum = objnum;
   m_IndirectObjs[objnum] = pObj;
   m_LastObjNum = std::max(m_LastObjNum, objnum);
+  ForgetLoadedObject(objnum);
   return TRUE;
 }
@@ -0,0 +1,76 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <memory>
+
+#include "core/include/fpdfapi/fpdf_objects.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using ScopedDict =
+    std::unique_ptr<CPDF_Dictionary, ReleaseDeleter<CPDF_Dictionary>>;
+
+CFX_ByteString JoinKeys(const CPDF_Dictionary* pDict) {
+  CFX_ByteString result;
+  for (const auto& it : *pDict) {
+    result += it.first;
+    result += " ";
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(fpdf_parser_objects, DictionaryKeepsKeysSorted) {
+  ScopedDict dict(new CPDF_Dictionary);
+  dict->SetAtInteger("Type", 1);
+  dict->SetAtInteger("Length", 2);
+  dict->SetAtInteger("Filter", 3);
+  dict->SetAtInteger("Length1", 4);
+  dict->SetAtInteger("", 5);
+  EXPECT_EQ(5u, dict->GetCount());
+  EXPECT_EQ(" Filter Length Length1 Type ", JoinKeys(dict.get()));
+  EXPECT_EQ(2, dict->GetInteger("Length"));
+  EXPECT_EQ(5, dict->GetInteger(""));
+  EXPECT_FALSE(dict->KeyExist("Len"));
+  EXPECT_FALSE(dict->KeyExist("Zzz"));
+
+  dict->SetAtInteger("Length", 6);
+  EXPECT_EQ(5u, dict->GetCount());
+  EXPECT_EQ(6, dict->GetInteger("Length"));
+
+  dict->SetAt("Type", nullptr);
+  dict->RemoveAt("");
+  dict->RemoveAt("Missing");
+  EXPECT_EQ("Filter Length Length1 ", JoinKeys(dict.get()));
+
+  ScopedDict clone(dict->Clone()->AsDictionary());
+  EXPECT_EQ("Filter Length Length1 ", JoinKeys(clone.get()));
+  EXPECT_EQ(6, clone->GetInteger("Length"));
+}
+
+TEST(fpdf_parser_objects, DictionaryReplaceKey) {
+  ScopedDict dict(new CPDF_Dictionary);
+  dict->SetAtInteger("A", 1);
+  dict->SetAtInteger("B", 2);
+  dict->SetAtInteger("C", 3);
+
+  dict->ReplaceKey("A", "D");
+  EXPECT_EQ("B C D ", JoinKeys(dict.get()));
+  EXPECT_EQ(1, dict->GetInteger("D"));
+
+  dict->ReplaceKey("D", "B");
+  EXPECT_EQ("B C ", JoinKeys(dict.get()));
+  EXPECT_EQ(1, dict->GetInteger("B"));
+
+  // The old key may alias the entry being replaced.
+  dict->ReplaceKey(dict->begin()->first, "A");
+  EXPECT_EQ("A C ", JoinKeys(dict.get()));
+  EXPECT_EQ(1, dict->GetInteger("A"));
+
+  dict->ReplaceKey("C", "C");
+  dict->ReplaceKey("Missing", "E");
+  EXPECT_EQ("A C ", JoinKeys(dict.get()));
+}
@@ -8,7 +8,9 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -30,6 +32,13 @@ const int32_t kMaxXRefSize = 1048576;
 // are higher, but this may be large enough in practice.
 const FX_DWORD kMaxObjectNumber = 1048576;
 
+// The default limit on decoded object stream data kept by the parser.
+const FX_DWORD kMaxObjectStreamCacheSize = 8 * 1024 * 1024;
+
+// Damaged files are scanned on several threads, in chunks of at least this
+// many bytes each.
+const FX_FILESIZE kMinCrossRefChunkSize = 256 * 1024;
+
 struct SearchTagRecord {
   const char* m_pTag;
   FX_DWORD m_Len;
@@ -50,6 +59,73 @@ class ScopedSetInsertion {
   const T m_Entry;
 };
 
+// Shares |name| with equal names already parsed into |pObjList|, if any.
+CFX_ByteString InternName(CPDF_IndirectObjectHolder* pObjList,
+                          const CFX_ByteStringC& name) {
+  return pObjList ? pObjList->InternName(name) : CFX_ByteString(name);
+}
+
+// Decodes the name token |name|, given without its leading slash.
+CFX_ByteString DecodeName(CPDF_IndirectObjectHolder* pObjList,
+                          const CFX_ByteStringC& name) {
+  if (FXSYS_memchr(name.GetCStr(), '#', name.GetLength()))
+    return InternName(pObjList, PDF_NameDecode(name));
+  return InternName(pObjList, name);
+}
+
+// Creates a parsed object, from |pObjList|'s object pool when it has one.
+template <typename T, typename... Args>
+T* NewObject(CPDF_IndirectObjectHolder* pObjList, Args&&... args) {
+  if (!pObjList)
+    return new T(std::forward<Args>(args)...);
+  return pObjList->NewParsedObject<T>(std::forward<Args>(args)...);
+}
+
+// Keeps the objects a rebuild parses and drops again out of the pool.
+class ScopedObjectPoolSuspension {
+ public:
+  explicit ScopedObjectPoolSuspension(CPDF_IndirectObjectHolder* pHolder)
+      : m_pHolder(pHolder) {
+    if (m_pHolder)
+      m_pHolder->SuspendObjectPool(true);
+  }
+  ~ScopedObjectPoolSuspension() {
+    if (m_pHolder)
+      m_pHolder->SuspendObjectPool(false);
+  }
+
+ private:
+  CPDF_IndirectObjectHolder* const m_pHolder;
+};
+
+// Serializes the reads of a document shared between threads. Streams read
+// their data straight from the file, without the document lock.
+class CPDF_SharedFileRead : public IFX_FileRead {
+ public:
+  CPDF_SharedFileRead(IFX_FileRead* pFile, FX_BOOL bOwnFile)
+      : m_pFile(pFile), m_bOwnFile(bOwnFile) {}
+
+  // IFX_FileRead:
+  void Release() override {
+    if (m_bOwnFile)
+      m_pFile->Release();
+    delete this;
+  }
+  FX_BOOL ReadBlock(void* buffer, FX_FILESIZE offset, size_t size) override {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    return m_pFile->ReadBlock(buffer, offset, size);
+  }
+  FX_FILESIZE GetSize() override { return m_pFile->GetSize(); }
+  const uint8_t* GetDirectBuffer() override {
+    return m_pFile->GetDirectBuffer();
+  }
+
+ private:
+  IFX_FileRead* const m_pFile;
+  const FX_BOOL m_bOwnFile;
+  std::mutex m_Lock;
+};
+
 int CompareFileSize(const void* p1, const void* p2) {
   return *(FX_FILESIZE*)p1 - *(FX_FILESIZE*)p2;
 }
@@ -97,6 +173,452 @@ bool CanReadFromBitStream(const CFX_BitStream* hStream,
           hStream->BitsRemaining() >= num_bits.ValueOrDie());
 }
 
+// Parses the object whose "<objnum> <gennum> obj" header is at |pos| in
+// |pSyntax|, failing if the header does not match |objnum|. Sets
+// |pResultPos| to the end of the object.
+CPDF_Object* ParseObjectAtByStrict(CPDF_SyntaxParser* pSyntax,
+                                   CPDF_IndirectObjectHolder* pObjList,
+                                   FX_FILESIZE pos,
+                                   FX_DWORD objnum,
+                                   PARSE_CONTEXT* pContext,
+                                   FX_FILESIZE* pResultPos) {
+  FX_FILESIZE SavedPos = pSyntax->SavePos();
+  pSyntax->RestorePos(pos);
+  bool bIsNumber;
+  CFX_ByteString word = pSyntax->GetNextWord(&bIsNumber);
+  if (!bIsNumber) {
+    pSyntax->RestorePos(SavedPos);
+    return NULL;
+  }
+  FX_DWORD parser_objnum = FXSYS_atoi(word);
+  if (objnum && parser_objnum != objnum) {
+    pSyntax->RestorePos(SavedPos);
+    return NULL;
+  }
+  word = pSyntax->GetNextWord(&bIsNumber);
+  if (!bIsNumber) {
+    pSyntax->RestorePos(SavedPos);
+    return NULL;
+  }
+  FX_DWORD gennum = FXSYS_atoi(word);
+  if (pSyntax->GetKeyword() != "obj") {
+    pSyntax->RestorePos(SavedPos);
+    return NULL;
+  }
+  CPDF_Object* pObj =
+      pSyntax->GetObjectByStrict(pObjList, objnum, gennum, pContext);
+  if (pResultPos) {
+    *pResultPos = pSyntax->SavePos();
+  }
+  pSyntax->RestorePos(SavedPos);
+  return pObj;
+}
+
+// Where RebuildCrossRef()'s byte by byte scan of a file is between two
+// bytes. Scans that reach the same position in the same state find the
+// same objects from there on.
+struct CrossRefScanState {
+  CrossRefScanState()
+      : status(0),
+        inside_index(0),
+        objnum(0),
+        gennum(0),
+        depth(0),
+        start_pos(0),
+        start_pos1(0) {}
+
+  int32_t status;
+  int32_t inside_index;
+  FX_DWORD objnum;
+  FX_DWORD gennum;
+  int32_t depth;
+  FX_FILESIZE start_pos;
+  FX_FILESIZE start_pos1;
+};
+
+// Receives what a cross-reference scan finds, in file order.
+class CrossRefScanHandler {
+ public:
+  virtual ~CrossRefScanHandler() {}
+
+  // Called for "|objnum| |gennum| obj" at |start_pos|, followed by the
+  // delimiter at |pos|. Returns where the scan goes on. That is before |pos|
+  // for an object whose header fails to parse.
+  virtual FX_FILESIZE OnObject(FX_FILESIZE start_pos,
+                               FX_DWORD objnum,
+                               FX_DWORD gennum,
+                               FX_FILESIZE pos) = 0;
+
+  // Called for "trailer" followed by the delimiter at |pos|.
+  virtual void OnTrailer(FX_FILESIZE pos) = 0;
+
+  // Called for "xref" followed by the byte at |pos|.
+  virtual void OnXRef(FX_FILESIZE pos) = 0;
+};
+
+// Scans |pFile|, of |file_len| bytes, from |pos| in |pState| until reaching
+// |end|, reading it in blocks unless |pFileData| holds all of it. Skips the
+// objects it finds, so it may stop past |end|. An object may also send the
+// scan back. If that is to the start of the block being scanned, or repeats
+// the last move back, the scan gives up and returns |end|. Otherwise returns
+// where it stopped, or -1 if a read failed.
+FX_FILESIZE ScanForCrossRef(IFX_FileRead* pFile,
+                            const uint8_t* pFileData,
+                            FX_FILESIZE file_len,
+                            FX_FILESIZE pos,
+                            FX_FILESIZE end,
+                            CrossRefScanState* pState,
+                            CrossRefScanHandler* pHandler) {
+  const FX_DWORD kBufferSize = 4096;
+  uint8_t buffer[kBufferSize];
+  CrossRefScanState& state = *pState;
+  FX_FILESIZE moved_back_from = -1;
+  FX_FILESIZE moved_back_to = -1;
+  while (pos < end) {
+    FX_DWORD size =
+        (FX_DWORD)std::min<FX_FILESIZE>(file_len - pos, kBufferSize);
+    const FX_FILESIZE block_pos = pos;
+    const uint8_t* pBlock = buffer;
+    if (pFileData)
+      pBlock = pFileData + pos;
+    else if (!pFile->ReadBlock(buffer, pos, size))
+      return -1;
+
+    const FX_FILESIZE block_end = std::min(block_pos + size, end);
+    bool bMovedBack = false;
+    while (pos < block_end && !bMovedBack) {
+      uint8_t byte = pBlock[pos - block_pos];
+      // Cleared to look at the byte again in the new state.
+      bool bNextByte = true;
+      switch (state.status) {
+        case 0:
+          if (PDFCharIsWhitespace(byte))
+            state.status = 1;
+
+          if (std::isdigit(byte)) {
+            bNextByte = false;
+            state.status = 1;
+          }
+
+          if (byte == '%') {
+            state.inside_index = 0;
+            state.status = 9;
+          }
+
+          if (byte == '(') {
+            state.status = 10;
+            state.depth = 1;
+          }
+
+          if (byte == '<') {
+            state.inside_index = 1;
+            state.status = 11;
+          }
+
+          if (byte == '\\')
+            state.status = 13;
+
+          if (byte == 't') {
+            state.status = 7;
+            state.inside_index = 1;
+          }
+          break;
+        case 1:
+          if (PDFCharIsWhitespace(byte)) {
+            break;
+          } else if (std::isdigit(byte)) {
+            state.start_pos = pos;
+            state.status = 2;
+            state.objnum = FXSYS_toDecimalDigit(byte);
+          } else if (byte == 't') {
+            state.status = 7;
+            state.inside_index = 1;
+          } else if (byte == 'x') {
+            state.status = 8;
+            state.inside_index = 1;
+          } else {
+            bNextByte = false;
+            state.status = 0;
+          }
+          break;
+        case 2:
+          if (std::isdigit(byte)) {
+            state.objnum = state.objnum * 10 + FXSYS_toDecimalDigit(byte);
+            break;
+          } else if (PDFCharIsWhitespace(byte)) {
+            state.status = 3;
+          } else {
+            bNextByte = false;
+            state.status = 14;
+            state.inside_index = 0;
+          }
+          break;
+        case 3:
+          if (std::isdigit(byte)) {
+            state.start_pos1 = pos;
+            state.status = 4;
+            state.gennum = FXSYS_toDecimalDigit(byte);
+          } else if (PDFCharIsWhitespace(byte)) {
+            break;
+          } else if (byte == 't') {
+            state.status = 7;
+            state.inside_index = 1;
+          } else {
+            bNextByte = false;
+            state.status = 0;
+          }
+          break;
+        case 4:
+          if (std::isdigit(byte)) {
+            state.gennum = state.gennum * 10 + FXSYS_toDecimalDigit(byte);
+            break;
+          } else if (PDFCharIsWhitespace(byte)) {
+            state.status = 5;
+          } else {
+            bNextByte = false;
+            state.status = 0;
+          }
+          break;
+        case 5:
+          if (byte == 'o') {
+            state.status = 6;
+            state.inside_index = 1;
+          } else if (PDFCharIsWhitespace(byte)) {
+            break;
+          } else if (std::isdigit(byte)) {
+            state.objnum = state.gennum;
+            state.gennum = FXSYS_toDecimalDigit(byte);
+            state.start_pos = state.start_pos1;
+            state.start_pos1 = pos;
+            state.status = 4;
+          } else if (byte == 't') {
+            state.status = 7;
+            state.inside_index = 1;
+          } else {
+            bNextByte = false;
+            state.status = 0;
+          }
+          break;
+        case 6:
+          switch (state.inside_index) {
+            case 1:
+              if (byte != 'b') {
+                bNextByte = false;
+                state.status = 0;
+              } else {
+                state.inside_index++;
+              }
+              break;
+            case 2:
+              if (byte != 'j') {
+                bNextByte = false;
+                state.status = 0;
+              } else {
+                state.inside_index++;
+              }
+              break;
+            case 3:
+              if (PDFCharIsWhitespace(byte) || PDFCharIsDelimiter(byte)) {
+                if (state.objnum > 0x1000000) {
+                  state.status = 0;
+                  break;
+                }
+                FX_FILESIZE next_pos = pHandler->OnObject(
+                    state.start_pos, state.objnum, state.gennum, pos);
+                if (next_pos < pos) {
+                  // Without this, a scan sent back to a block before the
+                  // current one would find the same object forever.
+                  if (next_pos == block_pos ||
+                      (pos == moved_back_from && next_pos == moved_back_to)) {
+                    return end;
+                  }
+                  moved_back_from = pos;
+                  moved_back_to = next_pos;
+                  bMovedBack = true;
+                }
+                pos = next_pos;
+              }
+              bNextByte = false;
+              state.status = 0;
+              break;
+          }
+          break;
+        case 7:
+          if (state.inside_index == 7) {
+            if (PDFCharIsWhitespace(byte) || PDFCharIsDelimiter(byte))
+              pHandler->OnTrailer(pos);
+            bNextByte = false;
+            state.status = 0;
+          } else if (byte == "trailer"[state.inside_index]) {
+            state.inside_index++;
+          } else {
+            bNextByte = false;
+            state.status = 0;
+          }
+          break;
+        case 8:
+          if (state.inside_index == 4) {
+            pHandler->OnXRef(pos);
+            state.status = 1;
+          } else if (byte == "xref"[state.inside_index]) {
+            state.inside_index++;
+          } else {
+            bNextByte = false;
+            state.status = 0;
+          }
+          break;
+        case 9:
+          if (byte == '\r' || byte == '\n') {
+            state.status = 0;
+          }
+          break;
+        case 10:
+          if (byte == ')') {
+            if (state.depth > 0) {
+              state.depth--;
+            }
+          } else if (byte == '(') {
+            state.depth++;
+          }
+          if (!state.depth) {
+            state.status = 0;
+          }
+          break;
+        case 11:
+          if (byte == '>' || (byte == '<' && state.inside_index == 1))
+            state.status = 0;
+          state.inside_index = 0;
+          break;
+        case 13:
+          if (PDFCharIsDelimiter(byte) || PDFCharIsWhitespace(byte)) {
+            bNextByte = false;
+            state.status = 0;
+          }
+          break;
+        case 14:
+          if (PDFCharIsWhitespace(byte)) {
+            state.status = 0;
+          } else if (byte == '%' || byte == '(' || byte == '<' ||
+                     byte == '\\') {
+            state.status = 0;
+            bNextByte = false;
+          } else if (state.inside_index == 6) {
+            state.status = 0;
+            bNextByte = false;
+          } else if (byte == "endobj"[state.inside_index]) {
+            state.inside_index++;
+          }
+          break;
+      }
+      if (bNextByte)
+        pos++;
+    }
+  }
+  return pos;
+}
+
+// Something a scan of part of the file found: an object, with where the scan
+// went on after it, a trailer or an xref.
+struct CrossRefScanEvent {
+  enum Type { kObject, kTrailer, kXRef };
+
+  Type type;
+  FX_FILESIZE pos;
+  FX_FILESIZE start_pos;
+  FX_DWORD objnum;
+  FX_DWORD gennum;
+  FX_FILESIZE next_pos;
+  // Whether the object parsed.
+  bool bParsed;
+  // Whether the object has to be parsed again with the document, because
+  // it failed to parse, its stream length or type is a reference, or it is
+  // a cross-reference stream that may become the trailer.
+  bool bReparse;
+};
+
+// Part of the file scanned on a thread of its own, starting at |start| in
+// the initial state.
+struct CrossRefChunk {
+  CrossRefChunk() : start(0), end(0), stop_pos(-1), bMovedBack(false) {}
+
+  FX_FILESIZE start;
+  FX_FILESIZE end;
+  std::vector<CrossRefScanEvent> events;
+  // The positions the scan was at in the initial state: |start|, then where
+  // it went on after each object. Each comes with the index of the next
+  // event.
+  std::vector<std::pair<FX_FILESIZE, size_t>> sync_points;
+  // Where the scan stopped and its state there, or -1 if a read failed.
+  FX_FILESIZE stop_pos;
+  CrossRefScanState stop_state;
+  // Whether an object would have sent the scan back. The scan went on after
+  // the object instead.
+  bool bMovedBack;
+};
+
+// Scans a CrossRefChunk, parsing the objects it finds without the document.
+class CrossRefChunkScanner : public CrossRefScanHandler {
+ public:
+  CrossRefChunkScanner(IFX_FileRead* pFile,
+                       FX_DWORD header_offset,
+                       CrossRefChunk* pChunk)
+      : m_HeaderOffset(header_offset), m_pChunk(pChunk) {
+    m_Syntax.InitParser(pFile, header_offset);
+    FXSYS_memset(&m_Context, 0, sizeof(PARSE_CONTEXT));
+    m_Context.m_Flags = PDFPARSE_NOSTREAMDATA;
+  }
+
+  // CrossRefScanHandler:
+  FX_FILESIZE OnObject(FX_FILESIZE start_pos,
+                       FX_DWORD objnum,
+                       FX_DWORD gennum,
+                       FX_FILESIZE pos) override {
+    FX_FILESIZE obj_end = 0;
+    std::unique_ptr<CPDF_Object, ReleaseDeleter<CPDF_Object>> pObject(
+        ParseObjectAtByStrict(&m_Syntax, nullptr, start_pos - m_HeaderOffset,
+                              objnum, &m_Context, &obj_end));
+    CrossRefScanEvent event = NewEvent(CrossRefScanEvent::kObject, pos);
+    event.start_pos = start_pos;
+    event.objnum = objnum;
+    event.gennum = gennum;
+    event.next_pos = std::max(obj_end + m_HeaderOffset, pos);
+    if (event.next_pos != obj_end + m_HeaderOffset)
+      m_pChunk->bMovedBack = true;
+    event.bParsed = !!pObject;
+    // An object that fails to parse may only need its stream length from
+    // the document.
+    event.bReparse = !pObject;
+    CPDF_Stream* pStream = ToStream(pObject.get());
+    if (CPDF_Dictionary* pDict = pStream ? pStream->GetDict() : nullptr) {
+      event.bReparse = ToReference(pDict->GetElement("Length")) ||
+                       ToReference(pDict->GetElement("Type")) ||
+                       pDict->GetString("Type") == "XRef";
+    }
+    m_pChunk->events.push_back(event);
+    m_pChunk->sync_points.push_back(
+        std::make_pair(event.next_pos, m_pChunk->events.size()));
+    return event.next_pos;
+  }
+  void OnTrailer(FX_FILESIZE pos) override {
+    m_pChunk->events.push_back(NewEvent(CrossRefScanEvent::kTrailer, pos));
+  }
+  void OnXRef(FX_FILESIZE pos) override {
+    m_pChunk->events.push_back(NewEvent(CrossRefScanEvent::kXRef, pos));
+  }
+
+ private:
+  static CrossRefScanEvent NewEvent(CrossRefScanEvent::Type type,
+                                    FX_FILESIZE pos) {
+    CrossRefScanEvent event = {type, pos, 0, 0, 0, pos, false, false};
+    return event;
+  }
+
+  const FX_DWORD m_HeaderOffset;
+  CrossRefChunk* const m_pChunk;
+  CPDF_SyntaxParser m_Syntax;
+  PARSE_CONTEXT m_Context;
+};
+
 }  // namespace
 
 // TODO(thestig) Using unique_ptr with ReleaseDeleter is still not ideal.
@@ -121,17 +643,25 @@ CPDF_Parser::CPDF_Parser() {
   m_bOwnFileRead = TRUE;
   m_FileVersion = 0;
   m_bForceUseSecurityHandler = FALSE;
+  m_pXRefIndex = NULL;
+  m_bXRefIndexUsed = FALSE;
+  m_FileModifiedTime = 0;
+  m_bUseObjectPool = FALSE;
+  m_bSharedAccess = FALSE;
+  m_dwObjStreamSize = 0;
+  m_dwObjStreamLimit = kMaxObjectStreamCacheSize;
+  m_nRebuildThreads = std::thread::hardware_concurrency();
 }
 CPDF_Parser::~CPDF_Parser() {
   CloseParser(FALSE);
 }
 
 FX_DWORD CPDF_Parser::GetLastObjNum() const {
-  return m_ObjectInfo.empty() ? 0 : m_ObjectInfo.rbegin()->first;
+  return m_ObjectInfo.empty() ? 0 : (FX_DWORD)m_ObjectInfo.size() - 1;
 }
 
 bool CPDF_Parser::IsValidObjectNumber(FX_DWORD objnum) const {
-  return !m_ObjectInfo.empty() && objnum <= m_ObjectInfo.rbegin()->first;
+  return objnum < m_ObjectInfo.size();
 }
 
 void CPDF_Parser::SetEncryptDictionary(CPDF_Dictionary* pDict) {
@@ -139,62 +669,68 @@ void CPDF_Parser::SetEncryptDictionary(CPDF_Dictionary* pDict) {
 }
 
 FX_FILESIZE CPDF_Parser::GetObjectPositionOrZero(FX_DWORD objnum) const {
-  auto it = m_ObjectInfo.find(objnum);
-  return it != m_ObjectInfo.end() ? it->second.pos : 0;
+  return IsValidObjectNumber(objnum) ? m_ObjectInfo[objnum].pos : 0;
 }
 
-void CPDF_Parser::ShrinkObjectMap(FX_DWORD objnum) {
-  if (objnum == 0) {
-    m_ObjectInfo.clear();
-    return;
-  }
+void CPDF_Parser::SetObjectPosition(FX_DWORD objnum, FX_FILESIZE pos) {
+  if (objnum >= m_ObjectInfo.size())
+    m_ObjectInfo.resize(objnum + 1);
+  m_ObjectInfo[objnum].pos = pos;
+}
 
-  auto it = m_ObjectInfo.lower_bound(objnum);
-  while (it != m_ObjectInfo.end()) {
-    auto saved_it = it++;
-    m_ObjectInfo.erase(saved_it);
-  }
+void CPDF_Parser::ShrinkObjectMap(FX_DWORD objnum) {
+  // |objnum| comes from a trailer /Size, which callers bound by
+  // kMaxXRefSize before the table grows to it.
+  ASSERT(objnum <= (FX_DWORD)kMaxXRefSize);
+  m_ObjectInfo.resize(objnum);
+}
 
-  if (!pdfium::ContainsKey(m_ObjectInfo, objnum - 1))
-    m_ObjectInfo[objnum - 1].pos = 0;
+void CPDF_Parser::SortOffsets() {
+  FX_FILESIZE* pBegin = m_SortedOffset.GetData();
+  FX_FILESIZE* pEnd = pBegin + m_SortedOffset.GetSize();
+  std::sort(pBegin, pEnd);
+  m_SortedOffset.SetSize(std::unique(pBegin, pEnd) - pBegin);
 }
 
 void CPDF_Parser::CloseParser(FX_BOOL bReParse) {
   m_bVersionUpdated = FALSE;
-  if (!bReParse) {
-    delete m_pDocument;
-    m_pDocument = NULL;
-  }
+  // Trailers may live in the document's object pool, so release them first.
   if (m_pTrailer) {
     m_pTrailer->Release();
     m_pTrailer = NULL;
   }
+  int32_t iLen = m_Trailers.GetSize();
+  for (int32_t i = 0; i < iLen; ++i) {
+    if (CPDF_Dictionary* trailer = m_Trailers.GetAt(i))
+      trailer->Release();
+  }
+  m_Trailers.RemoveAll();
+  if (!bReParse) {
+    delete m_pDocument;
+    m_pDocument = NULL;
+  }
   ReleaseEncryptHandler();
   SetEncryptDictionary(NULL);
   if (m_bOwnFileRead && m_Syntax.m_pFileAccess) {
-    m_Syntax.m_pFileAccess->Release();
+    // The kept document's streams may borrow from the mapped file.
+    if (bReParse && m_Syntax.m_pFileData)
+      m_RetiredFiles.push_back(m_Syntax.m_pFileAccess);
+    else
+      m_Syntax.m_pFileAccess->Release();
     m_Syntax.m_pFileAccess = NULL;
+    m_Syntax.m_pFileData = NULL;
   }
-  FX_POSITION pos = m_ObjectStreamMap.GetStartPosition();
-  while (pos) {
-    void* objnum;
-    CPDF_StreamAcc* pStream;
-    m_ObjectStreamMap.GetNextAssoc(pos, objnum, (void*&)pStream);
-    delete pStream;
+  if (!bReParse) {
+    for (IFX_FileRead* pFile : m_RetiredFiles)
+      pFile->Release();
+    m_RetiredFiles.clear();
   }
-  m_ObjectStreamMap.RemoveAll();
-  m_ObjCache.clear();
+  ReleaseObjectStreams();
 
   m_SortedOffset.RemoveAll();
   m_ObjectInfo.clear();
   m_V5Type.RemoveAll();
   m_ObjVersion.RemoveAll();
-  int32_t iLen = m_Trailers.GetSize();
-  for (int32_t i = 0; i < iLen; ++i) {
-    if (CPDF_Dictionary* trailer = m_Trailers.GetAt(i))
-      trailer->Release();
-  }
-  m_Trailers.RemoveAll();
   if (m_pLinearized) {
     m_pLinearized->Release();
     m_pLinearized = NULL;
@@ -206,9 +742,16 @@ FX_DWORD CPDF_Parser::StartParse(IFX_FileRead* pFileAccess,
                                  FX_BOOL bReParse,
                                  FX_BOOL bOwnFileRead) {
   CloseParser(bReParse);
+  if (m_bSharedAccess && pFileAccess) {
+    pFileAccess = new CPDF_SharedFileRead(pFileAccess, bOwnFileRead);
+    bOwnFileRead = TRUE;
+  }
   m_bXRefStream = FALSE;
   m_LastXRefOffset = 0;
   m_bOwnFileRead = bOwnFileRead;
+  m_bXRefIndexUsed = FALSE;
+  IFX_FileRead* pXRefIndex = m_pXRefIndex;
+  m_pXRefIndex = NULL;
 
   int32_t offset = GetHeaderOffset(pFileAccess);
   if (offset == -1) {
@@ -233,17 +776,19 @@ FX_DWORD CPDF_Parser::StartParse(IFX_FileRead* pFileAccess,
     return PDFPARSE_ERROR_FORMAT;
 
   m_Syntax.RestorePos(m_Syntax.m_FileLen - m_Syntax.m_HeaderOffset - 9);
-  if (!bReParse)
+  if (!bReParse) {
     m_pDocument = new CPDF_Document(this);
+    if (m_bUseObjectPool)
+      m_pDocument->EnableObjectPool();
+    if (m_bSharedAccess)
+      m_pDocument->EnableSharedAccess();
+  }
 
   FX_BOOL bXRefRebuilt = FALSE;
-  if (m_Syntax.SearchWord("startxref", TRUE, FALSE, 4096)) {
-    FX_FILESIZE startxref_offset = m_Syntax.SavePos();
-    void* pResult = FXSYS_bsearch(&startxref_offset, m_SortedOffset.GetData(),
-                                  m_SortedOffset.GetSize(), sizeof(FX_FILESIZE),
-                                  CompareFileSize);
-    if (!pResult)
-      m_SortedOffset.Add(startxref_offset);
+  if (pXRefIndex && LoadXRefIndex(pXRefIndex)) {
+    m_bXRefIndexUsed = TRUE;
+  } else if (m_Syntax.SearchWord("startxref", TRUE, FALSE, 4096)) {
+    m_SortedOffset.Add(m_Syntax.SavePos());
 
     m_Syntax.GetKeyword();
     bool bNumber;
@@ -287,8 +832,7 @@ FX_DWORD CPDF_Parser::StartParse(IFX_FileRead* pFileAccess,
     if (!m_pDocument->GetRoot())
       return PDFPARSE_ERROR_FORMAT;
   }
-  FXSYS_qsort(m_SortedOffset.GetData(), m_SortedOffset.GetSize(),
-              sizeof(FX_FILESIZE), CompareFileSize);
+  SortOffsets();
   if (GetRootObjNum() == 0) {
     ReleaseEncryptHandler();
     if (!RebuildCrossRef() || GetRootObjNum() == 0)
@@ -476,12 +1020,7 @@ FX_BOOL CPDF_Parser::LoadLinearizedCrossRefV4(FX_FILESIZE pos,
                                               FX_DWORD dwObjCount) {
   FX_FILESIZE dwStartPos = pos - m_Syntax.m_HeaderOffset;
   m_Syntax.RestorePos(dwStartPos);
-  void* pResult =
-      FXSYS_bsearch(&pos, m_SortedOffset.GetData(), m_SortedOffset.GetSize(),
-                    sizeof(FX_FILESIZE), CompareFileSize);
-  if (!pResult) {
-    m_SortedOffset.Add(pos);
-  }
+  m_SortedOffset.Add(pos);
   FX_DWORD start_objnum = 0;
   FX_DWORD count = dwObjCount;
   FX_FILESIZE SavedPos = m_Syntax.SavePos();
@@ -503,7 +1042,7 @@ FX_BOOL CPDF_Parser::LoadLinearizedCrossRefV4(FX_FILESIZE pos,
       FX_DWORD objnum = start_objnum + block * 1024 + i;
       char* pEntry = &buf[i * recordsize];
       if (pEntry[17] == 'f') {
-        m_ObjectInfo[objnum].pos = 0;
+        SetObjectPosition(objnum, 0);
         m_V5Type.SetAtGrow(objnum, 0);
       } else {
         int32_t offset = FXSYS_atoi(pEntry);
@@ -513,20 +1052,14 @@ FX_BOOL CPDF_Parser::LoadLinearizedCrossRefV4(FX_FILESIZE pos,
               return FALSE;
           }
         }
-        m_ObjectInfo[objnum].pos = offset;
+        SetObjectPosition(objnum, offset);
         int32_t version = FXSYS_atoi(pEntry + 11);
         if (version >= 1) {
           m_bVersionUpdated = TRUE;
         }
         m_ObjVersion.SetAtGrow(objnum, version);
-        if (m_ObjectInfo[objnum].pos < m_Syntax.m_FileLen) {
-          void* pResult = FXSYS_bsearch(
-              &m_ObjectInfo[objnum].pos, m_SortedOffset.GetData(),
-              m_SortedOffset.GetSize(), sizeof(FX_FILESIZE), CompareFileSize);
-          if (!pResult) {
-            m_SortedOffset.Add(m_ObjectInfo[objnum].pos);
-          }
-        }
+        if (offset < m_Syntax.m_FileLen)
+          m_SortedOffset.Add(offset);
         m_V5Type.SetAtGrow(objnum, 1);
       }
     }
@@ -535,11 +1068,6 @@ FX_BOOL CPDF_Parser::LoadLinearizedCrossRefV4(FX_FILESIZE pos,
   return TRUE;
 }
 
-bool CPDF_Parser::FindPosInOffsets(FX_FILESIZE pos) const {
-  return FXSYS_bsearch(&pos, m_SortedOffset.GetData(), m_SortedOffset.GetSize(),
-                       sizeof(FX_FILESIZE), CompareFileSize);
-}
-
 bool CPDF_Parser::LoadCrossRefV4(FX_FILESIZE pos,
                                  FX_FILESIZE streampos,
                                  FX_BOOL bSkip) {
@@ -547,11 +1075,9 @@ bool CPDF_Parser::LoadCrossRefV4(FX_FILESIZE pos,
   if (m_Syntax.GetKeyword() != "xref")
     return false;
 
-  if (!FindPosInOffsets(pos))
-    m_SortedOffset.Add(pos);
-
-  if (streampos && !FindPosInOffsets(streampos))
-      m_SortedOffset.Add(streampos);
+  m_SortedOffset.Add(pos);
+  if (streampos)
+    m_SortedOffset.Add(streampos);
 
   while (1) {
     FX_FILESIZE SavedPos = m_Syntax.SavePos();
@@ -585,7 +1111,7 @@ bool CPDF_Parser::LoadCrossRefV4(FX_FILESIZE pos,
           FX_DWORD objnum = start_objnum + block * 1024 + i;
           char* pEntry = &buf[i * recordsize];
           if (pEntry[17] == 'f') {
-            m_ObjectInfo[objnum].pos = 0;
+            SetObjectPosition(objnum, 0);
             m_V5Type.SetAtGrow(objnum, 0);
           } else {
             FX_FILESIZE offset = (FX_FILESIZE)FXSYS_atoi64(pEntry);
@@ -595,16 +1121,14 @@ bool CPDF_Parser::LoadCrossRefV4(FX_FILESIZE pos,
                   return false;
               }
             }
-            m_ObjectInfo[objnum].pos = offset;
+            SetObjectPosition(objnum, offset);
             int32_t version = FXSYS_atoi(pEntry + 11);
             if (version >= 1) {
               m_bVersionUpdated = TRUE;
             }
             m_ObjVersion.SetAtGrow(objnum, version);
-            if (m_ObjectInfo[objnum].pos < m_Syntax.m_FileLen &&
-                !FindPosInOffsets(m_ObjectInfo[objnum].pos)) {
-              m_SortedOffset.Add(m_ObjectInfo[objnum].pos);
-            }
+            if (offset < m_Syntax.m_FileLen)
+              m_SortedOffset.Add(offset);
             m_V5Type.SetAtGrow(objnum, 1);
           }
         }
@@ -630,392 +1154,345 @@ FX_BOOL CPDF_Parser::LoadAllCrossRefV5(FX_FILESIZE xrefpos) {
       return FALSE;
     }
   }
-  m_ObjectStreamMap.InitHashTable(101, FALSE);
   m_bXRefStream = TRUE;
   return TRUE;
 }
 
-FX_BOOL CPDF_Parser::RebuildCrossRef() {
-  m_ObjectInfo.clear();
-  m_V5Type.RemoveAll();
-  m_SortedOffset.RemoveAll();
-  m_ObjVersion.RemoveAll();
-  if (m_pTrailer) {
-    m_pTrailer->Release();
-    m_pTrailer = NULL;
+// Applies what RebuildCrossRef()'s scan finds to the parser, in file order.
+// Objects the scan of a chunk already parsed are not parsed again, unless
+// that needs the document.
+class CPDF_Parser::CrossRefRebuilder : public CrossRefScanHandler {
+ public:
+  explicit CrossRefRebuilder(CPDF_Parser* pParser)
+      : m_pParser(pParser),
+        m_pChunk(nullptr),
+        m_bMovedBack(false),
+        m_LastObj(-1),
+        m_LastXRef(-1),
+        m_LastTrailer(-1) {
+    // Only the dictionaries and extents of the objects found are needed, so
+    // don't spend time reading and decrypting stream data.
+    FXSYS_memset(&m_Context, 0, sizeof(PARSE_CONTEXT));
+    m_Context.m_Flags = PDFPARSE_NOSTREAMDATA;
+  }
+
+  // Makes OnObject() look for the objects in |pChunk|. Objects that would
+  // send the scan back then set MovedBack() instead.
+  void SetChunk(const CrossRefChunk* pChunk) { m_pChunk = pChunk; }
+  bool MovedBack() const { return m_bMovedBack; }
+
+  // Applies |event|, as found by a chunk's scan. Returns where the scan goes
+  // on after it. For an object that parses differently with the document,
+  // that is not |event.next_pos|.
+  FX_FILESIZE Replay(const CrossRefScanEvent& event) {
+    switch (event.type) {
+      case CrossRefScanEvent::kObject:
+        return AddObject(event.start_pos, event.objnum, event.gennum,
+                         event.pos, event.bReparse ? nullptr : &event);
+      case CrossRefScanEvent::kTrailer:
+        OnTrailer(event.pos);
+        break;
+      case CrossRefScanEvent::kXRef:
+        OnXRef(event.pos);
+        break;
+    }
+    return event.pos;
+  }
+
+  // Adds the end of the last section to the sorted offsets, once the scan
+  // is done. Returns whether a usable cross-reference was found.
+  FX_BOOL Finish() {
+    CPDF_SyntaxParser& syntax = m_pParser->m_Syntax;
+    if (m_LastXRef != -1 && m_LastXRef > m_LastObj) {
+      m_LastTrailer = m_LastXRef;
+    } else if (m_LastTrailer == -1 || m_LastXRef < m_LastObj) {
+      m_LastTrailer = syntax.m_FileLen;
+    }
+    m_pParser->m_SortedOffset.Add(m_LastTrailer - syntax.m_HeaderOffset);
+    return m_pParser->m_pTrailer && !m_pParser->m_ObjectInfo.empty();
+  }
+
+  // CrossRefScanHandler:
+  FX_FILESIZE OnObject(FX_FILESIZE start_pos,
+                       FX_DWORD objnum,
+                       FX_DWORD gennum,
+                       FX_FILESIZE pos) override {
+    const CrossRefScanEvent* pScanned = nullptr;
+    if (m_pChunk) {
+      auto it = std::lower_bound(
+          m_pChunk->events.begin(), m_pChunk->events.end(), pos,
+          [](const CrossRefScanEvent& event, FX_FILESIZE pos) {
+            return event.pos < pos;
+          });
+      if (it != m_pChunk->events.end() && it->pos == pos &&
+          it->type == CrossRefScanEvent::kObject &&
+          it->start_pos == start_pos && it->objnum == objnum &&
+          it->gennum == gennum && !it->bReparse) {
+        pScanned = &*it;
+      }
+    }
+    return AddObject(start_pos, objnum, gennum, pos, pScanned);
   }
-  int32_t status = 0;
-  int32_t inside_index = 0;
-  FX_DWORD objnum = 0;
-  FX_DWORD gennum = 0;
-  int32_t depth = 0;
-  const FX_DWORD kBufferSize = 4096;
-  std::vector<uint8_t> buffer(kBufferSize);
-  FX_FILESIZE pos = m_Syntax.m_HeaderOffset;
-  FX_FILESIZE start_pos = 0;
-  FX_FILESIZE start_pos1 = 0;
-  FX_FILESIZE last_obj = -1;
-  FX_FILESIZE last_xref = -1;
-  FX_FILESIZE last_trailer = -1;
-  while (pos < m_Syntax.m_FileLen) {
-    const FX_FILESIZE saved_pos = pos;
-    bool bOverFlow = false;
-    FX_DWORD size = std::min((FX_DWORD)(m_Syntax.m_FileLen - pos), kBufferSize);
-    if (!m_Syntax.m_pFileAccess->ReadBlock(buffer.data(), pos, size))
-      break;
+  void OnTrailer(FX_FILESIZE pos) override;
+  void OnXRef(FX_FILESIZE pos) override { m_LastXRef = pos - 4; }
 
-    for (FX_DWORD i = 0; i < size; i++) {
-      uint8_t byte = buffer[i];
-      switch (status) {
-        case 0:
-          if (PDFCharIsWhitespace(byte))
-            status = 1;
-
-          if (std::isdigit(byte)) {
-            --i;
-            status = 1;
-          }
-
-          if (byte == '%') {
-            inside_index = 0;
-            status = 9;
-          }
-
-          if (byte == '(') {
-            status = 10;
-            depth = 1;
-          }
+ private:
+  // Adds the object found at |start_pos|, parsing it unless |pScanned|
+  // holds the result already.
+  FX_FILESIZE AddObject(FX_FILESIZE start_pos,
+                        FX_DWORD objnum,
+                        FX_DWORD gennum,
+                        FX_FILESIZE pos,
+                        const CrossRefScanEvent* pScanned);
+
+  CPDF_Parser* const m_pParser;
+  const CrossRefChunk* m_pChunk;
+  bool m_bMovedBack;
+  PARSE_CONTEXT m_Context;
+  FX_FILESIZE m_LastObj;
+  FX_FILESIZE m_LastXRef;
+  FX_FILESIZE m_LastTrailer;
+};
 
-          if (byte == '<') {
-            inside_index = 1;
-            status = 11;
+FX_FILESIZE CPDF_Parser::CrossRefRebuilder::AddObject(
+    FX_FILESIZE start_pos,
+    FX_DWORD objnum,
+    FX_DWORD gennum,
+    FX_FILESIZE pos,
+    const CrossRefScanEvent* pScanned) {
+  CPDF_Parser* pParser = m_pParser;
+  const FX_FILESIZE header_offset = pParser->m_Syntax.m_HeaderOffset;
+  FX_FILESIZE obj_pos = start_pos - header_offset;
+  m_LastObj = start_pos;
+  pParser->m_SortedOffset.Add(obj_pos);
+  FX_FILESIZE next_pos;
+  bool bParsed;
+  if (pScanned) {
+    next_pos = pScanned->next_pos;
+    bParsed = pScanned->bParsed;
+  } else {
+    FX_FILESIZE obj_end = 0;
+    CPDF_Object* pObject = pParser->ParseIndirectObjectAtByStrict(
+        pParser->m_pDocument, obj_pos, objnum, &m_Context, &obj_end);
+    if (CPDF_Stream* pStream = ToStream(pObject)) {
+      if (CPDF_Dictionary* pDict = pStream->GetDict()) {
+        if ((pDict->KeyExist("Type")) &&
+            (pDict->GetString("Type") == "XRef" && pDict->KeyExist("Size"))) {
+          CPDF_Object* pRoot = pDict->GetElement("Root");
+          if (pRoot && pRoot->GetDict() &&
+              pRoot->GetDict()->GetElement("Pages")) {
+            if (pParser->m_pTrailer)
+              pParser->m_pTrailer->Release();
+            pParser->m_pTrailer = ToDictionary(pDict->Clone());
           }
+        }
+      }
+    }
+    next_pos = obj_end + header_offset;
+    if (m_pChunk && next_pos < pos) {
+      m_bMovedBack = true;
+      next_pos = pos;
+    }
+    bParsed = !!pObject;
+    if (pObject)
+      pObject->Release();
+  }
+  if (pParser->IsValidObjectNumber(objnum) &&
+      pParser->m_ObjectInfo[objnum].pos) {
+    if (bParsed) {
+      FX_DWORD oldgen = pParser->m_ObjVersion.GetAt(objnum);
+      pParser->m_ObjectInfo[objnum].pos = obj_pos;
+      pParser->m_ObjVersion.SetAt(objnum, (int16_t)gennum);
+      if (oldgen != gennum) {
+        pParser->m_bVersionUpdated = TRUE;
+      }
+    }
+  } else {
+    pParser->SetObjectPosition(objnum, obj_pos);
+    pParser->m_V5Type.SetAtGrow(objnum, 1);
+    pParser->m_ObjVersion.SetAtGrow(objnum, (int16_t)gennum);
+  }
+  return next_pos;
+}
 
-          if (byte == '\\')
-            status = 13;
+void CPDF_Parser::CrossRefRebuilder::OnTrailer(FX_FILESIZE pos) {
+  CPDF_Parser* pParser = m_pParser;
+  CPDF_SyntaxParser& syntax = pParser->m_Syntax;
+  m_LastTrailer = pos - 7;
+  syntax.RestorePos(pos - syntax.m_HeaderOffset);
+  CPDF_Object* pObj =
+      syntax.GetObject(pParser->m_pDocument, 0, 0, nullptr, true);
+  if (!pObj)
+    return;
+  if (!pObj->IsDictionary() && !pObj->AsStream()) {
+    pObj->Release();
+    return;
+  }
+  CPDF_Stream* pStream = pObj->AsStream();
+  CPDF_Dictionary* pTrailer =
+      pStream ? pStream->GetDict() : pObj->AsDictionary();
+  if (!pTrailer) {
+    pObj->Release();
+    return;
+  }
+  if (pParser->m_pTrailer) {
+    CPDF_Object* pRoot = pTrailer->GetElement("Root");
+    CPDF_Reference* pRef = ToReference(pRoot);
+    if (!pRoot ||
+        (pRef && pParser->IsValidObjectNumber(pRef->GetRefObjNum()) &&
+         pParser->m_ObjectInfo[pRef->GetRefObjNum()].pos != 0)) {
+      auto it = pTrailer->begin();
+      while (it != pTrailer->end()) {
+        const CFX_ByteString& key = it->first;
+        CPDF_Object* pElement = it->second;
+        ++it;
+        FX_DWORD dwObjNum = pElement ? pElement->GetObjNum() : 0;
+        if (dwObjNum) {
+          pParser->m_pTrailer->SetAtReference(key, pParser->m_pDocument,
+                                              dwObjNum);
+        } else {
+          pParser->m_pTrailer->SetAt(key, pElement->Clone());
+        }
+      }
+    }
+    pObj->Release();
+    return;
+  }
+  if (pObj->IsStream()) {
+    pParser->m_pTrailer = ToDictionary(pTrailer->Clone());
+    pObj->Release();
+  } else {
+    pParser->m_pTrailer = pTrailer;
+  }
+  FX_FILESIZE dwSavePos = syntax.SavePos();
+  CFX_ByteString strWord = syntax.GetKeyword();
+  if (!strWord.Compare("startxref")) {
+    bool bNumber;
+    CFX_ByteString bsOffset = syntax.GetNextWord(&bNumber);
+    if (bNumber) {
+      pParser->m_LastXRefOffset = FXSYS_atoi(bsOffset);
+    }
+  }
+  syntax.RestorePos(dwSavePos);
+}
 
-          if (byte == 't') {
-            status = 7;
-            inside_index = 1;
-          }
-          break;
-        case 1:
-          if (PDFCharIsWhitespace(byte)) {
-            break;
-          } else if (std::isdigit(byte)) {
-            start_pos = pos + i;
-            status = 2;
-            objnum = FXSYS_toDecimalDigit(byte);
-          } else if (byte == 't') {
-            status = 7;
-            inside_index = 1;
-          } else if (byte == 'x') {
-            status = 8;
-            inside_index = 1;
-          } else {
-            --i;
-            status = 0;
-          }
-          break;
-        case 2:
-          if (std::isdigit(byte)) {
-            objnum = objnum * 10 + FXSYS_toDecimalDigit(byte);
-            break;
-          } else if (PDFCharIsWhitespace(byte)) {
-            status = 3;
-          } else {
-            --i;
-            status = 14;
-            inside_index = 0;
-          }
-          break;
-        case 3:
-          if (std::isdigit(byte)) {
-            start_pos1 = pos + i;
-            status = 4;
-            gennum = FXSYS_toDecimalDigit(byte);
-          } else if (PDFCharIsWhitespace(byte)) {
-            break;
-          } else if (byte == 't') {
-            status = 7;
-            inside_index = 1;
-          } else {
-            --i;
-            status = 0;
-          }
-          break;
-        case 4:
-          if (std::isdigit(byte)) {
-            gennum = gennum * 10 + FXSYS_toDecimalDigit(byte);
-            break;
-          } else if (PDFCharIsWhitespace(byte)) {
-            status = 5;
-          } else {
-            --i;
-            status = 0;
-          }
-          break;
-        case 5:
-          if (byte == 'o') {
-            status = 6;
-            inside_index = 1;
-          } else if (PDFCharIsWhitespace(byte)) {
+FX_BOOL CPDF_Parser::RebuildCrossRef() {
+  ScopedObjectPoolSuspension suspend_pool(m_pDocument);
+  const FX_BOOL bVersionUpdated = m_bVersionUpdated;
+  const FX_FILESIZE last_xref_offset = m_LastXRefOffset;
+  auto reset = [&]() {
+    m_ObjectInfo.clear();
+    m_V5Type.RemoveAll();
+    m_SortedOffset.RemoveAll();
+    m_ObjVersion.RemoveAll();
+    if (m_pTrailer) {
+      m_pTrailer->Release();
+      m_pTrailer = NULL;
+    }
+    m_bVersionUpdated = bVersionUpdated;
+    m_LastXRefOffset = last_xref_offset;
+  };
+  reset();
+  IFX_FileRead* pFile = m_Syntax.m_pFileAccess;
+  const uint8_t* pFileData = m_Syntax.m_pFileData;
+  const FX_FILESIZE file_len = m_Syntax.m_FileLen;
+  FX_FILESIZE pos = m_Syntax.m_HeaderOffset;
+  auto scan_serially = [&]() {
+    CrossRefRebuilder rebuilder(this);
+    CrossRefScanState state;
+    ScanForCrossRef(pFile, pFileData, file_len, m_Syntax.m_HeaderOffset,
+                    file_len, &state, &rebuilder);
+    return rebuilder.Finish();
+  };
+
+  // Large files are split into chunks that are scanned at once, each from
+  // its start in the initial state. Objects parsed on other threads have no
+  // document to decrypt them with.
+  int nChunks = (int)std::min<FX_FILESIZE>(
+      m_nRebuildThreads, (file_len - pos) / kMinCrossRefChunkSize);
+  if (nChunks <= 1 || m_Syntax.m_pCryptoHandler)
+    return scan_serially();
+
+  std::vector<CrossRefChunk> chunks(nChunks);
+  {
+    std::unique_ptr<IFX_FileRead, ReleaseDeleter<IFX_FileRead>> pSharedFile(
+        new CPDF_SharedFileRead(pFile, FALSE));
+    auto scan_chunk = [&](CrossRefChunk* pChunk) {
+      CrossRefChunkScanner scanner(pSharedFile.get(), m_Syntax.m_HeaderOffset,
+                                   pChunk);
+      pChunk->sync_points.push_back(std::make_pair(pChunk->start, (size_t)0));
+      pChunk->stop_pos =
+          ScanForCrossRef(pSharedFile.get(), pFileData, file_len,
+                          pChunk->start, pChunk->end, &pChunk->stop_state,
+                          &scanner);
+    };
+    for (int i = 0; i < nChunks; ++i) {
+      chunks[i].start = pos + (file_len - pos) * i / nChunks;
+      chunks[i].end = pos + (file_len - pos) * (i + 1) / nChunks;
+    }
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nChunks; ++i)
+      threads.push_back(std::thread(scan_chunk, &chunks[i]));
+    scan_chunk(&chunks[0]);
+    for (std::thread& thread : threads)
+      thread.join();
+  }
+
+  CrossRefRebuilder rebuilder(this);
+  CrossRefScanState state;
+  bool bMovedBack = false;
+  for (const CrossRefChunk& chunk : chunks)
+    bMovedBack = bMovedBack || chunk.bMovedBack;
+
+  // Follow the scan from the start of the file through the chunks. Where it
+  // meets a chunk's scan in the initial state, the two find the same things
+  // from there on, so take what the chunk's scan found. Elsewhere, scan
+  // again, still taking the objects the chunk's scan parsed.
+  size_t index = 0;
+  while (!bMovedBack && pos >= 0 && pos < file_len) {
+    while (chunks[index].end <= pos)
+      ++index;
+    const CrossRefChunk& chunk = chunks[index];
+    rebuilder.SetChunk(&chunk);
+    auto sync = std::lower_bound(chunk.sync_points.begin(),
+                                 chunk.sync_points.end(),
+                                 std::make_pair(pos, (size_t)0));
+    if (sync != chunk.sync_points.end() && sync->first == pos) {
+      if (state.status == 0 && chunk.stop_pos >= 0) {
+        size_t i = sync->second;
+        for (; i < chunk.events.size(); ++i) {
+          const CrossRefScanEvent& event = chunk.events[i];
+          pos = rebuilder.Replay(event);
+          if (event.type == CrossRefScanEvent::kObject &&
+              pos != event.next_pos) {
             break;
-          } else if (std::isdigit(byte)) {
-            objnum = gennum;
-            gennum = FXSYS_toDecimalDigit(byte);
-            start_pos = start_pos1;
-            start_pos1 = pos + i;
-            status = 4;
-          } else if (byte == 't') {
-            status = 7;
-            inside_index = 1;
-          } else {
-            --i;
-            status = 0;
-          }
-          break;
-        case 6:
-          switch (inside_index) {
-            case 1:
-              if (byte != 'b') {
-                --i;
-                status = 0;
-              } else {
-                inside_index++;
-              }
-              break;
-            case 2:
-              if (byte != 'j') {
-                --i;
-                status = 0;
-              } else {
-                inside_index++;
-              }
-              break;
-            case 3:
-              if (PDFCharIsWhitespace(byte) || PDFCharIsDelimiter(byte)) {
-                if (objnum > 0x1000000) {
-                  status = 0;
-                  break;
-                }
-                FX_FILESIZE obj_pos = start_pos - m_Syntax.m_HeaderOffset;
-                last_obj = start_pos;
-                void* pResult =
-                    FXSYS_bsearch(&obj_pos, m_SortedOffset.GetData(),
-                                  m_SortedOffset.GetSize(), sizeof(FX_FILESIZE),
-                                  CompareFileSize);
-                if (!pResult) {
-                  m_SortedOffset.Add(obj_pos);
-                }
-                FX_FILESIZE obj_end = 0;
-                CPDF_Object* pObject = ParseIndirectObjectAtByStrict(
-                    m_pDocument, obj_pos, objnum, NULL, &obj_end);
-                if (CPDF_Stream* pStream = ToStream(pObject)) {
-                  if (CPDF_Dictionary* pDict = pStream->GetDict()) {
-                    if ((pDict->KeyExist("Type")) &&
-                        (pDict->GetString("Type") == "XRef" &&
-                         pDict->KeyExist("Size"))) {
-                      CPDF_Object* pRoot = pDict->GetElement("Root");
-                      if (pRoot && pRoot->GetDict() &&
-                          pRoot->GetDict()->GetElement("Pages")) {
-                        if (m_pTrailer)
-                          m_pTrailer->Release();
-                        m_pTrailer = ToDictionary(pDict->Clone());
-                        }
-                      }
-                  }
-                }
-                FX_FILESIZE offset = 0;
-                m_Syntax.RestorePos(obj_pos);
-                offset = m_Syntax.FindTag("obj", 0);
-                if (offset == -1) {
-                  offset = 0;
-                } else {
-                  offset += 3;
-                }
-                FX_FILESIZE nLen = obj_end - obj_pos - offset;
-                if ((FX_DWORD)nLen > size - i) {
-                  pos = obj_end + m_Syntax.m_HeaderOffset;
-                  bOverFlow = true;
-                } else {
-                  i += (FX_DWORD)nLen;
-                }
-                if (!m_ObjectInfo.empty() && IsValidObjectNumber(objnum) &&
-                    m_ObjectInfo[objnum].pos) {
-                  if (pObject) {
-                    FX_DWORD oldgen = m_ObjVersion.GetAt(objnum);
-                    m_ObjectInfo[objnum].pos = obj_pos;
-                    m_ObjVersion.SetAt(objnum, (int16_t)gennum);
-                    if (oldgen != gennum) {
-                      m_bVersionUpdated = TRUE;
-                    }
-                  }
-                } else {
-                  m_ObjectInfo[objnum].pos = obj_pos;
-                  m_V5Type.SetAtGrow(objnum, 1);
-                  m_ObjVersion.SetAtGrow(objnum, (int16_t)gennum);
-                }
-                if (pObject) {
-                  pObject->Release();
-                }
-              }
-              --i;
-              status = 0;
-              break;
-          }
-          break;
-        case 7:
-          if (inside_index == 7) {
-            if (PDFCharIsWhitespace(byte) || PDFCharIsDelimiter(byte)) {
-              last_trailer = pos + i - 7;
-              m_Syntax.RestorePos(pos + i - m_Syntax.m_HeaderOffset);
-              CPDF_Object* pObj =
-                  m_Syntax.GetObject(m_pDocument, 0, 0, nullptr, true);
-              if (pObj) {
-                if (!pObj->IsDictionary() && !pObj->AsStream()) {
-                  pObj->Release();
-                } else {
-                  CPDF_Stream* pStream = pObj->AsStream();
-                  if (CPDF_Dictionary* pTrailer =
-                          pStream ? pStream->GetDict() : pObj->AsDictionary()) {
-                    if (m_pTrailer) {
-                      CPDF_Object* pRoot = pTrailer->GetElement("Root");
-                      CPDF_Reference* pRef = ToReference(pRoot);
-                      if (!pRoot ||
-                          (pRef && IsValidObjectNumber(pRef->GetRefObjNum()) &&
-                           m_ObjectInfo[pRef->GetRefObjNum()].pos != 0)) {
-                        auto it = pTrailer->begin();
-                        while (it != pTrailer->end()) {
-                          const CFX_ByteString& key = it->first;
-                          CPDF_Object* pElement = it->second;
-                          ++it;
-                          FX_DWORD dwObjNum =
-                              pElement ? pElement->GetObjNum() : 0;
-                          if (dwObjNum) {
-                            m_pTrailer->SetAtReference(key, m_pDocument,
-                                                       dwObjNum);
-                          } else {
-                            m_pTrailer->SetAt(key, pElement->Clone());
-                          }
-                        }
-                        pObj->Release();
-                      } else {
-                        pObj->Release();
-                      }
-                    } else {
-                      if (pObj->IsStream()) {
-                        m_pTrailer = ToDictionary(pTrailer->Clone());
-                        pObj->Release();
-                      } else {
-                        m_pTrailer = pTrailer;
-                      }
-                      FX_FILESIZE dwSavePos = m_Syntax.SavePos();
-                      CFX_ByteString strWord = m_Syntax.GetKeyword();
-                      if (!strWord.Compare("startxref")) {
-                        bool bNumber;
-                        CFX_ByteString bsOffset =
-                            m_Syntax.GetNextWord(&bNumber);
-                        if (bNumber) {
-                          m_LastXRefOffset = FXSYS_atoi(bsOffset);
-                        }
-                      }
-                      m_Syntax.RestorePos(dwSavePos);
-                    }
-                  } else {
-                    pObj->Release();
-                  }
-                }
-              }
-            }
-            --i;
-            status = 0;
-          } else if (byte == "trailer"[inside_index]) {
-            inside_index++;
-          } else {
-            --i;
-            status = 0;
-          }
-          break;
-        case 8:
-          if (inside_index == 4) {
-            last_xref = pos + i - 4;
-            status = 1;
-          } else if (byte == "xref"[inside_index]) {
-            inside_index++;
-          } else {
-            --i;
-            status = 0;
-          }
-          break;
-        case 9:
-          if (byte == '\r' || byte == '\n') {
-            status = 0;
-          }
-          break;
-        case 10:
-          if (byte == ')') {
-            if (depth > 0) {
-              depth--;
-            }
-          } else if (byte == '(') {
-            depth++;
-          }
-          if (!depth) {
-            status = 0;
-          }
-          break;
-        case 11:
-          if (byte == '>' || (byte == '<' && inside_index == 1))
-            status = 0;
-          inside_index = 0;
-          break;
-        case 13:
-          if (PDFCharIsDelimiter(byte) || PDFCharIsWhitespace(byte)) {
-            --i;
-            status = 0;
-          }
-          break;
-        case 14:
-          if (PDFCharIsWhitespace(byte)) {
-            status = 0;
-          } else if (byte == '%' || byte == '(' || byte == '<' ||
-                     byte == '\\') {
-            status = 0;
-            --i;
-          } else if (inside_index == 6) {
-            status = 0;
-            --i;
-          } else if (byte == "endobj"[inside_index]) {
-            inside_index++;
           }
-          break;
-      }
-      if (bOverFlow) {
-        size = 0;
-        break;
+        }
+        bMovedBack = rebuilder.MovedBack();
+        if (i == chunk.events.size()) {
+          pos = chunk.stop_pos;
+          state = chunk.stop_state;
+        } else {
+          state = CrossRefScanState();
+        }
+        continue;
       }
+      ++sync;
     }
-    pos += size;
-
-    // If the position has not changed at all in a loop iteration, then break
-    // out to prevent infinite looping.
-    if (pos == saved_pos)
-      break;
+    FX_FILESIZE stop = chunk.end;
+    if (sync != chunk.sync_points.end())
+      stop = std::min(stop, sync->first);
+    pos = ScanForCrossRef(pFile, pFileData, file_len, pos, stop, &state,
+                          &rebuilder);
+    bMovedBack = rebuilder.MovedBack();
   }
-  if (last_xref != -1 && last_xref > last_obj) {
-    last_trailer = last_xref;
-  } else if (last_trailer == -1 || last_xref < last_obj) {
-    last_trailer = m_Syntax.m_FileLen;
-  }
-  FX_FILESIZE offset = last_trailer - m_Syntax.m_HeaderOffset;
-  void* pResult =
-      FXSYS_bsearch(&offset, m_SortedOffset.GetData(), m_SortedOffset.GetSize(),
-                    sizeof(FX_FILESIZE), CompareFileSize);
-  if (!pResult) {
-    m_SortedOffset.Add(offset);
+  // The serial scan goes back where an object's header fails to parse, and
+  // may take a different path from there, so do that scan instead.
+  if (bMovedBack) {
+    reset();
+    return scan_serially();
   }
-  return m_pTrailer && !m_ObjectInfo.empty();
+  return rebuilder.Finish();
 }
 
 FX_BOOL CPDF_Parser::LoadCrossRefV5(FX_FILESIZE* pos, FX_BOOL bMainXRef) {
@@ -1041,7 +1518,7 @@ FX_BOOL CPDF_Parser::LoadCrossRefV5(FX_FILESIZE* pos, FX_BOOL bMainXRef) {
 
   *pos = pStream->GetDict()->GetInteger("Prev");
   int32_t size = pStream->GetDict()->GetInteger("Size");
-  if (size < 0) {
+  if (size < 0 || size > kMaxXRefSize) {
     pStream->Release();
     return FALSE;
   }
@@ -1127,13 +1604,8 @@ FX_BOOL CPDF_Parser::LoadCrossRefV5(FX_FILESIZE* pos, FX_BOOL bMainXRef) {
       if (m_V5Type[startnum + j] == 255) {
         FX_FILESIZE offset =
             GetVarInt(entrystart + WidthArray[0], WidthArray[1]);
-        m_ObjectInfo[startnum + j].pos = offset;
-        void* pResult = FXSYS_bsearch(&offset, m_SortedOffset.GetData(),
-                                      m_SortedOffset.GetSize(),
-                                      sizeof(FX_FILESIZE), CompareFileSize);
-        if (!pResult) {
-          m_SortedOffset.Add(offset);
-        }
+        SetObjectPosition(startnum + j, offset);
+        m_SortedOffset.Add(offset);
         continue;
       }
       if (m_V5Type[startnum + j]) {
@@ -1141,18 +1613,13 @@ FX_BOOL CPDF_Parser::LoadCrossRefV5(FX_FILESIZE* pos, FX_BOOL bMainXRef) {
       }
       m_V5Type[startnum + j] = type;
       if (type == 0) {
-        m_ObjectInfo[startnum + j].pos = 0;
+        SetObjectPosition(startnum + j, 0);
       } else {
         FX_FILESIZE offset =
             GetVarInt(entrystart + WidthArray[0], WidthArray[1]);
-        m_ObjectInfo[startnum + j].pos = offset;
+        SetObjectPosition(startnum + j, offset);
         if (type == 1) {
-          void* pResult = FXSYS_bsearch(&offset, m_SortedOffset.GetData(),
-                                        m_SortedOffset.GetSize(),
-                                        sizeof(FX_FILESIZE), CompareFileSize);
-          if (!pResult) {
-            m_SortedOffset.Add(offset);
-          }
+          m_SortedOffset.Add(offset);
         } else {
           if (offset < 0 || offset >= m_V5Type.GetSize()) {
             pStream->Release();
@@ -1238,47 +1705,89 @@ CPDF_Object* CPDF_Parser::ParseIndirectObject(
   if (m_V5Type[objnum] != 2)
     return nullptr;
 
-  CPDF_StreamAcc* pObjStream = GetObjectStream(m_ObjectInfo[objnum].pos);
+  const ObjectStream* pObjStream = GetObjectStream(m_ObjectInfo[objnum].pos);
   if (!pObjStream)
     return nullptr;
 
-  ScopedFileStream file(FX_CreateMemoryStream(
-      (uint8_t*)pObjStream->GetData(), (size_t)pObjStream->GetSize(), FALSE));
+  const auto it = pObjStream->offsets.find(objnum);
+  if (it == pObjStream->offsets.end())
+    return nullptr;
+
+  ScopedFileStream file(
+      FX_CreateMemoryStream((uint8_t*)pObjStream->pAcc->GetData(),
+                            (size_t)pObjStream->pAcc->GetSize(), FALSE));
   CPDF_SyntaxParser syntax;
   syntax.InitParser(file.get(), 0);
-  const int32_t offset = GetStreamFirst(pObjStream);
+  syntax.RestorePos(pObjStream->first + it->second);
+  return syntax.GetObject(pObjList, 0, 0, pContext, true);
+}
 
-  // Read object numbers from |pObjStream| into a cache.
-  if (!pdfium::ContainsKey(m_ObjCache, pObjStream)) {
-    for (int32_t i = GetStreamNCount(pObjStream); i > 0; --i) {
-      FX_DWORD thisnum = syntax.GetDirectNum();
-      FX_DWORD thisoff = syntax.GetDirectNum();
-      m_ObjCache[pObjStream][thisnum] = thisoff;
-    }
-  }
+CPDF_Parser::ObjectStream::ObjectStream() : first(0) {}
 
-  const auto it = m_ObjCache[pObjStream].find(objnum);
-  if (it == m_ObjCache[pObjStream].end())
-    return nullptr;
+CPDF_Parser::ObjectStream::~ObjectStream() {}
 
-  syntax.RestorePos(offset + it->second);
-  return syntax.GetObject(pObjList, 0, 0, pContext, true);
+void CPDF_Parser::ReleaseObjectStreams() {
+  m_ObjectStreams.clear();
+  m_ObjectStreamLRU.clear();
+  m_dwObjStreamSize = 0;
+}
+
+void CPDF_Parser::SetObjectStreamCacheLimit(FX_DWORD size) {
+  m_dwObjStreamLimit = size;
+  TrimObjectStreams(0);
 }
 
-CPDF_StreamAcc* CPDF_Parser::GetObjectStream(FX_DWORD objnum) {
-  CPDF_StreamAcc* pStreamAcc = nullptr;
-  if (m_ObjectStreamMap.Lookup((void*)(uintptr_t)objnum, (void*&)pStreamAcc))
-    return pStreamAcc;
+void CPDF_Parser::TrimObjectStreams(FX_DWORD keep) {
+  // Never drop the most recently used stream; callers may still read from it.
+  while (m_dwObjStreamSize + keep > m_dwObjStreamLimit &&
+         m_ObjectStreamLRU.size() > (keep ? 0u : 1u)) {
+    auto it = m_ObjectStreams.find(m_ObjectStreamLRU.back());
+    m_dwObjStreamSize -= it->second.pAcc->GetSize();
+    m_ObjectStreamLRU.pop_back();
+    m_ObjectStreams.erase(it);
+  }
+}
+
+const CPDF_Parser::ObjectStream* CPDF_Parser::GetObjectStream(
+    FX_DWORD objnum) {
+  auto it = m_ObjectStreams.find(objnum);
+  if (it != m_ObjectStreams.end()) {
+    m_ObjectStreamLRU.splice(m_ObjectStreamLRU.begin(), m_ObjectStreamLRU,
+                             it->second.lru_pos);
+    return &it->second;
+  }
 
   const CPDF_Stream* pStream = ToStream(
       m_pDocument ? m_pDocument->GetIndirectObject(objnum, nullptr) : nullptr);
   if (!pStream)
     return nullptr;
 
-  pStreamAcc = new CPDF_StreamAcc;
-  pStreamAcc->LoadAllData(pStream);
-  m_ObjectStreamMap.SetAt((void*)(uintptr_t)objnum, pStreamAcc);
-  return pStreamAcc;
+  std::unique_ptr<CPDF_StreamAcc> pAcc(new CPDF_StreamAcc);
+  pAcc->LoadAllData(pStream);
+  TrimObjectStreams(pAcc->GetSize());
+
+  ObjectStream& entry = m_ObjectStreams[objnum];
+  entry.pAcc = std::move(pAcc);
+  entry.first = GetStreamFirst(entry.pAcc.get());
+
+  // Index the object number and offset pairs at the start of the stream.
+  ScopedFileStream file(
+      FX_CreateMemoryStream((uint8_t*)entry.pAcc->GetData(),
+                            (size_t)entry.pAcc->GetSize(), FALSE));
+  CPDF_SyntaxParser syntax;
+  syntax.InitParser(file.get(), 0);
+  for (int32_t i = GetStreamNCount(entry.pAcc.get()); i > 0; --i) {
+    FX_DWORD thisnum = syntax.GetDirectNum();
+    FX_DWORD thisoff = syntax.GetDirectNum();
+    entry.offsets.insert(std::make_pair(thisnum, thisoff));
+    entry.sorted_offsets.push_back(thisoff);
+  }
+  std::sort(entry.sorted_offsets.begin(), entry.sorted_offsets.end());
+
+  m_ObjectStreamLRU.push_front(objnum);
+  entry.lru_pos = m_ObjectStreamLRU.begin();
+  m_dwObjStreamSize += entry.pAcc->GetSize();
+  return &entry;
 }
 
 FX_FILESIZE CPDF_Parser::GetObjectSize(FX_DWORD objnum) const {
@@ -1316,34 +1825,34 @@ void CPDF_Parser::GetIndirectBinary(FX_DWORD objnum,
     return;
 
   if (m_V5Type[objnum] == 2) {
-    CPDF_StreamAcc* pObjStream = GetObjectStream(m_ObjectInfo[objnum].pos);
+    const ObjectStream* pObjStream = GetObjectStream(m_ObjectInfo[objnum].pos);
     if (!pObjStream)
       return;
 
-    int32_t offset = GetStreamFirst(pObjStream);
-    const uint8_t* pData = pObjStream->GetData();
-    FX_DWORD totalsize = pObjStream->GetSize();
-    ScopedFileStream file(
-        FX_CreateMemoryStream((uint8_t*)pData, (size_t)totalsize, FALSE));
-    CPDF_SyntaxParser syntax;
-    syntax.InitParser(file.get(), 0);
-    for (int i = GetStreamNCount(pObjStream); i > 0; --i) {
-      FX_DWORD thisnum = syntax.GetDirectNum();
-      FX_DWORD thisoff = syntax.GetDirectNum();
-      if (thisnum != objnum)
-        continue;
+    const auto it = pObjStream->offsets.find(objnum);
+    if (it == pObjStream->offsets.end())
+      return;
 
-      if (i == 1) {
-        size = totalsize - (thisoff + offset);
-      } else {
-        syntax.GetDirectNum();  // Skip nextnum.
-        FX_DWORD nextoff = syntax.GetDirectNum();
-        size = nextoff - thisoff;
-      }
-      pBuffer = FX_Alloc(uint8_t, size);
-      FXSYS_memcpy(pBuffer, pData + thisoff + offset, size);
+    // The object runs up to the next one in the stream, or to its end.
+    FX_DWORD totalsize = pObjStream->pAcc->GetSize();
+    FX_DWORD thisoff = it->second;
+    auto next = std::upper_bound(pObjStream->sorted_offsets.begin(),
+                                 pObjStream->sorted_offsets.end(), thisoff);
+    FX_SAFE_DWORD start = pObjStream->first;
+    start += thisoff;
+    FX_SAFE_DWORD end = totalsize;
+    if (next != pObjStream->sorted_offsets.end()) {
+      end = pObjStream->first;
+      end += *next;
+    }
+    if (!start.IsValid() || !end.IsValid() ||
+        start.ValueOrDie() > end.ValueOrDie() || end.ValueOrDie() > totalsize) {
       return;
     }
+    size = end.ValueOrDie() - start.ValueOrDie();
+    pBuffer = FX_Alloc(uint8_t, size);
+    FXSYS_memcpy(pBuffer, pObjStream->pAcc->GetData() + start.ValueOrDie(),
+                 size);
     return;
   }
 
@@ -1467,36 +1976,8 @@ CPDF_Object* CPDF_Parser::ParseIndirectObjectAtByStrict(
     FX_DWORD objnum,
     PARSE_CONTEXT* pContext,
     FX_FILESIZE* pResultPos) {
-  FX_FILESIZE SavedPos = m_Syntax.SavePos();
-  m_Syntax.RestorePos(pos);
-  bool bIsNumber;
-  CFX_ByteString word = m_Syntax.GetNextWord(&bIsNumber);
-  if (!bIsNumber) {
-    m_Syntax.RestorePos(SavedPos);
-    return NULL;
-  }
-  FX_DWORD parser_objnum = FXSYS_atoi(word);
-  if (objnum && parser_objnum != objnum) {
-    m_Syntax.RestorePos(SavedPos);
-    return NULL;
-  }
-  word = m_Syntax.GetNextWord(&bIsNumber);
-  if (!bIsNumber) {
-    m_Syntax.RestorePos(SavedPos);
-    return NULL;
-  }
-  FX_DWORD gennum = FXSYS_atoi(word);
-  if (m_Syntax.GetKeyword() != "obj") {
-    m_Syntax.RestorePos(SavedPos);
-    return NULL;
-  }
-  CPDF_Object* pObj =
-      m_Syntax.GetObjectByStrict(pObjList, objnum, gennum, pContext);
-  if (pResultPos) {
-    *pResultPos = m_Syntax.m_Pos;
-  }
-  m_Syntax.RestorePos(SavedPos);
-  return pObj;
+  return ParseObjectAtByStrict(&m_Syntax, pObjList, pos, objnum, pContext,
+                               pResultPos);
 }
 
 CPDF_Dictionary* CPDF_Parser::LoadTrailerV4() {
@@ -1605,6 +2086,8 @@ FX_DWORD CPDF_Parser::StartAsynParse(IFX_FileRead* pFileAccess,
   }
   if (!bReParse) {
     m_pDocument = new CPDF_Document(this);
+    if (m_bUseObjectPool)
+      m_pDocument->EnableObjectPool();
   }
   FX_FILESIZE dwFirstXRefOffset = m_Syntax.SavePos();
   FX_BOOL bXRefRebuilt = FALSE;
@@ -1624,7 +2107,7 @@ FX_DWORD CPDF_Parser::StartAsynParse(IFX_FileRead* pFileAccess,
     }
 
     int32_t xrefsize = GetDirectInteger(m_pTrailer, "Size");
-    if (xrefsize > 0) {
+    if (xrefsize > 0 && xrefsize <= kMaxXRefSize) {
       ShrinkObjectMap(xrefsize);
       m_V5Type.SetSize(xrefsize);
     }
@@ -1651,8 +2134,7 @@ FX_DWORD CPDF_Parser::StartAsynParse(IFX_FileRead* pFileAccess,
       return PDFPARSE_ERROR_FORMAT;
     }
   }
-  FXSYS_qsort(m_SortedOffset.GetData(), m_SortedOffset.GetSize(),
-              sizeof(FX_FILESIZE), CompareFileSize);
+  SortOffsets();
   if (GetRootObjNum() == 0) {
     ReleaseEncryptHandler();
     if (!RebuildCrossRef() || GetRootObjNum() == 0)
@@ -1685,7 +2167,6 @@ FX_BOOL CPDF_Parser::LoadLinearizedAllCrossRefV5(FX_FILESIZE xrefpos) {
       return FALSE;
     }
   }
-  m_ObjectStreamMap.InitHashTable(101, FALSE);
   m_bXRefStream = TRUE;
   return TRUE;
 }
@@ -1709,15 +2190,7 @@ FX_DWORD CPDF_Parser::LoadLinearizedMainXRefTable() {
     m_Syntax.GetNextChar(ch);
   }
   m_LastXRefOffset += dwCount;
-  FX_POSITION pos = m_ObjectStreamMap.GetStartPosition();
-  while (pos) {
-    void* objnum;
-    CPDF_StreamAcc* pStream;
-    m_ObjectStreamMap.GetNextAssoc(pos, objnum, (void*&)pStream);
-    delete pStream;
-  }
-  m_ObjectStreamMap.RemoveAll();
-  m_ObjCache.clear();
+  ReleaseObjectStreams();
 
   if (!LoadLinearizedAllCrossRefV4(m_LastXRefOffset, m_dwXrefStartObjNum) &&
       !LoadLinearizedAllCrossRefV5(m_LastXRefOffset)) {
@@ -1725,20 +2198,19 @@ FX_DWORD CPDF_Parser::LoadLinearizedMainXRefTable() {
     m_Syntax.m_MetadataObjnum = dwSaveMetadataObjnum;
     return PDFPARSE_ERROR_FORMAT;
   }
-  FXSYS_qsort(m_SortedOffset.GetData(), m_SortedOffset.GetSize(),
-              sizeof(FX_FILESIZE), CompareFileSize);
+  SortOffsets();
   m_Syntax.m_MetadataObjnum = dwSaveMetadataObjnum;
   return PDFPARSE_ERROR_SUCCESS;
 }
 
 // static
-int CPDF_SyntaxParser::s_CurrentRecursionDepth = 0;
+thread_local int CPDF_SyntaxParser::s_CurrentRecursionDepth = 0;
 
 CPDF_SyntaxParser::CPDF_SyntaxParser() {
   m_pFileAccess = NULL;
   m_pFileBuf = NULL;
+  m_pFileData = NULL;
   m_BufSize = CPDF_ModuleMgr::kFileBufSize;
-  m_pFileBuf = NULL;
   m_MetadataObjnum = 0;
   m_dwWordPos = 0;
   m_bFileStream = FALSE;
@@ -1759,6 +2231,14 @@ FX_BOOL CPDF_SyntaxParser::GetNextChar(uint8_t& ch) {
   if (pos >= m_FileLen) {
     return FALSE;
   }
+  if (m_pFileData) {
+    if (pos < 0) {
+      return FALSE;
+    }
+    ch = m_pFileData[pos];
+    m_Pos++;
+    return TRUE;
+  }
   if (m_BufOffset >= pos || (FX_FILESIZE)(m_BufOffset + m_BufSize) <= pos) {
     FX_FILESIZE read_pos = pos;
     FX_DWORD read_size = m_BufSize;
@@ -1787,6 +2267,13 @@ FX_BOOL CPDF_SyntaxParser::GetCharAtBackward(FX_FILESIZE pos, uint8_t& ch) {
   if (pos >= m_FileLen) {
     return FALSE;
   }
+  if (m_pFileData) {
+    if (pos < 0) {
+      return FALSE;
+    }
+    ch = m_pFileData[pos];
+    return TRUE;
+  }
   if (m_BufOffset >= pos || (FX_FILESIZE)(m_BufOffset + m_BufSize) <= pos) {
     FX_FILESIZE read_pos;
     if (pos < (FX_FILESIZE)m_BufSize) {
@@ -1812,6 +2299,15 @@ FX_BOOL CPDF_SyntaxParser::GetCharAtBackward(FX_FILESIZE pos, uint8_t& ch) {
   return TRUE;
 }
 FX_BOOL CPDF_SyntaxParser::ReadBlock(uint8_t* pBuf, FX_DWORD size) {
+  if (m_pFileData) {
+    FX_FILESIZE pos = m_Pos + m_HeaderOffset;
+    if (pos < 0 || pos > m_FileLen || (FX_FILESIZE)size > m_FileLen - pos) {
+      return FALSE;
+    }
+    FXSYS_memcpy(pBuf, m_pFileData + pos, size);
+    m_Pos += size;
+    return TRUE;
+  }
   if (!m_pFileAccess->ReadBlock(pBuf, m_Pos + m_HeaderOffset, size)) {
     return FALSE;
   }
@@ -1819,6 +2315,45 @@ FX_BOOL CPDF_SyntaxParser::ReadBlock(uint8_t* pBuf, FX_DWORD size) {
   return TRUE;
 }
 
+const uint8_t* CPDF_SyntaxParser::PeekBuffer(FX_DWORD* pSize) const {
+  FX_FILESIZE pos = m_Pos + m_HeaderOffset;
+  if (pos < 0 || pos >= m_FileLen)
+    return nullptr;
+
+  if (m_pFileData) {
+    *pSize = (FX_DWORD)std::min<FX_FILESIZE>(m_FileLen - pos, 0x7fffffff);
+    return m_pFileData + pos;
+  }
+  FX_FILESIZE end = std::min<FX_FILESIZE>(m_BufOffset + m_BufSize, m_FileLen);
+  if (m_BufOffset >= pos || end <= pos)
+    return nullptr;
+
+  *pSize = (FX_DWORD)(end - pos);
+  return m_pFileBuf + (pos - m_BufOffset);
+}
+
+void CPDF_SyntaxParser::ScanWord(bool* bIsNumber) {
+  FX_DWORD size;
+  const uint8_t* pData = PeekBuffer(&size);
+  if (!pData)
+    return;
+
+  FX_DWORD len = PDF_FindWordEnd(pData, size);
+  FX_DWORD copy_len =
+      std::min<FX_DWORD>(len, sizeof(m_WordBuffer) - 1 - m_WordSize);
+  FXSYS_memcpy(m_WordBuffer + m_WordSize, pData, copy_len);
+  m_WordSize += copy_len;
+  if (bIsNumber && *bIsNumber) {
+    for (FX_DWORD i = 0; i < len; ++i) {
+      if (!PDFCharIsNumeric(pData[i])) {
+        *bIsNumber = false;
+        break;
+      }
+    }
+  }
+  m_Pos += len;
+}
+
 void CPDF_SyntaxParser::GetNextWordInternal(bool* bIsNumber) {
   m_WordSize = 0;
   if (bIsNumber)
@@ -1836,6 +2371,9 @@ void CPDF_SyntaxParser::GetNextWordInternal(bool* bIsNumber) {
       break;
 
     while (1) {
+      FX_DWORD size;
+      if (const uint8_t* pData = PeekBuffer(&size))
+        m_Pos += PDF_FindLineEnding(pData, size);
       if (!GetNextChar(ch))
         return;
       if (PDFCharIsLineEnding(ch))
@@ -1849,6 +2387,7 @@ void CPDF_SyntaxParser::GetNextWordInternal(bool* bIsNumber) {
     m_WordBuffer[m_WordSize++] = ch;
     if (ch == '/') {
       while (1) {
+        ScanWord(nullptr);
         if (!GetNextChar(ch))
           return;
 
@@ -1885,6 +2424,7 @@ void CPDF_SyntaxParser::GetNextWordInternal(bool* bIsNumber) {
     if (!PDFCharIsNumeric(ch))
       if (bIsNumber)
         *bIsNumber = false;
+    ScanWord(bIsNumber);
     if (!GetNextChar(ch))
       return;
 
@@ -2088,23 +2628,23 @@ CPDF_Object* CPDF_SyntaxParser::GetObject(CPDF_IndirectObjectHolder* pObjList,
         FX_DWORD objnum = FXSYS_atoi(word);
         if (bTypeOnly)
           return (CPDF_Object*)PDFOBJ_REFERENCE;
-        return new CPDF_Reference(pObjList, objnum);
+        return NewObject<CPDF_Reference>(pObjList, pObjList, objnum);
       }
     }
     m_Pos = SavedPos;
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_NUMBER;
-    return new CPDF_Number(word);
+    return NewObject<CPDF_Number>(pObjList, word);
   }
   if (word == "true" || word == "false") {
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_BOOLEAN;
-    return new CPDF_Boolean(word == "true");
+    return NewObject<CPDF_Boolean>(pObjList, word == "true");
   }
   if (word == "null") {
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_NULL;
-    return new CPDF_Null;
+    return NewObject<CPDF_Null>(pObjList);
   }
   if (word == "(") {
     if (bTypeOnly)
@@ -2113,7 +2653,7 @@ CPDF_Object* CPDF_SyntaxParser::GetObject(CPDF_IndirectObjectHolder* pObjList,
     if (m_pCryptoHandler && bDecrypt) {
       m_pCryptoHandler->Decrypt(objnum, gennum, str);
     }
-    return new CPDF_String(str, FALSE);
+    return NewObject<CPDF_String>(pObjList, str, FALSE);
   }
   if (word == "<") {
     if (bTypeOnly)
@@ -2122,12 +2662,12 @@ CPDF_Object* CPDF_SyntaxParser::GetObject(CPDF_IndirectObjectHolder* pObjList,
     if (m_pCryptoHandler && bDecrypt) {
       m_pCryptoHandler->Decrypt(objnum, gennum, str);
     }
-    return new CPDF_String(str, TRUE);
+    return NewObject<CPDF_String>(pObjList, str, TRUE);
   }
   if (word == "[") {
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_ARRAY;
-    CPDF_Array* pArray = new CPDF_Array;
+    CPDF_Array* pArray = NewObject<CPDF_Array>(pObjList);
     while (CPDF_Object* pObj =
                GetObject(pObjList, objnum, gennum, nullptr, true)) {
       pArray->Add(pObj);
@@ -2137,8 +2677,8 @@ CPDF_Object* CPDF_SyntaxParser::GetObject(CPDF_IndirectObjectHolder* pObjList,
   if (word[0] == '/') {
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_NAME;
-    return new CPDF_Name(
-        PDF_NameDecode(CFX_ByteStringC(m_WordBuffer + 1, m_WordSize - 1)));
+    return NewObject<CPDF_Name>(pObjList, DecodeName(
+        pObjList, CFX_ByteStringC(m_WordBuffer + 1, m_WordSize - 1)));
   }
   if (word == "<<") {
     if (bTypeOnly)
@@ -2150,7 +2690,7 @@ CPDF_Object* CPDF_SyntaxParser::GetObject(CPDF_IndirectObjectHolder* pObjList,
     int32_t nKeys = 0;
     FX_FILESIZE dwSignValuePos = 0;
     std::unique_ptr<CPDF_Dictionary, ReleaseDeleter<CPDF_Dictionary>> pDict(
-        new CPDF_Dictionary);
+        NewObject<CPDF_Dictionary>(pObjList));
     while (1) {
       CFX_ByteString key = GetNextWord(nullptr);
       if (key.IsEmpty())
@@ -2180,7 +2720,7 @@ CPDF_Object* CPDF_SyntaxParser::GetObject(CPDF_IndirectObjectHolder* pObjList,
         continue;
 
       CFX_ByteStringC keyNoSlash(key.c_str() + 1, key.GetLength() - 1);
-      pDict->SetAt(keyNoSlash, pObj);
+      pDict->SetAt(InternName(pObjList, keyNoSlash), pObj);
     }
 
     // Only when this is a signature dictionary and has contents, we reset the
@@ -2243,23 +2783,23 @@ CPDF_Object* CPDF_SyntaxParser::GetObjectByStrict(
         if (bTypeOnly)
           return (CPDF_Object*)PDFOBJ_REFERENCE;
         FX_DWORD objnum = FXSYS_atoi(word);
-        return new CPDF_Reference(pObjList, objnum);
+        return NewObject<CPDF_Reference>(pObjList, pObjList, objnum);
       }
     }
     m_Pos = SavedPos;
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_NUMBER;
-    return new CPDF_Number(word);
+    return NewObject<CPDF_Number>(pObjList, word);
   }
   if (word == "true" || word == "false") {
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_BOOLEAN;
-    return new CPDF_Boolean(word == "true");
+    return NewObject<CPDF_Boolean>(pObjList, word == "true");
   }
   if (word == "null") {
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_NULL;
-    return new CPDF_Null;
+    return NewObject<CPDF_Null>(pObjList);
   }
   if (word == "(") {
     if (bTypeOnly)
@@ -2267,7 +2807,7 @@ CPDF_Object* CPDF_SyntaxParser::GetObjectByStrict(
     CFX_ByteString str = ReadString();
     if (m_pCryptoHandler)
       m_pCryptoHandler->Decrypt(objnum, gennum, str);
-    return new CPDF_String(str, FALSE);
+    return NewObject<CPDF_String>(pObjList, str, FALSE);
   }
   if (word == "<") {
     if (bTypeOnly)
@@ -2275,13 +2815,13 @@ CPDF_Object* CPDF_SyntaxParser::GetObjectByStrict(
     CFX_ByteString str = ReadHexString();
     if (m_pCryptoHandler)
       m_pCryptoHandler->Decrypt(objnum, gennum, str);
-    return new CPDF_String(str, TRUE);
+    return NewObject<CPDF_String>(pObjList, str, TRUE);
   }
   if (word == "[") {
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_ARRAY;
     std::unique_ptr<CPDF_Array, ReleaseDeleter<CPDF_Array>> pArray(
-        new CPDF_Array);
+        NewObject<CPDF_Array>(pObjList));
     while (CPDF_Object* pObj =
                GetObject(pObjList, objnum, gennum, nullptr, true)) {
       pArray->Add(pObj);
@@ -2291,8 +2831,8 @@ CPDF_Object* CPDF_SyntaxParser::GetObjectByStrict(
   if (word[0] == '/') {
     if (bTypeOnly)
       return (CPDF_Object*)PDFOBJ_NAME;
-    return new CPDF_Name(
-        PDF_NameDecode(CFX_ByteStringC(m_WordBuffer + 1, m_WordSize - 1)));
+    return NewObject<CPDF_Name>(pObjList, DecodeName(
+        pObjList, CFX_ByteStringC(m_WordBuffer + 1, m_WordSize - 1)));
   }
   if (word == "<<") {
     if (bTypeOnly)
@@ -2301,7 +2841,7 @@ CPDF_Object* CPDF_SyntaxParser::GetObjectByStrict(
       pContext->m_DictStart = SavedPos;
 
     std::unique_ptr<CPDF_Dictionary, ReleaseDeleter<CPDF_Dictionary>> pDict(
-        new CPDF_Dictionary);
+        NewObject<CPDF_Dictionary>(pObjList));
     while (1) {
       FX_FILESIZE SavedPos = m_Pos;
       CFX_ByteString key = GetNextWord(nullptr);
@@ -2328,7 +2868,8 @@ CPDF_Object* CPDF_SyntaxParser::GetObjectByStrict(
         return nullptr;
       }
       if (key.GetLength() > 1) {
-        pDict->SetAt(CFX_ByteStringC(key.c_str() + 1, key.GetLength() - 1),
+        pDict->SetAt(InternName(pObjList, CFX_ByteStringC(key.c_str() + 1,
+                                                          key.GetLength() - 1)),
                      obj.release());
       }
     }
@@ -2482,7 +3023,20 @@ CPDF_Stream* CPDF_SyntaxParser::ReadStream(CPDF_Dictionary* pDict,
     return nullptr;
   }
   uint8_t* pData = nullptr;
-  if (len > 0) {
+  CPDF_Stream* pStream = nullptr;
+  FX_FILESIZE dataPos = m_Pos + m_HeaderOffset;
+  bool bDataInFile = len > 0 && len <= m_FileLen && dataPos <= m_FileLen - len;
+  if (bDataInFile && pContext &&
+      (pContext->m_Flags & PDFPARSE_NOSTREAMDATA)) {
+    pStream = new CPDF_Stream(nullptr, 0, pDict);
+    m_Pos += len;
+  } else if (bDataInFile && m_pFileData && !pCryptoHandler) {
+    // The file stays mapped until the parser releases it, so the stream can
+    // reference its data in place instead of holding a copy.
+    pStream = new CPDF_Stream(nullptr, 0, pDict);
+    pStream->SetBorrowedData(m_pFileData + dataPos, (FX_DWORD)len);
+    m_Pos += len;
+  } else if (len > 0) {
     pData = FX_Alloc(uint8_t, len);
     ReadBlock(pData, len);
     if (pCryptoHandler) {
@@ -2497,7 +3051,8 @@ CPDF_Stream* CPDF_SyntaxParser::ReadStream(CPDF_Dictionary* pDict,
       dest_buf.DetachBuffer();
     }
   }
-  CPDF_Stream* pStream = new CPDF_Stream(pData, len, pDict);
+  if (!pStream)
+    pStream = new CPDF_Stream(pData, len, pDict);
   if (pContext) {
     pContext->m_DataEnd = pContext->m_DataStart + len;
   }
@@ -2515,12 +3070,17 @@ CPDF_Stream* CPDF_SyntaxParser::ReadStream(CPDF_Dictionary* pDict,
 void CPDF_SyntaxParser::InitParser(IFX_FileRead* pFileAccess,
                                    FX_DWORD HeaderOffset) {
   FX_Free(m_pFileBuf);
-  m_pFileBuf = FX_Alloc(uint8_t, m_BufSize);
+  m_pFileBuf = NULL;
   m_HeaderOffset = HeaderOffset;
   m_FileLen = pFileAccess->GetSize();
   m_Pos = 0;
   m_pFileAccess = pFileAccess;
   m_BufOffset = 0;
+  m_pFileData = pFileAccess->GetDirectBuffer();
+  if (m_pFileData) {
+    return;
+  }
+  m_pFileBuf = FX_Alloc(uint8_t, m_BufSize);
   pFileAccess->ReadBlock(
       m_pFileBuf, 0,
       (size_t)((FX_FILESIZE)m_BufSize > m_FileLen ? m_FileLen : m_BufSize));
@@ -3019,10 +3579,10 @@ FX_DWORD CPDF_DataAvail::GetObjectSize(FX_DWORD objnum, FX_FILESIZE& offset) {
     return 0;
 
   if (pParser->m_V5Type[objnum] == 2)
-    objnum = pParser->m_ObjectInfo[objnum].pos;
+    objnum = pParser->GetObjectPositionOrZero(objnum);
 
   if (pParser->m_V5Type[objnum] == 1 || pParser->m_V5Type[objnum] == 255) {
-    offset = pParser->m_ObjectInfo[objnum].pos;
+    offset = pParser->GetObjectPositionOrZero(objnum);
     if (offset == 0) {
       return 0;
     }
@@ -3262,9 +3822,7 @@ FX_BOOL CPDF_DataAvail::LoadAllXref(IFX_DownloadHints* pHints) {
     m_docStatus = PDF_DATAAVAIL_LOADALLFILE;
     return FALSE;
   }
-  FXSYS_qsort(m_parser.m_SortedOffset.GetData(),
-              m_parser.m_SortedOffset.GetSize(), sizeof(FX_FILESIZE),
-              CompareFileSize);
+  m_parser.SortOffsets();
   m_dwRootObjNum = m_parser.GetRootObjNum();
   m_dwInfoObjNum = m_parser.GetInfoObjNum();
   m_pCurrentParser = &m_parser;
@@ -2,8 +2,125 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/include/fpdfapi/fpdf_parser.h"
+#include "core/include/fxcrt/fx_ext.h"
+#include "core/include/fxcrt/fx_stream.h"
+#include "core/src/fpdfapi/fpdf_page/pageint.h"
 #include "testing/embedder_test.h"
 #include "testing/gtest/include/gtest/gtest.h"
+#include "testing/utils/path_service.h"
+
+namespace {
+
+using ScopedFileStream =
+    std::unique_ptr<IFX_FileStream, ReleaseDeleter<IFX_FileStream>>;
+
+// Builds a one page document followed by |count| small objects. Without
+// |with_xref| the document has no cross-reference table and must be rebuilt.
+std::string MakeDocumentWithObjects(int count, bool with_xref) {
+  std::string doc = "%PDF-1.7\n";
+  std::vector<size_t> offsets;
+  char buf[64];
+  const int total = count + 3;
+  for (int objnum = 1; objnum <= total; ++objnum) {
+    offsets.push_back(doc.size());
+    snprintf(buf, sizeof(buf), "%d 0 obj\n", objnum);
+    doc += buf;
+    if (objnum == 1) {
+      doc += "<< /Type /Catalog /Pages 2 0 R >>";
+    } else if (objnum == 2) {
+      doc += "<< /Type /Pages /Count 1 /Kids [3 0 R] >>";
+    } else if (objnum == 3) {
+      doc += "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] >>";
+    } else {
+      snprintf(buf, sizeof(buf), "%d", objnum);
+      doc += buf;
+    }
+    doc += "\nendobj\n";
+  }
+  size_t xref_offset = 0;
+  if (with_xref) {
+    xref_offset = doc.size();
+    snprintf(buf, sizeof(buf), "xref\n0 %d\n0000000000 65535 f\r\n",
+             total + 1);
+    doc += buf;
+    for (size_t offset : offsets) {
+      snprintf(buf, sizeof(buf), "%010zu 00000 n\r\n", offset);
+      doc += buf;
+    }
+  }
+  snprintf(buf, sizeof(buf), "trailer\n<< /Size %d /Root 1 0 R >>\n",
+           total + 1);
+  doc += buf;
+  snprintf(buf, sizeof(buf), "startxref\n%zu\n%%%%EOF\n", xref_offset);
+  doc += buf;
+  return doc;
+}
+
+// Builds a one page document of about |size| bytes with no cross-reference
+// table. Its streams replace earlier objects, take their lengths from the
+// objects before them and hold false ends followed by objects that are only
+// data.
+std::string MakeDamagedDocument(size_t size) {
+  std::string doc =
+      "%PDF-1.7\n"
+      "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n"
+      "2 0 obj\n<< /Type /Pages /Count 1 /Kids [3 0 R] >>\nendobj\n"
+      "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] >>\n"
+      "endobj\n";
+  char buf[256];
+  for (int objnum = 4; doc.size() < size; objnum += 2) {
+    snprintf(buf, sizeof(buf),
+             "%d 0 obj\n35\nendobj\n%d 0 obj\n()\nendobj\n"
+             "%d 0 obj\n<< /Length %d 0 R >>\nstream\nendstream\n"
+             "%d 0 obj\n(x)\nendobj\n\nendstream\nendobj\n",
+             objnum, objnum + 1, objnum + 1, objnum, objnum + 1000000);
+    doc += buf;
+  }
+  doc += "trailer\n<< /Root 1 0 R >>\n%%EOF\n";
+  return doc;
+}
+
+// Reads a string in place, like a mapped file, and overwrites it once
+// released so that streams still borrowing from it see the change.
+class CFX_TestMappedStringRead : public IFX_FileRead {
+ public:
+  CFX_TestMappedStringRead(std::string* data, bool* released)
+      : data_(data), released_(released) {}
+
+  // IFX_Stream
+  void Release() override {
+    data_->assign(data_->size(), 'x');
+    *released_ = true;
+    delete this;
+  }
+
+  // IFX_FileRead
+  FX_BOOL ReadBlock(void* buffer, FX_FILESIZE offset, size_t size) override {
+    if (offset < 0 || offset + size > data_->size())
+      return FALSE;
+
+    memcpy(buffer, data_->data() + offset, size);
+    return TRUE;
+  }
+  FX_FILESIZE GetSize() override { return (FX_FILESIZE)data_->size(); }
+  const uint8_t* GetDirectBuffer() override {
+    return reinterpret_cast<const uint8_t*>(data_->data());
+  }
+
+ private:
+  std::string* data_;
+  bool* released_;
+};
+
+}  // namespace
 
 class FPDFParserEmbeddertest : public EmbedderTest {};
 
@@ -38,3 +155,387 @@ TEST_F(FPDFParserEmbeddertest, Bug_325) {
   EXPECT_FALSE(OpenDocument("bug_325_a.pdf"));
   EXPECT_FALSE(OpenDocument("bug_325_b.pdf"));
 }
+
+TEST_F(FPDFParserEmbeddertest, XRefIndex) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("bug_xrefv4_loop.pdf", &file_path));
+  std::string other_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &other_path));
+
+  ScopedFileStream index(FX_CreateMemoryStream());
+  int page_count;
+  FX_DWORD root_objnum;
+  {
+    CPDF_Parser parser;
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+    EXPECT_FALSE(parser.IsXRefIndexUsed());
+    page_count = parser.GetDocument()->GetPageCount();
+    root_objnum = parser.GetRootObjNum();
+    ASSERT_TRUE(parser.SaveXRefIndex(index.get()));
+  }
+  {
+    CPDF_Parser parser;
+    parser.SetXRefIndex(index.get());
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+    EXPECT_TRUE(parser.IsXRefIndexUsed());
+    EXPECT_EQ(page_count, parser.GetDocument()->GetPageCount());
+    EXPECT_EQ(root_objnum, parser.GetRootObjNum());
+  }
+  {
+    // An index written for another file is not used.
+    CPDF_Parser parser;
+    parser.SetXRefIndex(index.get());
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser.StartParse(FX_CreateFileRead(other_path.c_str())));
+    EXPECT_FALSE(parser.IsXRefIndexUsed());
+    EXPECT_EQ(1, parser.GetDocument()->GetPageCount());
+  }
+  {
+    // Nor is one written before the file was last modified.
+    CPDF_Parser parser;
+    parser.SetXRefIndex(index.get());
+    parser.SetFileModifiedTime(1);
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+    EXPECT_FALSE(parser.IsXRefIndexUsed());
+    EXPECT_EQ(page_count, parser.GetDocument()->GetPageCount());
+  }
+}
+
+TEST_F(FPDFParserEmbeddertest, XRefIndexInconsistent) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("bug_xrefv4_loop.pdf", &file_path));
+
+  std::vector<uint8_t> saved;
+  {
+    CPDF_Parser parser;
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+    std::unique_ptr<IFX_MemoryStream, ReleaseDeleter<IFX_MemoryStream>> index(
+        FX_CreateMemoryStream(TRUE));
+    ASSERT_TRUE(parser.SaveXRefIndex(index.get()));
+    saved.assign(index->GetBuffer(), index->GetBuffer() + index->GetSize());
+  }
+
+  // The object offsets follow the fixed size header and the trailer, and the
+  // object types follow the offsets.
+  auto read_dword = [&saved](size_t pos) {
+    return saved[pos] | (saved[pos + 1] << 8) | (saved[pos + 2] << 16) |
+           (saved[pos + 3] << 24);
+  };
+  const size_t kFileSizePos = 12;
+  const size_t kTrailerSizePos = 52;
+  size_t count_pos = kTrailerSizePos + 4 + read_dword(kTrailerSizePos);
+  size_t offsets_pos = count_pos + 4;
+  size_t types_pos = offsets_pos + read_dword(count_pos) * 8 + 4;
+  ASSERT_GT(read_dword(count_pos), 1u);
+  ASSERT_LT(types_pos + 1, saved.size());
+  ASSERT_EQ(1, saved[types_pos + 1]);
+
+  // Each change comes with a matching hash.
+  auto expect_not_used = [&file_path](std::vector<uint8_t> data) {
+    FX_DWORD payload_size = data.size() - 4;
+    FX_DWORD hash = FX_HashCode_String_GetA(
+        reinterpret_cast<const FX_CHAR*>(data.data()), payload_size);
+    for (int i = 0; i < 4; ++i)
+      data[payload_size + i] = (uint8_t)(hash >> (i * 8));
+
+    ScopedFileStream index(FX_CreateMemoryStream(data.data(), data.size()));
+    CPDF_Parser parser;
+    parser.SetXRefIndex(index.get());
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+    EXPECT_FALSE(parser.IsXRefIndexUsed());
+    EXPECT_EQ(1, parser.GetDocument()->GetPageCount());
+  };
+
+  // An unknown type, and a compressed object whose stream number is a file
+  // offset.
+  for (uint8_t type : {7, 2}) {
+    SCOPED_TRACE(static_cast<int>(type));
+    std::vector<uint8_t> data = saved;
+    data[types_pos + 1] = type;
+    expect_not_used(data);
+  }
+
+  // An object at the end of the file.
+  std::vector<uint8_t> data = saved;
+  std::copy(&saved[kFileSizePos], &saved[kFileSizePos + 8],
+            &data[offsets_pos + 8]);
+  expect_not_used(data);
+}
+
+TEST_F(FPDFParserEmbeddertest, RebuildCrossRefParallel) {
+  std::string doc = MakeDamagedDocument(2 * 1024 * 1024);
+  CPDF_Parser serial;
+  serial.SetRebuildThreads(1);
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            serial.StartParse(FX_CreateMemoryStream(
+                reinterpret_cast<uint8_t*>(&doc[0]), doc.size(), FALSE)));
+  EXPECT_EQ(1, serial.GetDocument()->GetPageCount());
+  // The objects in the stream data are skipped.
+  EXPECT_LT(serial.GetLastObjNum(), 1000000u);
+
+  CPDF_Parser parser;
+  parser.SetRebuildThreads(4);
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            parser.StartParse(FX_CreateMemoryStream(
+                reinterpret_cast<uint8_t*>(&doc[0]), doc.size(), FALSE)));
+  EXPECT_EQ(1, parser.GetDocument()->GetPageCount());
+  ASSERT_EQ(serial.GetLastObjNum(), parser.GetLastObjNum());
+  for (FX_DWORD objnum = 0; objnum <= serial.GetLastObjNum(); ++objnum) {
+    EXPECT_EQ(serial.GetObjectOffset(objnum), parser.GetObjectOffset(objnum))
+        << objnum;
+  }
+  EXPECT_EQ(serial.GetLastXRefOffset(), parser.GetLastXRefOffset());
+}
+
+TEST_F(FPDFParserEmbeddertest, ReparseKeepsBorrowedData) {
+  const char kDoc[] =
+      "%PDF-1.7\n"
+      "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n"
+      "2 0 obj\n<< /Type /Pages /Count 1 /Kids [3 0 R] >>\nendobj\n"
+      "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] >>\n"
+      "endobj\n"
+      "4 0 obj\n<< /Length 5 >>\nstream\nhello\nendstream\nendobj\n"
+      "trailer\n<< /Root 1 0 R >>\n%%EOF\n";
+  std::string first = kDoc;
+  std::string second = kDoc;
+  bool first_released = false;
+  bool second_released = false;
+  {
+    CPDF_Parser parser;
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser.StartParse(
+                  new CFX_TestMappedStringRead(&first, &first_released)));
+    CPDF_Stream* stream =
+        ToStream(parser.GetDocument()->GetIndirectObject(4, nullptr));
+    ASSERT_TRUE(stream);
+
+    // The document and its streams outlive the reparse, so the first file
+    // stays readable until the document goes.
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser.StartParse(
+                  new CFX_TestMappedStringRead(&second, &second_released),
+                  TRUE));
+    EXPECT_FALSE(first_released);
+    CPDF_StreamAcc acc;
+    acc.LoadAllData(stream, TRUE);
+    EXPECT_EQ("hello",
+              std::string(reinterpret_cast<const char*>(acc.GetData()),
+                          acc.GetSize()));
+  }
+  EXPECT_TRUE(first_released);
+  EXPECT_TRUE(second_released);
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests.
+TEST_F(FPDFParserEmbeddertest, DISABLED_BenchmarkOpenManyObjects) {
+  const int kObjectCount = 1000000;
+  for (bool with_xref : {true, false}) {
+    std::string doc = MakeDocumentWithObjects(kObjectCount, with_xref);
+    auto start = std::chrono::steady_clock::now();
+    FPDF_DOCUMENT document =
+        FPDF_LoadMemDocument(doc.data(), doc.size(), nullptr);
+    auto end = std::chrono::steady_clock::now();
+    ASSERT_NE(nullptr, document);
+    EXPECT_EQ(1, FPDF_GetPageCount(document));
+    FPDF_CloseDocument(document);
+    printf("Open %d objects, %s: %lld ms\n", kObjectCount,
+           with_xref ? "xref table" : "rebuilt xref",
+           static_cast<long long>(
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   end - start).count()));
+  }
+}
+
+TEST_F(FPDFParserEmbeddertest, ObjectPool) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &file_path));
+
+  CPDF_Parser parser;
+  parser.SetUseObjectPool(TRUE);
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+  CPDF_Document* pDoc = parser.GetDocument();
+  EXPECT_TRUE(pDoc->HasObjectPool());
+  EXPECT_EQ(1, pDoc->GetPageCount());
+  for (FX_DWORD objnum = 1; objnum <= parser.GetLastObjNum(); ++objnum)
+    pDoc->GetIndirectObject(objnum, nullptr);
+
+  // Pooled objects can still be released early and replaced by edits.
+  CPDF_Dictionary* pPage = pDoc->GetPage(0);
+  ASSERT_TRUE(pPage);
+  pPage->SetAtInteger("Rotate", 90);
+  pPage->RemoveAt("Resources");
+  EXPECT_EQ(90, pPage->GetInteger("Rotate"));
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests.
+TEST_F(FPDFParserEmbeddertest, DISABLED_BenchmarkObjectPool) {
+  const int kObjectCount = 1000000;
+  std::string doc = MakeDocumentWithObjects(kObjectCount, true);
+  for (bool use_pool : {false, true}) {
+    auto start = std::chrono::steady_clock::now();
+    {
+      CPDF_Parser parser;
+      parser.SetUseObjectPool(use_pool);
+      ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+                parser.StartParse(FX_CreateMemoryStream(
+                    reinterpret_cast<uint8_t*>(&doc[0]), doc.size(), FALSE)));
+      CPDF_Document* pDoc = parser.GetDocument();
+      for (FX_DWORD objnum = 1; objnum <= parser.GetLastObjNum(); ++objnum)
+        pDoc->GetIndirectObject(objnum, nullptr);
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("Load and free %d objects, %s: %lld ms\n", kObjectCount,
+           use_pool ? "object pool" : "heap",
+           static_cast<long long>(
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   end - start).count()));
+  }
+}
+
+TEST_F(FPDFParserEmbeddertest, ObjectStreamCacheLimit) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("feature_linearized_loading.pdf",
+                                           &file_path));
+
+  // Read every object's binary with an unbounded cache first.
+  std::vector<std::string> expected;
+  {
+    CPDF_Parser parser;
+    ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+              parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+    ASSERT_TRUE(parser.IsXRefStream());
+    for (FX_DWORD objnum = 0; objnum <= parser.GetLastObjNum(); ++objnum) {
+      uint8_t* pBuffer;
+      FX_DWORD size;
+      parser.GetIndirectBinary(objnum, pBuffer, size);
+      expected.push_back(std::string(reinterpret_cast<char*>(pBuffer), size));
+      FX_Free(pBuffer);
+    }
+    EXPECT_LT(1u, parser.GetCachedObjectStreamCount());
+  }
+
+  // With no room in the cache only the last used object stream is kept, and
+  // objects are still found in the streams that were dropped.
+  CPDF_Parser parser;
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+  parser.SetObjectStreamCacheLimit(0);
+  EXPECT_GE(1u, parser.GetCachedObjectStreamCount());
+  for (int pass = 0; pass < 2; ++pass) {
+    for (FX_DWORD objnum = 0; objnum <= parser.GetLastObjNum(); ++objnum) {
+      uint8_t* pBuffer;
+      FX_DWORD size;
+      parser.GetIndirectBinary(objnum, pBuffer, size);
+      EXPECT_EQ(expected[objnum],
+                std::string(reinterpret_cast<char*>(pBuffer), size));
+      FX_Free(pBuffer);
+      EXPECT_GE(1u, parser.GetCachedObjectStreamCount());
+    }
+  }
+  CPDF_Document* pDoc = parser.GetDocument();
+  EXPECT_EQ(2, pDoc->GetPageCount());
+  for (FX_DWORD objnum = 1; objnum <= parser.GetLastObjNum(); ++objnum)
+    pDoc->GetIndirectObject(objnum, nullptr);
+  EXPECT_GE(1u, parser.GetCachedObjectStreamCount());
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests. Tokenizes every file
+// in the test corpus, and the decoded content streams of their pages.
+TEST_F(FPDFParserEmbeddertest, DISABLED_BenchmarkTokenizer) {
+  const int kIterations = 50;
+  std::string data_dir;
+  ASSERT_TRUE(PathService::GetTestDataDir(&data_dir));
+  void* folder = FX_OpenFolder(data_dir.c_str());
+  ASSERT_TRUE(folder);
+
+  std::vector<std::string> files;
+  std::vector<std::string> contents;
+  CFX_ByteString filename;
+  FX_BOOL bFolder;
+  while (FX_GetNextFile(folder, filename, bFolder)) {
+    if (bFolder || filename.Right(4) != ".pdf")
+      continue;
+
+    std::string path;
+    ASSERT_TRUE(PathService::GetTestFilePath(filename.c_str(), &path));
+    std::unique_ptr<IFX_FileRead, ReleaseDeleter<IFX_FileRead>> file(
+        FX_CreateFileRead(path.c_str()));
+    if (!file)
+      continue;
+    std::string file_data((size_t)file->GetSize(), '\0');
+    if (!file->ReadBlock(&file_data[0], 0, file_data.size()))
+      continue;
+    files.push_back(file_data);
+
+    CPDF_Parser parser;
+    if (parser.StartParse(FX_CreateFileRead(path.c_str())) !=
+        PDFPARSE_ERROR_SUCCESS) {
+      continue;
+    }
+    CPDF_Document* pDoc = parser.GetDocument();
+    for (int i = 0; i < pDoc->GetPageCount(); ++i) {
+      CPDF_Dictionary* pPage = pDoc->GetPage(i);
+      CPDF_Object* pContent =
+          pPage ? pPage->GetElementValue("Contents") : nullptr;
+      if (!pContent)
+        continue;
+      CPDF_Array* pArray = pContent->AsArray();
+      FX_DWORD count = pArray ? pArray->GetCount() : 1;
+      for (FX_DWORD j = 0; j < count; ++j) {
+        CPDF_Stream* pStream = ToStream(
+            pArray ? pArray->GetElementValue(j) : pContent);
+        if (!pStream)
+          continue;
+        CPDF_StreamAcc acc;
+        acc.LoadAllData(pStream, FALSE);
+        contents.push_back(std::string(
+            reinterpret_cast<const char*>(acc.GetData()), acc.GetSize()));
+      }
+    }
+  }
+  FX_CloseFolder(folder);
+  ASSERT_FALSE(files.empty());
+
+  int words = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    for (auto& file_data : files) {
+      ScopedFileStream stream(FX_CreateMemoryStream(
+          reinterpret_cast<uint8_t*>(&file_data[0]), file_data.size(), FALSE));
+      CPDF_SyntaxParser parser;
+      parser.InitParser(stream.get(), 0);
+      bool bIsNumber;
+      while (!parser.GetNextWord(&bIsNumber).IsEmpty())
+        ++words;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  printf("CPDF_SyntaxParser, %d files x %d: %d words, %lld ms\n",
+         static_cast<int>(files.size()), kIterations, words,
+         static_cast<long long>(
+             std::chrono::duration_cast<std::chrono::milliseconds>(
+                 end - start).count()));
+
+  words = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    for (const auto& content : contents) {
+      CPDF_StreamParser parser(
+          reinterpret_cast<const uint8_t*>(content.data()), content.size());
+      while (parser.ParseNextElement() != CPDF_StreamParser::EndOfData)
+        ++words;
+    }
+  }
+  end = std::chrono::steady_clock::now();
+  printf("CPDF_StreamParser, %d streams x %d: %d elements, %lld ms\n",
+         static_cast<int>(contents.size()), kIterations, words,
+         static_cast<long long>(
+             std::chrono::duration_cast<std::chrono::milliseconds>(
+                 end - start).count()));
+}
@@ -2,7 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <cstdio>
+#include <string>
+
 #include "core/include/fpdfapi/fpdf_parser.h"
+#include "core/include/fpdfapi/fpdf_serial.h"
 #include "core/include/fxcrt/fx_stream.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/utils/path_service.h"
@@ -46,6 +50,16 @@ class CFX_TestBufferRead : public IFX_FileRead {
   size_t total_size_;
 };
 
+// Also exposes the buffer for reading in place.
+class CFX_TestDirectBufferRead : public CFX_TestBufferRead {
+ public:
+  CFX_TestDirectBufferRead(const unsigned char* buffer_in, size_t buf_size)
+      : CFX_TestBufferRead(buffer_in, buf_size) {}
+
+  // IFX_FileRead
+  const uint8_t* GetDirectBuffer() override { return buffer_; }
+};
+
 // A wrapper class to help test member functions of CPDF_Parser.
 class CPDF_TestParser : public CPDF_Parser {
  public:
@@ -63,23 +77,55 @@ class CPDF_TestParser : public CPDF_Parser {
     return true;
   }
 
-  // Setup reading from a buffer and initial states.
-  bool InitTestFromBuffer(const unsigned char* buffer, size_t len) {
-    CFX_TestBufferRead* buffer_reader = new CFX_TestBufferRead(buffer, len);
+  // Setup reading from a buffer and initial states. With |direct|, the
+  // parser reads the buffer in place.
+  bool InitTestFromBuffer(const unsigned char* buffer,
+                          size_t len,
+                          bool direct = false) {
+    CFX_TestBufferRead* buffer_reader =
+        direct ? new CFX_TestDirectBufferRead(buffer, len)
+               : new CFX_TestBufferRead(buffer, len);
 
     // For the test file, the header is set at the beginning.
     m_Syntax.InitParser(buffer_reader, 0);
     return true;
   }
 
+  // Expects |other| to have rebuilt the same cross-reference as this parser.
+  void ExpectSameRebuild(const CPDF_TestParser& other) const {
+    ASSERT_EQ(m_ObjectInfo.size(), other.m_ObjectInfo.size());
+    for (size_t i = 0; i < m_ObjectInfo.size(); ++i)
+      EXPECT_EQ(m_ObjectInfo[i].pos, other.m_ObjectInfo[i].pos) << i;
+    ASSERT_EQ(m_V5Type.GetSize(), other.m_V5Type.GetSize());
+    EXPECT_EQ(0, FXSYS_memcmp(m_V5Type.GetData(), other.m_V5Type.GetData(),
+                              m_V5Type.GetSize()));
+    ASSERT_EQ(m_ObjVersion.GetSize(), other.m_ObjVersion.GetSize());
+    for (int i = 0; i < m_ObjVersion.GetSize(); ++i)
+      EXPECT_EQ(m_ObjVersion[i], other.m_ObjVersion[i]) << i;
+    ASSERT_EQ(m_SortedOffset.GetSize(), other.m_SortedOffset.GetSize());
+    for (int i = 0; i < m_SortedOffset.GetSize(); ++i)
+      EXPECT_EQ(m_SortedOffset[i], other.m_SortedOffset[i]) << i;
+    EXPECT_EQ(m_bVersionUpdated, other.m_bVersionUpdated);
+    EXPECT_EQ(m_LastXRefOffset, other.m_LastXRefOffset);
+    CFX_ByteTextBuf trailer;
+    trailer << m_pTrailer;
+    CFX_ByteTextBuf other_trailer;
+    other_trailer << other.m_pTrailer;
+    EXPECT_EQ(trailer.GetByteString(), other_trailer.GetByteString());
+  }
+
  private:
   // Add test cases here as private friend so that protected members in
   // CPDF_Parser can be accessed by test cases.
   // Need to access RebuildCrossRef.
   FRIEND_TEST(fpdf_parser_parser, RebuildCrossRefCorrectly);
   FRIEND_TEST(fpdf_parser_parser, RebuildCrossRefFailed);
+  FRIEND_TEST(fpdf_parser_parser, RebuildCrossRefParallel);
+  FRIEND_TEST(fpdf_parser_parser, RebuildCrossRefMovedBack);
   // Need to access LoadCrossRefV4.
   FRIEND_TEST(fpdf_parser_parser, LoadCrossRefV4);
+  // Need to access LoadCrossRefV5.
+  FRIEND_TEST(fpdf_parser_parser, LoadCrossRefV5HugeSize);
 };
 
 // TODO(thestig) Using unique_ptr with ReleaseDeleter is still not ideal.
@@ -245,6 +291,61 @@ TEST(fpdf_parser_parser, ReadHexString) {
   }
 }
 
+TEST(fpdf_parser_parser, ReadStreamWithoutData) {
+  uint8_t data[] = "<< /Length 5 >>\nstream\nhello\nendstream\nendobj";
+  const FX_DWORD kDataSize = sizeof(data) - 1;
+  FX_FILESIZE end_pos = 0;
+  {
+    ScopedFileStream stream(FX_CreateMemoryStream(data, kDataSize, FALSE));
+    CPDF_SyntaxParser parser;
+    parser.InitParser(stream.get(), 0);
+    std::unique_ptr<CPDF_Object, ReleaseDeleter<CPDF_Object>> obj(
+        parser.GetObject(nullptr, 1, 0, nullptr, true));
+    ASSERT_TRUE(obj && obj->IsStream());
+    EXPECT_EQ(5u, obj->AsStream()->GetRawSize());
+    end_pos = parser.SavePos();
+  }
+  {
+    ScopedFileStream stream(FX_CreateMemoryStream(data, kDataSize, FALSE));
+    CPDF_SyntaxParser parser;
+    parser.InitParser(stream.get(), 0);
+    PARSE_CONTEXT context;
+    FXSYS_memset(&context, 0, sizeof(PARSE_CONTEXT));
+    context.m_Flags = PDFPARSE_NOSTREAMDATA;
+    std::unique_ptr<CPDF_Object, ReleaseDeleter<CPDF_Object>> obj(
+        parser.GetObject(nullptr, 1, 0, &context, true));
+    ASSERT_TRUE(obj && obj->IsStream());
+    EXPECT_EQ(0u, obj->AsStream()->GetRawSize());
+    EXPECT_EQ(5, obj->GetDict()->GetInteger("Length"));
+    EXPECT_EQ(end_pos, parser.SavePos());
+  }
+}
+
+TEST(fpdf_parser_parser, InternNames) {
+  uint8_t data[] = "[<< /Type /Page /Parent 1 0 R >> << /Type /Pa#67e >>]";
+  ScopedFileStream stream(
+      FX_CreateMemoryStream(data, sizeof(data) - 1, FALSE));
+  CPDF_SyntaxParser parser;
+  parser.InitParser(stream.get(), 0);
+  CPDF_IndirectObjectHolder holder(nullptr);
+  std::unique_ptr<CPDF_Object, ReleaseDeleter<CPDF_Object>> obj(
+      parser.GetObject(&holder, 1, 0, nullptr, true));
+  ASSERT_TRUE(obj && obj->IsArray());
+  CPDF_Dictionary* pFirst = obj->AsArray()->GetDict(0);
+  CPDF_Dictionary* pSecond = obj->AsArray()->GetDict(1);
+  ASSERT_TRUE(pFirst && pSecond);
+
+  // Both dictionaries share the key and the decoded name value.
+  EXPECT_EQ("Parent", pFirst->begin()->first);
+  EXPECT_EQ(holder.InternName("Parent").c_str(),
+            pFirst->begin()->first.c_str());
+  EXPECT_EQ((++pFirst->begin())->first.c_str(),
+            pSecond->begin()->first.c_str());
+  EXPECT_EQ("Page", pSecond->GetConstString("Type"));
+  EXPECT_EQ(pFirst->GetConstString("Type").GetCStr(),
+            pSecond->GetConstString("Type").GetCStr());
+}
+
 TEST(fpdf_parser_parser, RebuildCrossRefCorrectly) {
   CPDF_TestParser parser;
   std::string test_file;
@@ -271,6 +372,133 @@ TEST(fpdf_parser_parser, RebuildCrossRefFailed) {
   ASSERT_FALSE(parser.RebuildCrossRef());
 }
 
+// Builds a damaged document of about |size| bytes, with the things that send
+// a scan of the file astray: streams whose data looks like objects, strings,
+// comments and stray parentheses, redefined objects, and trailers.
+std::string MakeDamagedDocument(size_t size) {
+  std::string doc =
+      "%PDF-1.7\n"
+      "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n"
+      "2 0 obj\n<< /Type /Pages /Kids [] /Count 0 >>\nendobj\n";
+  char buf[256];
+  for (int objnum = 3; doc.size() < size; ++objnum) {
+    switch (objnum % 11) {
+      case 0:
+        snprintf(buf, sizeof(buf),
+                 "%d 0 obj\n<< /Name (a (b) 4 0 obj c) >>\nendobj\n", objnum);
+        break;
+      case 1:
+        snprintf(buf, sizeof(buf),
+                 "%d 0 obj\n<< /Length 30 >>\nstream\n"
+                 "%% ( 7 0 obj << >> endobj x\n\nendstream\nendobj\n",
+                 objnum);
+        break;
+      case 2:
+        // The length of the stream is in the object before it, and the data
+        // holds a false end.
+        snprintf(buf, sizeof(buf),
+                 "%d 0 obj\n22\nendobj\n%d 0 obj\n<< /Length %d 0 R >>\n"
+                 "stream\nab endstream 5 0 obj\nendstream\nendobj\n",
+                 objnum, objnum + 1, objnum);
+        ++objnum;
+        break;
+      case 3:
+        snprintf(buf, sizeof(buf), "%d 1 obj\n%d\nendobj\n", objnum / 2,
+                 objnum);
+        break;
+      case 4:
+        snprintf(buf, sizeof(buf),
+                 "(stray 8 0 obj %d 0 obj\n[1 2]\nendobj\n", objnum);
+        break;
+      case 5:
+        snprintf(buf, sizeof(buf),
+                 ") %% 9 0 obj\n%d 0 obj\n<< /Info %d 0 R >>\nendobj\n",
+                 objnum, objnum - 1);
+        break;
+      case 6:
+        snprintf(buf, sizeof(buf),
+                 "%d 0 obj\n<< /Type /XRef /Size %d /Root 1 0 R /Length 3 >>"
+                 "\nstream\nabc\nendstream\nendobj\n",
+                 objnum, objnum + 1);
+        break;
+      case 7:
+        snprintf(buf, sizeof(buf),
+                 "trailer\n<< /Size %d /Root 1 0 R /ID [<%04x>] >>\n"
+                 "startxref\n%d\n%%%%EOF\n",
+                 objnum, objnum, objnum);
+        break;
+      case 8:
+        snprintf(buf, sizeof(buf), "xref\n0 1\n0000000000 65535 f \n");
+        break;
+      default:
+        snprintf(buf, sizeof(buf), "%d 0 obj\n<< /A /B%d >>\nendobj\n",
+                 objnum, objnum);
+        break;
+    }
+    doc += buf;
+  }
+  return doc;
+}
+
+TEST(fpdf_parser_parser, RebuildCrossRefParallel) {
+  const std::string doc = MakeDamagedDocument(3 * 1024 * 1024);
+  const unsigned char* data =
+      reinterpret_cast<const unsigned char*>(doc.data());
+  CPDF_TestParser serial;
+  ASSERT_TRUE(serial.InitTestFromBuffer(data, doc.size()));
+  serial.m_bVersionUpdated = FALSE;
+  serial.SetRebuildThreads(1);
+  ASSERT_TRUE(serial.RebuildCrossRef());
+
+  // Chunks start inside streams, strings and object headers alike.
+  for (int threads : {2, 7, 12}) {
+    for (bool direct : {false, true}) {
+      CPDF_TestParser parser;
+      ASSERT_TRUE(parser.InitTestFromBuffer(data, doc.size(), direct));
+      parser.m_bVersionUpdated = FALSE;
+      parser.m_LastXRefOffset = 0;
+      parser.SetRebuildThreads(threads);
+      ASSERT_TRUE(parser.RebuildCrossRef());
+      serial.ExpectSameRebuild(parser);
+    }
+  }
+}
+
+TEST(fpdf_parser_parser, RebuildCrossRefMovedBack) {
+  // The scan reads the number in this header as 1, but parsing the header
+  // reads another number, so the object sends the scan back to the start of
+  // the file. Early in the file, that is the start of the block the scan is
+  // in, so the scan gives up. Later, the scan goes through the file again
+  // and gives up when the object sends it back a second time.
+  const char kBadObject[] = "4294967297 0 obj\n<< >>\nendobj\n";
+  for (size_t bad_pos : {100, 2 * 1024 * 1024}) {
+    std::string doc = MakeDamagedDocument(3 * 1024 * 1024);
+    size_t insert_pos = doc.find("endobj\n", bad_pos) + 7;
+    doc.insert(insert_pos, kBadObject);
+    const unsigned char* data =
+        reinterpret_cast<const unsigned char*>(doc.data());
+    CPDF_TestParser serial;
+    ASSERT_TRUE(serial.InitTestFromBuffer(data, doc.size()));
+    serial.m_bVersionUpdated = FALSE;
+    serial.m_LastXRefOffset = 0;
+    serial.SetRebuildThreads(1);
+    FX_BOOL bRebuilt = serial.RebuildCrossRef();
+    EXPECT_EQ(bad_pos > 4096, !!bRebuilt);
+    // Nothing after the object is found.
+    for (size_t i = 0; i < serial.m_ObjectInfo.size(); ++i)
+      EXPECT_GE((FX_FILESIZE)insert_pos, serial.m_ObjectInfo[i].pos) << i;
+
+    for (int threads : {2, 7}) {
+      CPDF_TestParser parser;
+      ASSERT_TRUE(parser.InitTestFromBuffer(data, doc.size()));
+      parser.m_bVersionUpdated = FALSE;
+      parser.SetRebuildThreads(threads);
+      EXPECT_EQ(bRebuilt, parser.RebuildCrossRef());
+      serial.ExpectSameRebuild(parser);
+    }
+  }
+}
+
 TEST(fpdf_parser_parser, LoadCrossRefV4) {
   {
     const unsigned char xref_table[] =
@@ -368,3 +596,72 @@ TEST(fpdf_parser_parser, LoadCrossRefV4) {
     ASSERT_TRUE(CompareArray(parser.m_V5Type, types, FX_ArraySize(types)));
   }
 }
+
+TEST(fpdf_parser_parser, LoadCrossRefV5HugeSize) {
+  const unsigned char xref_stream[] =
+      "1 0 obj\n"
+      "<< /Type /XRef /Size 2147483647 /W [1 1 1] /Length 3 >>\n"
+      "stream\n"
+      "\x01\x00\x00\n"
+      "endstream\n"
+      "endobj\n";
+  CPDF_TestParser parser;
+  ASSERT_TRUE(
+      parser.InitTestFromBuffer(xref_stream, FX_ArraySize(xref_stream)));
+
+  // Rejected before the object table grows to the trailer's /Size.
+  FX_FILESIZE pos = 0;
+  EXPECT_FALSE(parser.LoadCrossRefV5(&pos, TRUE));
+  EXPECT_TRUE(parser.m_ObjectInfo.empty());
+}
+
+TEST(fpdf_parser_parser, FindWordEnd) {
+  // Put each byte value at every position of a 40 byte run, so it lands in
+  // both the vector loop and the tail, and check against PDF_CharType.
+  uint8_t data[40];
+  for (int ch = 0; ch < 256; ++ch) {
+    for (FX_DWORD pos = 0; pos < sizeof(data); ++pos) {
+      FXSYS_memset(data, 'a', sizeof(data));
+      data[pos] = (uint8_t)ch;
+      bool bWordEnd = PDFCharIsWhitespace(ch) || PDFCharIsDelimiter(ch);
+      bool bLineEnding = PDFCharIsLineEnding(ch);
+      for (FX_DWORD size = 0; size <= sizeof(data); ++size) {
+        FX_DWORD expected = pos < size ? pos : size;
+        EXPECT_EQ(bWordEnd ? expected : size, PDF_FindWordEnd(data, size))
+            << ch << " " << pos << " " << size;
+        EXPECT_EQ(bLineEnding ? expected : size,
+                  PDF_FindLineEnding(data, size))
+            << ch << " " << pos << " " << size;
+      }
+    }
+  }
+}
+
+TEST(fpdf_parser_parser, GetNextWordAcrossBuffers) {
+  // Words that straddle the parser's 512 byte read buffer, or overflow the
+  // word buffer, come out the same as they always have.
+  for (FX_DWORD padding = 480; padding < 520; ++padding) {
+    std::string long_name(300, 'N');
+    std::string content = std::string(padding, ' ') + "/" + long_name +
+                          " 123.45 % comment\r-7/Name[word]";
+    ScopedFileStream stream(FX_CreateMemoryStream(
+        reinterpret_cast<uint8_t*>(&content[0]), content.size(), FALSE));
+    CPDF_SyntaxParser parser;
+    parser.InitParser(stream.get(), 0);
+
+    bool bIsNumber;
+    EXPECT_EQ(("/" + long_name.substr(0, 255)).c_str(),
+              parser.GetNextWord(&bIsNumber));
+    EXPECT_FALSE(bIsNumber);
+    EXPECT_EQ("123.45", parser.GetNextWord(&bIsNumber));
+    EXPECT_TRUE(bIsNumber);
+    EXPECT_EQ("-7", parser.GetNextWord(&bIsNumber));
+    EXPECT_TRUE(bIsNumber);
+    EXPECT_EQ("/Name", parser.GetNextWord(&bIsNumber));
+    EXPECT_EQ("[", parser.GetNextWord(&bIsNumber));
+    EXPECT_EQ("word", parser.GetNextWord(&bIsNumber));
+    EXPECT_FALSE(bIsNumber);
+    EXPECT_EQ("]", parser.GetNextWord(&bIsNumber));
+    EXPECT_EQ((FX_FILESIZE)content.size(), parser.SavePos());
+  }
+}
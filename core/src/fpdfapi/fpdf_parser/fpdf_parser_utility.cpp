@@ -8,6 +8,10 @@
 
 #include "core/include/fxcrt/fx_ext.h"
 
+#if defined(PDF_USE_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 // Indexed by 8-bit character code, contains either:
 //   'W' - for whitespace: NUL, TAB, CR, LF, FF, SPACE, 0x80, 0xff
 //   'N' - for numeric: 0123456789+-.
@@ -60,6 +64,81 @@ const char PDF_CharType[256] = {
     'R', 'R', 'R', 'R', 'R', 'R', 'R', 'R', 'R', 'R', 'R', 'R', 'R', 'R', 'R',
     'R', 'R', 'R', 'R', 'R', 'R', 'R', 'W'};
 
+#ifdef PDF_USE_SSE2
+namespace {
+
+int LowestSetBit(int mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// Returns a mask with 0xff in each byte of |v| that is whitespace or a
+// delimiter in PDF_CharType.
+__m128i WordEndMask(__m128i v) {
+  const __m128i or1 = _mm_or_si128(v, _mm_set1_epi8(0x01));
+  const __m128i or2 = _mm_or_si128(v, _mm_set1_epi8(0x02));
+  const __m128i or20 = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  // Whitespace: NUL, TAB, LF, FF and CR, SPACE, 0x80, 0xff.
+  __m128i mask = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x09)));
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x0a)));
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(or1, _mm_set1_epi8(0x0d)));
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x20)));
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0x80)));
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0xff)));
+  // Delimiters: % / ( ) < > [ ] { }.
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8('%')));
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(or1, _mm_set1_epi8(')')));
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(or2, _mm_set1_epi8('>')));
+  mask = _mm_or_si128(mask, _mm_cmpeq_epi8(or20, _mm_set1_epi8('{')));
+  return _mm_or_si128(mask, _mm_cmpeq_epi8(or20, _mm_set1_epi8('}')));
+}
+
+}  // namespace
+#endif  // PDF_USE_SSE2
+
+FX_DWORD PDF_FindWordEnd(const uint8_t* pData, FX_DWORD size) {
+  FX_DWORD i = 0;
+#ifdef PDF_USE_SSE2
+  for (; i + 16 <= size; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + i));
+    int mask = _mm_movemask_epi8(WordEndMask(v));
+    if (mask)
+      return i + LowestSetBit(mask);
+  }
+#endif
+  for (; i < size; ++i) {
+    if (PDFCharIsWhitespace(pData[i]) || PDFCharIsDelimiter(pData[i]))
+      break;
+  }
+  return i;
+}
+
+FX_DWORD PDF_FindLineEnding(const uint8_t* pData, FX_DWORD size) {
+  FX_DWORD i = 0;
+#ifdef PDF_USE_SSE2
+  for (; i + 16 <= size; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + i));
+    __m128i mask = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                                _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    int bits = _mm_movemask_epi8(mask);
+    if (bits)
+      return i + LowestSetBit(bits);
+  }
+#endif
+  for (; i < size; ++i) {
+    if (PDFCharIsLineEnding(pData[i]))
+      break;
+  }
+  return i;
+}
+
 CPDF_SimpleParser::CPDF_SimpleParser(const uint8_t* pData, FX_DWORD dwSize) {
   m_pData = pData;
   m_dwSize = dwSize;
@@ -0,0 +1,338 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "core/include/fpdfapi/fpdf_parser.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "core/include/fpdfapi/fpdf_serial.h"
+#include "core/include/fxcrt/fx_ext.h"
+
+// An xref index records the cross-reference state that StartParse() builds
+// for a file, so that reopening the same file can skip the xref tables and
+// streams, or a full rebuild for damaged files. All integers are stored in
+// little-endian order:
+//
+//   magic "PDFXRIDX", format version,
+//   file size, header offset, hashes of the first and last file bytes,
+//   file modification time,
+//   flags, last xref offset, trailer dictionary in PDF syntax,
+//   object offsets, object types, object generations, sorted offsets,
+//   hash of everything above.
+
+namespace {
+
+using ScopedFileStream =
+    std::unique_ptr<IFX_FileStream, ReleaseDeleter<IFX_FileStream>>;
+
+const char kXRefIndexMagic[] = "PDFXRIDX";
+const FX_DWORD kXRefIndexMagicSize = 8;
+const FX_DWORD kXRefIndexVersion = 3;
+
+// The number of bytes hashed at each end of the file to detect changes.
+const FX_DWORD kFingerprintSize = 1024;
+
+// Refuse to load indexes beyond this size.
+const FX_FILESIZE kMaxXRefIndexSize = 256 * 1024 * 1024;
+
+const FX_DWORD kIndexFlagXRefStream = 1;
+const FX_DWORD kIndexFlagVersionUpdated = 2;
+
+FX_DWORD HashBytes(const uint8_t* pData, FX_DWORD size) {
+  return FX_HashCode_String_GetA(reinterpret_cast<const FX_CHAR*>(pData),
+                                 size);
+}
+
+FX_BOOL GetFileFingerprint(IFX_FileRead* pFile,
+                           FX_DWORD* pHeadHash,
+                           FX_DWORD* pTailHash) {
+  FX_FILESIZE file_size = pFile->GetSize();
+  FX_DWORD size = (FX_DWORD)std::min<FX_FILESIZE>(file_size, kFingerprintSize);
+  std::vector<uint8_t> buffer(size);
+  if (size == 0)
+    return FALSE;
+  if (!pFile->ReadBlock(buffer.data(), 0, size))
+    return FALSE;
+  *pHeadHash = HashBytes(buffer.data(), size);
+  if (!pFile->ReadBlock(buffer.data(), file_size - size, size))
+    return FALSE;
+  *pTailHash = HashBytes(buffer.data(), size);
+  return TRUE;
+}
+
+class CPDF_XRefIndexWriter {
+ public:
+  void WriteDWord(FX_DWORD value) {
+    for (int i = 0; i < 4; ++i)
+      m_Buf.AppendByte((uint8_t)(value >> (i * 8)));
+  }
+  void WriteInt64(int64_t value) {
+    uint64_t v = (uint64_t)value;
+    for (int i = 0; i < 8; ++i)
+      m_Buf.AppendByte((uint8_t)(v >> (i * 8)));
+  }
+  void WriteFileSize(FX_FILESIZE value) { WriteInt64(value); }
+  void WriteBlock(const void* pData, FX_DWORD size) {
+    m_Buf.AppendBlock(pData, size);
+  }
+  const CFX_BinaryBuf& GetBuffer() const { return m_Buf; }
+
+ private:
+  CFX_BinaryBuf m_Buf;
+};
+
+class CPDF_XRefIndexReader {
+ public:
+  CPDF_XRefIndexReader(const uint8_t* pData, FX_DWORD size)
+      : m_pData(pData), m_dwSize(size), m_dwPos(0) {}
+
+  bool ReadDWord(FX_DWORD* pValue) {
+    if (m_dwSize - m_dwPos < 4)
+      return false;
+    FX_DWORD value = 0;
+    for (int i = 0; i < 4; ++i)
+      value |= (FX_DWORD)m_pData[m_dwPos++] << (i * 8);
+    *pValue = value;
+    return true;
+  }
+  bool ReadInt64(int64_t* pValue) {
+    if (m_dwSize - m_dwPos < 8)
+      return false;
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i)
+      value |= (uint64_t)m_pData[m_dwPos++] << (i * 8);
+    *pValue = (int64_t)value;
+    return true;
+  }
+  bool ReadFileSize(FX_FILESIZE* pValue) {
+    int64_t value;
+    if (!ReadInt64(&value))
+      return false;
+    *pValue = (FX_FILESIZE)value;
+    return true;
+  }
+  bool ReadBlock(const uint8_t** ppData, FX_DWORD size) {
+    if (m_dwSize - m_dwPos < size)
+      return false;
+    *ppData = m_pData + m_dwPos;
+    m_dwPos += size;
+    return true;
+  }
+  // Reads an element count, checking that |element_size| bytes are left for
+  // each element.
+  bool ReadCount(FX_DWORD* pCount, FX_DWORD element_size) {
+    return ReadDWord(pCount) &&
+           *pCount <= (m_dwSize - m_dwPos) / element_size;
+  }
+  FX_DWORD GetPos() const { return m_dwPos; }
+
+ private:
+  const uint8_t* const m_pData;
+  const FX_DWORD m_dwSize;
+  FX_DWORD m_dwPos;
+};
+
+}  // namespace
+
+FX_BOOL CPDF_Parser::SaveXRefIndex(IFX_FileWrite* pFile) {
+  IFX_FileRead* pFileAccess = m_Syntax.m_pFileAccess;
+  if (!pFile || !pFileAccess || !m_pTrailer || m_ObjectInfo.empty())
+    return FALSE;
+
+  FX_DWORD head_hash;
+  FX_DWORD tail_hash;
+  if (!GetFileFingerprint(pFileAccess, &head_hash, &tail_hash))
+    return FALSE;
+
+  CPDF_XRefIndexWriter writer;
+  writer.WriteBlock(kXRefIndexMagic, kXRefIndexMagicSize);
+  writer.WriteDWord(kXRefIndexVersion);
+  writer.WriteFileSize(m_Syntax.m_FileLen);
+  writer.WriteDWord(m_Syntax.m_HeaderOffset);
+  writer.WriteDWord(head_hash);
+  writer.WriteDWord(tail_hash);
+  writer.WriteInt64(m_FileModifiedTime);
+  FX_DWORD flags = 0;
+  if (m_bXRefStream)
+    flags |= kIndexFlagXRefStream;
+  if (m_bVersionUpdated)
+    flags |= kIndexFlagVersionUpdated;
+  writer.WriteDWord(flags);
+  writer.WriteFileSize(m_LastXRefOffset);
+
+  CFX_ByteTextBuf trailer;
+  trailer << m_pTrailer;
+  writer.WriteDWord(trailer.GetSize());
+  writer.WriteBlock(trailer.GetBuffer(), trailer.GetSize());
+
+  writer.WriteDWord((FX_DWORD)m_ObjectInfo.size());
+  for (const auto& info : m_ObjectInfo)
+    writer.WriteFileSize(info.pos);
+  writer.WriteDWord(m_V5Type.GetSize());
+  writer.WriteBlock(m_V5Type.GetData(), m_V5Type.GetSize());
+  writer.WriteDWord(m_ObjVersion.GetSize());
+  for (int i = 0; i < m_ObjVersion.GetSize(); ++i) {
+    FX_WORD gennum = m_ObjVersion.GetAt(i);
+    uint8_t bytes[2] = {(uint8_t)gennum, (uint8_t)(gennum >> 8)};
+    writer.WriteBlock(bytes, 2);
+  }
+  writer.WriteDWord(m_SortedOffset.GetSize());
+  for (int i = 0; i < m_SortedOffset.GetSize(); ++i)
+    writer.WriteFileSize(m_SortedOffset.GetAt(i));
+
+  const CFX_BinaryBuf& buf = writer.GetBuffer();
+  writer.WriteDWord(HashBytes(buf.GetBuffer(), buf.GetSize()));
+  return pFile->WriteBlock(buf.GetBuffer(), 0, buf.GetSize()) &&
+         pFile->Flush();
+}
+
+FX_BOOL CPDF_Parser::LoadXRefIndex(IFX_FileRead* pIndex) {
+  FX_FILESIZE index_size = pIndex->GetSize();
+  if (index_size <= 4 || index_size > kMaxXRefIndexSize)
+    return FALSE;
+
+  std::vector<uint8_t> data((size_t)index_size);
+  if (!pIndex->ReadBlock(data.data(), 0, data.size()))
+    return FALSE;
+
+  FX_DWORD payload_size = (FX_DWORD)index_size - 4;
+  CPDF_XRefIndexReader checksum_reader(data.data() + payload_size, 4);
+  FX_DWORD checksum;
+  if (!checksum_reader.ReadDWord(&checksum) ||
+      checksum != HashBytes(data.data(), payload_size)) {
+    return FALSE;
+  }
+
+  CPDF_XRefIndexReader reader(data.data(), payload_size);
+  const uint8_t* magic;
+  FX_DWORD version;
+  if (!reader.ReadBlock(&magic, kXRefIndexMagicSize) ||
+      FXSYS_memcmp(magic, kXRefIndexMagic, kXRefIndexMagicSize) != 0 ||
+      !reader.ReadDWord(&version) || version != kXRefIndexVersion) {
+    return FALSE;
+  }
+
+  // Make sure the index was written for this file, as it is now.
+  FX_FILESIZE file_size;
+  FX_DWORD header_offset;
+  FX_DWORD head_hash;
+  FX_DWORD tail_hash;
+  FX_DWORD file_head_hash;
+  FX_DWORD file_tail_hash;
+  int64_t modified_time;
+  if (!reader.ReadFileSize(&file_size) || file_size != m_Syntax.m_FileLen ||
+      !reader.ReadDWord(&header_offset) ||
+      header_offset != m_Syntax.m_HeaderOffset ||
+      !reader.ReadDWord(&head_hash) || !reader.ReadDWord(&tail_hash) ||
+      !reader.ReadInt64(&modified_time) ||
+      modified_time != m_FileModifiedTime ||
+      !GetFileFingerprint(m_Syntax.m_pFileAccess, &file_head_hash,
+                          &file_tail_hash) ||
+      head_hash != file_head_hash || tail_hash != file_tail_hash) {
+    return FALSE;
+  }
+
+  FX_DWORD flags;
+  FX_FILESIZE last_xref_offset;
+  FX_DWORD trailer_size;
+  const uint8_t* trailer_data;
+  if (!reader.ReadDWord(&flags) || !reader.ReadFileSize(&last_xref_offset) ||
+      !reader.ReadDWord(&trailer_size) ||
+      !reader.ReadBlock(&trailer_data, trailer_size)) {
+    return FALSE;
+  }
+
+  FX_DWORD count;
+  if (!reader.ReadCount(&count, 8))
+    return FALSE;
+  std::vector<ObjectInfo> object_info(count);
+  for (FX_DWORD i = 0; i < count; ++i) {
+    if (!reader.ReadFileSize(&object_info[i].pos))
+      return FALSE;
+  }
+  const uint8_t* types;
+  if (!reader.ReadCount(&count, 1) || !reader.ReadBlock(&types, count))
+    return FALSE;
+  CFX_ByteArray v5_type;
+  v5_type.SetSize(count);
+  if (count)
+    FXSYS_memcpy(v5_type.GetData(), types, count);
+
+  const uint8_t* versions;
+  if (!reader.ReadCount(&count, 2) || !reader.ReadBlock(&versions, count * 2))
+    return FALSE;
+  CFX_WordArray obj_version;
+  obj_version.SetSize(count);
+  for (FX_DWORD i = 0; i < count; ++i)
+    obj_version[i] = versions[i * 2] | (versions[i * 2 + 1] << 8);
+
+  if (!reader.ReadCount(&count, 8))
+    return FALSE;
+  CFX_FileSizeArray sorted_offset;
+  sorted_offset.SetSize(count);
+  for (FX_DWORD i = 0; i < count; ++i) {
+    if (!reader.ReadFileSize(&sorted_offset[i]) || sorted_offset[i] < 0 ||
+        sorted_offset[i] >= m_Syntax.m_FileLen) {
+      return FALSE;
+    }
+  }
+  if (reader.GetPos() != payload_size)
+    return FALSE;
+
+  // The hash only catches accidental damage, so check that the tables agree
+  // before the parser indexes one with another: each object has a known
+  // type, objects in the file lie within it, and compressed objects live in
+  // object streams listed here too.
+  count = (FX_DWORD)object_info.size();
+  if ((FX_DWORD)v5_type.GetSize() != count ||
+      (FX_DWORD)obj_version.GetSize() != count) {
+    return FALSE;
+  }
+  for (FX_DWORD i = 0; i < count; ++i) {
+    switch (v5_type[i]) {
+      case 0:
+        break;
+      case 1:
+      case 255:  // A cross-reference stream, see LoadCrossRefV5().
+        if (object_info[i].pos < 0 ||
+            object_info[i].pos >= m_Syntax.m_FileLen) {
+          return FALSE;
+        }
+        break;
+      case 2: {
+        FX_FILESIZE stream_objnum = object_info[i].pos;
+        if (stream_objnum <= 0 || stream_objnum >= (FX_FILESIZE)count ||
+            v5_type[(FX_DWORD)stream_objnum] != 1) {
+          return FALSE;
+        }
+        break;
+      }
+      default:
+        return FALSE;
+    }
+  }
+
+  ScopedFileStream trailer_stream(FX_CreateMemoryStream(
+      const_cast<uint8_t*>(trailer_data), trailer_size, FALSE));
+  CPDF_SyntaxParser trailer_parser;
+  trailer_parser.InitParser(trailer_stream.get(), 0);
+  std::unique_ptr<CPDF_Object, ReleaseDeleter<CPDF_Object>> pTrailer(
+      trailer_parser.GetObject(m_pDocument, 0, 0, nullptr, false));
+  if (!ToDictionary(pTrailer.get()))
+    return FALSE;
+
+  if (m_pTrailer)
+    m_pTrailer->Release();
+  m_pTrailer = pTrailer.release()->AsDictionary();
+  m_ObjectInfo.swap(object_info);
+  m_V5Type.Copy(v5_type);
+  m_ObjVersion.Copy(obj_version);
+  m_SortedOffset.Copy(sorted_offset);
+  m_LastXRefOffset = last_xref_offset;
+  m_bXRefStream = !!(flags & kIndexFlagXRefStream);
+  m_bVersionUpdated = !!(flags & kIndexFlagVersionUpdated);
+  return TRUE;
+}
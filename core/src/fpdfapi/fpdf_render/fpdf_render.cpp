@@ -6,19 +6,72 @@
 
 #include "render_int.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "core/include/fpdfapi/fpdf_module.h"
 #include "core/include/fpdfapi/fpdf_render.h"
 #include "core/include/fxge/fx_ge.h"
 #include "core/src/fpdfapi/fpdf_page/pageint.h"
 
+namespace {
+
+// The render module keeps render data of its own, with no document.
+std::recursive_mutex* GetDocLock(CPDF_Document* pDoc) {
+  return pDoc ? pDoc->GetSharedLock() : nullptr;
+}
+
+// CPDF_RenderContext::RenderTiled() hands out several bands per thread, so
+// that threads whose bands render quickly take on more of them.
+const int kBandsPerThread = 4;
+const int kMinBandHeight = 32;
+
+// Whether CPDF_RenderStatus::ProcessTransparency() would draw an object of
+// |pObjs| into an offscreen bitmap. That bitmap is placed at the top left of
+// the object's clipped box, so a band gets other float coordinates, and
+// other rounding, than the whole area does.
+FX_BOOL NeedsGroupBitmap(const CPDF_PageObjects* pObjs) {
+  if (pObjs->BackgroundAlphaNeeded())
+    return TRUE;
+
+  FX_POSITION pos = pObjs->GetFirstObjectPosition();
+  while (pos) {
+    const CPDF_PageObject* pObj = pObjs->GetNextObject(pos);
+    const CPDF_GeneralStateData* pGeneralState = pObj->m_GeneralState;
+    if (pGeneralState && (pGeneralState->m_pSoftMask ||
+                          pGeneralState->m_BlendType != FXDIB_BLEND_NORMAL)) {
+      return TRUE;
+    }
+    if (pObj->m_ClipPath.NotNull() && pObj->m_ClipPath.GetTextCount())
+      return TRUE;
+    if (pObj->m_Type != PDFPAGE_FORM)
+      continue;
+
+    const CPDF_FormObject* pFormObj = static_cast<const CPDF_FormObject*>(pObj);
+    if ((pGeneralState && pGeneralState->m_FillAlpha != 1.0f) ||
+        (pFormObj->m_pForm->m_Transparency &
+         (PDFTRANS_ISOLATED | PDFTRANS_KNOCKOUT)) ||
+        NeedsGroupBitmap(pFormObj->m_pForm)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+}  // namespace
+
 CPDF_DocRenderData::CPDF_DocRenderData(CPDF_Document* pPDFDoc)
     : m_pPDFDoc(pPDFDoc), m_pFontCache(new CFX_FontCache) {}
 
 CPDF_DocRenderData::~CPDF_DocRenderData() {
   Clear(TRUE);
+  CPDF_DocImageCache::GetProcessCache()->Remove(m_pPDFDoc, 0);
 }
 
 void CPDF_DocRenderData::Clear(FX_BOOL bRelease) {
+  CFX_AutoLock lock(GetDocLock(m_pPDFDoc));
   for (auto it = m_Type3FaceMap.begin(); it != m_Type3FaceMap.end();) {
     auto curr_it = it++;
     CPDF_CountedObject<CPDF_Type3Cache>* cache = curr_it->second;
@@ -49,7 +102,15 @@ void CPDF_DocRenderData::Clear(FX_BOOL bRelease) {
   }
 }
 
+CPDF_DocImageCache* CPDF_DocRenderData::GetImageCache(FX_BOOL bCreate) {
+  CFX_AutoLock lock(GetDocLock(m_pPDFDoc));
+  if (!m_pImageCache && bCreate)
+    m_pImageCache.reset(new CPDF_DocImageCache);
+  return m_pImageCache.get();
+}
+
 CPDF_Type3Cache* CPDF_DocRenderData::GetCachedType3(CPDF_Type3Font* pFont) {
+  CFX_AutoLock lock(GetDocLock(m_pPDFDoc));
   CPDF_CountedObject<CPDF_Type3Cache>* pCache;
   auto it = m_Type3FaceMap.find(pFont);
   if (it == m_Type3FaceMap.end()) {
@@ -63,6 +124,7 @@ CPDF_Type3Cache* CPDF_DocRenderData::GetCachedType3(CPDF_Type3Font* pFont) {
 }
 
 void CPDF_DocRenderData::ReleaseCachedType3(CPDF_Type3Font* pFont) {
+  CFX_AutoLock lock(GetDocLock(m_pPDFDoc));
   auto it = m_Type3FaceMap.find(pFont);
   if (it != m_Type3FaceMap.end())
     it->second->RemoveRef();
@@ -154,7 +216,7 @@ FX_ARGB CPDF_RenderOptions::TranslateColor(FX_ARGB argb) const {
 }
 
 // static
-int CPDF_RenderStatus::s_CurrentRecursionDepth = 0;
+thread_local int CPDF_RenderStatus::s_CurrentRecursionDepth = 0;
 
 CPDF_RenderStatus::CPDF_RenderStatus()
     : m_pFormResource(nullptr),
@@ -246,6 +308,16 @@ void CPDF_RenderStatus::RenderObjectList(const CPDF_PageObjects* pObjs,
   CFX_Matrix device2object;
   device2object.SetReverse(*pObj2Device);
   device2object.TransformRect(clip_rect);
+  if (pObjs->HasObjectIndex() && !m_pStopObj) {
+    std::vector<FX_POSITION> positions;
+    pObjs->GetObjectsInRect(clip_rect, &positions);
+    for (FX_POSITION pos : positions) {
+      RenderSingleObject(pObjs->GetObjectAt(pos), pObj2Device);
+      if (m_bStopped)
+        return;
+    }
+    return;
+  }
   int index = 0;
   FX_POSITION pos = pObjs->GetFirstObjectPosition();
   while (pos) {
@@ -1022,6 +1094,70 @@ void CPDF_RenderContext::Render(CFX_RenderDevice* pDevice,
     pDevice->RestoreState();
   }
 }
+int CPDF_RenderContext::RenderTiled(CFX_DIBitmap* pBitmap,
+                                    FX_BOOL bRgbByteOrder,
+                                    const FX_RECT& clip,
+                                    const CPDF_RenderOptions* pOptions,
+                                    int nThreads) {
+  FX_RECT area = clip;
+  area.Intersect(0, 0, pBitmap->GetWidth(), pBitmap->GetHeight());
+  if (area.IsEmpty())
+    return 0;
+
+  // Bands would draw transparency groups and soft masks with other rounding,
+  // so pages using them render in one piece.
+  FX_BOOL bBandable = !(pOptions && (pOptions->m_Flags & RENDER_OVERPRINT));
+  for (int i = 0; bBandable && i < m_ContentList.GetSize(); i++) {
+    const CPDF_PageObjects* pObjs = m_ContentList.GetDataPtr(i)->m_pObjectList;
+    bBandable = pObjs->IsParsed() && !NeedsGroupBitmap(pObjs);
+  }
+  // No more threads than bands, which also keeps the product from
+  // overflowing.
+  int nMaxBands = area.Height() / kMinBandHeight;
+  nThreads = std::min(nThreads, nMaxBands);
+  int nBands = std::min(nThreads * kBandsPerThread, nMaxBands);
+  if (nThreads <= 1 || nBands <= 1 || !bBandable || !m_pPageCache ||
+      !m_pDocument->GetSharedLock()) {
+    RenderBand(pBitmap, bRgbByteOrder, area, pOptions, m_pPageCache);
+    return 1;
+  }
+
+  // The bands only read the object lists from here on.
+  for (int i = 0; i < m_ContentList.GetSize(); i++)
+    m_ContentList.GetDataPtr(i)->m_pObjectList->UpdateObjectIndex();
+
+  std::atomic<int> next_band(0);
+  auto render_bands = [&]() {
+    CPDF_PageRenderCache cache(m_pPageCache->GetPage());
+    int band;
+    while ((band = next_band++) < nBands) {
+      FX_RECT rect(area.left, area.top + area.Height() * band / nBands,
+                   area.right, area.top + area.Height() * (band + 1) / nBands);
+      RenderBand(pBitmap, bRgbByteOrder, rect, pOptions, &cache);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < nThreads; i++)
+    threads.push_back(std::thread(render_bands));
+  render_bands();
+  for (std::thread& thread : threads)
+    thread.join();
+  return nBands;
+}
+void CPDF_RenderContext::RenderBand(CFX_DIBitmap* pBitmap,
+                                    FX_BOOL bRgbByteOrder,
+                                    const FX_RECT& rect,
+                                    const CPDF_RenderOptions* pOptions,
+                                    CPDF_PageRenderCache* pPageCache) const {
+  CPDF_RenderContext context(m_pDocument, pPageCache);
+  context.m_pPageResources = m_pPageResources;
+  context.m_ContentList.Copy(m_ContentList);
+  CFX_FxgeDevice device;
+  device.Attach(pBitmap, 0, bRgbByteOrder);
+  device.SetClip_Rect(&rect);
+  CPDF_ProgressiveRenderer renderer(&context, &device, pOptions);
+  renderer.Start(nullptr);
+}
 void CPDF_RenderContext::DrawObjectList(CFX_RenderDevice* pDevice,
                                         CPDF_PageObjects* pObjs,
                                         const CFX_Matrix* pObject2Device,
@@ -1041,7 +1177,9 @@ CPDF_ProgressiveRenderer::CPDF_ProgressiveRenderer(
       m_LayerIndex(0),
       m_ObjectIndex(0),
       m_ObjectPos(nullptr),
-      m_PrevLastPos(nullptr) {
+      m_PrevLastPos(nullptr),
+      m_bIndexed(false),
+      m_NextIndexed(0) {
 }
 
 CPDF_ProgressiveRenderer::~CPDF_ProgressiveRenderer() {
@@ -1106,6 +1244,17 @@ void CPDF_ProgressiveRenderer::Continue(IFX_Pause* pPause) {
       CFX_Matrix device2object;
       device2object.SetReverse(pItem->m_Matrix);
       device2object.TransformRect(m_ClipRect);
+
+      // Only visit the objects the index finds within the clip box.
+      m_IndexedPositions.clear();
+      m_NextIndexed = 0;
+      m_bIndexed = pItem->m_pObjectList->IsParsed() &&
+                   pItem->m_pObjectList->HasObjectIndex();
+      if (m_bIndexed) {
+        pItem->m_pObjectList->GetObjectsInRect(m_ClipRect,
+                                               &m_IndexedPositions);
+        m_ObjectPos = GetNextIndexedPosition();
+      }
     }
     int objs_to_go = CPDF_ModuleMgr::Get()
                          ->GetRenderModule()
@@ -1134,7 +1283,10 @@ void CPDF_ProgressiveRenderer::Continue(IFX_Pause* pPause) {
         }
       }
       m_ObjectIndex++;
-      pItem->m_pObjectList->GetNextObject(m_ObjectPos);
+      if (m_bIndexed)
+        m_ObjectPos = GetNextIndexedPosition();
+      else
+        pItem->m_pObjectList->GetNextObject(m_ObjectPos);
       if (objs_to_go == 0) {
         if (pPause && pPause->NeedToPauseNow()) {
           return;
@@ -1159,6 +1311,11 @@ void CPDF_ProgressiveRenderer::Continue(IFX_Pause* pPause) {
   }
   m_Status = Done;
 }
+FX_POSITION CPDF_ProgressiveRenderer::GetNextIndexedPosition() {
+  if (m_NextIndexed >= m_IndexedPositions.size())
+    return nullptr;
+  return m_IndexedPositions[m_NextIndexed++];
+}
 int CPDF_ProgressiveRenderer::EstimateProgress() {
   if (!m_pContext) {
     return 0;
@@ -1184,6 +1341,7 @@ CPDF_TransferFunc* CPDF_DocRenderData::GetTransferFunc(CPDF_Object* pObj) {
   if (!pObj)
     return nullptr;
 
+  CFX_AutoLock lock(GetDocLock(m_pPDFDoc));
   auto it = m_TransferFuncMap.find(pObj);
   if (it != m_TransferFuncMap.end()) {
     CPDF_CountedObject<CPDF_TransferFunc>* pTransferCounter = it->second;
@@ -1248,6 +1406,7 @@ CPDF_TransferFunc* CPDF_DocRenderData::GetTransferFunc(CPDF_Object* pObj) {
 }
 
 void CPDF_DocRenderData::ReleaseTransferFunc(CPDF_Object* pObj) {
+  CFX_AutoLock lock(GetDocLock(m_pPDFDoc));
   auto it = m_TransferFuncMap.find(pObj);
   if (it != m_TransferFuncMap.end())
     it->second->RemoveRef();
@@ -6,8 +6,11 @@
 
 #include "render_int.h"
 
+#include <cstdlib>
+
 #include "core/include/fpdfapi/fpdf_pageobj.h"
 #include "core/include/fpdfapi/fpdf_render.h"
+#include "core/include/fxcodec/fx_codec.h"
 #include "core/include/fxge/fx_ge.h"
 #include "core/src/fpdfapi/fpdf_page/pageint.h"
 
@@ -91,6 +94,10 @@ void CPDF_PageRenderCache::GetCachedBitmap(CPDF_Stream* pStream,
     pEntry = it->second;
   else
     pEntry = new CPDF_ImageCacheEntry(m_pPage->m_pDocument, pStream);
+  if (pEntry->IsTooCoarse(downsampleWidth, downsampleHeight)) {
+    m_nCacheSize -= pEntry->EstimateSize();
+    pEntry->Reset(NULL);
+  }
 
   m_nTimeCount++;
   FX_BOOL bAlreadyCached = pEntry->GetCachedBitmap(
@@ -119,6 +126,10 @@ FX_BOOL CPDF_PageRenderCache::StartGetCachedBitmap(
     m_pCurImageCacheEntry =
         new CPDF_ImageCacheEntry(m_pPage->m_pDocument, pStream);
   }
+  if (m_pCurImageCacheEntry->IsTooCoarse(downsampleWidth, downsampleHeight)) {
+    m_nCacheSize -= m_pCurImageCacheEntry->EstimateSize();
+    m_pCurImageCacheEntry->Reset(NULL);
+  }
   int ret = m_pCurImageCacheEntry->StartGetCachedBitmap(
       pRenderStatus->m_pFormResource, m_pPage->m_pPageResources, bStdCS,
       GroupFamily, bLoadMask, pRenderStatus, downsampleWidth, downsampleHeight);
@@ -160,6 +171,16 @@ void CPDF_PageRenderCache::ResetBitmap(CPDF_Stream* pStream,
   m_nCacheSize -= pEntry->EstimateSize();
   pEntry->Reset(pBitmap);
   m_nCacheSize += pEntry->EstimateSize();
+
+  // Other pages decode the image again rather than see the old pixels.
+  CPDF_Document* pDoc = m_pPage->m_pDocument;
+  FX_DWORD objnum = pStream->GetObjNum();
+  if (!objnum)
+    return;
+  CPDF_DocImageCache::GetProcessCache()->Remove(pDoc, objnum);
+  CPDF_DocImageCache* pDocCache = pDoc->GetRenderData()->GetImageCache(FALSE);
+  if (pDocCache)
+    pDocCache->Remove(pDoc, objnum);
 }
 CPDF_ImageCacheEntry::CPDF_ImageCacheEntry(CPDF_Document* pDoc,
                                            CPDF_Stream* pStream)
@@ -172,14 +193,26 @@ CPDF_ImageCacheEntry::CPDF_ImageCacheEntry(CPDF_Document* pDoc,
       m_pStream(pStream),
       m_pCachedBitmap(NULL),
       m_pCachedMask(NULL),
-      m_dwCacheSize(0) {}
+      m_dwCacheSize(0),
+      m_pSharedCache(NULL),
+      m_DownScale(1) {}
 CPDF_ImageCacheEntry::~CPDF_ImageCacheEntry() {
+  if (m_pShared)
+    return;
   delete m_pCachedBitmap;
   delete m_pCachedMask;
 }
 void CPDF_ImageCacheEntry::Reset(const CFX_DIBitmap* pBitmap) {
-  delete m_pCachedBitmap;
+  if (m_pShared) {
+    if (m_pCachedMask)
+      m_pCachedMask = m_pCachedMask->Clone();
+    m_pShared.reset();
+  } else {
+    delete m_pCachedBitmap;
+  }
+  m_pSharedCache = NULL;
   m_pCachedBitmap = NULL;
+  m_DownScale = 1;
   if (pBitmap) {
     m_pCachedBitmap = pBitmap->Clone();
   }
@@ -222,16 +255,24 @@ FX_BOOL CPDF_ImageCacheEntry::GetCachedBitmap(CFX_DIBSource*& pBitmap,
   CPDF_RenderContext* pContext = pRenderStatus->GetContext();
   CPDF_PageRenderCache* pPageRenderCache = pContext->GetPageCache();
   m_dwTimeCount = pPageRenderCache->GetTimeCount();
+  if (FindShared(pRenderStatus->m_pFormResource, pPageResources, bStdCS,
+                 GroupFamily, bLoadMask)) {
+    pBitmap = m_pCachedBitmap;
+    pMask = m_pCachedMask;
+    MatteColor = m_MatteColor;
+    return FALSE;
+  }
   CPDF_DIBSource* pSrc = new CPDF_DIBSource;
   CPDF_DIBSource* pMaskSrc = NULL;
   if (!pSrc->Load(m_pDocument, m_pStream, &pMaskSrc, &MatteColor,
                   pRenderStatus->m_pFormResource, pPageResources, bStdCS,
-                  GroupFamily, bLoadMask)) {
+                  GroupFamily, bLoadMask, downsampleWidth, downsampleHeight)) {
     delete pSrc;
     pBitmap = NULL;
     return FALSE;
   }
   m_MatteColor = MatteColor;
+  m_DownScale = pSrc->GetDownScale();
   if (pSrc->GetPitch() * pSrc->GetHeight() < FPDF_HUGE_IMAGE_SIZE) {
     m_pCachedBitmap = pSrc->Clone();
     delete pSrc;
@@ -246,6 +287,7 @@ FX_BOOL CPDF_ImageCacheEntry::GetCachedBitmap(CFX_DIBSource*& pBitmap,
   pBitmap = m_pCachedBitmap;
   pMask = m_pCachedMask;
   CalcSize();
+  AddShared();
   return FALSE;
 }
 CFX_DIBSource* CPDF_ImageCacheEntry::DetachBitmap() {
@@ -274,12 +316,21 @@ int CPDF_ImageCacheEntry::StartGetCachedBitmap(CPDF_Dictionary* pFormResources,
   if (!pRenderStatus) {
     return 0;
   }
+  if (FindShared(pFormResources, pPageResources, bStdCS, GroupFamily,
+                 bLoadMask)) {
+    m_dwTimeCount =
+        pRenderStatus->GetContext()->GetPageCache()->GetTimeCount();
+    m_pCurBitmap = m_pCachedBitmap;
+    m_pCurMask = m_pCachedMask;
+    return 0;
+  }
   m_pRenderStatus = pRenderStatus;
   m_pCurBitmap = new CPDF_DIBSource;
   int ret =
       ((CPDF_DIBSource*)m_pCurBitmap)
           ->StartLoadDIBSource(m_pDocument, m_pStream, TRUE, pFormResources,
-                               pPageResources, bStdCS, GroupFamily, bLoadMask);
+                               pPageResources, bStdCS, GroupFamily, bLoadMask,
+                               downsampleWidth, downsampleHeight);
   if (ret == 2) {
     return ret;
   }
@@ -293,6 +344,7 @@ int CPDF_ImageCacheEntry::StartGetCachedBitmap(CPDF_Dictionary* pFormResources,
 }
 void CPDF_ImageCacheEntry::ContinueGetCachedBitmap() {
   m_MatteColor = ((CPDF_DIBSource*)m_pCurBitmap)->m_MatteColor;
+  m_DownScale = ((CPDF_DIBSource*)m_pCurBitmap)->GetDownScale();
   m_pCurMask = ((CPDF_DIBSource*)m_pCurBitmap)->DetachMask();
   CPDF_RenderContext* pContext = m_pRenderStatus->GetContext();
   CPDF_PageRenderCache* pPageRenderCache = pContext->GetPageCache();
@@ -313,6 +365,7 @@ void CPDF_ImageCacheEntry::ContinueGetCachedBitmap() {
   m_pCurBitmap = m_pCachedBitmap;
   m_pCurMask = m_pCachedMask;
   CalcSize();
+  AddShared();
 }
 int CPDF_ImageCacheEntry::Continue(IFX_Pause* pPause) {
   int ret = ((CPDF_DIBSource*)m_pCurBitmap)->ContinueLoadDIBSource(pPause);
@@ -327,10 +380,204 @@ int CPDF_ImageCacheEntry::Continue(IFX_Pause* pPause) {
   ContinueGetCachedBitmap();
   return 0;
 }
+FX_BOOL CPDF_ImageCacheEntry::IsTooCoarse(int32_t downsampleWidth,
+                                          int32_t downsampleHeight) const {
+  if (!m_pCachedBitmap || m_DownScale <= 1)
+    return FALSE;
+  if (!downsampleWidth || !downsampleHeight)
+    return TRUE;
+
+  CPDF_Dictionary* pDict = m_pStream->GetDict();
+  return FX_GetDownsampleRatio(pDict->GetInteger("Width"),
+                               pDict->GetInteger("Height"),
+                               std::abs(downsampleWidth),
+                               std::abs(downsampleHeight)) < m_DownScale;
+}
 void CPDF_ImageCacheEntry::CalcSize() {
   m_dwCacheSize = FPDF_ImageCache_EstimateImageSize(m_pCachedBitmap) +
                   FPDF_ImageCache_EstimateImageSize(m_pCachedMask);
 }
+FX_BOOL CPDF_ImageCacheEntry::FindShared(CPDF_Dictionary* pFormResources,
+                                         CPDF_Dictionary* pPageResources,
+                                         FX_BOOL bStdCS,
+                                         FX_DWORD GroupFamily,
+                                         FX_BOOL bLoadMask) {
+  m_pSharedCache = CPDF_DocImageCache::ForDocument(m_pDocument);
+  if (!m_pSharedCache ||
+      !CPDF_DocImageCache::GetKey(m_pDocument, m_pStream, pFormResources,
+                                  pPageResources, bStdCS, GroupFamily,
+                                  bLoadMask, &m_SharedKey)) {
+    m_pSharedCache = NULL;
+    return FALSE;
+  }
+  m_pShared = m_pSharedCache->Find(m_SharedKey);
+  if (!m_pShared)
+    return FALSE;
+
+  m_pCachedBitmap = m_pShared->m_pBitmap;
+  m_pCachedMask = m_pShared->m_pMask;
+  m_MatteColor = m_pShared->m_MatteColor;
+  CalcSize();
+  return TRUE;
+}
+void CPDF_ImageCacheEntry::AddShared() {
+  // Huge images stay CPDF_DIBSources, decoded a line at a time as they are
+  // drawn, which only one page can do at once. Some of those have a buffer
+  // of their own, so go by the size the bitmap was cloned below. Reduced
+  // images would not suit every page.
+  if (!m_pSharedCache || !m_pCachedBitmap ||
+      m_pCachedBitmap->GetPitch() * m_pCachedBitmap->GetHeight() >=
+          FPDF_HUGE_IMAGE_SIZE ||
+      m_DownScale > 1) {
+    return;
+  }
+
+  m_pShared.reset(
+      new CPDF_DecodedImage(m_pCachedBitmap, m_pCachedMask, m_MatteColor));
+  m_pSharedCache->Add(m_SharedKey, m_pShared, m_dwCacheSize);
+}
+
+CPDF_DecodedImage::~CPDF_DecodedImage() {
+  delete m_pBitmap;
+  delete m_pMask;
+}
+
+// static
+CPDF_DocImageCache* CPDF_DocImageCache::GetProcessCache() {
+  static CPDF_DocImageCache s_ProcessCache;
+  return &s_ProcessCache;
+}
+
+// static
+CPDF_DocImageCache* CPDF_DocImageCache::GetDocumentCache(CPDF_Document* pDoc) {
+  return pDoc->GetRenderData()->GetImageCache(TRUE);
+}
+
+// static
+CPDF_DocImageCache* CPDF_DocImageCache::ForDocument(CPDF_Document* pDoc) {
+  CPDF_DocImageCache* pCache = pDoc->GetRenderData()->GetImageCache(FALSE);
+  if (pCache && pCache->GetBudget())
+    return pCache;
+
+  pCache = GetProcessCache();
+  return pCache->GetBudget() ? pCache : nullptr;
+}
+
+// static
+FX_BOOL CPDF_DocImageCache::GetKey(CPDF_Document* pDoc,
+                                   const CPDF_Stream* pStream,
+                                   CPDF_Dictionary* pFormResources,
+                                   CPDF_Dictionary* pPageResources,
+                                   FX_BOOL bStdCS,
+                                   FX_DWORD GroupFamily,
+                                   FX_BOOL bLoadMask,
+                                   Key* pKey) {
+  if (!pStream->GetObjNum())
+    return FALSE;
+
+  // Only a colour space named in the resources makes the pixels depend on
+  // where the image is drawn from.
+  CPDF_Dictionary* pDict = pStream->GetDict();
+  CPDF_Object* pCSObj = pDict ? pDict->GetElementValue("ColorSpace") : nullptr;
+  FX_DWORD form_objnum = 0;
+  FX_DWORD page_objnum = 0;
+  if (pCSObj && pCSObj->IsName() && pCSObj->GetString() != "DeviceGray" &&
+      pCSObj->GetString() != "DeviceRGB" &&
+      pCSObj->GetString() != "DeviceCMYK") {
+    // Direct resource dictionaries cannot be told apart once freed.
+    if ((pFormResources && !pFormResources->GetObjNum()) ||
+        (pPageResources && !pPageResources->GetObjNum())) {
+      return FALSE;
+    }
+    form_objnum = pFormResources ? pFormResources->GetObjNum() : 0;
+    page_objnum = pPageResources ? pPageResources->GetObjNum() : 0;
+  }
+  *pKey = Key(pDoc, pStream->GetObjNum(), form_objnum, page_objnum,
+              GroupFamily, !!bStdCS, !!bLoadMask);
+  return TRUE;
+}
+
+CPDF_DocImageCache::CPDF_DocImageCache()
+    : m_dwBudget(0), m_dwSize(0), m_nHits(0), m_nMisses(0) {}
+
+CPDF_DocImageCache::~CPDF_DocImageCache() {}
+
+void CPDF_DocImageCache::SetBudget(FX_DWORD dwBudget) {
+  std::lock_guard<std::mutex> lock(m_Lock);
+  m_dwBudget = dwBudget;
+  TrimToBudget();
+}
+
+FX_DWORD CPDF_DocImageCache::GetBudget() const {
+  std::lock_guard<std::mutex> lock(m_Lock);
+  return m_dwBudget;
+}
+
+FX_DWORD CPDF_DocImageCache::GetSize() const {
+  std::lock_guard<std::mutex> lock(m_Lock);
+  return m_dwSize;
+}
+
+FX_DWORD CPDF_DocImageCache::GetHitCount() const {
+  std::lock_guard<std::mutex> lock(m_Lock);
+  return m_nHits;
+}
+
+FX_DWORD CPDF_DocImageCache::GetMissCount() const {
+  std::lock_guard<std::mutex> lock(m_Lock);
+  return m_nMisses;
+}
+
+std::shared_ptr<CPDF_DecodedImage> CPDF_DocImageCache::Find(const Key& key) {
+  std::lock_guard<std::mutex> lock(m_Lock);
+  auto it = m_Images.find(key);
+  if (it == m_Images.end()) {
+    m_nMisses++;
+    return nullptr;
+  }
+  m_nHits++;
+  m_LRU.splice(m_LRU.begin(), m_LRU, it->second.m_LRUPos);
+  return it->second.m_pImage;
+}
+
+void CPDF_DocImageCache::Add(const Key& key,
+                             const std::shared_ptr<CPDF_DecodedImage>& pImage,
+                             FX_DWORD dwSize) {
+  std::lock_guard<std::mutex> lock(m_Lock);
+  if (dwSize > m_dwBudget)
+    return;
+
+  // Two pages decoding the same image at once both add it.
+  auto it = m_Images.find(key);
+  if (it != m_Images.end())
+    Erase(it);
+  m_LRU.push_front(key);
+  Entry entry = {pImage, dwSize, m_LRU.begin()};
+  m_Images[key] = entry;
+  m_dwSize += dwSize;
+  TrimToBudget();
+}
+
+void CPDF_DocImageCache::Remove(CPDF_Document* pDoc, FX_DWORD objnum) {
+  std::lock_guard<std::mutex> lock(m_Lock);
+  auto it = m_Images.lower_bound(
+      Key(pDoc, objnum, 0, 0, 0, FALSE, FALSE));
+  while (it != m_Images.end() && std::get<0>(it->first) == pDoc &&
+         (!objnum || std::get<1>(it->first) == objnum)) {
+    Erase(it++);
+  }
+}
+
+void CPDF_DocImageCache::TrimToBudget() {
+  while (m_dwSize > m_dwBudget)
+    Erase(m_Images.find(m_LRU.back()));
+}
+
+void CPDF_DocImageCache::Erase(std::map<Key, Entry>::iterator it) {
+  m_dwSize -= it->second.m_dwSize;
+  m_LRU.erase(it->second.m_LRUPos);
+  m_Images.erase(it);
+}
 void CPDF_Document::ClearRenderFont() {
   if (m_pDocRender) {
     CFX_FontCache* pCache = m_pDocRender->GetFontCache();
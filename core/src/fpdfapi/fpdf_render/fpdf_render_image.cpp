@@ -6,6 +6,7 @@
 
 #include "render_int.h"
 
+#include <algorithm>
 #include <utility>
 #include <vector>
 
@@ -318,16 +319,12 @@ CPDF_ImageRenderer::~CPDF_ImageRenderer() {
   delete m_pClone;
 }
 FX_BOOL CPDF_ImageRenderer::StartLoadDIBSource() {
-  CFX_FloatRect image_rect_f = m_ImageMatrix.GetUnitRect();
-  FX_RECT image_rect = image_rect_f.GetOutterRect();
-  int dest_width = image_rect.Width();
-  int dest_height = image_rect.Height();
-  if (m_ImageMatrix.a < 0) {
-    dest_width = -dest_width;
-  }
-  if (m_ImageMatrix.d > 0) {
-    dest_height = -dest_height;
-  }
+  // The device lengths of the image's edges, which for a rotated image are
+  // not those of its bounding box. The image may be decoded down to them.
+  FX_FLOAT width = FXSYS_sqrt2(m_ImageMatrix.a, m_ImageMatrix.b);
+  FX_FLOAT height = FXSYS_sqrt2(m_ImageMatrix.c, m_ImageMatrix.d);
+  int dest_width = (int)std::max(1.0f, std::min(FXSYS_ceil(width), 1e9f));
+  int dest_height = (int)std::max(1.0f, std::min(FXSYS_ceil(height), 1e9f));
   if (m_Loader.Start(m_pImageObject,
                      m_pRenderStatus->m_pContext->GetPageCache(), m_LoadHandle,
                      m_bStdCS, m_pRenderStatus->m_GroupFamily,
@@ -7,6 +7,7 @@
 #include "render_int.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <memory>
 #include <vector>
 
@@ -178,6 +179,8 @@ CPDF_DIBSource::CPDF_DIBSource() {
   m_pMaskStream = NULL;
   m_Status = 0;
   m_bHasMask = FALSE;
+  m_nDownsampleWidth = m_nDownsampleHeight = 0;
+  m_DownScale = 1;
 }
 CPDF_DIBSource::~CPDF_DIBSource() {
   delete m_pStreamAcc;
@@ -212,11 +215,15 @@ FX_BOOL CPDF_DIBSource::Load(CPDF_Document* pDoc,
                              CPDF_Dictionary* pPageResources,
                              FX_BOOL bStdCS,
                              FX_DWORD GroupFamily,
-                             FX_BOOL bLoadMask) {
+                             FX_BOOL bLoadMask,
+                             int32_t nDownsampleWidth,
+                             int32_t nDownsampleHeight) {
   if (!pStream) {
     return FALSE;
   }
   m_pDocument = pDoc;
+  m_nDownsampleWidth = std::abs(nDownsampleWidth);
+  m_nDownsampleHeight = std::abs(nDownsampleHeight);
   m_pDict = pStream->GetDict();
   if (!m_pDict) {
     return FALSE;
@@ -251,8 +258,8 @@ FX_BOOL CPDF_DIBSource::Load(CPDF_Document* pDoc,
     return FALSE;
   }
   if (m_bImageMask) {
-    m_bpp = 1;
-    m_bpc = 1;
+    // Reduced masks have averaged 8-bit samples.
+    m_bpp = m_bpc = m_DownScale > 1 ? 8 : 1;
     m_nComponents = 1;
     m_AlphaFlag = 1;
   } else if (m_bpc * m_nComponents == 1) {
@@ -291,8 +298,8 @@ FX_BOOL CPDF_DIBSource::Load(CPDF_Document* pDoc,
 }
 int CPDF_DIBSource::ContinueToLoadMask() {
   if (m_bImageMask) {
-    m_bpp = 1;
-    m_bpc = 1;
+    // Reduced masks have averaged 8-bit samples.
+    m_bpp = m_bpc = m_DownScale > 1 ? 8 : 1;
     m_nComponents = 1;
     m_AlphaFlag = 1;
   } else if (m_bpc * m_nComponents == 1) {
@@ -333,11 +340,15 @@ int CPDF_DIBSource::StartLoadDIBSource(CPDF_Document* pDoc,
                                        CPDF_Dictionary* pPageResources,
                                        FX_BOOL bStdCS,
                                        FX_DWORD GroupFamily,
-                                       FX_BOOL bLoadMask) {
+                                       FX_BOOL bLoadMask,
+                                       int32_t nDownsampleWidth,
+                                       int32_t nDownsampleHeight) {
   if (!pStream) {
     return 0;
   }
   m_pDocument = pDoc;
+  m_nDownsampleWidth = std::abs(nDownsampleWidth);
+  m_nDownsampleHeight = std::abs(nDownsampleHeight);
   m_pDict = pStream->GetDict();
   m_pStream = pStream;
   m_bStdCS = bStdCS;
@@ -401,6 +412,8 @@ int CPDF_DIBSource::ContinueLoadDIBSource(IFX_Pause* pPause) {
     if (decoder == "JPXDecode") {
       return 0;
     }
+    // The JBIG2 symbol dictionary cache belongs to the document.
+    CFX_AutoLock lock(m_pDocument->GetSharedLock());
     ICodec_Jbig2Module* pJbig2Module = CPDF_ModuleMgr::Get()->GetJbig2Module();
     if (!m_pJbig2Context) {
       m_pJbig2Context = pJbig2Module->CreateJbig2Context();
@@ -427,6 +440,7 @@ int CPDF_DIBSource::ContinueLoadDIBSource(IFX_Pause* pPause) {
       if (ret == FXCODEC_STATUS_DECODE_TOBECONTINUE) {
         return 2;
       }
+      DownScaleJbig2Bitmap();
       int ret1 = 1;
       if (m_bHasMask) {
         ret1 = ContinueLoadMaskDIB(pPause);
@@ -452,6 +466,7 @@ int CPDF_DIBSource::ContinueLoadDIBSource(IFX_Pause* pPause) {
     if (ret == FXCODEC_STATUS_DECODE_TOBECONTINUE) {
       return 2;
     }
+    DownScaleJbig2Bitmap();
     int ret1 = 1;
     if (m_bHasMask) {
       ret1 = ContinueLoadMaskDIB(pPause);
@@ -676,18 +691,94 @@ int CPDF_DIBSource::CreateDecoder() {
   if (provided_pitch.ValueOrDie() < requested_pitch.ValueOrDie()) {
     return 0;
   }
+  int scale = GetAllowedDownScale();
+  if (scale > 1 && (m_bpc == 8 || (m_bpc == 1 && m_nComponents == 1)) &&
+      m_pDecoder->GetBPC() == (int)m_bpc &&
+      m_pDecoder->CountComps() == (int)m_nComponents &&
+      m_pDecoder->GetWidth() == m_Width &&
+      m_pDecoder->GetHeight() == m_Height) {
+    m_pDecoder->DownScale(m_nDownsampleWidth, m_nDownsampleHeight);
+    if (m_pDecoder->GetWidth() == (m_Width + scale - 1) / scale &&
+        m_pDecoder->GetHeight() == (m_Height + scale - 1) / scale) {
+      SetDownScale(scale);
+    } else {
+      m_pDecoder->DownScale(m_Width, m_Height);
+    }
+  }
   return 1;
 }
+
+int CPDF_DIBSource::GetAllowedDownScale() const {
+  // Masks and colour keys are matched to the samples at full size, and
+  // palette indexes cannot be averaged.
+  if (m_nDownsampleWidth <= 0 || m_nDownsampleHeight <= 0 || m_bColorKey ||
+      m_Family == PDFCS_INDEXED || m_pDict->KeyExist("SMask") ||
+      m_pDict->KeyExist("Mask")) {
+    return 1;
+  }
+  return FX_GetDownsampleRatio(m_Width, m_Height, m_nDownsampleWidth,
+                               m_nDownsampleHeight);
+}
+
+void CPDF_DIBSource::SetDownScale(int scale) {
+  m_DownScale = scale;
+  m_Width = (m_Width + scale - 1) / scale;
+  m_Height = (m_Height + scale - 1) / scale;
+  if (m_bpc != 1)
+    return;
+
+  m_bpc = 8;
+  if (m_pColorSpace) {
+    FX_Free(m_pCompData);
+    m_pCompData = GetDecodeAndMaskArray(m_bDefaultDecode, m_bColorKey);
+  }
+}
+
+void CPDF_DIBSource::DownScaleJbig2Bitmap() {
+  int scale = GetAllowedDownScale();
+  if (scale <= 1)
+    return;
+
+  CCodec_BoxDownsampler downsampler(m_Width, 1, 1, scale);
+  std::unique_ptr<CFX_DIBitmap> pBitmap(new CFX_DIBitmap);
+  if (!pBitmap->Create(downsampler.GetWidth(), (m_Height + scale - 1) / scale,
+                       m_bImageMask ? FXDIB_8bppMask : FXDIB_8bppRgb)) {
+    return;
+  }
+  for (int row = 0; row < pBitmap->GetHeight(); row++) {
+    downsampler.Reset();
+    int end = std::min((row + 1) * scale, m_Height);
+    for (int line = row * scale; line < end; line++)
+      downsampler.AddLine(m_pCachedBitmap->GetScanline(line));
+    FXSYS_memcpy(pBitmap->GetBuffer() + row * pBitmap->GetPitch(),
+                 downsampler.Finish(), downsampler.GetWidth());
+  }
+  m_pCachedBitmap = std::move(pBitmap);
+  SetDownScale(scale);
+  m_bpp = 8;
+  m_Pitch = CalculatePitch32(m_bpp, m_Width).ValueOrDie();
+  FX_Free(m_pLineBuf);
+  m_pLineBuf = FX_Alloc(uint8_t, m_Pitch);
+  FX_Free(m_pPalette);
+  m_pPalette = NULL;
+  LoadPalette();
+}
 void CPDF_DIBSource::LoadJpxBitmap() {
   ICodec_JpxModule* pJpxModule = CPDF_ModuleMgr::Get()->GetJpxModule();
   if (!pJpxModule)
     return;
 
+  uint32_t reduce = 0;
+  for (int scale = GetAllowedDownScale(); scale > 1; scale /= 2)
+    reduce++;
   std::unique_ptr<JpxBitMapContext> context(new JpxBitMapContext(pJpxModule));
-  context->set_decoder(pJpxModule->CreateDecoder(
-      m_pStreamAcc->GetData(), m_pStreamAcc->GetSize(), m_pColorSpace));
+  context->set_decoder(pJpxModule->CreateDecoder(m_pStreamAcc->GetData(),
+                                                 m_pStreamAcc->GetSize(),
+                                                 m_pColorSpace, &reduce));
   if (!context->decoder())
     return;
+  if (reduce)
+    SetDownScale(1 << reduce);
 
   FX_DWORD width = 0;
   FX_DWORD height = 0;
@@ -1133,7 +1224,11 @@ const uint8_t* CPDF_DIBSource::GetScanline(int line) const {
     return m_pLineBuf;
   }
   if (m_bpc * m_nComponents <= 8) {
-    if (m_bpc == 8) {
+    if (m_bImageMask && m_bDefaultDecode) {
+      // A reduced mask, where samples of 0 paint.
+      for (FX_DWORD i = 0; i < src_pitch_value; i++)
+        m_pLineBuf[i] = 255 - pSrcLine[i];
+    } else if (m_bpc == 8) {
       FXSYS_memcpy(m_pLineBuf, pSrcLine, src_pitch_value);
     } else {
       int src_bit_pos = 0;
@@ -1403,7 +1498,7 @@ void CPDF_DIBSource::DownSampleScanline8Bit(int orig_Bpp,
     src_x %= src_width;
     uint8_t index = pSrcLine[src_x];
     if (dest_Bpp == 1) {
-      dest_scan[i] = index;
+      dest_scan[i] = m_bImageMask && m_bDefaultDecode ? 255 - index : index;
     } else {
       int dest_pos = i * dest_Bpp;
       FX_ARGB argb = m_pPalette[index];
@@ -2,11 +2,96 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/include/fpdfapi/fpdf_parser.h"
+#include "core/src/fpdfapi/fpdf_render/render_int.h"
 #include "testing/embedder_test.h"
 #include "testing/gtest/include/gtest/gtest.h"
+#include "testing/utils/path_service.h"
 
 class FPDFRenderLoadImageEmbeddertest : public EmbedderTest {};
 
+namespace {
+
+using ScopedFileStream =
+    std::unique_ptr<IFX_FileStream, ReleaseDeleter<IFX_FileStream>>;
+using ScopedStream = std::unique_ptr<CPDF_Stream, ReleaseDeleter<CPDF_Stream>>;
+
+// An image XObject with the entries in |dict| and the already encoded
+// |data|.
+ScopedStream MakeImageStream(CPDF_Document* pDoc,
+                             std::string dict,
+                             const std::vector<uint8_t>& data) {
+  ScopedFileStream stream(FX_CreateMemoryStream(
+      reinterpret_cast<uint8_t*>(&dict[0]), dict.size(), FALSE));
+  CPDF_SyntaxParser parser;
+  parser.InitParser(stream.get(), 0);
+  CPDF_Object* pDict = parser.GetObject(pDoc, 0, 0, nullptr, FALSE);
+  uint8_t* pData = FX_Alloc(uint8_t, data.size());
+  FXSYS_memcpy(pData, data.data(), data.size());
+  return ScopedStream(new CPDF_Stream(pData, data.size(), ToDictionary(pDict)));
+}
+
+std::vector<uint8_t> FlateEncode(const std::vector<uint8_t>& data) {
+  uint8_t* dest_buf = nullptr;
+  FX_DWORD dest_size = 0;
+  ::FlateEncode(data.data(), data.size(), dest_buf, dest_size);
+  std::vector<uint8_t> result(dest_buf, dest_buf + dest_size);
+  FX_Free(dest_buf);
+  return result;
+}
+
+// Literal runs only, which RunLengthDecode takes 128 bytes at a time.
+std::vector<uint8_t> RunLengthEncode(const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> result;
+  for (size_t i = 0; i < data.size(); i += 128) {
+    size_t count = std::min<size_t>(128, data.size() - i);
+    result.push_back(static_cast<uint8_t>(count - 1));
+    result.insert(result.end(), data.begin() + i, data.begin() + i + count);
+  }
+  result.push_back(128);
+  return result;
+}
+
+std::unique_ptr<CPDF_DIBSource> LoadImage(CPDF_Document* pDoc,
+                                          const CPDF_Stream* pStream,
+                                          int width,
+                                          int height) {
+  std::unique_ptr<CPDF_DIBSource> pSource(new CPDF_DIBSource);
+  if (!pSource->Load(pDoc, pStream, nullptr, nullptr, nullptr, nullptr, FALSE,
+                     0, FALSE, width, height)) {
+    return nullptr;
+  }
+  return pSource;
+}
+
+// The average of the |scale| by |scale| block of |width| by |height|
+// |samples| at |col|, |row| of the reduced image.
+int BoxAverage(const std::vector<int>& samples,
+               int width,
+               int height,
+               int scale,
+               int col,
+               int row) {
+  int sum = 0;
+  int count = 0;
+  for (int y = row * scale; y < std::min((row + 1) * scale, height); ++y) {
+    for (int x = col * scale; x < std::min((col + 1) * scale, width); ++x) {
+      sum += samples[y * width + x];
+      ++count;
+    }
+  }
+  return (sum + count / 2) / count;
+}
+
+}  // namespace
+
 TEST_F(FPDFRenderLoadImageEmbeddertest, Bug_554151) {
   // Test scanline downsampling with a BitsPerComponent of 4.
   // Should not crash.
@@ -27,3 +112,228 @@ TEST_F(FPDFRenderLoadImageEmbeddertest, Bug_557223) {
   FPDFBitmap_Destroy(bitmap);
   UnloadPage(page);
 }
+
+TEST_F(FPDFRenderLoadImageEmbeddertest, DownScaleFlate) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &file_path));
+  CPDF_Parser parser;
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+  CPDF_Document* pDoc = parser.GetDocument();
+
+  const int kWidth = 101;
+  const int kHeight = 61;
+  std::vector<int> samples(kWidth * kHeight);
+  for (int i = 0; i < kWidth * kHeight; ++i)
+    samples[i] = (i % kWidth * 7 + i / kWidth * 13) % 256;
+  std::vector<uint8_t> data = FlateEncode(
+      std::vector<uint8_t>(samples.begin(), samples.end()));
+  const char kDict[] =
+      "<< /Type /XObject /Subtype /Image /Width 101 /Height 61 "
+      "/BitsPerComponent 8 /ColorSpace /DeviceGray /Filter /FlateDecode %s>>";
+  char dict[256];
+  snprintf(dict, sizeof(dict), kDict, "");
+  ScopedStream pStream = MakeImageStream(pDoc, dict, data);
+
+  // Four times smaller still covers 25 by 15 pixels.
+  std::unique_ptr<CPDF_DIBSource> pSource =
+      LoadImage(pDoc, pStream.get(), 25, -15);
+  ASSERT_TRUE(pSource);
+  EXPECT_EQ(4, pSource->GetDownScale());
+  ASSERT_EQ(26, pSource->GetWidth());
+  ASSERT_EQ(16, pSource->GetHeight());
+  EXPECT_EQ(8, pSource->GetBPP());
+  for (int row = 0; row < 16; ++row) {
+    const uint8_t* scan = pSource->GetScanline(row);
+    for (int col = 0; col < 26; ++col) {
+      ASSERT_EQ(BoxAverage(samples, kWidth, kHeight, 4, col, row), scan[col])
+          << col << ", " << row;
+    }
+  }
+  // Back to the start, as the renderer does for every pass.
+  EXPECT_EQ(BoxAverage(samples, kWidth, kHeight, 4, 3, 0),
+            pSource->GetScanline(0)[3]);
+
+  // Whole, without a size to reduce to or one close to the image's.
+  pSource = LoadImage(pDoc, pStream.get(), 0, 0);
+  ASSERT_TRUE(pSource);
+  EXPECT_EQ(1, pSource->GetDownScale());
+  EXPECT_EQ(kWidth, pSource->GetWidth());
+  EXPECT_EQ(samples[kWidth + 5], pSource->GetScanline(1)[5]);
+  pSource = LoadImage(pDoc, pStream.get(), 60, 40);
+  ASSERT_TRUE(pSource);
+  EXPECT_EQ(kWidth, pSource->GetWidth());
+
+  // Whole, as the colour key applies to the samples themselves.
+  snprintf(dict, sizeof(dict), kDict, "/Mask [0 10] ");
+  ScopedStream pKeyedStream = MakeImageStream(pDoc, dict, data);
+  pSource = LoadImage(pDoc, pKeyedStream.get(), 25, 15);
+  ASSERT_TRUE(pSource);
+  EXPECT_EQ(1, pSource->GetDownScale());
+  EXPECT_EQ(kWidth, pSource->GetWidth());
+}
+
+TEST_F(FPDFRenderLoadImageEmbeddertest, DownScaleRunLengthMask) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &file_path));
+  CPDF_Parser parser;
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+  CPDF_Document* pDoc = parser.GetDocument();
+
+  const int kWidth = 37;
+  const int kHeight = 20;
+  const int kPitch = (kWidth + 7) / 8;
+  std::vector<int> samples(kWidth * kHeight);
+  std::vector<uint8_t> bits(kPitch * kHeight);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      if ((x / 3 + y / 2) % 3 == 0) {
+        samples[y * kWidth + x] = 255;
+        bits[y * kPitch + x / 8] |= 0x80 >> (x % 8);
+      }
+    }
+  }
+  ScopedStream pStream = MakeImageStream(
+      pDoc,
+      "<< /Type /XObject /Subtype /Image /Width 37 /Height 20 "
+      "/ImageMask true /Filter /RunLengthDecode >>",
+      RunLengthEncode(bits));
+
+  std::unique_ptr<CPDF_DIBSource> pSource =
+      LoadImage(pDoc, pStream.get(), 9, 5);
+  ASSERT_TRUE(pSource);
+  EXPECT_EQ(4, pSource->GetDownScale());
+  ASSERT_EQ(10, pSource->GetWidth());
+  ASSERT_EQ(5, pSource->GetHeight());
+  EXPECT_EQ(FXDIB_8bppMask, pSource->GetFormat());
+  for (int row = 0; row < 5; ++row) {
+    const uint8_t* scan = pSource->GetScanline(row);
+    for (int col = 0; col < 10; ++col) {
+      // Samples of 0 paint.
+      ASSERT_EQ(255 - BoxAverage(samples, kWidth, kHeight, 4, col, row),
+                scan[col])
+          << col << ", " << row;
+    }
+  }
+
+  pSource = LoadImage(pDoc, pStream.get(), 0, 0);
+  ASSERT_TRUE(pSource);
+  EXPECT_EQ(FXDIB_1bppMask, pSource->GetFormat());
+}
+
+TEST_F(FPDFRenderLoadImageEmbeddertest, DownScaleJpx) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("jpx_reduce.pdf", &file_path));
+  CPDF_Parser parser;
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+  CPDF_Document* pDoc = parser.GetDocument();
+  CPDF_Stream* pStream = ToStream(pDoc->GetIndirectObject(5, nullptr));
+  ASSERT_TRUE(pStream);
+
+  std::unique_ptr<CPDF_DIBSource> pWhole = LoadImage(pDoc, pStream, 0, 0);
+  ASSERT_TRUE(pWhole);
+  EXPECT_EQ(32, pWhole->GetWidth());
+  // Decoded from the codestream's lower resolution levels.
+  std::unique_ptr<CPDF_DIBSource> pReduced = LoadImage(pDoc, pStream, 8, 8);
+  ASSERT_TRUE(pReduced);
+  EXPECT_EQ(4, pReduced->GetDownScale());
+  ASSERT_EQ(8, pReduced->GetWidth());
+  ASSERT_EQ(8, pReduced->GetHeight());
+  // The wavelet low pass is centred on the first pixel of each box rather
+  // than its middle, which is 12 levels off on these gradients.
+  for (int row = 0; row < 8; ++row) {
+    const uint8_t* scan = pReduced->GetScanline(row);
+    for (int i = 0; i < 8 * 3; ++i) {
+      int sum = 0;
+      for (int y = row * 4; y < row * 4 + 4; ++y) {
+        const uint8_t* whole_scan = pWhole->GetScanline(y);
+        for (int x = i / 3 * 4; x < i / 3 * 4 + 4; ++x)
+          sum += whole_scan[x * 3 + i % 3];
+      }
+      EXPECT_NEAR(sum / 16, scan[i], 16) << i / 3 << ", " << row;
+    }
+  }
+}
+
+TEST_F(FPDFRenderLoadImageEmbeddertest, RenderReducedThenWhole) {
+  EXPECT_TRUE(OpenDocument("jpx_reduce.pdf"));
+  FPDF_PAGE page = LoadPage(0);
+  ASSERT_NE(nullptr, page);
+  FPDF_BITMAP thumbnail = FPDFBitmap_Create(8, 8, 0);
+  FPDFBitmap_FillRect(thumbnail, 0, 0, 8, 8, 0xFFFFFFFF);
+  FPDF_RenderPageBitmap(thumbnail, page, 0, 0, 8, 8, 0, 0);
+  FPDFBitmap_Destroy(thumbnail);
+  // The image cached for the thumbnail is too small for this.
+  FPDF_BITMAP after_thumbnail = FPDFBitmap_Create(32, 32, 0);
+  FPDFBitmap_FillRect(after_thumbnail, 0, 0, 32, 32, 0xFFFFFFFF);
+  FPDF_RenderPageBitmap(after_thumbnail, page, 0, 0, 32, 32, 0, 0);
+  UnloadPage(page);
+
+  page = LoadPage(0);
+  ASSERT_NE(nullptr, page);
+  FPDF_BITMAP whole = FPDFBitmap_Create(32, 32, 0);
+  FPDFBitmap_FillRect(whole, 0, 0, 32, 32, 0xFFFFFFFF);
+  FPDF_RenderPageBitmap(whole, page, 0, 0, 32, 32, 0, 0);
+  const uint8_t* expected =
+      static_cast<const uint8_t*>(FPDFBitmap_GetBuffer(whole));
+  const uint8_t* actual =
+      static_cast<const uint8_t*>(FPDFBitmap_GetBuffer(after_thumbnail));
+  EXPECT_EQ(std::vector<uint8_t>(expected, expected + 32 * 32 * 4),
+            std::vector<uint8_t>(actual, actual + 32 * 32 * 4));
+  FPDFBitmap_Destroy(whole);
+  FPDFBitmap_Destroy(after_thumbnail);
+  UnloadPage(page);
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests. Decodes a page sized
+// scan at 600 DPI whole and for a thumbnail.
+TEST_F(FPDFRenderLoadImageEmbeddertest, DISABLED_BenchmarkDownScale) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &file_path));
+  CPDF_Parser parser;
+  ASSERT_EQ(static_cast<FX_DWORD>(PDFPARSE_ERROR_SUCCESS),
+            parser.StartParse(FX_CreateFileRead(file_path.c_str())));
+  CPDF_Document* pDoc = parser.GetDocument();
+
+  const int kWidth = 5100;
+  const int kHeight = 6600;
+  const int kPitch = (kWidth + 7) / 8;
+  std::vector<uint8_t> bits(kPitch * kHeight);
+  unsigned seed = 1;
+  for (size_t i = 0; i < bits.size(); ++i) {
+    seed = seed * 1103515245 + 12345;
+    // Mostly white, like text on paper.
+    bits[i] = (seed >> 16) % 8 ? 0xFF : (seed >> 8) & 0xFF;
+  }
+  char dict[256];
+  snprintf(dict, sizeof(dict),
+           "<< /Type /XObject /Subtype /Image /Width %d /Height %d "
+           "/BitsPerComponent 1 /ColorSpace /DeviceGray "
+           "/Filter /FlateDecode >>",
+           kWidth, kHeight);
+  ScopedStream pStream = MakeImageStream(pDoc, dict, FlateEncode(bits));
+
+  const int kThumbnailWidth = kWidth / 8;
+  const int kThumbnailHeight = kHeight / 8;
+  for (int size : {0, 1}) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<CPDF_DIBSource> pSource =
+        size ? LoadImage(pDoc, pStream.get(), kThumbnailWidth, kThumbnailHeight)
+             : LoadImage(pDoc, pStream.get(), 0, 0);
+    ASSERT_TRUE(pSource);
+    // What the page cache and the renderer do with it.
+    std::unique_ptr<CFX_DIBitmap> pBitmap(pSource->Clone());
+    ASSERT_TRUE(pBitmap);
+    std::unique_ptr<CFX_DIBitmap> pThumbnail(
+        pBitmap->StretchTo(kThumbnailWidth, kThumbnailHeight, 0, nullptr));
+    ASSERT_TRUE(pThumbnail);
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start).count();
+    printf("%s: %dx%d, %lld ms, %u bytes cached\n",
+           size ? "thumbnail" : "whole", pBitmap->GetWidth(),
+           pBitmap->GetHeight(), ms,
+           pBitmap->GetPitch() * pBitmap->GetHeight());
+  }
+}
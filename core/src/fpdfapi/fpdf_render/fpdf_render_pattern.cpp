@@ -6,12 +6,62 @@
 
 #include "render_int.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "core/include/fpdfapi/fpdf_pageobj.h"
 #include "core/include/fpdfapi/fpdf_render.h"
 #include "core/include/fxge/fx_ge.h"
 #include "core/src/fpdfapi/fpdf_page/pageint.h"
 
 #define SHADING_STEPS 256
+// The colors of the SHADING_STEPS steps of an axial or radial shading. The
+// function results come from the functions' sample tables, which are kept
+// between draws, or from calling the functions where there is no table.
+static void GetShadingColors(FX_FLOAT t_min,
+                             FX_FLOAT t_max,
+                             CPDF_Function** pFuncs,
+                             int nFuncs,
+                             CPDF_ColorSpace* pCS,
+                             int alpha,
+                             FX_DWORD* rgb_array) {
+  int total_results = 0;
+  std::vector<CPDF_Function::Samples> samples(nFuncs);
+  for (int j = 0; j < nFuncs; j++) {
+    if (pFuncs[j]) {
+      total_results += pFuncs[j]->CountOutputs();
+      samples[j] = pFuncs[j]->GetSamples(t_min, t_max, SHADING_STEPS);
+    }
+  }
+  if (pCS->CountComponents() > total_results) {
+    total_results = pCS->CountComponents();
+  }
+  CFX_FixedBufGrow<FX_FLOAT, 16> result_array(total_results);
+  FX_FLOAT* pResults = result_array;
+  FXSYS_memset(pResults, 0, total_results * sizeof(FX_FLOAT));
+  for (int i = 0; i < SHADING_STEPS; i++) {
+    int offset = 0;
+    for (int j = 0; j < nFuncs; j++) {
+      if (samples[j]) {
+        int nresults = pFuncs[j]->CountOutputs();
+        FXSYS_memcpy(pResults + offset, samples[j]->data() + i * nresults,
+                     nresults * sizeof(FX_FLOAT));
+        offset += nresults;
+      } else if (pFuncs[j]) {
+        FX_FLOAT input = (t_max - t_min) * i / SHADING_STEPS + t_min;
+        int nresults;
+        if (pFuncs[j]->Call(&input, 1, pResults + offset, nresults)) {
+          offset += nresults;
+        }
+      }
+    }
+    FX_FLOAT R = 0.0f, G = 0.0f, B = 0.0f;
+    pCS->GetRGB(pResults, R, G, B);
+    rgb_array[i] =
+        FXARGB_TODIB(FXARGB_MAKE(alpha, FXSYS_round(R * 255),
+                                 FXSYS_round(G * 255), FXSYS_round(B * 255)));
+  }
+}
 static void DrawAxialShading(CFX_DIBitmap* pBitmap,
                              CFX_Matrix* pObject2Bitmap,
                              CPDF_Dictionary* pDict,
@@ -48,36 +98,8 @@ static void DrawAxialShading(CFX_DIBitmap* pBitmap,
       FXSYS_Mul(x_span, x_span) + FXSYS_Mul(y_span, y_span);
   CFX_Matrix matrix;
   matrix.SetReverse(*pObject2Bitmap);
-  int total_results = 0;
-  for (int j = 0; j < nFuncs; j++) {
-    if (pFuncs[j]) {
-      total_results += pFuncs[j]->CountOutputs();
-    }
-  }
-  if (pCS->CountComponents() > total_results) {
-    total_results = pCS->CountComponents();
-  }
-  CFX_FixedBufGrow<FX_FLOAT, 16> result_array(total_results);
-  FX_FLOAT* pResults = result_array;
-  FXSYS_memset(pResults, 0, total_results * sizeof(FX_FLOAT));
   FX_DWORD rgb_array[SHADING_STEPS];
-  for (int i = 0; i < SHADING_STEPS; i++) {
-    FX_FLOAT input = (t_max - t_min) * i / SHADING_STEPS + t_min;
-    int offset = 0;
-    for (int j = 0; j < nFuncs; j++) {
-      if (pFuncs[j]) {
-        int nresults = 0;
-        if (pFuncs[j]->Call(&input, 1, pResults + offset, nresults)) {
-          offset += nresults;
-        }
-      }
-    }
-    FX_FLOAT R = 0.0f, G = 0.0f, B = 0.0f;
-    pCS->GetRGB(pResults, R, G, B);
-    rgb_array[i] =
-        FXARGB_TODIB(FXARGB_MAKE(alpha, FXSYS_round(R * 255),
-                                 FXSYS_round(G * 255), FXSYS_round(B * 255)));
-  }
+  GetShadingColors(t_min, t_max, pFuncs, nFuncs, pCS, alpha, rgb_array);
   int pitch = pBitmap->GetPitch();
   for (int row = 0; row < height; row++) {
     FX_DWORD* dib_buf = (FX_DWORD*)(pBitmap->GetBuffer() + row * pitch);
@@ -135,36 +157,8 @@ static void DrawRadialShading(CFX_DIBitmap* pBitmap,
     bStartExtend = pArray->GetInteger(0);
     bEndExtend = pArray->GetInteger(1);
   }
-  int total_results = 0;
-  for (int j = 0; j < nFuncs; j++) {
-    if (pFuncs[j]) {
-      total_results += pFuncs[j]->CountOutputs();
-    }
-  }
-  if (pCS->CountComponents() > total_results) {
-    total_results = pCS->CountComponents();
-  }
-  CFX_FixedBufGrow<FX_FLOAT, 16> result_array(total_results);
-  FX_FLOAT* pResults = result_array;
-  FXSYS_memset(pResults, 0, total_results * sizeof(FX_FLOAT));
   FX_DWORD rgb_array[SHADING_STEPS];
-  for (int i = 0; i < SHADING_STEPS; i++) {
-    FX_FLOAT input = (t_max - t_min) * i / SHADING_STEPS + t_min;
-    int offset = 0;
-    for (int j = 0; j < nFuncs; j++) {
-      if (pFuncs[j]) {
-        int nresults;
-        if (pFuncs[j]->Call(&input, 1, pResults + offset, nresults)) {
-          offset += nresults;
-        }
-      }
-    }
-    FX_FLOAT R = 0.0f, G = 0.0f, B = 0.0f;
-    pCS->GetRGB(pResults, R, G, B);
-    rgb_array[i] =
-        FXARGB_TODIB(FXARGB_MAKE(alpha, FXSYS_round(R * 255),
-                                 FXSYS_round(G * 255), FXSYS_round(B * 255)));
-  }
+  GetShadingColors(t_min, t_max, pFuncs, nFuncs, pCS, alpha, rgb_array);
   FX_FLOAT a = FXSYS_Mul(start_x - end_x, start_x - end_x) +
                FXSYS_Mul(start_y - end_y, start_y - end_y) -
                FXSYS_Mul(start_r - end_r, start_r - end_r);
@@ -241,6 +235,18 @@ static void DrawRadialShading(CFX_DIBitmap* pBitmap,
     }
   }
 }
+// The number of grid points that places samples of a function shading at
+// most |pixel_span| apart across |span|, or 0 if there would be too many.
+static int GetFuncShadingGridSize(FX_FLOAT span, FX_FLOAT pixel_span) {
+  if (!(span > 0) || !(pixel_span > 0)) {
+    return 0;
+  }
+  FX_FLOAT steps = FXSYS_ceil(span / pixel_span);
+  if (!(steps < 512)) {
+    return 0;
+  }
+  return (int)steps + 1;
+}
 static void DrawFuncShading(CFX_DIBitmap* pBitmap,
                             CFX_Matrix* pObject2Bitmap,
                             CPDF_Dictionary* pDict,
@@ -277,6 +283,21 @@ static void DrawFuncShading(CFX_DIBitmap* pBitmap,
   CFX_FixedBufGrow<FX_FLOAT, 16> result_array(total_results);
   FX_FLOAT* pResults = result_array;
   FXSYS_memset(pResults, 0, total_results * sizeof(FX_FLOAT));
+  // When a grid about one pixel apart has no more points than the bitmap,
+  // look the results up in the functions' sample grids, which are kept for
+  // the next draw at this size, instead of calling them per pixel.
+  int nx = GetFuncShadingGridSize(xmax - xmin, FXSYS_fabs(matrix.a) +
+                                                   FXSYS_fabs(matrix.c));
+  int ny = GetFuncShadingGridSize(ymax - ymin, FXSYS_fabs(matrix.b) +
+                                                   FXSYS_fabs(matrix.d));
+  std::vector<CPDF_Function::Samples> samples(nFuncs);
+  if (nx > 0 && ny > 0 && nx * ny <= width * height) {
+    for (int j = 0; j < nFuncs; j++) {
+      if (pFuncs[j]) {
+        samples[j] = pFuncs[j]->GetSamples(xmin, xmax, nx, ymin, ymax, ny);
+      }
+    }
+  }
   for (int row = 0; row < height; row++) {
     FX_DWORD* dib_buf = (FX_DWORD*)(pBitmap->GetBuffer() + row * pitch);
     for (int column = 0; column < width; column++) {
@@ -290,7 +311,17 @@ static void DrawFuncShading(CFX_DIBitmap* pBitmap,
       input[0] = x;
       input[1] = y;
       for (int j = 0; j < nFuncs; j++) {
-        if (pFuncs[j]) {
+        if (samples[j]) {
+          int nresults = pFuncs[j]->CountOutputs();
+          int ix = FXSYS_round((x - xmin) * (nx - 1) / (xmax - xmin));
+          int iy = FXSYS_round((y - ymin) * (ny - 1) / (ymax - ymin));
+          ix = std::min(std::max(ix, 0), nx - 1);
+          iy = std::min(std::max(iy, 0), ny - 1);
+          FXSYS_memcpy(pResults + offset,
+                       samples[j]->data() + (iy * nx + ix) * nresults,
+                       nresults * sizeof(FX_FLOAT));
+          offset += nresults;
+        } else if (pFuncs[j]) {
           int nresults;
           if (pFuncs[j]->Call(input, 2, pResults + offset, nresults)) {
             offset += nresults;
@@ -351,6 +351,9 @@ class CPDF_RefType3Cache {
 FX_BOOL CPDF_RenderStatus::ProcessType3Text(const CPDF_TextObject* textobj,
                                             const CFX_Matrix* pObj2Device) {
   CPDF_Type3Font* pType3Font = textobj->m_TextState.GetFont()->GetType3Font();
+  // Type3 glyphs are parsed and cached on first use, which is not worth
+  // splitting up when the document is shared between threads.
+  CPDF_FontLock lock(pType3Font);
   for (int j = 0; j < m_Type3FontCache.GetSize(); j++) {
     if (m_Type3FontCache.GetAt(j) == pType3Font)
       return TRUE;
@@ -530,6 +533,7 @@ void CPDF_CharPosList::Load(int nChars,
                             FX_FLOAT* pCharPos,
                             CPDF_Font* pFont,
                             FX_FLOAT FontSize) {
+  CPDF_FontLock lock(pFont);
   m_pCharPos = FX_Alloc(FXTEXT_CHARPOS, nChars);
   m_nChars = 0;
   CPDF_CIDFont* pCIDFont = pFont->GetCIDFont();
@@ -784,6 +788,7 @@ void CPDF_RenderStatus::DrawTextPathWithPattern(const CPDF_TextObject* textobj,
 }
 
 CFX_PathData* CPDF_Font::LoadGlyphPath(FX_DWORD charcode, int dest_width) {
+  CPDF_FontLock lock(this);
   int glyph_index = GlyphFromCharCode(charcode);
   if (!m_Font.GetFace())
     return nullptr;
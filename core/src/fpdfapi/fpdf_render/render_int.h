@@ -76,6 +76,9 @@ class CPDF_DocRenderData {
   CPDF_Type3Cache* GetCachedType3(CPDF_Type3Font* pFont);
   CPDF_TransferFunc* GetTransferFunc(CPDF_Object* pObj);
   CFX_FontCache* GetFontCache() { return m_pFontCache; }
+  // The document's own decoded image cache; null unless it exists or
+  // |bCreate| is set.
+  CPDF_DocImageCache* GetImageCache(FX_BOOL bCreate);
   void Clear(FX_BOOL bRelease = FALSE);
   void ReleaseCachedType3(CPDF_Type3Font* pFont);
   void ReleaseTransferFunc(CPDF_Object* pObj);
@@ -90,6 +93,7 @@ class CPDF_DocRenderData {
   CFX_FontCache* m_pFontCache;
   CPDF_Type3CacheMap m_Type3FaceMap;
   CPDF_TransferFuncMap m_TransferFuncMap;
+  std::unique_ptr<CPDF_DocImageCache> m_pImageCache;
 };
 struct _PDF_RenderItem {
  public:
@@ -245,7 +249,7 @@ class CPDF_RenderStatus {
 
  protected:
   static const int kRenderMaxRecursionDepth = 64;
-  static int s_CurrentRecursionDepth;
+  static thread_local int s_CurrentRecursionDepth;
 
   CFX_RenderDevice* m_pDevice;
   CFX_Matrix m_DeviceMatrix;
@@ -435,6 +439,9 @@ class CPDF_ImageCacheEntry {
                           int32_t downsampleWidth = 0,
                           int32_t downsampleHeight = 0);
   FX_DWORD EstimateSize() const { return m_dwCacheSize; }
+  // Whether the bitmap was decoded too small to be drawn at the downsample
+  // size.
+  FX_BOOL IsTooCoarse(int32_t downsampleWidth, int32_t downsampleHeight) const;
   FX_DWORD GetTimeCount() const { return m_dwTimeCount; }
   CPDF_Stream* GetStream() const { return m_pStream; }
   void SetTimeCount(FX_DWORD dwTimeCount) { m_dwTimeCount = dwTimeCount; }
@@ -460,11 +467,26 @@ class CPDF_ImageCacheEntry {
  protected:
   void ContinueGetCachedBitmap();
 
+  // Takes the bitmaps from the document's image cache, if it has them.
+  FX_BOOL FindShared(CPDF_Dictionary* pFormResources,
+                     CPDF_Dictionary* pPageResources,
+                     FX_BOOL bStdCS,
+                     FX_DWORD GroupFamily,
+                     FX_BOOL bLoadMask);
+  // Hands the bitmaps just decoded to the cache FindShared() looked in.
+  void AddShared();
+
   CPDF_Document* m_pDocument;
   CPDF_Stream* m_pStream;
   CFX_DIBSource* m_pCachedBitmap;
   CFX_DIBSource* m_pCachedMask;
   FX_DWORD m_dwCacheSize;
+  // Owns the cached bitmaps once they are shared.
+  std::shared_ptr<CPDF_DecodedImage> m_pShared;
+  CPDF_DocImageCache* m_pSharedCache;
+  CPDF_DocImageCache::Key m_SharedKey;
+  // How many times smaller than the image the cached bitmap was decoded.
+  int m_DownScale;
   void CalcSize();
 };
 typedef struct {
@@ -487,7 +509,9 @@ class CPDF_DIBSource : public CFX_DIBSource {
                CPDF_Dictionary* pPageResources,
                FX_BOOL bStdCS = FALSE,
                FX_DWORD GroupFamily = 0,
-               FX_BOOL bLoadMask = FALSE);
+               FX_BOOL bLoadMask = FALSE,
+               int32_t nDownsampleWidth = 0,
+               int32_t nDownsampleHeight = 0);
 
   // CFX_DIBSource
   FX_BOOL SkipToScanline(int line, IFX_Pause* pPause) const override;
@@ -505,6 +529,8 @@ class CPDF_DIBSource : public CFX_DIBSource {
   CFX_DIBitmap* GetBitmap() const;
   void ReleaseBitmap(CFX_DIBitmap*) const;
   void ClearImageData();
+  // How many times smaller than its /Width and /Height the image was decoded.
+  int GetDownScale() const { return m_DownScale; }
 
   int StartLoadDIBSource(CPDF_Document* pDoc,
                          const CPDF_Stream* pStream,
@@ -513,7 +539,9 @@ class CPDF_DIBSource : public CFX_DIBSource {
                          CPDF_Dictionary* pPageResources,
                          FX_BOOL bStdCS = FALSE,
                          FX_DWORD GroupFamily = 0,
-                         FX_BOOL bLoadMask = FALSE);
+                         FX_BOOL bLoadMask = FALSE,
+                         int32_t nDownsampleWidth = 0,
+                         int32_t nDownsampleHeight = 0);
   int ContinueLoadDIBSource(IFX_Pause* pPause);
   int StratLoadMask();
   int StartLoadMaskDIB();
@@ -539,6 +567,13 @@ class CPDF_DIBSource : public CFX_DIBSource {
   void LoadJpxBitmap();
   void LoadPalette();
   int CreateDecoder();
+  // The power of two by which the image may be decoded smaller and still
+  // cover the downsample size; 1 for images that must be decoded whole.
+  int GetAllowedDownScale() const;
+  // Switches to the size of a decode |scale| times smaller, with 8 bits per
+  // component for images that had 1.
+  void SetDownScale(int scale);
+  void DownScaleJbig2Bitmap();
   void TranslateScanline24bpp(uint8_t* dest_scan,
                               const uint8_t* src_scan) const;
   void ValidateDictParam();
@@ -591,6 +626,9 @@ class CPDF_DIBSource : public CFX_DIBSource {
   uint8_t* m_pMaskedLine;
   std::unique_ptr<CFX_DIBitmap> m_pCachedBitmap;
   ICodec_ScanlineDecoder* m_pDecoder;
+  int32_t m_nDownsampleWidth;
+  int32_t m_nDownsampleHeight;
+  int m_DownScale;
 };
 
 #define FPDF_HUGE_IMAGE_SIZE 60000000
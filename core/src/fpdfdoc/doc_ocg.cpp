@@ -6,6 +6,8 @@
 
 #include "core/include/fpdfdoc/fpdf_doc.h"
 
+#include "core/include/fxcrt/fx_lock.h"
+
 static int32_t FPDFDOC_OCG_FindGroup(const CPDF_Object* pObject,
                                      const CPDF_Dictionary* pGroupDict) {
   if (!pObject || !pGroupDict)
@@ -174,6 +176,8 @@ FX_BOOL CPDF_OCContext::GetOCGVisible(const CPDF_Dictionary* pOCGDict) {
   if (!pOCGDict)
     return FALSE;
 
+  // Bands of a page rendered at once share the context.
+  CFX_AutoLock lock(m_pDocument->GetSharedLock());
   const auto it = m_OCGStates.find(pOCGDict);
   if (it != m_OCGStates.end())
     return it->second;
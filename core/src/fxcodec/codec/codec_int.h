@@ -53,7 +53,7 @@ class CCodec_ScanlineDecoder : public ICodec_ScanlineDecoder {
   int GetWidth() override { return m_OutputWidth; }
   int GetHeight() override { return m_OutputHeight; }
   int CountComps() override { return m_nComps; }
-  int GetBPC() override { return m_bpc; }
+  int GetBPC() override { return m_pBoxDownsampler ? 8 : m_bpc; }
   FX_BOOL IsColorTransformed() override { return m_bColorTransformed; }
   void ClearImageData() override { m_pDataCache.reset(); }
 
@@ -88,6 +88,11 @@ class CCodec_ScanlineDecoder : public ICodec_ScanlineDecoder {
 
   uint8_t* ReadNextLine();
 
+  // For decoders that cannot reduce the image themselves: averages blocks of
+  // the lines they decode instead. Lines then have 8 bits per component.
+  void BoxDownScale(int dest_width, int dest_height);
+  const uint8_t* GetBoxScanline(int line);
+
   int m_OrigWidth;
   int m_OrigHeight;
   int m_DownScale;
@@ -100,6 +105,10 @@ class CCodec_ScanlineDecoder : public ICodec_ScanlineDecoder {
   int m_NextLine;
   uint8_t* m_pLastScanline;
   std::unique_ptr<ImageDataCache> m_pDataCache;
+  std::unique_ptr<CCodec_BoxDownsampler> m_pBoxDownsampler;
+  // The last line averaged by |m_pBoxDownsampler|. |m_NextLine| still counts
+  // the decoded lines.
+  int m_BoxLine;
 };
 
 class CCodec_FaxModule : public ICodec_FaxModule {
@@ -334,7 +343,8 @@ class CCodec_JpxModule : public ICodec_JpxModule {
   // ICodec_JpxModule:
   CJPX_Decoder* CreateDecoder(const uint8_t* src_buf,
                               FX_DWORD src_size,
-                              CPDF_ColorSpace* cs) override;
+                              CPDF_ColorSpace* cs,
+                              uint32_t* reduce) override;
   void GetImageInfo(CJPX_Decoder* pDecoder,
                     FX_DWORD* width,
                     FX_DWORD* height,
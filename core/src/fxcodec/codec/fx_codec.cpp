@@ -6,6 +6,7 @@
 
 #include "core/include/fxcodec/fx_codec.h"
 
+#include <algorithm>
 #include <cmath>
 #include <utility>
 
@@ -72,13 +73,16 @@ const uint8_t* CCodec_ScanlineDecoder::ImageDataCache::GetLine(int line) const {
 }
 
 CCodec_ScanlineDecoder::CCodec_ScanlineDecoder()
-    : m_NextLine(-1), m_pLastScanline(nullptr) {
+    : m_NextLine(-1), m_pLastScanline(nullptr), m_BoxLine(-1) {
 }
 
 CCodec_ScanlineDecoder::~CCodec_ScanlineDecoder() {
 }
 
 const uint8_t* CCodec_ScanlineDecoder::GetScanline(int line) {
+  if (m_pBoxDownsampler)
+    return GetBoxScanline(line);
+
   if (m_pDataCache && line < m_pDataCache->NumLines())
     return m_pDataCache->GetLine(line);
 
@@ -103,8 +107,15 @@ FX_BOOL CCodec_ScanlineDecoder::SkipToScanline(int line, IFX_Pause* pPause) {
   if (m_pDataCache && line < m_pDataCache->NumLines())
     return FALSE;
 
-  if (m_NextLine == line || m_NextLine == line + 1)
+  if (m_pBoxDownsampler) {
+    if (line == m_BoxLine)
+      return FALSE;
+    line *= m_pBoxDownsampler->GetScale();
+    if (m_NextLine == line)
+      return FALSE;
+  } else if (m_NextLine == line || m_NextLine == line + 1) {
     return FALSE;
+  }
 
   if (m_NextLine < 0 || m_NextLine > line) {
     v_Rewind();
@@ -135,6 +146,11 @@ void CCodec_ScanlineDecoder::DownScale(int dest_width, int dest_height) {
   dest_width = std::abs(dest_width);
   dest_height = std::abs(dest_height);
   v_DownScale(dest_width, dest_height);
+  if (m_pBoxDownsampler) {
+    // Averaged lines are cheap to make again from the decoded ones.
+    m_pDataCache.reset();
+    return;
+  }
 
   if (m_pDataCache &&
       m_pDataCache->IsSameDimensions(m_OutputWidth, m_OutputHeight)) {
@@ -149,6 +165,133 @@ void CCodec_ScanlineDecoder::DownScale(int dest_width, int dest_height) {
   m_pDataCache = std::move(cache);
 }
 
+void CCodec_ScanlineDecoder::BoxDownScale(int dest_width, int dest_height) {
+  int scale = 1;
+  if ((m_bpc == 8 || (m_bpc == 1 && m_nComps == 1)) && dest_width > 0 &&
+      dest_height > 0) {
+    scale = FX_GetDownsampleRatio(m_OrigWidth, m_OrigHeight, dest_width,
+                                  dest_height);
+  }
+  int old_scale = m_pBoxDownsampler ? m_pBoxDownsampler->GetScale() : 1;
+  if (scale == old_scale)
+    return;
+
+  if (scale == 1) {
+    m_pBoxDownsampler.reset();
+  } else {
+    m_pBoxDownsampler.reset(
+        new CCodec_BoxDownsampler(m_OrigWidth, m_nComps, m_bpc, scale));
+  }
+  m_OutputWidth = (m_OrigWidth + scale - 1) / scale;
+  m_OutputHeight = (m_OrigHeight + scale - 1) / scale;
+  m_BoxLine = -1;
+  m_pLastScanline = nullptr;
+  m_NextLine = -1;
+}
+
+const uint8_t* CCodec_ScanlineDecoder::GetBoxScanline(int line) {
+  if (line == m_BoxLine)
+    return m_pBoxDownsampler->GetOutput();
+
+  int scale = m_pBoxDownsampler->GetScale();
+  int src_line = line * scale;
+  if (m_NextLine < 0 || m_NextLine > src_line) {
+    if (!v_Rewind())
+      return nullptr;
+    m_NextLine = 0;
+  }
+  while (m_NextLine < src_line) {
+    if (!v_GetNextLine())
+      return nullptr;
+    m_NextLine++;
+  }
+  m_pBoxDownsampler->Reset();
+  int src_end = std::min(src_line + scale, m_OrigHeight);
+  while (m_NextLine < src_end) {
+    const uint8_t* pLine = v_GetNextLine();
+    if (!pLine)
+      break;
+    m_pBoxDownsampler->AddLine(pLine);
+    m_NextLine++;
+  }
+  m_BoxLine = line;
+  return m_pBoxDownsampler->Finish();
+}
+
+CCodec_BoxDownsampler::CCodec_BoxDownsampler(int src_width,
+                                             int nComps,
+                                             int bpc,
+                                             int scale)
+    : m_SrcWidth(src_width),
+      m_nComps(nComps),
+      m_bpc(bpc),
+      m_Scale(scale),
+      m_Width((src_width + scale - 1) / scale),
+      m_nLines(0),
+      m_Sums(m_Width * nComps),
+      m_Output(m_Width * nComps) {
+}
+
+CCodec_BoxDownsampler::~CCodec_BoxDownsampler() {
+}
+
+void CCodec_BoxDownsampler::Reset() {
+  std::fill(m_Sums.begin(), m_Sums.end(), 0);
+  m_nLines = 0;
+}
+
+void CCodec_BoxDownsampler::AddLine(const uint8_t* src_line) {
+  static const uint8_t kNibbleBits[16] = {0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4};
+  FX_DWORD* pSums = m_Sums.data();
+  if (m_bpc == 1) {
+    // Counts the set bits, a byte at a time where blocks do not straddle
+    // bytes.
+    int x = 0;
+    if (8 % m_Scale == 0) {
+      int blocks_per_byte = 8 / m_Scale;
+      uint8_t mask = (uint8_t)((1 << m_Scale) - 1);
+      for (; x + 8 <= m_SrcWidth; x += 8) {
+        uint8_t byte = src_line[x / 8];
+        for (int i = blocks_per_byte - 1; i >= 0; i--) {
+          uint8_t bits = (byte >> (i * m_Scale)) & mask;
+          *pSums++ += kNibbleBits[bits >> 4] + kNibbleBits[bits & 15];
+        }
+      }
+    }
+    for (; x < m_SrcWidth; x++) {
+      if (src_line[x / 8] & (1 << (7 - x % 8)))
+        m_Sums[x / m_Scale]++;
+    }
+  } else {
+    for (int x = 0; x < m_SrcWidth; x += m_Scale, pSums += m_nComps) {
+      int end = std::min(x + m_Scale, m_SrcWidth);
+      for (int i = x; i < end; i++) {
+        for (int c = 0; c < m_nComps; c++)
+          pSums[c] += *src_line++;
+      }
+    }
+  }
+  m_nLines++;
+}
+
+const uint8_t* CCodec_BoxDownsampler::Finish() {
+  if (m_nLines == 0) {
+    std::fill(m_Output.begin(), m_Output.end(), 0);
+    return m_Output.data();
+  }
+  for (int col = 0; col < m_Width; col++) {
+    int count = std::min(m_Scale, m_SrcWidth - col * m_Scale) * m_nLines;
+    for (int c = 0; c < m_nComps; c++) {
+      int i = col * m_nComps + c;
+      // 1-bit samples are counted rather than summed.
+      FX_DWORD sum = m_bpc == 1 ? m_Sums[i] * 255 : m_Sums[i];
+      m_Output[i] = (uint8_t)((sum + count / 2) / count);
+    }
+  }
+  return m_Output.data();
+}
+
 FX_BOOL CCodec_BasicModule::RunLengthEncode(const uint8_t* src_buf,
                                             FX_DWORD src_size,
                                             uint8_t*& dest_buf,
@@ -297,7 +440,9 @@ class CCodec_RLScanlineDecoder : public CCodec_ScanlineDecoder {
                  int bpc);
 
   // CCodec_ScanlineDecoder
-  void v_DownScale(int dest_width, int dest_height) override {}
+  void v_DownScale(int dest_width, int dest_height) override {
+    BoxDownScale(dest_width, dest_height);
+  }
   FX_BOOL v_Rewind() override;
   uint8_t* v_GetNextLine() override;
   FX_DWORD GetSrcOffset() override { return m_SrcOffset; }
@@ -613,7 +613,9 @@ class CCodec_FaxDecoder : public CCodec_ScanlineDecoder {
                  int Rows);
 
   // CCodec_ScanlineDecoder
-  void v_DownScale(int dest_width, int dest_height) override {}
+  void v_DownScale(int dest_width, int dest_height) override {
+    BoxDownScale(dest_width, dest_height);
+  }
   FX_BOOL v_Rewind() override;
   uint8_t* v_GetNextLine() override;
   FX_DWORD GetSrcOffset() override;
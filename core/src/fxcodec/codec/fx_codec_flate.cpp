@@ -750,7 +750,9 @@ class CCodec_FlateScanlineDecoder : public CCodec_ScanlineDecoder {
   void Destroy() { delete this; }
 
   // CCodec_ScanlineDecoder
-  void v_DownScale(int dest_width, int dest_height) override {}
+  void v_DownScale(int dest_width, int dest_height) override {
+    BoxDownScale(dest_width, dest_height);
+  }
   FX_BOOL v_Rewind() override;
   uint8_t* v_GetNextLine() override;
   FX_DWORD GetSrcOffset() override;
@@ -855,7 +857,7 @@ uint8_t* CCodec_FlateScanlineDecoder::v_GetNextLine() {
       } else {
         FPDFAPI_FlateOutput(m_pFlate, m_pScanline, m_Pitch);
         TIFF_PredictLine(m_pScanline, m_PredictPitch, m_bpc, m_nComps,
-                         m_OutputWidth);
+                         m_OrigWidth);
       }
     } else {
       size_t bytes_to_go = m_Pitch;
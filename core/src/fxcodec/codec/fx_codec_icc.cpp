@@ -5,6 +5,9 @@
 // Original code copyright 2014 Foxit Software Inc. http://www.foxitsoftware.com
 
 #include "codec_int.h"
+
+#include <algorithm>
+
 #include "core/include/fxcodec/fx_codec.h"
 #include "third_party/lcms2-2.6/include/lcms2.h"
 
@@ -1978,3 +1981,77 @@ void AdobeCMYK_to_sRGB(FX_FLOAT c,
   G = 1.0f * g / 255;
   B = 1.0f * b / 255;
 }
+
+namespace {
+
+// Where a CMYK component value falls on its axis of the g_CMYKSamples grid,
+// as computed by AdobeCMYK_to_sRGB1(): the nearest sample, the direction of
+// the neighbouring sample and the interpolation weight towards it.
+struct CMYKAxisStep {
+  int index;
+  int delta;
+  int rate;
+};
+
+class CMYKAxisTable {
+ public:
+  CMYKAxisTable() {
+    for (int v = 0; v < 256; ++v) {
+      int fix = v << 8;
+      int index = (fix + 4096) >> 13;
+      int index1 = fix >> 13;
+      if (index1 == index)
+        index1 = index1 == 8 ? index1 - 1 : index1 + 1;
+      m_Steps[v].index = index;
+      m_Steps[v].delta = index1 - index;
+      m_Steps[v].rate = (fix - (index << 13)) * (index - index1);
+    }
+  }
+
+  const CMYKAxisStep& operator[](uint8_t v) const { return m_Steps[v]; }
+
+ private:
+  CMYKAxisStep m_Steps[256];
+};
+
+void AddCMYKAxis(const uint8_t* pSample,
+                 const CMYKAxisStep& step,
+                 int stride,
+                 int* fix) {
+  const uint8_t* pNeighbour = pSample + step.delta * stride;
+  for (int i = 0; i < 3; ++i)
+    fix[i] += (pSample[i] - pNeighbour[i]) * step.rate / 32;
+}
+
+}  // namespace
+
+void AdobeCMYK_to_sRGBLine(uint8_t* pDestBuf,
+                           const uint8_t* pSrcBuf,
+                           int pixels) {
+  static const CMYKAxisTable s_Axis;
+  for (int i = 0; i < pixels; ++i) {
+    if (i && FXSYS_memcmp(pSrcBuf, pSrcBuf - 4, 4) == 0) {
+      FXSYS_memcpy(pDestBuf, pDestBuf - 3, 3);
+      pSrcBuf += 4;
+      pDestBuf += 3;
+      continue;
+    }
+    const CMYKAxisStep& c = s_Axis[pSrcBuf[0]];
+    const CMYKAxisStep& m = s_Axis[pSrcBuf[1]];
+    const CMYKAxisStep& y = s_Axis[pSrcBuf[2]];
+    const CMYKAxisStep& k = s_Axis[pSrcBuf[3]];
+    const uint8_t* pSample =
+        g_CMYKSamples +
+        (((c.index * 9 + m.index) * 9 + y.index) * 9 + k.index) * 3;
+    int fix[3] = {pSample[0] << 8, pSample[1] << 8, pSample[2] << 8};
+    AddCMYKAxis(pSample, c, 9 * 9 * 9 * 3, fix);
+    AddCMYKAxis(pSample, m, 9 * 9 * 3, fix);
+    AddCMYKAxis(pSample, y, 9 * 3, fix);
+    AddCMYKAxis(pSample, k, 3, fix);
+    pDestBuf[2] = std::max(fix[0], 0) >> 8;
+    pDestBuf[1] = std::max(fix[1], 0) >> 8;
+    pDestBuf[0] = std::max(fix[2], 0) >> 8;
+    pSrcBuf += 4;
+    pDestBuf += 3;
+  }
+}
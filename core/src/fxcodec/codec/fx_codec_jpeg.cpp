@@ -446,6 +446,8 @@ int32_t FX_GetDownsampleRatio(int32_t originWidth,
                               int32_t originHeight,
                               int32_t downsampleWidth,
                               int32_t downsampleHeight) {
+  if (downsampleWidth <= 0 || downsampleHeight <= 0)
+    return 1;
   int iratio_w = originWidth / downsampleWidth;
   int iratio_h = originHeight / downsampleHeight;
   int ratio = (iratio_w > iratio_h) ? iratio_h : iratio_w;
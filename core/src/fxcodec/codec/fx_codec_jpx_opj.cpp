@@ -659,11 +659,27 @@ void color_apply_conversion(opj_image_t* image) {
     return;
   }
 }
+
+// The length of the |start| to |end| extent of the image in a component
+// subsampled by |step|, at a resolution |reduce| times halved.
+static OPJ_UINT32 ReducedLength(OPJ_UINT32 start,
+                                OPJ_UINT32 end,
+                                OPJ_UINT32 step,
+                                uint32_t reduce) {
+  uint64_t first = ((uint64_t)start + step - 1) / step;
+  uint64_t last = ((uint64_t)end + step - 1) / step;
+  return (OPJ_UINT32)(((last + (1ULL << reduce) - 1) >> reduce) -
+                      ((first + (1ULL << reduce) - 1) >> reduce));
+}
+
 class CJPX_Decoder {
  public:
   explicit CJPX_Decoder(CPDF_ColorSpace* cs);
   ~CJPX_Decoder();
-  FX_BOOL Init(const unsigned char* src_data, FX_DWORD src_size);
+  FX_BOOL Init(const unsigned char* src_data,
+               FX_DWORD src_size,
+               uint32_t reduce);
+  uint32_t GetReduce() const { return m_Reduce; }
   void GetInfo(FX_DWORD* width, FX_DWORD* height, FX_DWORD* components);
   bool Decode(uint8_t* dest_buf,
               int pitch,
@@ -676,10 +692,16 @@ class CJPX_Decoder {
   opj_codec_t* l_codec;
   opj_stream_t* l_stream;
   const CPDF_ColorSpace* const m_ColorSpace;
+  // Each level halves the width and height of the decoded image.
+  uint32_t m_Reduce;
 };
 
 CJPX_Decoder::CJPX_Decoder(CPDF_ColorSpace* cs)
-    : image(nullptr), l_codec(nullptr), l_stream(nullptr), m_ColorSpace(cs) {}
+    : image(nullptr),
+      l_codec(nullptr),
+      l_stream(nullptr),
+      m_ColorSpace(cs),
+      m_Reduce(0) {}
 
 CJPX_Decoder::~CJPX_Decoder() {
   if (l_codec) {
@@ -693,7 +715,9 @@ CJPX_Decoder::~CJPX_Decoder() {
   }
 }
 
-FX_BOOL CJPX_Decoder::Init(const unsigned char* src_data, FX_DWORD src_size) {
+FX_BOOL CJPX_Decoder::Init(const unsigned char* src_data,
+                           FX_DWORD src_size,
+                           uint32_t reduce) {
   static const unsigned char szJP2Header[] = {
       0x00, 0x00, 0x00, 0x0c, 0x6a, 0x50, 0x20, 0x20, 0x0d, 0x0a, 0x87, 0x0a};
   if (!src_data || src_size < sizeof(szJP2Header))
@@ -734,6 +758,22 @@ FX_BOOL CJPX_Decoder::Init(const unsigned char* src_data, FX_DWORD src_size) {
     return FALSE;
   }
   image->pdfium_use_colorspace = !!m_ColorSpace;
+  // Fails for levels the codestream does not have, but still records them.
+  while (reduce && !opj_set_decoded_resolution_factor(l_codec, reduce))
+    reduce--;
+  if (reduce) {
+    // The decoded components are laid out by their sizes, which setting
+    // the factor leaves at the full resolution.
+    m_Reduce = reduce;
+    for (OPJ_UINT32 i = 0; i < image->numcomps; i++) {
+      opj_image_comp_t* comp = &image->comps[i];
+      comp->factor = reduce;
+      comp->w = ReducedLength(image->x0, image->x1, comp->dx, reduce);
+      comp->h = ReducedLength(image->y0, image->y1, comp->dy, reduce);
+    }
+  } else {
+    opj_set_decoded_resolution_factor(l_codec, 0);
+  }
 
   if (!parameters.nb_tile_to_decode) {
     if (!opj_set_decode_area(l_codec, image, parameters.DA_x0, parameters.DA_y0,
@@ -779,21 +819,25 @@ FX_BOOL CJPX_Decoder::Init(const unsigned char* src_data, FX_DWORD src_size) {
 void CJPX_Decoder::GetInfo(FX_DWORD* width,
                            FX_DWORD* height,
                            FX_DWORD* components) {
-  *width = (FX_DWORD)image->x1;
-  *height = (FX_DWORD)image->y1;
+  *width = (FX_DWORD)ReducedLength(0, image->x1, 1, m_Reduce);
+  *height = (FX_DWORD)ReducedLength(0, image->y1, 1, m_Reduce);
   *components = (FX_DWORD)image->numcomps;
 }
 
 bool CJPX_Decoder::Decode(uint8_t* dest_buf,
                           int pitch,
                           const std::vector<uint8_t>& offsets) {
-  if (image->comps[0].w != image->x1 || image->comps[0].h != image->y1)
+  FX_DWORD image_width = 0;
+  FX_DWORD image_height = 0;
+  FX_DWORD components = 0;
+  GetInfo(&image_width, &image_height, &components);
+  if (image->comps[0].w != image_width || image->comps[0].h != image_height)
     return false;
 
   if (pitch<(int)(image->comps[0].w * 8 * image->numcomps + 31)>> 5 << 2)
     return false;
 
-  FXSYS_memset(dest_buf, 0xff, image->y1 * pitch);
+  FXSYS_memset(dest_buf, 0xff, image_height * pitch);
   std::vector<uint8_t*> channel_bufs(image->numcomps);
   std::vector<int> adjust_comps(image->numcomps);
   for (uint32_t i = 0; i < image->numcomps; i++) {
@@ -864,9 +908,21 @@ CCodec_JpxModule::~CCodec_JpxModule() {
 
 CJPX_Decoder* CCodec_JpxModule::CreateDecoder(const uint8_t* src_buf,
                                               FX_DWORD src_size,
-                                              CPDF_ColorSpace* cs) {
+                                              CPDF_ColorSpace* cs,
+                                              uint32_t* reduce) {
+  uint32_t levels = reduce ? *reduce : 0;
   std::unique_ptr<CJPX_Decoder> decoder(new CJPX_Decoder(cs));
-  return decoder->Init(src_buf, src_size) ? decoder.release() : nullptr;
+  if (!decoder->Init(src_buf, src_size, levels)) {
+    // Tiles may have fewer levels than the main header says.
+    if (!levels)
+      return nullptr;
+    decoder.reset(new CJPX_Decoder(cs));
+    if (!decoder->Init(src_buf, src_size, 0))
+      return nullptr;
+  }
+  if (reduce)
+    *reduce = decoder->GetReduce();
+  return decoder.release();
 }
 
 void CCodec_JpxModule::GetImageInfo(CJPX_Decoder* pDecoder,
@@ -235,6 +235,9 @@ bool CFX_ByteString::Equal(const CFX_ByteStringC& str) const {
          FXSYS_memcmp(m_pData->m_String, str.GetCStr(), str.GetLength()) == 0;
 }
 bool CFX_ByteString::Equal(const CFX_ByteString& other) const {
+  if (m_pData == other.m_pData) {
+    return true;
+  }
   if (IsEmpty()) {
     return other.IsEmpty();
   }
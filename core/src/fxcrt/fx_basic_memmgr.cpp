@@ -46,7 +46,8 @@ void CFX_GrowOnlyPool::FreeAll() {
   m_pFirstTrunk = NULL;
 }
 void* CFX_GrowOnlyPool::Alloc(size_t size) {
-  size = (size + 3) / 4 * 4;
+  // Keep every block pointer-aligned so that objects can live in the pool.
+  size = (size + 7) / 8 * 8;
   _FX_GrowOnlyTrunk* pTrunk = (_FX_GrowOnlyTrunk*)m_pFirstTrunk;
   while (pTrunk) {
     if (pTrunk->m_Size - pTrunk->m_Allocated >= size) {
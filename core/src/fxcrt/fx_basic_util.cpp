@@ -6,7 +6,9 @@
 
 #include "core/include/fxcrt/fx_basic.h"
 #include "core/include/fxcrt/fx_ext.h"
+#include "core/include/fxcrt/fx_lock.h"
 
+#include <atomic>
 #include <cctype>
 
 #if _FXM_PLATFORM_ != _FXM_PLATFORM_WINDOWS_
@@ -92,34 +94,63 @@ void CFX_PrivateData::ClearAll() {
   }
   m_DataList.RemoveAll();
 }
+namespace {
+
+const FX_FLOAT kFractionScales[] = {
+    0.1f,         0.01f,         0.001f,        0.0001f,
+    0.00001f,     0.000001f,     0.0000001f,    0.00000001f,
+    0.000000001f, 0.0000000001f, 0.00000000001f};
+
+// Adds the digits after a decimal point to |value|, the same way FX_atof()
+// does.
+FX_FLOAT AddFraction(FX_FLOAT value, const FX_CHAR* str, int cc, int len) {
+  int scale = 0;
+  while (cc < len) {
+    value += kFractionScales[scale] * FXSYS_toDecimalDigit(str[cc]);
+    scale++;
+    if (scale == FX_ArraySize(kFractionScales))
+      break;
+    cc++;
+  }
+  return value;
+}
+
+}  // namespace
+
 void FX_atonum(const CFX_ByteStringC& strc, FX_BOOL& bInteger, void* pData) {
-  if (!FXSYS_memchr(strc.GetPtr(), '.', strc.GetLength())) {
-    bInteger = TRUE;
-    int cc = 0, integer = 0;
-    const FX_CHAR* str = strc.GetCStr();
-    int len = strc.GetLength();
-    FX_BOOL bNegative = FALSE;
-    if (str[0] == '+') {
-      cc++;
-    } else if (str[0] == '-') {
-      bNegative = TRUE;
-      cc++;
-    }
-    while (cc < len && std::isdigit(str[cc])) {
-      // TODO(dsinclair): This is not the right way to handle overflow.
-      integer = integer * 10 + FXSYS_toDecimalDigit(str[cc]);
-      if (integer < 0)
-        break;
-      cc++;
-    }
-    if (bNegative) {
-      integer = -integer;
-    }
-    *(int*)pData = integer;
-  } else {
+  int cc = 0, integer = 0;
+  const FX_CHAR* str = strc.GetCStr();
+  int len = strc.GetLength();
+  FX_BOOL bNegative = FALSE;
+  if (len > 0 && str[0] == '+') {
+    cc++;
+  } else if (len > 0 && str[0] == '-') {
+    bNegative = TRUE;
+    cc++;
+  }
+  int digits_start = cc;
+  while (cc < len && std::isdigit(str[cc])) {
+    // TODO(dsinclair): This is not the right way to handle overflow.
+    integer = integer * 10 + FXSYS_toDecimalDigit(str[cc]);
+    if (integer < 0)
+      break;
+    cc++;
+  }
+  if (cc < len && str[cc] == '.' && cc - digits_start <= 7) {
+    // Up to 7 digits are exact as a float, so this matches the integer part
+    // FX_atof() would compute and only the fraction is left to read.
+    FX_FLOAT value = AddFraction((FX_FLOAT)integer, str, cc + 1, len);
+    bInteger = FALSE;
+    *(FX_FLOAT*)pData = bNegative ? -value : value;
+    return;
+  }
+  if (cc < len && FXSYS_memchr(str + cc, '.', len - cc)) {
     bInteger = FALSE;
     *(FX_FLOAT*)pData = FX_atof(strc);
+    return;
   }
+  bInteger = TRUE;
+  *(int*)pData = bNegative ? -integer : integer;
 }
 FX_FLOAT FX_atof(const CFX_ByteStringC& strc) {
   if (strc.GetLength() == 0) {
@@ -149,22 +180,8 @@ FX_FLOAT FX_atof(const CFX_ByteStringC& strc) {
     value = value * 10 + FXSYS_toDecimalDigit(str[cc]);
     cc++;
   }
-  static const FX_FLOAT fraction_scales[] = {
-      0.1f,         0.01f,         0.001f,        0.0001f,
-      0.00001f,     0.000001f,     0.0000001f,    0.00000001f,
-      0.000000001f, 0.0000000001f, 0.00000000001f};
-  int scale = 0;
-  if (cc < len && str[cc] == '.') {
-    cc++;
-    while (cc < len) {
-      value += fraction_scales[scale] * FXSYS_toDecimalDigit(str[cc]);
-      scale++;
-      if (scale == sizeof fraction_scales / sizeof(FX_FLOAT)) {
-        break;
-      }
-      cc++;
-    }
-  }
+  if (cc < len && str[cc] == '.')
+    value = AddFraction(value, str, cc + 1, len);
   return bNegative ? -value : value;
 }
 
@@ -373,3 +390,18 @@ CFX_Vector_3by1 CFX_Matrix_3by3::TransformVector(const CFX_Vector_3by1& v) {
                          d * v.a + e * v.b + f * v.c,
                          g * v.a + h * v.b + i * v.c);
 }
+
+namespace {
+
+std::atomic<bool> g_bGlobalLockEnabled(false);
+
+}  // namespace
+
+void FX_EnableGlobalLock() {
+  g_bGlobalLockEnabled = true;
+}
+
+std::recursive_mutex* FX_GetGlobalLock() {
+  static std::recursive_mutex s_GlobalLock;
+  return g_bGlobalLockEnabled ? &s_GlobalLock : nullptr;
+}
@@ -0,0 +1,60 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstring>
+
+#include "core/include/fxcrt/fx_string.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Parses |str| and returns the result as a float, whichever type it was.
+FX_FLOAT ParseNumber(const char* str, FX_BOOL* bInteger) {
+  int data;
+  FX_atonum(str, *bInteger, &data);
+  if (*bInteger)
+    return (FX_FLOAT)data;
+  FX_FLOAT value;
+  std::memcpy(&value, &data, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+TEST(fxcrt, FX_atonumIntegers) {
+  const struct {
+    const char* str;
+    int expected;
+  } kTests[] = {
+      {"", 0},       {"0", 0},         {"123", 123},
+      {"+42", 42},   {"-42", -42},     {"12abc", 12},
+      {"-", 0},      {"2147483647", 2147483647},
+  };
+  for (const auto& test : kTests) {
+    FX_BOOL bInteger;
+    int value;
+    FX_atonum(test.str, bInteger, &value);
+    EXPECT_TRUE(bInteger) << test.str;
+    EXPECT_EQ(test.expected, value) << test.str;
+  }
+}
+
+TEST(fxcrt, FX_atonumMatchesFX_atof) {
+  // Numbers with a decimal point must come out bit for bit as FX_atof()
+  // gives them, whether or not they take the short path.
+  const char* const kTests[] = {
+      "0.5",        "-0.5",         ".25",          "-.25",
+      "1.",         "-0.0",         "3.14159",      "1234567.125",
+      "12345678.5", "-98765432.1",  "0.000000001",  "1.123456789012345",
+      "+-1.5",      "1-2.5",        "12a.5",        "5.5.5",
+      "99999999999.9", "1.2e5",     "0.1234567890123",
+  };
+  for (const char* str : kTests) {
+    FX_BOOL bInteger;
+    FX_FLOAT value = ParseNumber(str, &bInteger);
+    EXPECT_FALSE(bInteger) << str;
+    FX_FLOAT expected = FX_atof(str);
+    EXPECT_EQ(0, std::memcmp(&expected, &value, sizeof(value))) << str;
+  }
+}
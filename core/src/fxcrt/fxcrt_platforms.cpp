@@ -15,6 +15,9 @@
 IFXCRT_FileAccess* FXCRT_FileAccess_Create() {
   return new CFXCRT_FileAccess_CRT;
 }
+IFX_FileRead* FX_CreateMappedFileRead(const FX_CHAR* filename) {
+  return NULL;
+}
 void FXCRT_GetFileModeString(FX_DWORD dwModes, CFX_ByteString& bsMode) {
   if (dwModes & FX_FILEMODE_ReadOnly) {
     bsMode = "rb";
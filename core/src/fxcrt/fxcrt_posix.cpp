@@ -11,6 +11,8 @@
 #if _FXM_PLATFORM_ == _FXM_PLATFORM_LINUX_ || \
     _FXM_PLATFORM_ == _FXM_PLATFORM_APPLE_ || \
     _FXM_PLATFORM_ == _FXM_PLATFORM_ANDROID_
+#include <sys/mman.h>
+
 IFXCRT_FileAccess* FXCRT_FileAccess_Create() {
   return new CFXCRT_FileAccess_Posix;
 }
@@ -127,4 +129,65 @@ FX_BOOL CFXCRT_FileAccess_Posix::Truncate(FX_FILESIZE szFile) {
   }
   return !ftruncate(m_nFD, szFile);
 }
+
+IFX_FileRead* FX_CreateMappedFileRead(const FX_CHAR* filename) {
+  CFXCRT_MappedFileRead_Posix* pFile = new CFXCRT_MappedFileRead_Posix;
+  if (!pFile->Open(filename)) {
+    pFile->Release();
+    return NULL;
+  }
+  return pFile;
+}
+CFXCRT_MappedFileRead_Posix::CFXCRT_MappedFileRead_Posix()
+    : m_pData(NULL), m_nSize(0) {}
+CFXCRT_MappedFileRead_Posix::~CFXCRT_MappedFileRead_Posix() {
+  if (m_pData) {
+    munmap(m_pData, (size_t)m_nSize);
+  }
+}
+FX_BOOL CFXCRT_MappedFileRead_Posix::Open(const CFX_ByteStringC& fileName) {
+  if (m_pData) {
+    return FALSE;
+  }
+  int32_t nFD = open(fileName.GetCStr(), O_BINARY | O_LARGEFILE | O_RDONLY);
+  if (nFD < 0) {
+    return FALSE;
+  }
+  struct stat s;
+  FXSYS_memset(&s, 0, sizeof(s));
+  // mmap() rejects empty mappings, so empty files are left to the regular
+  // file reader.
+  if (fstat(nFD, &s) < 0 || s.st_size <= 0 ||
+      s.st_size != (off_t)(size_t)s.st_size) {
+    close(nFD);
+    return FALSE;
+  }
+  void* pData = mmap(NULL, (size_t)s.st_size, PROT_READ, MAP_PRIVATE, nFD, 0);
+  // The mapping keeps its own reference to the file.
+  close(nFD);
+  if (pData == MAP_FAILED) {
+    return FALSE;
+  }
+  m_pData = static_cast<uint8_t*>(pData);
+  m_nSize = s.st_size;
+  return TRUE;
+}
+void CFXCRT_MappedFileRead_Posix::Release() {
+  delete this;
+}
+FX_BOOL CFXCRT_MappedFileRead_Posix::ReadBlock(void* buffer,
+                                               FX_FILESIZE offset,
+                                               size_t size) {
+  if (offset < 0 || offset > m_nSize || (FX_FILESIZE)size > m_nSize - offset) {
+    return FALSE;
+  }
+  FXSYS_memcpy(buffer, m_pData + offset, size);
+  return TRUE;
+}
+FX_FILESIZE CFXCRT_MappedFileRead_Posix::GetSize() {
+  return m_nSize;
+}
+const uint8_t* CFXCRT_MappedFileRead_Posix::GetDirectBuffer() {
+  return m_pData;
+}
 #endif
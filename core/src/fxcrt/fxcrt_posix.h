@@ -37,6 +37,24 @@ class CFXCRT_FileAccess_Posix : public IFXCRT_FileAccess {
  protected:
   int32_t m_nFD;
 };
+
+class CFXCRT_MappedFileRead_Posix final : public IFX_FileRead {
+ public:
+  CFXCRT_MappedFileRead_Posix();
+  ~CFXCRT_MappedFileRead_Posix() override;
+
+  FX_BOOL Open(const CFX_ByteStringC& fileName);
+
+  // IFX_FileRead
+  void Release() override;
+  FX_BOOL ReadBlock(void* buffer, FX_FILESIZE offset, size_t size) override;
+  FX_FILESIZE GetSize() override;
+  const uint8_t* GetDirectBuffer() override;
+
+ protected:
+  uint8_t* m_pData;
+  FX_FILESIZE m_nSize;
+};
 #endif
 
 #endif  // CORE_SRC_FXCRT_FXCRT_POSIX_H_
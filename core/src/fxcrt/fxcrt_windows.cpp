@@ -12,6 +12,9 @@
 IFXCRT_FileAccess* FXCRT_FileAccess_Create() {
   return new CFXCRT_FileAccess_Win64;
 }
+IFX_FileRead* FX_CreateMappedFileRead(const FX_CHAR* filename) {
+  return NULL;
+}
 void FXCRT_Windows_GetFileMode(FX_DWORD dwMode,
                                FX_DWORD& dwAccess,
                                FX_DWORD& dwShare,
@@ -0,0 +1,150 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "core/include/fxge/fx_dib.h"
+#include "testing/embedder_test.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+class FXDIBCompositeEmbeddertest : public EmbedderTest {};
+
+namespace {
+
+const int kBlendTypes[] = {
+    FXDIB_BLEND_NORMAL,     FXDIB_BLEND_MULTIPLY,   FXDIB_BLEND_SCREEN,
+    FXDIB_BLEND_OVERLAY,    FXDIB_BLEND_DARKEN,     FXDIB_BLEND_LIGHTEN,
+    FXDIB_BLEND_COLORDODGE, FXDIB_BLEND_COLORBURN,  FXDIB_BLEND_HARDLIGHT,
+    FXDIB_BLEND_SOFTLIGHT,  FXDIB_BLEND_DIFFERENCE, FXDIB_BLEND_EXCLUSION,
+    FXDIB_BLEND_HUE,        FXDIB_BLEND_SATURATION, FXDIB_BLEND_COLOR,
+    FXDIB_BLEND_LUMINOSITY,
+};
+
+// Pseudo-random pixels of |Bpp| bytes. With |Bpp| 4, the alpha bytes come
+// in runs of transparent, opaque and partly transparent pixels, so a row
+// mixes the pixels the vector kernels take with those they leave.
+std::vector<uint8_t> MakePixels(int pixels, int Bpp, unsigned seed) {
+  std::vector<uint8_t> data(pixels * Bpp);
+  for (uint8_t& byte : data) {
+    seed = seed * 1103515245 + 12345;
+    byte = seed >> 16;
+  }
+  if (Bpp == 4) {
+    for (int i = 0; i < pixels; ++i) {
+      switch (i / 7 % 3) {
+        case 0:
+          data[i * 4 + 3] = 0;
+          break;
+        case 1:
+          data[i * 4 + 3] = 255;
+          break;
+      }
+    }
+  }
+  return data;
+}
+
+// Composites |src| onto |dest| in one go, or |step| pixels at a time.
+void CompositeRow(FXDIB_Format dest_format,
+                  FXDIB_Format src_format,
+                  int blend_type,
+                  uint8_t* dest,
+                  const uint8_t* src,
+                  const uint8_t* clip,
+                  int pixels,
+                  int step) {
+  CFX_ScanlineCompositor compositor;
+  ASSERT_TRUE(compositor.Init(dest_format, src_format, pixels, nullptr,
+                              0xc0306090, blend_type, !!clip));
+  int dest_Bpp = (dest_format & 0xff) / 8;
+  int src_Bpp = (src_format & 0xff) / 8;
+  for (int i = 0; i < pixels; i += step) {
+    int width = std::min(step, pixels - i);
+    const uint8_t* clip_scan = clip ? clip + i : nullptr;
+    if (src_format == FXDIB_8bppMask) {
+      compositor.CompositeByteMaskLine(dest + i * dest_Bpp, src + i, width,
+                                       clip_scan);
+    } else {
+      compositor.CompositeRgbBitmapLine(dest + i * dest_Bpp, src + i * src_Bpp,
+                                        width, clip_scan);
+    }
+  }
+}
+
+}  // namespace
+
+TEST_F(FXDIBCompositeEmbeddertest, VectorMatchesScalar) {
+  struct {
+    FXDIB_Format dest;
+    FXDIB_Format src;
+  } formats[] = {
+      {FXDIB_Argb, FXDIB_Argb},     {FXDIB_Rgb32, FXDIB_Argb},
+      {FXDIB_Rgb, FXDIB_Argb},      {FXDIB_Argb, FXDIB_8bppMask},
+      {FXDIB_Rgb32, FXDIB_8bppMask}, {FXDIB_Rgb, FXDIB_8bppMask},
+  };
+  // Not a multiple of the four pixels the vector kernels take at a time.
+  const int kPixels = 1001;
+  const std::vector<uint8_t> clip = MakePixels(kPixels, 1, 3);
+  for (const auto& format : formats) {
+    int dest_Bpp = (format.dest & 0xff) / 8;
+    int src_Bpp = (format.src & 0xff) / 8;
+    std::vector<uint8_t> src = MakePixels(kPixels, src_Bpp, 2);
+    for (int blend_type : kBlendTypes) {
+      for (const uint8_t* clip_scan : {(const uint8_t*)nullptr, clip.data()}) {
+        std::vector<uint8_t> whole = MakePixels(kPixels, dest_Bpp, 1);
+        std::vector<uint8_t> per_pixel = whole;
+        // One pixel at a time never reaches the vector kernels.
+        CompositeRow(format.dest, format.src, blend_type, whole.data(),
+                     src.data(), clip_scan, kPixels, kPixels);
+        CompositeRow(format.dest, format.src, blend_type, per_pixel.data(),
+                     src.data(), clip_scan, kPixels, 1);
+        EXPECT_EQ(per_pixel, whole) << std::hex << format.dest << " "
+                                    << format.src << std::dec << " blend "
+                                    << blend_type << " clip " << !!clip_scan;
+      }
+    }
+  }
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests. Composites a page
+// sized area whole, and three pixels at a time to keep to the scalar code.
+TEST_F(FXDIBCompositeEmbeddertest, DISABLED_BenchmarkComposite) {
+  struct {
+    const char* name;
+    FXDIB_Format dest;
+    FXDIB_Format src;
+    int blend_type;
+  } cases[] = {
+      {"Argb onto Argb", FXDIB_Argb, FXDIB_Argb, FXDIB_BLEND_NORMAL},
+      {"Argb onto Rgb32", FXDIB_Rgb32, FXDIB_Argb, FXDIB_BLEND_NORMAL},
+      {"Argb onto Rgb32, multiply", FXDIB_Rgb32, FXDIB_Argb,
+       FXDIB_BLEND_MULTIPLY},
+      {"mask onto Argb", FXDIB_Argb, FXDIB_8bppMask, FXDIB_BLEND_NORMAL},
+      {"mask onto Rgb32", FXDIB_Rgb32, FXDIB_8bppMask, FXDIB_BLEND_NORMAL},
+  };
+  const int kWidth = 2000;
+  const int kHeight = 2000;
+  for (const auto& test : cases) {
+    int dest_Bpp = (test.dest & 0xff) / 8;
+    int src_Bpp = (test.src & 0xff) / 8;
+    std::vector<uint8_t> src = MakePixels(kWidth, src_Bpp, 2);
+    std::vector<uint8_t> backdrop(kWidth * dest_Bpp, 0xff);
+    long long ms[2];
+    for (int i = 0; i < 2; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      for (int row = 0; row < kHeight; ++row) {
+        std::vector<uint8_t> dest = backdrop;
+        CompositeRow(test.dest, test.src, test.blend_type, dest.data(),
+                     src.data(), nullptr, kWidth, i ? 3 : kWidth);
+      }
+      ms[i] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start).count();
+    }
+    printf("%s %dx%d: %lld ms, %lld ms three pixels at a time\n", test.name,
+           kWidth, kHeight, ms[0], ms[1]);
+  }
+}
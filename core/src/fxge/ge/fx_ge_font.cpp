@@ -4,6 +4,7 @@
 
 // Original code copyright 2014 Foxit Software Inc. http://www.foxitsoftware.com
 
+#include "core/include/fxcrt/fx_lock.h"
 #include "core/include/fxge/fx_freetype.h"
 #include "core/include/fxge/fx_ge.h"
 #include "text_int.h"
@@ -71,6 +72,7 @@ CFX_Font::CFX_Font() {
 
 #ifdef PDF_ENABLE_XFA
 FX_BOOL CFX_Font::LoadClone(const CFX_Font* pFont) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   if (pFont == NULL) {
     return FALSE;
   }
@@ -105,6 +107,7 @@ FX_BOOL CFX_Font::LoadClone(const CFX_Font* pFont) {
 #endif  // PDF_ENABLE_XFA
 
 CFX_Font::~CFX_Font() {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   delete m_pSubstFont;
   FX_Free(m_pFontDataAllocation);
 #ifdef PDF_ENABLE_XFA
@@ -134,6 +137,7 @@ CFX_Font::~CFX_Font() {
 #endif
 }
 void CFX_Font::DeleteFace() {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   FXFT_Done_Face(m_Face);
   m_Face = NULL;
 }
@@ -144,6 +148,7 @@ void CFX_Font::LoadSubst(const CFX_ByteString& face_name,
                          int italic_angle,
                          int CharsetCP,
                          FX_BOOL bVertical) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   m_bEmbedded = FALSE;
   m_bVertical = bVertical;
   m_pSubstFont = new CFX_SubstFont;
@@ -207,6 +212,7 @@ FX_BOOL _LoadFile(FXFT_Library library,
 FX_BOOL CFX_Font::LoadFile(IFX_FileRead* pFile,
                            int nFaceIndex,
                            int* pFaceCount) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   m_bEmbedded = FALSE;
 
   CFX_FontMgr* pFontMgr = CFX_GEModule::Get()->GetFontMgr();
@@ -226,6 +232,7 @@ FX_BOOL CFX_Font::LoadFile(IFX_FileRead* pFile,
 #endif  // PDF_ENABLE_XFA
 
 int CFX_Font::GetGlyphWidth(FX_DWORD glyph_index) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   if (!m_Face) {
     return 0;
   }
@@ -244,6 +251,7 @@ int CFX_Font::GetGlyphWidth(FX_DWORD glyph_index) {
 }
 
 FX_BOOL CFX_Font::LoadEmbedded(const uint8_t* data, FX_DWORD size) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   m_pFontDataAllocation = FX_Alloc(uint8_t, size);
   FXSYS_memcpy(m_pFontDataAllocation, data, size);
   m_Face = FT_LoadFont(m_pFontDataAllocation, size);
@@ -274,6 +282,7 @@ int CFX_Font::GetDescent() const {
 }
 
 FX_BOOL CFX_Font::GetGlyphBBox(FX_DWORD glyph_index, FX_RECT& bbox) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   if (!m_Face)
     return FALSE;
 
@@ -406,6 +415,7 @@ CFX_ByteString CFX_Font::GetFaceName() const {
   return m_pSubstFont->m_Family;
 }
 FX_BOOL CFX_Font::GetBBox(FX_RECT& bbox) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   if (!m_Face) {
     return FALSE;
   }
@@ -463,6 +473,7 @@ CFX_UnicodeEncoding::~CFX_UnicodeEncoding() {
 }
 
 FX_DWORD CFX_UnicodeEncoding::GlyphFromCharCode(FX_DWORD charcode) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   FXFT_Face face = m_pFont->GetFace();
   if (!face)
     return charcode;
@@ -490,6 +501,7 @@ CFX_UnicodeEncodingEx::~CFX_UnicodeEncodingEx() {
 }
 
 FX_DWORD CFX_UnicodeEncodingEx::GlyphFromCharCode(FX_DWORD charcode) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   FXFT_Face face = m_pFont->GetFace();
   FT_UInt nIndex = FXFT_Get_Char_Index(face, charcode);
   if (nIndex > 0) {
@@ -518,6 +530,7 @@ FX_DWORD CFX_UnicodeEncodingEx::GlyphFromCharCode(FX_DWORD charcode) {
 }
 
 FX_DWORD CFX_UnicodeEncodingEx::CharCodeFromUnicode(FX_WCHAR Unicode) const {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   if (m_nEncodingID == FXFM_ENCODING_UNICODE ||
       m_nEncodingID == FXFM_ENCODING_MS_SYMBOL) {
     return Unicode;
@@ -7,6 +7,7 @@
 #include "core/include/fxge/fx_ge.h"
 #include "core/include/fxge/fx_freetype.h"
 #include "core/include/fxcodec/fx_codec.h"
+#include "core/include/fxcrt/fx_lock.h"
 #include "text_int.h"
 
 #undef FX_GAMMA
@@ -404,7 +405,11 @@ FX_BOOL CFX_RenderDevice::DrawNormalText(int nChars,
     }
     FX_BOOL bBGRStripe = text_flags & FXTEXT_BGR_STRIPE;
     ncols /= 3;
-    int x_subpixel = (int)(glyph.m_fOriginX * 3) % 3;
+    // Floored, so that glyphs left of the device origin, as in a tile of a
+    // page, get the same subpixel phase as they would further right.
+    int x_subpixel = (int)FXSYS_floor(glyph.m_fOriginX * 3) % 3;
+    if (x_subpixel < 0)
+      x_subpixel += 3;
     uint8_t* src_buf = pGlyph->GetBuffer();
     int src_pitch = pGlyph->GetPitch();
     int start_col = left;
@@ -1172,6 +1177,7 @@ CFX_FontCache::~CFX_FontCache() {
 }
 
 CFX_FaceCache* CFX_FontCache::GetCachedFace(CFX_Font* pFont) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   FXFT_Face internal_face = pFont->GetFace();
   const FX_BOOL bExternal = internal_face == nullptr;
   FXFT_Face face =
@@ -1193,6 +1199,7 @@ CFX_FaceCache* CFX_FontCache::GetCachedFace(CFX_Font* pFont) {
 }
 
 void CFX_FontCache::ReleaseCachedFace(CFX_Font* pFont) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   FXFT_Face internal_face = pFont->GetFace();
   const FX_BOOL bExternal = internal_face == nullptr;
   FXFT_Face face =
@@ -1210,6 +1217,7 @@ void CFX_FontCache::ReleaseCachedFace(CFX_Font* pFont) {
 }
 
 void CFX_FontCache::FreeCache(FX_BOOL bRelease) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   for (auto it = m_FTFaceMap.begin(); it != m_FTFaceMap.end();) {
     auto curr_it = it++;
     CFX_CountedFaceCache* cache = curr_it->second;
@@ -1281,6 +1289,7 @@ const CFX_GlyphBitmap* CFX_FaceCache::LoadGlyphBitmap(CFX_Font* pFont,
                                                       int dest_width,
                                                       int anti_alias,
                                                       int& text_flags) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   if (glyph_index == (FX_DWORD)-1) {
     return NULL;
   }
@@ -1643,6 +1652,7 @@ CFX_GlyphBitmap* CFX_FaceCache::RenderGlyph(CFX_Font* pFont,
 const CFX_PathData* CFX_FaceCache::LoadGlyphPath(CFX_Font* pFont,
                                                  FX_DWORD glyph_index,
                                                  int dest_width) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   if (!m_Face || glyph_index == (FX_DWORD)-1)
     return nullptr;
 
@@ -1787,6 +1797,7 @@ static int _Outline_CubicTo(const FXFT_Vector* control1,
 }
 };
 CFX_PathData* CFX_Font::LoadGlyphPath(FX_DWORD glyph_index, int dest_width) {
+  CFX_AutoLock lock(FX_GetGlobalLock());
   if (!m_Face) {
     return NULL;
   }
@@ -119,19 +119,25 @@ FPDF_DOCUMENT FPDFDocumentFromCPDFDocument(CPDF_Document* doc);
 
 CPDF_Page* CPDFPageFromFPDFPage(FPDF_PAGE page);
 
+// Cache budgets are FX_DWORD byte counts; larger ones are no limit anyway.
+FX_DWORD ClampBudget(unsigned long max_bytes);
+
 void DropContext(void* data);
 void FSDK_SetSandBoxPolicy(FPDF_DWORD policy, FPDF_BOOL enable);
 FPDF_BOOL FSDK_IsSandBoxPolicyEnabled(FPDF_DWORD policy);
-void FPDF_RenderPage_Retail(CRenderContext* pContext,
-                            FPDF_PAGE page,
-                            int start_x,
-                            int start_y,
-                            int size_x,
-                            int size_y,
-                            int rotate,
-                            int flags,
-                            FX_BOOL bNeedToRestore,
-                            IFSDK_PAUSE_Adapter* pause);
+// Returns the number of threads the page was rendered with, or 0 if |page|
+// is invalid.
+int FPDF_RenderPage_Retail(CRenderContext* pContext,
+                           FPDF_PAGE page,
+                           int start_x,
+                           int start_y,
+                           int size_x,
+                           int size_y,
+                           int rotate,
+                           int flags,
+                           FX_BOOL bNeedToRestore,
+                           IFSDK_PAUSE_Adapter* pause,
+                           int thread_count = 1);
 
 void CheckUnSupportError(CPDF_Document* pDoc, FX_DWORD err_code);
 void CheckUnSupportAnnot(CPDF_Document* pDoc, const CPDF_Annot* pPDFAnnot);
@@ -45,6 +45,7 @@ LOCAL_SRC_FILES := \
     src/fpdf_progressive.cpp \
     src/fpdf_searchex.cpp \
     src/fpdf_sysfontinfo.cpp \
+    src/fpdf_tilecache.cpp \
     src/fpdf_transformpage.cpp \
     src/fpdfdoc.cpp \
     src/fpdfeditimg.cpp \
@@ -0,0 +1,384 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "public/fpdf_tilecache.h"
+
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <tuple>
+
+#include "core/include/fxcrt/fx_safe_types.h"
+#include "fpdfsdk/include/fsdk_define.h"
+#include "fpdfsdk/include/fsdk_rendercontext.h"
+
+namespace {
+
+// The object number of the page, the page size, the tile column and row, the
+// rotation and the flags.
+typedef std::tuple<FX_DWORD, int, int, int, int, int, int> TileKey;
+
+// Averages each 2 by 2 block of pixels of the 32 bpp |pSrc|, starting at
+// |src_left|, |src_top|, into the pixels of |pDest| from |dest_left|,
+// |dest_top| on, for |width| by |height| destination pixels.
+void DownscaleBlock(CFX_DIBitmap* pDest,
+                    int dest_left,
+                    int dest_top,
+                    int width,
+                    int height,
+                    const CFX_DIBitmap* pSrc) {
+  for (int row = 0; row < height; row++) {
+    uint8_t* dest_scan =
+        pDest->GetBuffer() + (dest_top + row) * pDest->GetPitch() +
+        dest_left * 4;
+    const uint8_t* src_scan = pSrc->GetScanline(row * 2);
+    const uint8_t* src_scan2 = pSrc->GetScanline(row * 2 + 1);
+    for (int col = 0; col < width * 4; col++) {
+      int i = col / 4 * 8 + col % 4;
+      dest_scan[col] =
+          (src_scan[i] + src_scan[i + 4] + src_scan2[i] + src_scan2[i + 4] +
+           2) /
+          4;
+    }
+  }
+}
+
+}  // namespace
+
+class CFPDF_TileCache {
+ public:
+  CFPDF_TileCache(int tile_size, FX_DWORD dwMaxBytes, FX_BOOL bDownscale)
+      : m_nHits(0),
+        m_nDownscaled(0),
+        m_nMisses(0),
+        m_TileSize(tile_size),
+        m_dwMaxBytes(dwMaxBytes),
+        m_dwSize(0),
+        m_bDownscale(bDownscale),
+        m_pDest(nullptr) {}
+  ~CFPDF_TileCache() { Close(); }
+
+  int Start(CFX_DIBitmap* pBitmap,
+            FPDF_PAGE page,
+            int size_x,
+            int size_y,
+            int tile_x,
+            int tile_y,
+            int rotate,
+            int flags,
+            IFSDK_PAUSE* pause);
+  int Continue(IFSDK_PAUSE* pause);
+  void Close();
+  void RemovePage(FX_DWORD objnum);
+
+  FX_DWORD m_nHits;
+  FX_DWORD m_nDownscaled;
+  FX_DWORD m_nMisses;
+
+ private:
+  struct Tile {
+    std::unique_ptr<CFX_DIBitmap> m_pBitmap;
+    std::list<TileKey>::iterator m_LRUPos;
+  };
+
+  const CFX_DIBitmap* Find(const TileKey& key);
+  void Add(const TileKey& key, std::unique_ptr<CFX_DIBitmap> pTile);
+  void Erase(std::map<TileKey, Tile>::iterator it);
+  // Builds the tile of |key| from the four tiles covering its area at twice
+  // the page size, if they are all cached.
+  std::unique_ptr<CFX_DIBitmap> Downscale(const TileKey& key);
+  // Moves the rendered tile into the destination and the cache.
+  void Finish();
+  void CopyTile(const CFX_DIBitmap* pTile);
+
+  const int m_TileSize;
+  const FX_DWORD m_dwMaxBytes;
+  FX_DWORD m_dwSize;
+  const FX_BOOL m_bDownscale;
+  std::map<TileKey, Tile> m_Tiles;
+  // The least recently used key last.
+  std::list<TileKey> m_LRU;
+
+  // The tile being rendered.
+  std::unique_ptr<CRenderContext> m_pContext;
+  std::unique_ptr<CFX_DIBitmap> m_pTile;
+  CFX_DIBitmap* m_pDest;
+  TileKey m_CurKey;
+};
+
+int CFPDF_TileCache::Start(CFX_DIBitmap* pBitmap,
+                           FPDF_PAGE page,
+                           int size_x,
+                           int size_y,
+                           int tile_x,
+                           int tile_y,
+                           int rotate,
+                           int flags,
+                           IFSDK_PAUSE* pause) {
+  Close();
+  CPDF_Page* pPage = CPDFPageFromFPDFPage(page);
+  FX_SAFE_INT32 tile_left = tile_x;
+  tile_left *= m_TileSize;
+  FX_SAFE_INT32 tile_top = tile_y;
+  tile_top *= m_TileSize;
+  if (!pBitmap || !pPage || !pause || pause->version != 1 || size_x <= 0 ||
+      size_y <= 0 || tile_x < 0 || tile_y < 0 || !tile_left.IsValid() ||
+      tile_left.ValueOrDie() >= size_x || !tile_top.IsValid() ||
+      tile_top.ValueOrDie() >= size_y) {
+    return FPDF_RENDER_FAILED;
+  }
+
+  TileKey key(pPage->m_pFormDict->GetObjNum(), size_x, size_y, tile_x, tile_y,
+              rotate, flags);
+  m_pDest = pBitmap;
+  const CFX_DIBitmap* pCached = Find(key);
+  if (pCached) {
+    m_nHits++;
+    CopyTile(pCached);
+    return FPDF_RENDER_DONE;
+  }
+  if (m_bDownscale) {
+    std::unique_ptr<CFX_DIBitmap> pTile = Downscale(key);
+    if (pTile) {
+      m_nDownscaled++;
+      CopyTile(pTile.get());
+      Add(key, std::move(pTile));
+      return FPDF_RENDER_DONE;
+    }
+  }
+
+  m_nMisses++;
+  m_CurKey = key;
+  m_pTile.reset(new CFX_DIBitmap);
+  if (!m_pTile->Create(m_TileSize, m_TileSize, FXDIB_Rgb32)) {
+    m_pTile.reset();
+    return FPDF_RENDER_FAILED;
+  }
+  m_pTile->Clear(0xFFFFFFFF);
+
+  m_pContext.reset(new CRenderContext);
+#ifdef _SKIA_SUPPORT_
+  CFX_SkiaDevice* pDevice = new CFX_SkiaDevice;
+#else
+  CFX_FxgeDevice* pDevice = new CFX_FxgeDevice;
+#endif
+  pDevice->Attach(m_pTile.get(), 0, !!(flags & FPDF_REVERSE_BYTE_ORDER));
+  m_pContext->m_pDevice = pDevice;
+  IFSDK_PAUSE_Adapter IPauseAdapter(pause);
+  FPDF_RenderPage_Retail(m_pContext.get(), page, -tile_left.ValueOrDie(),
+                         -tile_top.ValueOrDie(), size_x, size_y, rotate, flags,
+                         FALSE, &IPauseAdapter);
+  if (!m_pContext->m_pRenderer) {
+    Close();
+    return FPDF_RENDER_FAILED;
+  }
+  int status = CPDF_ProgressiveRenderer::ToFPDFStatus(
+      m_pContext->m_pRenderer->GetStatus());
+  if (status == FPDF_RENDER_DONE)
+    Finish();
+  else if (status == FPDF_RENDER_FAILED)
+    Close();
+  return status;
+}
+
+int CFPDF_TileCache::Continue(IFSDK_PAUSE* pause) {
+  if (!pause || pause->version != 1 || !m_pContext)
+    return FPDF_RENDER_FAILED;
+
+  IFSDK_PAUSE_Adapter IPauseAdapter(pause);
+  m_pContext->m_pRenderer->Continue(&IPauseAdapter);
+  int status = CPDF_ProgressiveRenderer::ToFPDFStatus(
+      m_pContext->m_pRenderer->GetStatus());
+  if (status == FPDF_RENDER_DONE)
+    Finish();
+  else if (status == FPDF_RENDER_FAILED)
+    Close();
+  return status;
+}
+
+void CFPDF_TileCache::Close() {
+  if (m_pContext) {
+    m_pContext->m_pDevice->RestoreState();
+    m_pContext.reset();
+  }
+  m_pTile.reset();
+  m_pDest = nullptr;
+}
+
+void CFPDF_TileCache::Finish() {
+  m_pContext->m_pDevice->RestoreState();
+  m_pContext.reset();
+  CopyTile(m_pTile.get());
+  Add(m_CurKey, std::move(m_pTile));
+  m_pDest = nullptr;
+}
+
+void CFPDF_TileCache::CopyTile(const CFX_DIBitmap* pTile) {
+  m_pDest->TransferBitmap(0, 0, m_TileSize, m_TileSize, pTile, 0, 0);
+}
+
+void CFPDF_TileCache::RemovePage(FX_DWORD objnum) {
+  const int kMin = std::numeric_limits<int>::min();
+  auto it = m_Tiles.lower_bound(
+      TileKey(objnum, kMin, kMin, kMin, kMin, kMin, kMin));
+  while (it != m_Tiles.end() && std::get<0>(it->first) == objnum)
+    Erase(it++);
+}
+
+const CFX_DIBitmap* CFPDF_TileCache::Find(const TileKey& key) {
+  auto it = m_Tiles.find(key);
+  if (it == m_Tiles.end())
+    return nullptr;
+
+  m_LRU.splice(m_LRU.begin(), m_LRU, it->second.m_LRUPos);
+  return it->second.m_pBitmap.get();
+}
+
+void CFPDF_TileCache::Add(const TileKey& key,
+                          std::unique_ptr<CFX_DIBitmap> pTile) {
+  FX_DWORD dwSize = pTile->GetPitch() * pTile->GetHeight();
+  if (dwSize > m_dwMaxBytes)
+    return;
+
+  m_LRU.push_front(key);
+  Tile& tile = m_Tiles[key];
+  tile.m_pBitmap = std::move(pTile);
+  tile.m_LRUPos = m_LRU.begin();
+  m_dwSize += dwSize;
+  while (m_dwSize > m_dwMaxBytes)
+    Erase(m_Tiles.find(m_LRU.back()));
+}
+
+void CFPDF_TileCache::Erase(std::map<TileKey, Tile>::iterator it) {
+  const CFX_DIBitmap* pBitmap = it->second.m_pBitmap.get();
+  m_dwSize -= pBitmap->GetPitch() * pBitmap->GetHeight();
+  m_LRU.erase(it->second.m_LRUPos);
+  m_Tiles.erase(it);
+}
+
+std::unique_ptr<CFX_DIBitmap> CFPDF_TileCache::Downscale(const TileKey& key) {
+  if (m_TileSize % 2)
+    return nullptr;
+
+  FX_SAFE_INT32 safe_size_x = std::get<1>(key);
+  safe_size_x *= 2;
+  FX_SAFE_INT32 safe_size_y = std::get<2>(key);
+  safe_size_y *= 2;
+  if (!safe_size_x.IsValid() || !safe_size_y.IsValid())
+    return nullptr;
+
+  FX_DWORD objnum = std::get<0>(key);
+  int size_x = safe_size_x.ValueOrDie();
+  int size_y = safe_size_y.ValueOrDie();
+  int tile_x = std::get<3>(key) * 2;
+  int tile_y = std::get<4>(key) * 2;
+  const CFX_DIBitmap* pSources[2][2];
+  for (int row = 0; row < 2; row++) {
+    for (int col = 0; col < 2; col++) {
+      // Tiles past the edge of the page are blank, and never rendered.
+      FX_SAFE_INT32 left = tile_x + col;
+      left *= m_TileSize;
+      FX_SAFE_INT32 top = tile_y + row;
+      top *= m_TileSize;
+      if (!left.IsValid() || left.ValueOrDie() >= size_x || !top.IsValid() ||
+          top.ValueOrDie() >= size_y) {
+        pSources[row][col] = nullptr;
+        continue;
+      }
+      pSources[row][col] =
+          Find(TileKey(objnum, size_x, size_y, tile_x + col, tile_y + row,
+                       std::get<5>(key), std::get<6>(key)));
+      if (!pSources[row][col])
+        return nullptr;
+    }
+  }
+
+  std::unique_ptr<CFX_DIBitmap> pTile(new CFX_DIBitmap);
+  if (!pTile->Create(m_TileSize, m_TileSize, FXDIB_Rgb32))
+    return nullptr;
+
+  pTile->Clear(0xFFFFFFFF);
+  int half = m_TileSize / 2;
+  for (int row = 0; row < 2; row++) {
+    for (int col = 0; col < 2; col++) {
+      if (pSources[row][col]) {
+        DownscaleBlock(pTile.get(), col * half, row * half, half, half,
+                       pSources[row][col]);
+      }
+    }
+  }
+  return pTile;
+}
+
+DLLEXPORT FPDF_TILECACHE STDCALL FPDF_CreateTileCache(FPDF_DOCUMENT document,
+                                                      int tile_size,
+                                                      unsigned long max_bytes,
+                                                      FPDF_BOOL downscale) {
+  if (!CPDFDocumentFromFPDFDocument(document) || tile_size <= 0)
+    return nullptr;
+
+  return new CFPDF_TileCache(tile_size, ClampBudget(max_bytes), downscale);
+}
+
+DLLEXPORT void STDCALL FPDF_DestroyTileCache(FPDF_TILECACHE cache) {
+  delete static_cast<CFPDF_TileCache*>(cache);
+}
+
+DLLEXPORT int STDCALL FPDF_RenderTile_Start(FPDF_TILECACHE cache,
+                                            FPDF_BITMAP bitmap,
+                                            FPDF_PAGE page,
+                                            int size_x,
+                                            int size_y,
+                                            int tile_x,
+                                            int tile_y,
+                                            int rotate,
+                                            int flags,
+                                            IFSDK_PAUSE* pause) {
+  if (!cache)
+    return FPDF_RENDER_FAILED;
+
+  return static_cast<CFPDF_TileCache*>(cache)->Start(
+      static_cast<CFX_DIBitmap*>(bitmap), page, size_x, size_y, tile_x,
+      tile_y, rotate, flags, pause);
+}
+
+DLLEXPORT int STDCALL FPDF_RenderTile_Continue(FPDF_TILECACHE cache,
+                                               IFSDK_PAUSE* pause) {
+  if (!cache)
+    return FPDF_RENDER_FAILED;
+
+  return static_cast<CFPDF_TileCache*>(cache)->Continue(pause);
+}
+
+DLLEXPORT void STDCALL FPDF_RenderTile_Close(FPDF_TILECACHE cache) {
+  if (cache)
+    static_cast<CFPDF_TileCache*>(cache)->Close();
+}
+
+DLLEXPORT void STDCALL FPDF_TileCache_RemovePage(FPDF_TILECACHE cache,
+                                                 FPDF_PAGE page) {
+  CPDF_Page* pPage = CPDFPageFromFPDFPage(page);
+  if (cache && pPage) {
+    static_cast<CFPDF_TileCache*>(cache)->RemovePage(
+        pPage->m_pFormDict->GetObjNum());
+  }
+}
+
+DLLEXPORT FPDF_BOOL STDCALL FPDF_TileCache_GetStats(FPDF_TILECACHE cache,
+                                                    unsigned long* hits,
+                                                    unsigned long* downscaled,
+                                                    unsigned long* misses) {
+  if (!cache)
+    return FALSE;
+
+  CFPDF_TileCache* pCache = static_cast<CFPDF_TileCache*>(cache);
+  if (hits)
+    *hits = pCache->m_nHits;
+  if (downscaled)
+    *downscaled = pCache->m_nDownscaled;
+  if (misses)
+    *misses = pCache->m_nMisses;
+  return TRUE;
+}
@@ -0,0 +1,193 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "public/fpdf_tilecache.h"
+#include "public/fpdfview.h"
+#include "testing/embedder_test.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kTileSize = 64;
+
+int NeverPause(IFSDK_PAUSE* pThis) {
+  return 0;
+}
+
+int AlwaysPause(IFSDK_PAUSE* pThis) {
+  return 1;
+}
+
+// The |width| by |height| pixels of |bitmap| from |left|, |top| on.
+std::vector<uint8_t> GetPixels(FPDF_BITMAP bitmap,
+                               int left,
+                               int top,
+                               int width,
+                               int height) {
+  std::vector<uint8_t> result;
+  const uint8_t* buffer =
+      static_cast<const uint8_t*>(FPDFBitmap_GetBuffer(bitmap));
+  int stride = FPDFBitmap_GetStride(bitmap);
+  for (int row = top; row < top + height; ++row) {
+    const uint8_t* scan = buffer + row * stride + left * 4;
+    result.insert(result.end(), scan, scan + width * 4);
+  }
+  return result;
+}
+
+// Renders the tile, pausing as often as possible when |pause_often|.
+std::vector<uint8_t> RenderTile(FPDF_TILECACHE cache,
+                                FPDF_PAGE page,
+                                int size,
+                                int tile_x,
+                                int tile_y,
+                                bool pause_often) {
+  IFSDK_PAUSE pause = {};
+  pause.version = 1;
+  pause.NeedToPauseNow = pause_often ? AlwaysPause : NeverPause;
+  FPDF_BITMAP bitmap = FPDFBitmap_Create(kTileSize, kTileSize, 0);
+  int status = FPDF_RenderTile_Start(cache, bitmap, page, size, size, tile_x,
+                                     tile_y, 0, 0, &pause);
+  while (status == FPDF_RENDER_TOBECOUNTINUED)
+    status = FPDF_RenderTile_Continue(cache, &pause);
+  EXPECT_EQ(FPDF_RENDER_DONE, status);
+  std::vector<uint8_t> result =
+      GetPixels(bitmap, 0, 0, kTileSize, kTileSize);
+  FPDFBitmap_Destroy(bitmap);
+  return result;
+}
+
+void ExpectStats(FPDF_TILECACHE cache,
+                 unsigned long hits,
+                 unsigned long downscaled,
+                 unsigned long misses) {
+  unsigned long actual_hits = 0;
+  unsigned long actual_downscaled = 0;
+  unsigned long actual_misses = 0;
+  EXPECT_TRUE(FPDF_TileCache_GetStats(cache, &actual_hits, &actual_downscaled,
+                                      &actual_misses));
+  EXPECT_EQ(hits, actual_hits);
+  EXPECT_EQ(downscaled, actual_downscaled);
+  EXPECT_EQ(misses, actual_misses);
+}
+
+}  // namespace
+
+class FPDFTileCacheEmbeddertest : public EmbedderTest {};
+
+TEST_F(FPDFTileCacheEmbeddertest, RenderTiles) {
+  EXPECT_TRUE(OpenDocument("hello_world.pdf"));
+  FPDF_PAGE page = LoadPage(0);
+  ASSERT_NE(nullptr, page);
+
+  // The whole page, on white like the tiles.
+  const int kSize = 4 * kTileSize;
+  FPDF_BITMAP page_bitmap = FPDFBitmap_Create(kSize, kSize, 0);
+  FPDFBitmap_FillRect(page_bitmap, 0, 0, kSize, kSize, 0xFFFFFFFF);
+  FPDF_RenderPageBitmap(page_bitmap, page, 0, 0, kSize, kSize, 0, 0);
+
+  FPDF_TILECACHE cache =
+      FPDF_CreateTileCache(document(), kTileSize, 1 << 20, 1);
+  ASSERT_NE(nullptr, cache);
+  for (int tile_y = 0; tile_y < 4; ++tile_y) {
+    for (int tile_x = 0; tile_x < 4; ++tile_x) {
+      EXPECT_EQ(GetPixels(page_bitmap, tile_x * kTileSize, tile_y * kTileSize,
+                          kTileSize, kTileSize),
+                RenderTile(cache, page, kSize, tile_x, tile_y, tile_x == 1));
+    }
+  }
+  ExpectStats(cache, 0, 0, 16);
+  EXPECT_EQ(GetPixels(page_bitmap, kTileSize, kTileSize, kTileSize, kTileSize),
+            RenderTile(cache, page, kSize, 1, 1, false));
+  ExpectStats(cache, 1, 0, 16);
+
+  // Half the size, from the cached tiles.
+  std::vector<uint8_t> tile = RenderTile(cache, page, kSize / 2, 1, 0, false);
+  ExpectStats(cache, 1, 1, 16);
+  std::vector<uint8_t> source =
+      GetPixels(page_bitmap, 2 * kTileSize, 0, 2 * kTileSize, 2 * kTileSize);
+  int source_stride = 2 * kTileSize * 4;
+  for (int row = 0; row < kTileSize; ++row) {
+    for (int col = 0; col < kTileSize * 4; ++col) {
+      int i = row * 2 * source_stride + col / 4 * 8 + col % 4;
+      int sum = source[i] + source[i + 4] + source[i + source_stride] +
+                source[i + source_stride + 4];
+      ASSERT_EQ((sum + 2) / 4, tile[row * kTileSize * 4 + col]);
+    }
+  }
+  RenderTile(cache, page, kSize / 2, 1, 0, false);
+  ExpectStats(cache, 2, 1, 16);
+  // A quarter of the size, from the downscaled tiles once they are all there.
+  RenderTile(cache, page, kSize / 4, 0, 0, false);
+  ExpectStats(cache, 2, 1, 17);
+  FPDF_TileCache_RemovePage(cache, page);
+  RenderTile(cache, page, kSize / 4, 0, 0, false);
+  ExpectStats(cache, 2, 1, 18);
+
+  // Out of the page.
+  IFSDK_PAUSE pause = {};
+  pause.version = 1;
+  pause.NeedToPauseNow = NeverPause;
+  FPDF_BITMAP bitmap = FPDFBitmap_Create(kTileSize, kTileSize, 0);
+  EXPECT_EQ(FPDF_RENDER_FAILED, FPDF_RenderTile_Start(cache, bitmap, page,
+                                                      kSize, kSize, 4, 0, 0, 0,
+                                                      &pause));
+  EXPECT_EQ(FPDF_RENDER_FAILED, FPDF_RenderTile_Start(cache, bitmap, page,
+                                                      kSize, kSize, 0, -1, 0,
+                                                      0, &pause));
+  EXPECT_EQ(FPDF_RENDER_FAILED, FPDF_RenderTile_Continue(cache, &pause));
+  FPDFBitmap_Destroy(bitmap);
+
+  // Abandoned while in progress.
+  pause.NeedToPauseNow = AlwaysPause;
+  bitmap = FPDFBitmap_Create(kTileSize, kTileSize, 0);
+  FPDF_RenderTile_Start(cache, bitmap, page, kSize, kSize, 0, 0, 0, 0, &pause);
+  FPDF_RenderTile_Close(cache);
+  EXPECT_EQ(FPDF_RENDER_FAILED, FPDF_RenderTile_Continue(cache, &pause));
+  FPDF_RenderTile_Start(cache, bitmap, page, kSize, kSize, 0, 0, 0, 0, &pause);
+  FPDFBitmap_Destroy(bitmap);
+  FPDF_DestroyTileCache(cache);
+
+  FPDFBitmap_Destroy(page_bitmap);
+  UnloadPage(page);
+}
+
+TEST_F(FPDFTileCacheEmbeddertest, Eviction) {
+  EXPECT_TRUE(OpenDocument("hello_world.pdf"));
+  FPDF_PAGE page = LoadPage(0);
+  ASSERT_NE(nullptr, page);
+
+  // Room for two tiles.
+  FPDF_TILECACHE cache = FPDF_CreateTileCache(
+      document(), kTileSize, 2 * kTileSize * kTileSize * 4, 0);
+  ASSERT_NE(nullptr, cache);
+  const int kSize = 2 * kTileSize;
+  RenderTile(cache, page, kSize, 0, 0, false);
+  RenderTile(cache, page, kSize, 1, 0, false);
+  RenderTile(cache, page, kSize, 0, 0, false);
+  ExpectStats(cache, 1, 0, 2);
+  // Drops tile 1, 0, the least recently used.
+  RenderTile(cache, page, kSize, 0, 1, false);
+  RenderTile(cache, page, kSize, 0, 0, false);
+  ExpectStats(cache, 2, 0, 3);
+  RenderTile(cache, page, kSize, 1, 0, false);
+  ExpectStats(cache, 2, 0, 4);
+
+  // Nothing downscaled when disabled.
+  RenderTile(cache, page, kSize / 2, 0, 0, false);
+  ExpectStats(cache, 2, 0, 5);
+  FPDF_DestroyTileCache(cache);
+
+  // Tiles larger than the cache are not kept.
+  cache = FPDF_CreateTileCache(document(), kTileSize, 1000, 1);
+  RenderTile(cache, page, kSize, 0, 0, false);
+  RenderTile(cache, page, kSize, 0, 0, false);
+  ExpectStats(cache, 0, 0, 2);
+  FPDF_DestroyTileCache(cache);
+
+  EXPECT_EQ(nullptr, FPDF_CreateTileCache(document(), 0, 1000, 1));
+  UnloadPage(page);
+}
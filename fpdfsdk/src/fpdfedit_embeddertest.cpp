@@ -2,6 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "core/include/fpdfapi/fpdf_objects.h"
+#include "core/include/fpdfapi/fpdf_page.h"
+#include "core/include/fpdfapi/fpdf_pageobj.h"
 #include "public/fpdf_edit.h"
 #include "public/fpdfview.h"
 #include "testing/embedder_test.h"
@@ -11,6 +18,43 @@
 
 class FPDFEditEmbeddertest : public EmbedderTest, public TestSaver {};
 
+namespace {
+
+CPDF_FormObject* FindFormObject(FPDF_PAGE page) {
+  for (int i = 0; i < FPDFPage_CountObject(page); ++i) {
+    CPDF_PageObject* pObj =
+        static_cast<CPDF_PageObject*>(FPDFPage_GetObject(page, i));
+    if (pObj->m_Type == PDFPAGE_FORM)
+      return static_cast<CPDF_FormObject*>(pObj);
+  }
+  return nullptr;
+}
+
+std::vector<FPDF_PAGEOBJECT> GetObjectsInRect(FPDF_PAGE page,
+                                              const FS_RECTF& rect) {
+  int count = FPDFPage_GetObjectsInRect(page, rect.left, rect.bottom,
+                                        rect.right, rect.top, nullptr, 0);
+  std::vector<FPDF_PAGEOBJECT> objects(std::max(count, 0));
+  FPDFPage_GetObjectsInRect(page, rect.left, rect.bottom, rect.right,
+                            rect.top, objects.data(), count);
+  return objects;
+}
+
+// Renders the top right quarter of |page| at twice its size.
+std::vector<uint8_t> RenderTile(FPDF_PAGE page) {
+  FPDF_BITMAP bitmap = FPDFBitmap_Create(200, 200, 0);
+  FPDFBitmap_FillRect(bitmap, 0, 0, 200, 200, 0xFFFFFFFF);
+  FPDF_RenderPageBitmap(bitmap, page, -200, 0, 400, 400, 0, 0);
+  const uint8_t* buffer =
+      static_cast<const uint8_t*>(FPDFBitmap_GetBuffer(bitmap));
+  std::vector<uint8_t> result(buffer,
+                              buffer + FPDFBitmap_GetStride(bitmap) * 200);
+  FPDFBitmap_Destroy(bitmap);
+  return result;
+}
+
+}  // namespace
+
 TEST_F(FPDFEditEmbeddertest, EmptyCreation) {
   EXPECT_TRUE(CreateEmptyDocument());
   FPDF_PAGE page = FPDFPage_New(document(), 1, 640.0, 480.0);
@@ -58,3 +102,103 @@ TEST_F(FPDFEditEmbeddertest, EmptyCreation) {
                   "%%EOF\r\n"));
   FPDFPage_Delete(document(), 1);
 }
+
+TEST_F(FPDFEditEmbeddertest, SharedFormParse) {
+  // Each page draws the same form XObject in the same graphics state.
+  EXPECT_TRUE(OpenDocument("shared_resources.pdf"));
+  FPDF_PAGE page0 = LoadPage(0);
+  FPDF_PAGE page1 = LoadPage(1);
+  CPDF_FormObject* pFormObj0 = FindFormObject(page0);
+  CPDF_FormObject* pFormObj1 = FindFormObject(page1);
+  ASSERT_TRUE(pFormObj0);
+  ASSERT_TRUE(pFormObj1);
+  EXPECT_EQ(pFormObj0->m_pForm, pFormObj1->m_pForm);
+  EXPECT_EQ(2u, pFormObj0->m_pForm->CountObjects());
+
+  // Copies share the form too, unless the cache does not hold it.
+  std::unique_ptr<CPDF_PageObject> pCopy(pFormObj0->Clone());
+  EXPECT_EQ(pFormObj0->m_pForm,
+            static_cast<CPDF_FormObject*>(pCopy.get())->m_pForm);
+  std::unique_ptr<CPDF_Form> pUncachedForm(pFormObj0->m_pForm->Clone());
+  CPDF_FormObject uncached;
+  uncached.m_pForm = pUncachedForm.get();
+  pCopy.reset(uncached.Clone());
+  CPDF_Form* pCopiedForm = static_cast<CPDF_FormObject*>(pCopy.get())->m_pForm;
+  ASSERT_TRUE(pCopiedForm);
+  EXPECT_NE(pUncachedForm.get(), pCopiedForm);
+  EXPECT_EQ(2u, pCopiedForm->CountObjects());
+  pCopy.reset(pCopy->Clone());
+  pCopiedForm = static_cast<CPDF_FormObject*>(pCopy.get())->m_pForm;
+  EXPECT_EQ(2u, pCopiedForm->CountObjects());
+  pCopy.reset();
+  uncached.m_pForm = nullptr;
+
+  // Once the form is edited, pages loaded later parse it again.
+  static const char kNewContent[] = "0 0 80 80 re f";
+  pFormObj0->m_pForm->m_pFormStream->SetData(
+      reinterpret_cast<const uint8_t*>(kNewContent), sizeof(kNewContent) - 1,
+      FALSE, FALSE);
+  FPDF_PAGE page2 = LoadPage(2);
+  CPDF_FormObject* pFormObj2 = FindFormObject(page2);
+  ASSERT_TRUE(pFormObj2);
+  EXPECT_NE(pFormObj0->m_pForm, pFormObj2->m_pForm);
+  EXPECT_EQ(1u, pFormObj2->m_pForm->CountObjects());
+  EXPECT_EQ(2u, pFormObj0->m_pForm->CountObjects());
+
+  UnloadPage(page2);
+  UnloadPage(page1);
+  UnloadPage(page0);
+}
+
+TEST_F(FPDFEditEmbeddertest, ObjectsInRect) {
+  EXPECT_TRUE(OpenDocument("shared_resources.pdf"));
+  FPDF_PAGE page = LoadPage(0);
+  ASSERT_TRUE(page);
+  std::vector<uint8_t> expected = RenderTile(page);
+
+  // Page, image corner, empty corner and a point inside the form.
+  const FS_RECTF kRects[] = {{0, 200, 200, 0},
+                             {25, 175, 30, 170},
+                             {190, 200, 200, 190},
+                             {150, 60, 160, 50}};
+  std::vector<std::vector<FPDF_PAGEOBJECT>> unindexed;
+  for (const FS_RECTF& rect : kRects)
+    unindexed.push_back(GetObjectsInRect(page, rect));
+  EXPECT_EQ(5u, unindexed[0].size());
+  ASSERT_EQ(2u, unindexed[1].size());
+  EXPECT_EQ(PDFPAGE_SHADING,
+            static_cast<CPDF_PageObject*>(unindexed[1][0])->m_Type);
+  EXPECT_EQ(PDFPAGE_IMAGE,
+            static_cast<CPDF_PageObject*>(unindexed[1][1])->m_Type);
+  EXPECT_TRUE(unindexed[2].empty());
+
+  EXPECT_TRUE(FPDFPage_BuildObjectIndex(page));
+  for (size_t i = 0; i < FX_ArraySize(kRects); ++i)
+    EXPECT_EQ(unindexed[i], GetObjectsInRect(page, kRects[i]));
+  EXPECT_EQ(expected, RenderTile(page));
+
+  // Moving an object or inserting one rebuilds the index.
+  const FS_RECTF kMoved = {1000, 1200, 1200, 1000};
+  FPDF_PAGEOBJECT image = unindexed[1][1];
+  FPDFPageObj_Transform(image, 1, 0, 0, 1, 1000, 1000);
+  EXPECT_EQ(std::vector<FPDF_PAGEOBJECT>(1, image),
+            GetObjectsInRect(page, kMoved));
+  FPDFPageObj_Transform(image, 1, 0, 0, 1, -1000, -1000);
+  EXPECT_TRUE(GetObjectsInRect(page, kMoved).empty());
+  FPDF_PAGEOBJECT new_image = FPDFPageObj_NewImgeObj(document());
+  ASSERT_TRUE(new_image);
+  FPDFImageObj_SetMatrix(new_image, 10, 0, 0, 10, 1100, 1100);
+  FPDFPage_InsertObject(page, new_image);
+  EXPECT_EQ(std::vector<FPDF_PAGEOBJECT>(1, new_image),
+            GetObjectsInRect(page, kMoved));
+  FPDFImageObj_SetMatrix(new_image, 10, 0, 0, 10, 0, 0);
+  EXPECT_TRUE(GetObjectsInRect(page, kMoved).empty());
+  for (size_t i = 0; i < FX_ArraySize(kRects); ++i) {
+    std::vector<FPDF_PAGEOBJECT> objects = unindexed[i];
+    if (i == 0)
+      objects.push_back(new_image);
+    EXPECT_EQ(objects, GetObjectsInRect(page, kRects[i]));
+  }
+
+  UnloadPage(page);
+}
@@ -58,6 +58,7 @@ DLLEXPORT FPDF_BOOL STDCALL FPDFImageObj_SetMatrix(FPDF_PAGEOBJECT image_object,
   pImgObj->m_Matrix.e = (FX_FLOAT)e;
   pImgObj->m_Matrix.f = (FX_FLOAT)f;
   pImgObj->CalcBoundingBox();
+  pImgObj->InvalidateObjectIndex();
   return TRUE;
 }
 
@@ -191,6 +191,34 @@ DLLEXPORT FPDF_PAGEOBJECT STDCALL FPDFPage_GetObject(FPDF_PAGE page,
   return pPage->GetObjectByIndex(index);
 }
 
+DLLEXPORT FPDF_BOOL STDCALL FPDFPage_BuildObjectIndex(FPDF_PAGE page) {
+  CPDF_Page* pPage = CPDFPageFromFPDFPage(page);
+  return pPage && pPage->BuildObjectIndex();
+}
+
+DLLEXPORT int STDCALL FPDFPage_GetObjectsInRect(FPDF_PAGE page,
+                                                double left,
+                                                double bottom,
+                                                double right,
+                                                double top,
+                                                FPDF_PAGEOBJECT* objects,
+                                                int max_count) {
+  CPDF_Page* pPage = CPDFPageFromFPDFPage(page);
+  if (!pPage)
+    return -1;
+
+  std::vector<FX_POSITION> positions;
+  pPage->GetObjectsInRect(CFX_FloatRect((FX_FLOAT)left, (FX_FLOAT)bottom,
+                                        (FX_FLOAT)right, (FX_FLOAT)top),
+                          &positions);
+  int count = (int)positions.size();
+  if (objects) {
+    for (int i = 0; i < count && i < max_count; ++i)
+      objects[i] = pPage->GetObjectAt(positions[i]);
+  }
+  return count;
+}
+
 DLLEXPORT FPDF_BOOL STDCALL FPDFPage_HasTransparency(FPDF_PAGE page) {
   CPDF_Page* pPage = CPDFPageFromFPDFPage(page);
   return pPage && pPage->BackgroundAlphaNeeded();
@@ -262,6 +290,7 @@ DLLEXPORT void STDCALL FPDFPageObj_Transform(FPDF_PAGEOBJECT page_object,
   CFX_Matrix matrix((FX_FLOAT)a, (FX_FLOAT)b, (FX_FLOAT)c, (FX_FLOAT)d,
                     (FX_FLOAT)e, (FX_FLOAT)f);
   pPageObj->Transform(matrix);
+  pPageObj->InvalidateObjectIndex();
 }
 DLLEXPORT void STDCALL FPDFPage_TransformAnnots(FPDF_PAGE page,
                                                 double a,
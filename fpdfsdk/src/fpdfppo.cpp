@@ -7,6 +7,7 @@
 #include "public/fpdf_ppo.h"
 
 #include <memory>
+#include <vector>
 
 #include "fpdfsdk/include/fsdk_define.h"
 
@@ -213,22 +214,24 @@ FX_BOOL CPDF_PageOrganizer::UpdateReference(CPDF_Object* pObj,
     }
     case PDFOBJ_DICTIONARY: {
       CPDF_Dictionary* pDict = pObj->AsDictionary();
-      auto it = pDict->begin();
-      while (it != pDict->end()) {
-        const CFX_ByteString& key = it->first;
-        CPDF_Object* pNextObj = it->second;
-        ++it;
+      // Removing entries invalidates iterators, so collect the keys first.
+      std::vector<CFX_ByteString> bad_keys;
+      for (const auto& it : *pDict) {
+        const CFX_ByteString& key = it.first;
+        CPDF_Object* pNextObj = it.second;
         if (!FXSYS_strcmp(key, "Parent") || !FXSYS_strcmp(key, "Prev") ||
             !FXSYS_strcmp(key, "First")) {
           continue;
         }
         if (pNextObj) {
           if (!UpdateReference(pNextObj, pDoc, pObjNumberMap))
-            pDict->RemoveAt(key);
+            bad_keys.push_back(key);
         } else {
           return FALSE;
         }
       }
+      for (const auto& key : bad_keys)
+        pDict->RemoveAt(key);
       break;
     }
     case PDFOBJ_ARRAY: {
@@ -6,6 +6,10 @@
 
 #include "public/fpdfview.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <limits>
 #include <memory>
 
 #include "core/include/fxcodec/fx_codec.h"
@@ -65,6 +69,14 @@ CPDF_Page* CPDFPageFromFPDFPage(FPDF_PAGE page) {
 #endif  // PDF_ENABLE_XFA
 }
 
+FX_DWORD ClampBudget(unsigned long max_bytes) {
+  // Widened first, so the test is not always false where long is 32 bits.
+  const uint64_t kMaxBudget = std::numeric_limits<FX_DWORD>::max();
+  return static_cast<uint64_t>(max_bytes) > kMaxBudget
+             ? static_cast<FX_DWORD>(kMaxBudget)
+             : static_cast<FX_DWORD>(max_bytes);
+}
+
 #ifdef PDF_ENABLE_XFA
 CFPDF_FileStream::CFPDF_FileStream(FPDF_FILEHANDLER* pFS) {
   m_pFS = pFS;
@@ -300,22 +312,65 @@ DLLEXPORT void STDCALL FPDF_SetSandBoxPolicy(FPDF_DWORD policy,
 
 DLLEXPORT FPDF_DOCUMENT STDCALL FPDF_LoadDocument(FPDF_STRING file_path,
                                                   FPDF_BYTESTRING password) {
+  return FPDF_LoadDocumentWithFlags(file_path, password, 0);
+}
+
+DLLEXPORT FPDF_DOCUMENT STDCALL
+FPDF_LoadDocumentWithFlags(FPDF_STRING file_path,
+                           FPDF_BYTESTRING password,
+                           int flags) {
+#ifndef PDF_ENABLE_SHARED_DOCUMENTS
+  // Reference counts are not atomic in this build, so the document could
+  // not be used on several threads.
+  if (flags & FPDF_LOAD_SHARED) {
+    SetLastError(FPDF_ERR_UNSUPPORTED);
+    return nullptr;
+  }
+#endif  // PDF_ENABLE_SHARED_DOCUMENTS
+
   // NOTE: the creation of the file needs to be by the embedder on the
   // other side of this API.
-  IFX_FileRead* pFileAccess = FX_CreateFileRead((const FX_CHAR*)file_path);
+  IFX_FileRead* pFileAccess = nullptr;
+  if (flags & FPDF_LOAD_MMAP)
+    pFileAccess = FX_CreateMappedFileRead((const FX_CHAR*)file_path);
+  if (!pFileAccess)
+    pFileAccess = FX_CreateFileRead((const FX_CHAR*)file_path);
   if (!pFileAccess) {
     return nullptr;
   }
 
   CPDF_Parser* pParser = new CPDF_Parser;
   pParser->SetPassword(password);
-
+  pParser->SetUseObjectPool(!!(flags & FPDF_LOAD_OBJECT_POOL));
+  pParser->SetSharedAccess(!!(flags & FPDF_LOAD_SHARED));
+
+  CFX_ByteString index_path;
+  IFX_FileRead* pXRefIndex = nullptr;
+  if (flags & FPDF_LOAD_XREF_INDEX) {
+    index_path = CFX_ByteString((const FX_CHAR*)file_path) + ".xrefidx";
+    pXRefIndex = FX_CreateFileRead(index_path.c_str());
+    pParser->SetXRefIndex(pXRefIndex);
+    // Files rewritten in place may keep their size and both ends.
+    struct stat file_stat;
+    if (stat((const FX_CHAR*)file_path, &file_stat) == 0)
+      pParser->SetFileModifiedTime(file_stat.st_mtime);
+  }
   FX_DWORD err_code = pParser->StartParse(pFileAccess);
+  if (pXRefIndex)
+    pXRefIndex->Release();
   if (err_code) {
     delete pParser;
     ProcessParseError(err_code);
     return NULL;
   }
+  if ((flags & FPDF_LOAD_XREF_INDEX) && !pParser->IsXRefIndexUsed()) {
+    IFX_FileStream* pIndexFile =
+        FX_CreateFileStream(index_path.c_str(), FX_FILEMODE_Truncate);
+    if (pIndexFile) {
+      pParser->SaveXRefIndex(pIndexFile);
+      pIndexFile->Release();
+    }
+  }
 #ifdef PDF_ENABLE_XFA
   CPDF_Document* pPDFDoc = pParser->GetDocument();
   if (!pPDFDoc)
@@ -476,6 +531,62 @@ DLLEXPORT int STDCALL FPDF_GetPageCount(FPDF_DOCUMENT document) {
   return pDoc ? pDoc->GetPageCount() : 0;
 }
 
+DLLEXPORT void STDCALL FPDF_SetObjectCacheLimit(FPDF_DOCUMENT document,
+                                                unsigned long max_bytes) {
+  CPDF_Document* pDoc = CPDFDocumentFromFPDFDocument(document);
+  if (pDoc)
+    pDoc->SetObjectBudget(ClampBudget(max_bytes));
+}
+
+DLLEXPORT void STDCALL FPDF_TrimObjectCache(FPDF_DOCUMENT document) {
+  CPDF_Document* pDoc = CPDFDocumentFromFPDFDocument(document);
+  if (pDoc)
+    pDoc->TrimMemory();
+}
+
+DLLEXPORT FPDF_BOOL STDCALL FPDF_GetObjectCacheStats(FPDF_DOCUMENT document,
+                                                     unsigned long* evictions,
+                                                     unsigned long* reloads) {
+  CPDF_Document* pDoc = CPDFDocumentFromFPDFDocument(document);
+  if (!pDoc)
+    return FALSE;
+
+  if (evictions)
+    *evictions = pDoc->GetEvictionCount();
+  if (reloads)
+    *reloads = pDoc->GetReloadCount();
+  return TRUE;
+}
+
+DLLEXPORT void STDCALL FPDF_SetImageCacheLimit(FPDF_DOCUMENT document,
+                                               unsigned long max_bytes) {
+  CPDF_DocImageCache* pCache = CPDF_DocImageCache::GetProcessCache();
+  if (document) {
+    CPDF_Document* pDoc = CPDFDocumentFromFPDFDocument(document);
+    if (!pDoc)
+      return;
+    pCache = CPDF_DocImageCache::GetDocumentCache(pDoc);
+  }
+  pCache->SetBudget(ClampBudget(max_bytes));
+}
+
+DLLEXPORT FPDF_BOOL STDCALL FPDF_GetImageCacheStats(FPDF_DOCUMENT document,
+                                                    unsigned long* hits,
+                                                    unsigned long* misses) {
+  CPDF_DocImageCache* pCache = CPDF_DocImageCache::GetProcessCache();
+  if (document) {
+    CPDF_Document* pDoc = CPDFDocumentFromFPDFDocument(document);
+    if (!pDoc)
+      return FALSE;
+    pCache = CPDF_DocImageCache::GetDocumentCache(pDoc);
+  }
+  if (hits)
+    *hits = pCache->GetHitCount();
+  if (misses)
+    *misses = pCache->GetMissCount();
+  return TRUE;
+}
+
 DLLEXPORT FPDF_PAGE STDCALL FPDF_LoadPage(FPDF_DOCUMENT document,
                                           int page_index) {
   UnderlyingDocumentType* pDoc = UnderlyingFromFPDFDocument(document);
@@ -498,6 +609,56 @@ DLLEXPORT FPDF_PAGE STDCALL FPDF_LoadPage(FPDF_DOCUMENT document,
 #endif  // PDF_ENABLE_XFA
 }
 
+DLLEXPORT FPDF_PAGE STDCALL FPDF_LoadPageFromDisplayList(FPDF_DOCUMENT document,
+                                                         int page_index,
+                                                         const void* data,
+                                                         unsigned long size) {
+#ifdef PDF_ENABLE_XFA
+  return FPDF_LoadPage(document, page_index);
+#else   // PDF_ENABLE_XFA
+  CPDF_Document* pDoc = CPDFDocumentFromFPDFDocument(document);
+  if (!pDoc)
+    return nullptr;
+
+  if (page_index < 0 || page_index >= pDoc->GetPageCount())
+    return nullptr;
+
+  CPDF_Dictionary* pDict = pDoc->GetPage(page_index);
+  if (!pDict)
+    return nullptr;
+
+  CPDF_Page* pPage = new CPDF_Page;
+  pPage->Load(pDoc, pDict);
+  if (data && size) {
+    std::unique_ptr<IFX_FileStream, ReleaseDeleter<IFX_FileStream>> pList(
+        FX_CreateMemoryStream(
+            static_cast<uint8_t*>(const_cast<void*>(data)), size, FALSE));
+    if (pPage->LoadDisplayList(pList.get()))
+      return pPage;
+  }
+  pPage->ParseContent();
+  return pPage;
+#endif  // PDF_ENABLE_XFA
+}
+
+DLLEXPORT unsigned long STDCALL FPDF_SavePageDisplayList(FPDF_PAGE page,
+                                                         void* buffer,
+                                                         unsigned long buflen) {
+  CPDF_Page* pPage = CPDFPageFromFPDFPage(page);
+  if (!pPage)
+    return 0;
+
+  std::unique_ptr<IFX_MemoryStream, ReleaseDeleter<IFX_MemoryStream>> pList(
+      FX_CreateMemoryStream(TRUE));
+  if (!pPage->SaveDisplayList(pList.get()))
+    return 0;
+
+  unsigned long size = (unsigned long)pList->GetSize();
+  if (buffer && buflen >= size)
+    FXSYS_memcpy(buffer, pList->GetBuffer(), size);
+  return size;
+}
+
 DLLEXPORT double STDCALL FPDF_GetPageWidth(FPDF_PAGE page) {
   UnderlyingPageType* pPage = UnderlyingFromFPDFPage(page);
   return pPage ? pPage->GetPageWidth() : 0.0;
@@ -686,11 +847,24 @@ DLLEXPORT void STDCALL FPDF_RenderPageBitmap(FPDF_BITMAP bitmap,
                                              int size_y,
                                              int rotate,
                                              int flags) {
+  FPDF_RenderPageBitmapWithThreads(bitmap, page, start_x, start_y, size_x,
+                                   size_y, rotate, flags, 1);
+}
+
+DLLEXPORT int STDCALL FPDF_RenderPageBitmapWithThreads(FPDF_BITMAP bitmap,
+                                                       FPDF_PAGE page,
+                                                       int start_x,
+                                                       int start_y,
+                                                       int size_x,
+                                                       int size_y,
+                                                       int rotate,
+                                                       int flags,
+                                                       int thread_count) {
   if (!bitmap)
-    return;
+    return 0;
   CPDF_Page* pPage = CPDFPageFromFPDFPage(page);
   if (!pPage)
-    return;
+    return 0;
   CRenderContext* pContext = new CRenderContext;
   pPage->SetPrivateData((void*)1, pContext, DropContext);
 #ifdef _SKIA_SUPPORT_
@@ -711,11 +885,17 @@ DLLEXPORT void STDCALL FPDF_RenderPageBitmap(FPDF_BITMAP bitmap,
     ((CFX_FxgeDevice*)pContext->m_pDevice)->Attach((CFX_DIBitmap*)bitmap);
 #endif
 
-  FPDF_RenderPage_Retail(pContext, page, start_x, start_y, size_x, size_y,
-                         rotate, flags, TRUE, NULL);
+#ifdef _SKIA_SUPPORT_
+  // The bands are drawn through the Agg device.
+  thread_count = 1;
+#endif
+  int threads_used =
+      FPDF_RenderPage_Retail(pContext, page, start_x, start_y, size_x, size_y,
+                             rotate, flags, TRUE, NULL, thread_count);
 
   delete pContext;
   pPage->RemovePrivateData((void*)1);
+  return threads_used;
 }
 
 DLLEXPORT void STDCALL FPDF_ClosePage(FPDF_PAGE page) {
@@ -731,7 +911,11 @@ DLLEXPORT void STDCALL FPDF_ClosePage(FPDF_PAGE page) {
     pPageView->TakeOverPage();
     return;
   }
+  CPDF_Document* pDoc = ((CPDF_Page*)page)->m_pDocument;
   delete (CPDF_Page*)page;
+  // Objects only this page used may now go, see FPDF_SetObjectCacheLimit().
+  if (pDoc && !pDoc->GetSharedLock() && pDoc->IsOverObjectBudget())
+    pDoc->TrimMemory();
 #endif  // PDF_ENABLE_XFA
 }
 
@@ -892,19 +1076,20 @@ DLLEXPORT void STDCALL FPDFBitmap_Destroy(FPDF_BITMAP bitmap) {
   delete (CFX_DIBitmap*)bitmap;
 }
 
-void FPDF_RenderPage_Retail(CRenderContext* pContext,
-                            FPDF_PAGE page,
-                            int start_x,
-                            int start_y,
-                            int size_x,
-                            int size_y,
-                            int rotate,
-                            int flags,
-                            FX_BOOL bNeedToRestore,
-                            IFSDK_PAUSE_Adapter* pause) {
+int FPDF_RenderPage_Retail(CRenderContext* pContext,
+                           FPDF_PAGE page,
+                           int start_x,
+                           int start_y,
+                           int size_x,
+                           int size_y,
+                           int rotate,
+                           int flags,
+                           FX_BOOL bNeedToRestore,
+                           IFSDK_PAUSE_Adapter* pause,
+                           int thread_count) {
   CPDF_Page* pPage = CPDFPageFromFPDFPage(page);
   if (!pPage)
-    return;
+    return 0;
 
   if (!pContext->m_pOptions)
     pContext->m_pOptions = new CPDF_RenderOptions;
@@ -960,11 +1145,23 @@ void FPDF_RenderPage_Retail(CRenderContext* pContext,
                                        &matrix, TRUE, NULL);
   }
 
-  pContext->m_pRenderer = new CPDF_ProgressiveRenderer(
-      pContext->m_pContext, pContext->m_pDevice, pContext->m_pOptions);
-  pContext->m_pRenderer->Start(pause);
+  int threads_used = 1;
+  CFX_DIBitmap* pBitmap = pContext->m_pDevice->GetBitmap();
+  if (thread_count > 1 && pBitmap) {
+    int bands = pContext->m_pContext->RenderTiled(
+        pBitmap, !!(flags & FPDF_REVERSE_BYTE_ORDER), clip,
+        pContext->m_pOptions, thread_count);
+    // RenderTiled() starts no more threads than there are bands.
+    if (bands > 1)
+      threads_used = std::min(thread_count, bands);
+  } else {
+    pContext->m_pRenderer = new CPDF_ProgressiveRenderer(
+        pContext->m_pContext, pContext->m_pDevice, pContext->m_pOptions);
+    pContext->m_pRenderer->Start(pause);
+  }
   if (bNeedToRestore)
     pContext->m_pDevice->RestoreState();
+  return threads_used;
 }
 
 DLLEXPORT int STDCALL FPDF_GetPageSizeByIndex(FPDF_DOCUMENT document,
@@ -22,6 +22,7 @@
 #include "public/fpdf_searchex.h"
 #include "public/fpdf_sysfontinfo.h"
 #include "public/fpdf_text.h"
+#include "public/fpdf_tilecache.h"
 #include "public/fpdf_transformpage.h"
 #include "public/fpdfview.h"
 
@@ -73,6 +74,8 @@ int CheckPDFiumCApi() {
     CHK(FPDFPage_InsertObject);
     CHK(FPDFPage_CountObject);
     CHK(FPDFPage_GetObject);
+    CHK(FPDFPage_BuildObjectIndex);
+    CHK(FPDFPage_GetObjectsInRect);
     CHK(FPDFPage_HasTransparency);
     CHK(FPDFPage_GenerateContent);
     CHK(FPDFPageObj_HasTransparency);
@@ -183,6 +186,15 @@ int CheckPDFiumCApi() {
     CHK(FPDFLink_GetRect);
     CHK(FPDFLink_CloseWebLinks);
 
+    // fpdf_tilecache.h
+    CHK(FPDF_CreateTileCache);
+    CHK(FPDF_DestroyTileCache);
+    CHK(FPDF_RenderTile_Start);
+    CHK(FPDF_RenderTile_Continue);
+    CHK(FPDF_RenderTile_Close);
+    CHK(FPDF_TileCache_RemovePage);
+    CHK(FPDF_TileCache_GetStats);
+
     // fpdf_transformpage.h
     CHK(FPDFPage_SetMediaBox);
     CHK(FPDFPage_SetCropBox);
@@ -200,6 +212,7 @@ int CheckPDFiumCApi() {
     CHK(FPDF_DestroyLibrary);
     CHK(FPDF_SetSandBoxPolicy);
     CHK(FPDF_LoadDocument);
+    CHK(FPDF_LoadDocumentWithFlags);
     CHK(FPDF_LoadMemDocument);
     CHK(FPDF_LoadCustomDocument);
     CHK(FPDF_GetFileVersion);
@@ -207,11 +220,19 @@ int CheckPDFiumCApi() {
     CHK(FPDF_GetDocPermissions);
     CHK(FPDF_GetSecurityHandlerRevision);
     CHK(FPDF_GetPageCount);
+    CHK(FPDF_SetObjectCacheLimit);
+    CHK(FPDF_TrimObjectCache);
+    CHK(FPDF_GetObjectCacheStats);
+    CHK(FPDF_SetImageCacheLimit);
+    CHK(FPDF_GetImageCacheStats);
     CHK(FPDF_LoadPage);
+    CHK(FPDF_LoadPageFromDisplayList);
+    CHK(FPDF_SavePageDisplayList);
     CHK(FPDF_GetPageWidth);
     CHK(FPDF_GetPageHeight);
     CHK(FPDF_GetPageSizeByIndex);
     CHK(FPDF_RenderPageBitmap);
+    CHK(FPDF_RenderPageBitmapWithThreads);
     CHK(FPDF_ClosePage);
     CHK(FPDF_CloseDocument);
     CHK(FPDF_DeviceToPage);
@@ -2,18 +2,149 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <limits>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "core/include/fpdfapi/fpdf_pageobj.h"
+#include "core/include/fpdfapi/fpdf_render.h"
+#include "core/include/fxcrt/fx_ext.h"
+#include "fpdfsdk/include/fsdk_define.h"
 #include "fpdfsdk/src/fpdfview_c_api_test.h"
+#include "public/fpdf_edit.h"
 #include "public/fpdfview.h"
 #include "testing/embedder_test.h"
 #include "testing/gtest/include/gtest/gtest.h"
+#include "testing/utils/path_service.h"
 
 TEST(fpdf, CApiTest) {
   EXPECT_TRUE(CheckPDFiumCApi());
 }
 
+namespace {
+
+// FPDF_LOAD_SHARED in builds that support it, otherwise no flag.
+#ifdef PDF_ENABLE_SHARED_DOCUMENTS
+const int kLoadShared = FPDF_LOAD_SHARED;
+#else
+const int kLoadShared = 0;
+#endif  // PDF_ENABLE_SHARED_DOCUMENTS
+
+std::vector<uint8_t> RenderToBuffer(FPDF_PAGE page) {
+  std::vector<uint8_t> result;
+  FPDF_BITMAP bitmap = FPDFBitmap_Create(200, 200, 0);
+  FPDFBitmap_FillRect(bitmap, 0, 0, 200, 200, 0xFFFFFFFF);
+  FPDF_RenderPageBitmap(bitmap, page, 0, 0, 200, 200, 0, 0);
+  const uint8_t* buffer =
+      static_cast<const uint8_t*>(FPDFBitmap_GetBuffer(bitmap));
+  result.assign(buffer, buffer + FPDFBitmap_GetStride(bitmap) * 200);
+  FPDFBitmap_Destroy(bitmap);
+  return result;
+}
+
+std::vector<uint8_t> RenderPageToBuffer(FPDF_DOCUMENT doc, int page_index) {
+  FPDF_PAGE page = FPDF_LoadPage(doc, page_index);
+  if (!page)
+    return std::vector<uint8_t>();
+
+  std::vector<uint8_t> result = RenderToBuffer(page);
+  FPDF_ClosePage(page);
+  return result;
+}
+
+// Sets |threads_used|, if given, to what FPDF_RenderPageBitmapWithThreads()
+// returns.
+std::vector<uint8_t> RenderWithThreads(FPDF_PAGE page,
+                                       int size,
+                                       int thread_count,
+                                       int* threads_used = nullptr) {
+  std::vector<uint8_t> result;
+  FPDF_BITMAP bitmap = FPDFBitmap_Create(size, size, 0);
+  FPDFBitmap_FillRect(bitmap, 0, 0, size, size, 0xFFFFFFFF);
+  int used = FPDF_RenderPageBitmapWithThreads(bitmap, page, 0, 0, size, size,
+                                              0, FPDF_ANNOT, thread_count);
+  if (threads_used)
+    *threads_used = used;
+  const uint8_t* buffer =
+      static_cast<const uint8_t*>(FPDFBitmap_GetBuffer(bitmap));
+  result.assign(buffer, buffer + FPDFBitmap_GetStride(bitmap) * size);
+  FPDFBitmap_Destroy(bitmap);
+  return result;
+}
+
+// The number of bands CPDF_RenderContext::RenderTiled() splits |page| into.
+int CountRenderBands(FPDF_PAGE page, int size, int thread_count) {
+  CPDF_Page* pPage = CPDFPageFromFPDFPage(page);
+  CFX_DIBitmap bitmap;
+  bitmap.Create(size, size, FXDIB_Argb);
+  CFX_Matrix matrix;
+  pPage->GetDisplayMatrix(matrix, 0, 0, size, size, 0);
+  CPDF_RenderContext context(pPage);
+  context.AppendObjectList(pPage, &matrix);
+  return context.RenderTiled(&bitmap, FALSE, FX_RECT(0, 0, size, size),
+                             nullptr, thread_count);
+}
+
+// Returns the last object of |type| on |page|, or the last one with a blend
+// mode other than Normal if |blended| is set.
+CPDF_PageObject* FindPageObject(FPDF_PAGE page, int type, bool blended) {
+  CPDF_PageObject* pFound = nullptr;
+  for (int i = 0; i < FPDFPage_CountObject(page); ++i) {
+    CPDF_PageObject* pObj =
+        static_cast<CPDF_PageObject*>(FPDFPage_GetObject(page, i));
+    if (pObj->m_Type != type)
+      continue;
+    const CPDF_GeneralStateData* pGeneralData = pObj->m_GeneralState;
+    if (!blended ||
+        (pGeneralData && pGeneralData->m_BlendType != FXDIB_BLEND_NORMAL)) {
+      pFound = pObj;
+    }
+  }
+  return pFound;
+}
+
+// Returns the text mode of the last text object on |page|, the blend type of
+// the last blended path and the line cap and join of the last path.
+std::vector<int> GetDisplayListFields(FPDF_PAGE page) {
+  CPDF_PageObject* pText = FindPageObject(page, PDFPAGE_TEXT, false);
+  CPDF_PageObject* pBlend = FindPageObject(page, PDFPAGE_PATH, true);
+  CPDF_PageObject* pPath = FindPageObject(page, PDFPAGE_PATH, false);
+  if (!pText || !pBlend || !pPath)
+    return std::vector<int>();
+  return {pText->m_TextState.GetObject()->m_TextMode,
+          pBlend->m_GeneralState.GetObject()->m_BlendType,
+          pPath->m_GraphState.GetObject()->m_LineCap,
+          pPath->m_GraphState.GetObject()->m_LineJoin};
+}
+
+void AppendBytes(std::vector<uint8_t>* pBytes, const void* pData, size_t size) {
+  const uint8_t* pByteData = static_cast<const uint8_t*>(pData);
+  pBytes->insert(pBytes->end(), pByteData, pByteData + size);
+}
+
+// Writes |value| |offset| bytes past where |pattern| is found in
+// |display_list|, and updates the checksum that ends the list.
+void PatchDisplayList(std::vector<uint8_t>* display_list,
+                      const std::vector<uint8_t>& pattern,
+                      size_t offset,
+                      uint32_t value) {
+  auto it = std::search(display_list->begin(), display_list->end(),
+                        pattern.begin(), pattern.end());
+  ASSERT_NE(display_list->end(), it);
+  memcpy(&*it + offset, &value, sizeof(value));
+  size_t size = display_list->size() - sizeof(uint32_t);
+  uint32_t checksum = FX_HashCode_String_GetA(
+      reinterpret_cast<const FX_CHAR*>(display_list->data()), size);
+  memcpy(display_list->data() + size, &checksum, sizeof(checksum));
+}
+
+}  // namespace
+
 class FPDFViewEmbeddertest : public EmbedderTest {};
 
 TEST_F(FPDFViewEmbeddertest, Document) {
@@ -39,6 +170,387 @@ TEST_F(FPDFViewEmbeddertest, Page) {
   EXPECT_EQ(nullptr, LoadPage(1));
 }
 
+TEST_F(FPDFViewEmbeddertest, LoadDocumentWithFlags) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &file_path));
+
+  FPDF_BITMAP bitmaps[3];
+  const int flags[] = {0, FPDF_LOAD_MMAP, FPDF_LOAD_OBJECT_POOL};
+  for (size_t i = 0; i < 3; ++i) {
+    FPDF_DOCUMENT doc =
+        FPDF_LoadDocumentWithFlags(file_path.c_str(), nullptr, flags[i]);
+    ASSERT_NE(nullptr, doc);
+    EXPECT_EQ(1, FPDF_GetPageCount(doc));
+    FPDF_PAGE page = FPDF_LoadPage(doc, 0);
+    ASSERT_NE(nullptr, page);
+    bitmaps[i] = FPDFBitmap_Create(200, 200, 0);
+    FPDFBitmap_FillRect(bitmaps[i], 0, 0, 200, 200, 0xFFFFFFFF);
+    FPDF_RenderPageBitmap(bitmaps[i], page, 0, 0, 200, 200, 0, 0);
+    FPDF_ClosePage(page);
+    FPDF_CloseDocument(doc);
+  }
+  for (size_t i = 1; i < 3; ++i) {
+    EXPECT_EQ(0, memcmp(FPDFBitmap_GetBuffer(bitmaps[0]),
+                        FPDFBitmap_GetBuffer(bitmaps[i]),
+                        FPDFBitmap_GetStride(bitmaps[0]) * 200));
+  }
+  for (size_t i = 0; i < 3; ++i)
+    FPDFBitmap_Destroy(bitmaps[i]);
+
+  EXPECT_EQ(nullptr, FPDF_LoadDocumentWithFlags("does_not_exist.pdf", nullptr,
+                                                FPDF_LOAD_MMAP));
+}
+
+TEST_F(FPDFViewEmbeddertest, LoadDocumentShared) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("shared_resources.pdf", &file_path));
+#ifndef PDF_ENABLE_SHARED_DOCUMENTS
+  // Without PDF_ENABLE_SHARED_DOCUMENTS, FPDF_LOAD_SHARED is refused.
+  EXPECT_EQ(nullptr, FPDF_LoadDocumentWithFlags(file_path.c_str(), nullptr,
+                                                FPDF_LOAD_SHARED));
+  EXPECT_EQ(static_cast<unsigned long>(FPDF_ERR_UNSUPPORTED),
+            FPDF_GetLastError());
+#else   // PDF_ENABLE_SHARED_DOCUMENTS
+
+  // Every page uses the same fonts, image, form and shading.
+  FPDF_DOCUMENT doc = FPDF_LoadDocument(file_path.c_str(), nullptr);
+  ASSERT_NE(nullptr, doc);
+  const int page_count = FPDF_GetPageCount(doc);
+  EXPECT_EQ(8, page_count);
+  std::vector<std::vector<uint8_t>> expected;
+  for (int i = 0; i < page_count; ++i) {
+    expected.push_back(RenderPageToBuffer(doc, i));
+    EXPECT_FALSE(expected.back().empty());
+  }
+  FPDF_CloseDocument(doc);
+
+  doc = FPDF_LoadDocumentWithFlags(file_path.c_str(), nullptr,
+                                   FPDF_LOAD_SHARED);
+  ASSERT_NE(nullptr, doc);
+  // The threads also share the decoded image.
+  FPDF_SetImageCacheLimit(doc, 16 * 1024 * 1024);
+  const int kThreadCount = 4;
+  const int kRounds = 4;
+  std::vector<int> mismatches(kThreadCount);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreadCount; ++t) {
+    threads.push_back(std::thread([&, t]() {
+      for (int round = 0; round < kRounds; ++round) {
+        for (int i = (t + round) % kThreadCount; i < page_count;
+             i += kThreadCount) {
+          if (RenderPageToBuffer(doc, i) != expected[i])
+            ++mismatches[t];
+        }
+      }
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+  for (int t = 0; t < kThreadCount; ++t)
+    EXPECT_EQ(0, mismatches[t]);
+  FPDF_CloseDocument(doc);
+#endif  // PDF_ENABLE_SHARED_DOCUMENTS
+}
+
+TEST_F(FPDFViewEmbeddertest, RenderPageBitmapWithThreads) {
+  // The second file has a soft mask and transparency groups, which are not
+  // split into bands.
+  const char* const kFiles[] = {"shared_resources.pdf",
+                                "transparency_groups.pdf"};
+  for (const char* name : kFiles) {
+    std::string file_path;
+    ASSERT_TRUE(PathService::GetTestFilePath(name, &file_path));
+    for (int flags : {0, kLoadShared}) {
+      FPDF_DOCUMENT doc =
+          FPDF_LoadDocumentWithFlags(file_path.c_str(), nullptr, flags);
+      ASSERT_NE(nullptr, doc);
+      for (int i = 0; i < FPDF_GetPageCount(doc); ++i) {
+        FPDF_PAGE page = FPDF_LoadPage(doc, i);
+        ASSERT_NE(nullptr, page);
+        bool banded = name == kFiles[0] && (flags & FPDF_LOAD_SHARED);
+
+        // Not a multiple of the band count, so bands differ in height.
+        const int kSize = 601;
+        int threads_used = 0;
+        std::vector<uint8_t> expected =
+            RenderWithThreads(page, kSize, 1, &threads_used);
+        EXPECT_EQ(1, threads_used);
+        EXPECT_EQ(expected, RenderWithThreads(page, kSize, 4, &threads_used))
+            << name << " page " << i << " flags " << flags;
+        EXPECT_EQ(banded ? 4 : 1, threads_used);
+        EXPECT_EQ(expected, RenderWithThreads(page, kSize, 3, &threads_used))
+            << name << " page " << i << " flags " << flags;
+        EXPECT_EQ(banded ? 3 : 1, threads_used);
+
+        // Four bands per thread, but none under 32 pixels high.
+        const int kMaxThreads = std::numeric_limits<int>::max();
+        EXPECT_EQ(banded ? 16 : 1, CountRenderBands(page, kSize, 4));
+        EXPECT_EQ(banded ? 12 : 1, CountRenderBands(page, kSize, 3));
+        EXPECT_EQ(banded ? kSize / 32 : 1,
+                  CountRenderBands(page, kSize, kMaxThreads));
+        EXPECT_EQ(1, CountRenderBands(page, kSize, 1));
+        FPDF_ClosePage(page);
+      }
+      FPDF_CloseDocument(doc);
+    }
+  }
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests. Renders a page at
+// about 1000 DPI with one to four threads.
+TEST_F(FPDFViewEmbeddertest, DISABLED_BenchmarkRenderPageBitmapWithThreads) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("shared_resources.pdf", &file_path));
+  FPDF_DOCUMENT doc =
+      FPDF_LoadDocumentWithFlags(file_path.c_str(), nullptr, kLoadShared);
+  ASSERT_NE(nullptr, doc);
+  FPDF_PAGE page = FPDF_LoadPage(doc, 0);
+  ASSERT_NE(nullptr, page);
+  const int kSize = 2800;
+  for (int thread_count = 1; thread_count <= 4; ++thread_count) {
+    auto start = std::chrono::steady_clock::now();
+    RenderWithThreads(page, kSize, thread_count);
+    printf("%d thread(s): %lld ms\n", thread_count,
+           static_cast<long long>(
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start).count()));
+  }
+  FPDF_ClosePage(page);
+  FPDF_CloseDocument(doc);
+}
+
+TEST_F(FPDFViewEmbeddertest, DisplayList) {
+  EXPECT_TRUE(OpenDocument("shared_resources.pdf"));
+  for (int i = 0; i < 2; ++i) {
+    std::vector<uint8_t> expected = RenderPageToBuffer(document(), i);
+    ASSERT_FALSE(expected.empty());
+
+    FPDF_PAGE page = FPDF_LoadPage(document(), i);
+    ASSERT_NE(nullptr, page);
+    unsigned long size = FPDF_SavePageDisplayList(page, nullptr, 0);
+    ASSERT_GT(size, 0u);
+    std::vector<uint8_t> display_list(size);
+    EXPECT_EQ(size, FPDF_SavePageDisplayList(page, display_list.data(), size));
+    FPDF_ClosePage(page);
+
+    page = FPDF_LoadPageFromDisplayList(document(), i, display_list.data(),
+                                        size);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(expected, RenderToBuffer(page));
+    FPDF_ClosePage(page);
+
+    // A display list for another page is rejected and the page is parsed.
+    page = FPDF_LoadPageFromDisplayList(document(), 1 - i,
+                                        display_list.data(), size);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(RenderPageToBuffer(document(), 1 - i), RenderToBuffer(page));
+    FPDF_ClosePage(page);
+
+    // So is a damaged one.
+    display_list[size / 2] ^= 0xFF;
+    page = FPDF_LoadPageFromDisplayList(document(), i, display_list.data(),
+                                        size);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(expected, RenderToBuffer(page));
+    FPDF_ClosePage(page);
+  }
+}
+
+TEST_F(FPDFViewEmbeddertest, DisplayListOutOfRange) {
+  EXPECT_TRUE(OpenDocument("transparency_groups.pdf"));
+  FPDF_PAGE page = LoadPage(0);
+  ASSERT_NE(nullptr, page);
+  unsigned long size = FPDF_SavePageDisplayList(page, nullptr, 0);
+  ASSERT_GT(size, 0u);
+  std::vector<uint8_t> display_list(size);
+  FPDF_SavePageDisplayList(page, display_list.data(), size);
+
+  // Find where the fields are written from their values and neighbours.
+  const std::vector<int> fields = GetDisplayListFields(page);
+  ASSERT_EQ(4u, fields.size());
+  ASSERT_EQ(FXDIB_BLEND_MULTIPLY, fields[1]);
+  const CPDF_TextStateData* pTextData =
+      FindPageObject(page, PDFPAGE_TEXT, false)->m_TextState.GetObject();
+  std::vector<uint8_t> text_state;
+  AppendBytes(&text_state, &pTextData->m_FontSize, sizeof(FX_FLOAT) * 3);
+  AppendBytes(&text_state, pTextData->m_Matrix, sizeof(pTextData->m_Matrix));
+  AppendBytes(&text_state, &pTextData->m_TextMode, sizeof(int));
+  AppendBytes(&text_state, pTextData->m_CTM, sizeof(pTextData->m_CTM));
+  const CPDF_GeneralStateData* pGeneralData =
+      FindPageObject(page, PDFPAGE_PATH, true)->m_GeneralState.GetObject();
+  std::vector<uint8_t> general_state;
+  AppendBytes(&general_state, pGeneralData->m_BlendMode,
+              sizeof(pGeneralData->m_BlendMode));
+  AppendBytes(&general_state, &pGeneralData->m_BlendType, sizeof(int));
+  const CFX_GraphStateData* pGraphData =
+      FindPageObject(page, PDFPAGE_PATH, false)->m_GraphState.GetObject();
+  ASSERT_EQ(0, pGraphData->m_DashCount);
+  std::vector<uint8_t> graph_state;
+  const uint32_t dwords[] = {(uint32_t)pGraphData->m_LineCap, 0,
+                             (uint32_t)pGraphData->m_LineJoin};
+  AppendBytes(&graph_state, &dwords[0], sizeof(uint32_t) * 2);
+  AppendBytes(&graph_state, &pGraphData->m_DashPhase, sizeof(FX_FLOAT));
+  AppendBytes(&graph_state, &dwords[2], sizeof(uint32_t));
+  AppendBytes(&graph_state, &pGraphData->m_MiterLimit, sizeof(FX_FLOAT));
+  AppendBytes(&graph_state, &pGraphData->m_LineWidth, sizeof(FX_FLOAT));
+  UnloadPage(page);
+
+  struct {
+    const std::vector<uint8_t>* pattern;
+    size_t offset;
+    size_t field;
+    uint32_t value;
+    bool valid;
+  } cases[] = {
+      {&text_state, 28, 0, 7, true},
+      {&text_state, 28, 0, 8, false},
+      {&text_state, 28, 0, 0xFFFFFFFF, false},
+      {&general_state, 16, 1, FXDIB_BLEND_LUMINOSITY, true},
+      {&general_state, 16, 1, FXDIB_BLEND_EXCLUSION + 1, false},
+      {&general_state, 16, 1, FXDIB_BLEND_LUMINOSITY + 1, false},
+      {&general_state, 16, 1, 0xFFFFFFFF, false},
+      {&graph_state, 0, 2, CFX_GraphStateData::LineCapSquare, true},
+      {&graph_state, 0, 2, 3, false},
+      {&graph_state, 12, 3, CFX_GraphStateData::LineJoinBevel, true},
+      {&graph_state, 12, 3, 0x80000000, false},
+  };
+  for (const auto& test : cases) {
+    std::vector<uint8_t> patched = display_list;
+    PatchDisplayList(&patched, *test.pattern, test.offset, test.value);
+    page = FPDF_LoadPageFromDisplayList(document(), 0, patched.data(), size);
+    ASSERT_NE(nullptr, page);
+    // A list with a value out of range is rejected, and the page is parsed.
+    std::vector<int> expected = fields;
+    if (test.valid)
+      expected[test.field] = test.value;
+    EXPECT_EQ(expected, GetDisplayListFields(page))
+        << test.field << " " << test.value;
+    UnloadPage(page);
+  }
+}
+
+TEST_F(FPDFViewEmbeddertest, ObjectCacheLimit) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("hello_world.pdf", &file_path));
+  FPDF_DOCUMENT doc = FPDF_LoadDocument(file_path.c_str(), nullptr);
+  ASSERT_NE(nullptr, doc);
+  FPDF_SetObjectCacheLimit(doc, 1);
+
+  auto render = [](FPDF_PAGE page) {
+    FPDF_BITMAP bitmap = FPDFBitmap_Create(200, 200, 0);
+    FPDFBitmap_FillRect(bitmap, 0, 0, 200, 200, 0xFFFFFFFF);
+    FPDF_RenderPageBitmap(bitmap, page, 0, 0, 200, 200, 0, 0);
+    return bitmap;
+  };
+  auto same_bitmaps = [](FPDF_BITMAP bitmap1, FPDF_BITMAP bitmap2) {
+    return memcmp(FPDFBitmap_GetBuffer(bitmap1), FPDFBitmap_GetBuffer(bitmap2),
+                  FPDFBitmap_GetStride(bitmap1) * 200) == 0;
+  };
+
+  FPDF_BITMAP bitmaps[2];
+  unsigned long evictions = 0;
+  unsigned long reloads = 0;
+  for (size_t i = 0; i < 2; ++i) {
+    FPDF_PAGE page = FPDF_LoadPage(doc, 0);
+    ASSERT_NE(nullptr, page);
+    bitmaps[i] = render(page);
+    // Closing the page evicts the objects only it used.
+    FPDF_ClosePage(page);
+    ASSERT_TRUE(FPDF_GetObjectCacheStats(doc, &evictions, &reloads));
+    EXPECT_GT(evictions, 0u);
+  }
+  // The second round parsed the evicted page objects again.
+  EXPECT_GT(reloads, 0u);
+  EXPECT_TRUE(same_bitmaps(bitmaps[0], bitmaps[1]));
+  FPDFBitmap_Destroy(bitmaps[1]);
+
+  // The objects of loaded pages are kept.
+  FPDF_PAGE page = FPDF_LoadPage(doc, 0);
+  ASSERT_NE(nullptr, page);
+  unsigned long loaded_evictions = 0;
+  ASSERT_TRUE(FPDF_GetObjectCacheStats(doc, &loaded_evictions, &reloads));
+  FPDF_TrimObjectCache(doc);
+  ASSERT_TRUE(FPDF_GetObjectCacheStats(doc, &evictions, &reloads));
+  EXPECT_EQ(loaded_evictions, evictions);
+  FPDF_BITMAP bitmap = render(page);
+  EXPECT_TRUE(same_bitmaps(bitmaps[0], bitmap));
+  FPDFBitmap_Destroy(bitmap);
+  FPDFBitmap_Destroy(bitmaps[0]);
+  FPDF_ClosePage(page);
+
+  // Edited objects are kept.
+  page = FPDF_LoadPage(doc, 0);
+  ASSERT_NE(nullptr, page);
+  FPDFPage_SetRotation(page, 1);
+  FPDF_ClosePage(page);
+  FPDF_TrimObjectCache(doc);
+  page = FPDF_LoadPage(doc, 0);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(1, FPDFPage_GetRotation(page));
+  FPDF_ClosePage(page);
+
+  // Limits past the budget's range are no limit.
+  CPDF_Document* pDoc = CPDFDocumentFromFPDFDocument(doc);
+  FPDF_SetObjectCacheLimit(doc, std::numeric_limits<unsigned long>::max());
+  EXPECT_EQ(std::numeric_limits<FX_DWORD>::max(), pDoc->GetObjectBudget());
+  FPDF_SetObjectCacheLimit(doc, 1000);
+  EXPECT_EQ(1000u, pDoc->GetObjectBudget());
+  FPDF_CloseDocument(doc);
+
+  EXPECT_FALSE(FPDF_GetObjectCacheStats(nullptr, &evictions, &reloads));
+}
+
+TEST_F(FPDFViewEmbeddertest, ImageCache) {
+  std::string file_path;
+  ASSERT_TRUE(PathService::GetTestFilePath("shared_resources.pdf", &file_path));
+  FPDF_DOCUMENT doc = FPDF_LoadDocument(file_path.c_str(), nullptr);
+  ASSERT_NE(nullptr, doc);
+  const int page_count = FPDF_GetPageCount(doc);
+  std::vector<std::vector<uint8_t>> expected;
+  for (int i = 0; i < page_count; ++i)
+    expected.push_back(RenderPageToBuffer(doc, i));
+  unsigned long hits = 1;
+  unsigned long misses = 1;
+  EXPECT_TRUE(FPDF_GetImageCacheStats(doc, &hits, &misses));
+  EXPECT_EQ(0u, hits);
+  EXPECT_EQ(0u, misses);
+
+  // Every page draws the same image, which is decoded for the first only.
+  FPDF_SetImageCacheLimit(doc, 16 * 1024 * 1024);
+  for (int i = 0; i < page_count; ++i)
+    EXPECT_EQ(expected[i], RenderPageToBuffer(doc, i));
+  EXPECT_TRUE(FPDF_GetImageCacheStats(doc, &hits, &misses));
+  EXPECT_EQ(static_cast<unsigned long>(page_count - 1), hits);
+  EXPECT_EQ(1u, misses);
+
+  // An image larger than the budget is not kept.
+  FPDF_SetImageCacheLimit(doc, 1);
+  for (int i = 0; i < 2; ++i)
+    EXPECT_EQ(expected[i], RenderPageToBuffer(doc, i));
+  EXPECT_TRUE(FPDF_GetImageCacheStats(doc, &hits, &misses));
+  EXPECT_EQ(static_cast<unsigned long>(page_count - 1), hits);
+  EXPECT_EQ(3u, misses);
+  FPDF_CloseDocument(doc);
+
+  // Documents without a budget of their own share the process-wide cache.
+  unsigned long process_hits = 0;
+  unsigned long process_misses = 0;
+  EXPECT_TRUE(FPDF_GetImageCacheStats(nullptr, &process_hits,
+                                      &process_misses));
+  FPDF_SetImageCacheLimit(nullptr, 16 * 1024 * 1024);
+  for (int round = 0; round < 2; ++round) {
+    doc = FPDF_LoadDocument(file_path.c_str(), nullptr);
+    ASSERT_NE(nullptr, doc);
+    for (int i = 0; i < page_count; ++i)
+      EXPECT_EQ(expected[i], RenderPageToBuffer(doc, i));
+    FPDF_CloseDocument(doc);
+  }
+  EXPECT_TRUE(FPDF_GetImageCacheStats(nullptr, &hits, &misses));
+  EXPECT_EQ(process_hits + 2 * (page_count - 1), hits);
+  EXPECT_EQ(process_misses + 2, misses);
+  FPDF_SetImageCacheLimit(nullptr, 0);
+}
+
 TEST_F(FPDFViewEmbeddertest, ViewerRef) {
   EXPECT_TRUE(OpenDocument("about_blank.pdf"));
   EXPECT_TRUE(FPDF_VIEWERREF_GetPrintScaling(document()));
@@ -9,6 +9,7 @@
     'pdf_use_skia%': 0,
     'pdf_enable_v8%': 1,
     'pdf_enable_xfa%': 0, # Set to 1 by standalone.gypi in a standalone build.
+    'pdf_enable_shared_documents%': 0,
     'conditions': [
       ['OS=="linux"', {
         'bundle_freetype%': 0,
@@ -44,6 +45,9 @@
       ['pdf_enable_xfa==1', {
         'defines': ['PDF_ENABLE_XFA'],
       }],
+      ['pdf_enable_shared_documents==1', {
+        'defines': ['PDF_ENABLE_SHARED_DOCUMENTS'],
+      }],
       ['OS=="linux"', {
         'conditions': [
           ['target_arch=="x64"', {
@@ -108,6 +112,7 @@
         'fpdfsdk/src/fpdf_progressive.cpp',
         'fpdfsdk/src/fpdf_searchex.cpp',
         'fpdfsdk/src/fpdf_sysfontinfo.cpp',
+        'fpdfsdk/src/fpdf_tilecache.cpp',
         'fpdfsdk/src/fpdf_transformpage.cpp',
         'fpdfsdk/src/fsdk_actionhandler.cpp',
         'fpdfsdk/src/fsdk_annothandler.cpp',
@@ -128,6 +133,7 @@
         'public/fpdf_searchex.h',
         'public/fpdf_sysfontinfo.h',
         'public/fpdf_text.h',
+        'public/fpdf_tilecache.h',
         'public/fpdf_transformpage.h',
         'public/fpdfview.h',
       ],
@@ -300,9 +306,11 @@
         'core/src/fpdfapi/fpdf_page/fpdf_page.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_colors.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_doc.cpp',
+        'core/src/fpdfapi/fpdf_page/fpdf_page_displaylist.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_func.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_graph_state.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_image.cpp',
+        'core/src/fpdfapi/fpdf_page/fpdf_page_objectindex.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_parser.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_parser_old.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_path.cpp',
@@ -312,9 +320,11 @@
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_document.cpp',
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_encrypt.cpp',
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_fdf.cpp',
+        'core/src/fpdfapi/fpdf_parser/fpdf_parser_filters.cpp',
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_objects.cpp',
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_parser.cpp',
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_utility.cpp',
+        'core/src/fpdfapi/fpdf_parser/fpdf_parser_xrefindex.cpp',
         'core/src/fpdfapi/fpdf_parser/parser_int.h',
         'core/src/fpdfapi/fpdf_render/fpdf_render.cpp',
         'core/src/fpdfapi/fpdf_render/fpdf_render_cache.cpp',
@@ -441,6 +451,7 @@
         'core/include/fxcrt/fx_bidi.h',
         'core/include/fxcrt/fx_coordinates.h',
         'core/include/fxcrt/fx_ext.h',
+        'core/include/fxcrt/fx_lock.h',
         'core/include/fxcrt/fx_memory.h',
         'core/include/fxcrt/fx_safe_types.h',
         'core/include/fxcrt/fx_stream.h',
@@ -753,13 +764,17 @@
       'sources': [
         'core/src/fpdfapi/fpdf_font/fpdf_font_cid_unittest.cpp',
         'core/src/fpdfapi/fpdf_font/fpdf_font_unittest.cpp',
+        'core/src/fpdfapi/fpdf_page/fpdf_page_func_unittest.cpp',
+        'core/src/fpdfapi/fpdf_page/fpdf_page_objectindex_unittest.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_parser_old_unittest.cpp',
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_decode_unittest.cpp',
+        'core/src/fpdfapi/fpdf_parser/fpdf_parser_objects_unittest.cpp',
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_parser_unittest.cpp',
         'core/src/fpdftext/fpdf_text_int_unittest.cpp',
         'core/src/fxcodec/codec/fx_codec_jpx_unittest.cpp',
         'core/src/fxcrt/fx_basic_bstring_unittest.cpp',
         'core/src/fxcrt/fx_basic_memmgr_unittest.cpp',
+        'core/src/fxcrt/fx_basic_util_unittest.cpp',
         'core/src/fxcrt/fx_basic_wstring_unittest.cpp',
         'core/src/fxcrt/fx_bidi_unittest.cpp',
         'core/src/fxcrt/fx_extension_unittest.cpp',
@@ -786,12 +801,16 @@
         'test_support',
       ],
       'sources': [
+        'core/src/fpdfapi/fpdf_page/fpdf_page_colors_embeddertest.cpp',
         'core/src/fpdfapi/fpdf_page/fpdf_page_func_embeddertest.cpp',
+        'core/src/fpdfapi/fpdf_page/fpdf_page_parser_embeddertest.cpp',
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_decode_embeddertest.cpp',
         'core/src/fpdfapi/fpdf_parser/fpdf_parser_parser_embeddertest.cpp',
         'core/src/fpdfapi/fpdf_render/fpdf_render_loadimage_embeddertest.cpp',
         'core/src/fpdfapi/fpdf_render/fpdf_render_pattern_embeddertest.cpp',
+        'core/src/fxge/dib/fx_dib_composite_embeddertest.cpp',
         'fpdfsdk/src/fpdf_dataavail_embeddertest.cpp',
+        'fpdfsdk/src/fpdf_tilecache_embeddertest.cpp',
         'fpdfsdk/src/fpdfdoc_embeddertest.cpp',
         'fpdfsdk/src/fpdfedit_embeddertest.cpp',
         'fpdfsdk/src/fpdfext_embeddertest.cpp',
@@ -134,6 +134,44 @@ DLLEXPORT int STDCALL FPDFPage_CountObject(FPDF_PAGE page);
 //          The handle of the page object. Null for failed.
 DLLEXPORT FPDF_PAGEOBJECT STDCALL FPDFPage_GetObject(FPDF_PAGE page, int index);
 
+// Function: FPDFPage_BuildObjectIndex
+//          Build a spatial index over the bounding boxes of the page objects.
+// Parameters:
+//          page        -   Handle to a page. Returned by FPDF_LoadPage.
+// Return value:
+//          True if successful, false otherwise.
+// Comment:
+//          The index speeds up FPDFPage_GetObjectsInRect and lets rendering
+//          skip the objects outside the rendered area, which matters for
+//          pages with many objects. It is built when first needed, and built
+//          again after objects are inserted or moved with
+//          FPDFPage_InsertObject, FPDFPageObj_Transform or
+//          FPDFImageObj_SetMatrix.
+DLLEXPORT FPDF_BOOL STDCALL FPDFPage_BuildObjectIndex(FPDF_PAGE page);
+
+// Function: FPDFPage_GetObjectsInRect
+//          Get the page objects whose bounding boxes intersect a rectangle.
+// Parameters:
+//          page        -   Handle to a page. Returned by FPDFPage_New or
+//          FPDF_LoadPage.
+//          left        -   The left of the rectangle, in page coordinates.
+//          bottom      -   The bottom of the rectangle.
+//          right       -   The right of the rectangle.
+//          top         -   The top of the rectangle.
+//          objects     -   A buffer receiving the handles of the objects, in
+//                          paint order. Can be NULL.
+//          max_count   -   The number of handles |objects| can hold.
+// Return value:
+//          The number of objects in the rectangle, which may exceed
+//          |max_count|. -1 for failed.
+DLLEXPORT int STDCALL FPDFPage_GetObjectsInRect(FPDF_PAGE page,
+                                                double left,
+                                                double bottom,
+                                                double right,
+                                                double top,
+                                                FPDF_PAGEOBJECT* objects,
+                                                int max_count);
+
 // Function: FPDFPage_HasTransparency
 //          Check that whether the content of specified PDF page contains
 //          transparency.
@@ -0,0 +1,140 @@
+// Copyright 2016 PDFium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef PUBLIC_FPDF_TILECACHE_H_
+#define PUBLIC_FPDF_TILECACHE_H_
+
+#include "fpdf_progressive.h"
+#include "fpdfview.h"
+
+// A cache of rendered page tiles.
+typedef void* FPDF_TILECACHE;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Function: FPDF_CreateTileCache
+//          Create a cache of rendered tiles for the pages of a document.
+// Parameters:
+//          document    -   Handle to document. Returned by FPDF_LoadDocument.
+//          tile_size   -   Width and height of the tiles, in pixels.
+//          max_bytes   -   Memory the cached tiles may use. The least recently
+//                          used tiles are dropped to stay within it.
+//          downscale   -   Whether a tile may be built from the four tiles
+//                          covering the same area at twice the size, when
+//                          they are cached, instead of being rendered. Such
+//                          tiles are filtered, so they differ slightly from
+//                          rendered ones.
+// Return value:
+//          A handle to the cache, or NULL if |tile_size| is not positive.
+// Comments:
+//          The cache must be destroyed with FPDF_DestroyTileCache() before the
+//          document is closed.
+DLLEXPORT FPDF_TILECACHE STDCALL FPDF_CreateTileCache(FPDF_DOCUMENT document,
+                                                      int tile_size,
+                                                      unsigned long max_bytes,
+                                                      FPDF_BOOL downscale);
+
+// Function: FPDF_DestroyTileCache
+//          Destroy a tile cache, and any tile rendering it has in progress.
+// Parameters:
+//          cache       -   Handle to the cache. Returned by
+//                          FPDF_CreateTileCache.
+// Return value:
+//          None.
+DLLEXPORT void STDCALL FPDF_DestroyTileCache(FPDF_TILECACHE cache);
+
+// Function: FPDF_RenderTile_Start
+//          Start to render a tile of a page, or copy it from the cache.
+// Parameters:
+//          cache       -   Handle to the cache. Returned by
+//                          FPDF_CreateTileCache.
+//          bitmap      -   Handle to the device independent bitmap that
+//                          receives the tile at its top left corner.
+//          page        -   Handle to the page. Returned by FPDF_LoadPage.
+//          size_x      -   Horizontal size (in pixels) of the whole page at
+//                          the zoom level of the tile.
+//          size_y      -   Vertical size (in pixels) of the whole page at the
+//                          zoom level of the tile.
+//          tile_x      -   Column of the tile, counting from 0 at the left.
+//          tile_y      -   Row of the tile, counting from 0 at the top.
+//          rotate      -   Page orientation, as for FPDF_RenderPageBitmap.
+//          flags       -   0 for normal display, or combination of flags
+//                          defined in fpdfview.h.
+//          pause       -   The IFSDK_PAUSE interface, as for
+//                          FPDF_RenderPageBitmap_Start.
+// Return value:
+//          Rendering Status. See flags for progressive process status for the
+//          details. FPDF_RENDER_DONE right away if the tile was cached.
+// Comments:
+//          Tiles are rendered on white; the parts of the tile past the edge
+//          of the page stay white. Tiles are cached by page, size, position,
+//          rotation and flags. Only one tile of a cache renders at a time, so
+//          this ends the one in progress, if any. The page must stay loaded
+//          until the tile is done or FPDF_RenderTile_Close() is called.
+DLLEXPORT int STDCALL FPDF_RenderTile_Start(FPDF_TILECACHE cache,
+                                            FPDF_BITMAP bitmap,
+                                            FPDF_PAGE page,
+                                            int size_x,
+                                            int size_y,
+                                            int tile_x,
+                                            int tile_y,
+                                            int rotate,
+                                            int flags,
+                                            IFSDK_PAUSE* pause);
+
+// Function: FPDF_RenderTile_Continue
+//          Continue rendering the tile started by FPDF_RenderTile_Start.
+// Parameters:
+//          cache       -   Handle to the cache. Returned by
+//                          FPDF_CreateTileCache.
+//          pause       -   The IFSDK_PAUSE interface.
+// Return value:
+//          Rendering Status. Once it is FPDF_RENDER_DONE, the tile is in the
+//          bitmap given to FPDF_RenderTile_Start and in the cache.
+DLLEXPORT int STDCALL FPDF_RenderTile_Continue(FPDF_TILECACHE cache,
+                                               IFSDK_PAUSE* pause);
+
+// Function: FPDF_RenderTile_Close
+//          Release the resources of the tile rendering in progress, if any.
+// Parameters:
+//          cache       -   Handle to the cache. Returned by
+//                          FPDF_CreateTileCache.
+// Return value:
+//          None.
+DLLEXPORT void STDCALL FPDF_RenderTile_Close(FPDF_TILECACHE cache);
+
+// Function: FPDF_TileCache_RemovePage
+//          Drop the cached tiles of a page, such as after editing it.
+// Parameters:
+//          cache       -   Handle to the cache. Returned by
+//                          FPDF_CreateTileCache.
+//          page        -   Handle to the page. Returned by FPDF_LoadPage.
+// Return value:
+//          None.
+DLLEXPORT void STDCALL FPDF_TileCache_RemovePage(FPDF_TILECACHE cache,
+                                                 FPDF_PAGE page);
+
+// Function: FPDF_TileCache_GetStats
+//          Get how tiles asked of the cache were produced.
+// Parameters:
+//          cache       -   Handle to the cache. Returned by
+//                          FPDF_CreateTileCache.
+//          hits        -   Receives the number of tiles found in the cache.
+//          downscaled  -   Receives the number of tiles built from larger
+//                          cached tiles.
+//          misses      -   Receives the number of tiles rendered.
+// Return value:
+//          TRUE on success, FALSE if |cache| is NULL.
+DLLEXPORT FPDF_BOOL STDCALL FPDF_TileCache_GetStats(FPDF_TILECACHE cache,
+                                                    unsigned long* hits,
+                                                    unsigned long* downscaled,
+                                                    unsigned long* misses);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PUBLIC_FPDF_TILECACHE_H_
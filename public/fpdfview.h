@@ -228,6 +228,48 @@ DLLEXPORT void STDCALL FPDF_SetSandBoxPolicy(FPDF_DWORD policy,
 DLLEXPORT FPDF_DOCUMENT STDCALL FPDF_LoadDocument(FPDF_STRING file_path,
                                                   FPDF_BYTESTRING password);
 
+// Flags for FPDF_LoadDocumentWithFlags().
+// Map the file into memory instead of reading it through a buffer. Object
+// parsing then reads the file directly and unencrypted stream data is used in
+// place without being copied. Ignored where the file cannot be mapped.
+#define FPDF_LOAD_MMAP 0x01
+// Keep the cross-reference data of the file in a sidecar file next to it,
+// named after the file with ".xrefidx" appended. Loading uses the sidecar when
+// it matches the size, modification time and both ends of the file, and
+// writes or replaces it otherwise, which makes reopening large or damaged
+// files faster.
+#define FPDF_LOAD_XREF_INDEX 0x02
+// Allocate the objects parsed from the file from a per-document arena that is
+// released in one go by FPDF_CloseDocument(). Faster to load and to close for
+// documents with many objects, at the cost of not reusing the memory of
+// objects the document drops before it is closed.
+#define FPDF_LOAD_OBJECT_POOL 0x04
+// Allow FPDF_LoadPage(), FPDF_RenderPageBitmap() and FPDF_ClosePage() to run
+// on several threads at once, each thread working on its own pages. No other
+// function may use the document or its pages while they do, and the document
+// must not be modified. Needs PDFium built with pdf_enable_shared_documents;
+// other builds fail to load the document with FPDF_ERR_UNSUPPORTED.
+#define FPDF_LOAD_SHARED 0x08
+
+// Function: FPDF_LoadDocumentWithFlags
+//          Open and load a PDF document, with loading options.
+// Parameters:
+//          file_path -  Path to the PDF file (including extension).
+//          password  -  A string used as the password for the PDF file.
+//                       If no password is needed, empty or NULL can be used.
+//          flags     -  0 for the default behavior, or a combination of the
+//                       FPDF_LOAD_ flags defined above.
+// Return value:
+//          A handle to the loaded document, or NULL on failure.
+// Comments:
+//          Same as FPDF_LoadDocument() when |flags| is 0.
+//          When FPDF_LOAD_MMAP is used, the file must not be modified or
+//          truncated while the document is open.
+DLLEXPORT FPDF_DOCUMENT STDCALL
+FPDF_LoadDocumentWithFlags(FPDF_STRING file_path,
+                           FPDF_BYTESTRING password,
+                           int flags);
+
 // Function: FPDF_LoadMemDocument
 //          Open and load a PDF document from memory.
 // Parameters:
@@ -396,6 +438,7 @@ DLLEXPORT FPDF_BOOL STDCALL FPDF_GetFileVersion(FPDF_DOCUMENT doc,
 #define FPDF_ERR_XFALOAD 7    // Load XFA error.
 #define FPDF_ERR_XFALAYOUT 8  // Layout XFA error.
 #endif  // PDF_ENABLE_XFA
+#define FPDF_ERR_UNSUPPORTED 9  // Option not supported by this build.
 
 // Function: FPDF_GetLastError
 //          Get last error code when a function fails.
@@ -436,6 +479,84 @@ DLLEXPORT int STDCALL FPDF_GetSecurityHandlerRevision(FPDF_DOCUMENT document);
 //          Total number of pages in the document.
 DLLEXPORT int STDCALL FPDF_GetPageCount(FPDF_DOCUMENT document);
 
+// Function: FPDF_SetObjectCacheLimit
+//          Limit the memory used by the objects the document keeps after
+//          parsing them from the file.
+// Parameters:
+//          document    -   Handle to document. Returned by FPDF_LoadDocument.
+//          max_bytes   -   Estimated memory the parsed objects may use after
+//                          FPDF_TrimObjectCache(), or 0 for no limit, which
+//                          is the default.
+// Return value:
+//          None.
+// Comments:
+//          Objects are only tracked from the time a limit is set, so this is
+//          best called right after loading the document.
+//          While the objects are over the limit, FPDF_ClosePage() trims the
+//          cache as FPDF_TrimObjectCache() does.
+DLLEXPORT void STDCALL FPDF_SetObjectCacheLimit(FPDF_DOCUMENT document,
+                                                unsigned long max_bytes);
+
+// Function: FPDF_TrimObjectCache
+//          Evict the least recently used parsed objects of the document until
+//          the rest fit in the limit set by FPDF_SetObjectCacheLimit().
+// Parameters:
+//          document    -   Handle to document. Returned by FPDF_LoadDocument.
+// Return value:
+//          None.
+// Comments:
+//          Evicted objects are parsed again from the file when next used.
+//          Objects changed since they were loaded are kept, as are those that
+//          loaded pages, bookmarks, forms and the document information refer
+//          to. Link, action and destination handles taken from pages that are
+//          no longer loaded become invalid.
+DLLEXPORT void STDCALL FPDF_TrimObjectCache(FPDF_DOCUMENT document);
+
+// Function: FPDF_GetObjectCacheStats
+//          Get how many objects FPDF_TrimObjectCache() evicted from the
+//          document and how many of them had to be parsed again.
+// Parameters:
+//          document    -   Handle to document. Returned by FPDF_LoadDocument.
+//          evictions   -   Receives the number of evicted objects.
+//          reloads     -   Receives the number of evicted objects parsed again.
+// Return value:
+//          TRUE on success, FALSE if |document| is invalid.
+DLLEXPORT FPDF_BOOL STDCALL FPDF_GetObjectCacheStats(FPDF_DOCUMENT document,
+                                                     unsigned long* evictions,
+                                                     unsigned long* reloads);
+
+// Function: FPDF_SetImageCacheLimit
+//          Keep decoded images for reuse by all pages of the document, or of
+//          every document, within a memory budget.
+// Parameters:
+//          document    -   Handle to document. Returned by FPDF_LoadDocument,
+//                          or NULL to set the budget shared by the documents
+//                          that have none of their own.
+//          max_bytes   -   Memory the decoded images may use, or 0 to keep
+//                          none, which is the default.
+// Return value:
+//          None.
+// Comments:
+//          An image drawn on several pages, such as a logo, is then decoded
+//          once. The least recently used images are dropped first. Pages
+//          keep the images they drew in their own cache as before.
+DLLEXPORT void STDCALL FPDF_SetImageCacheLimit(FPDF_DOCUMENT document,
+                                               unsigned long max_bytes);
+
+// Function: FPDF_GetImageCacheStats
+//          Get how often a page found a decoded image in the cache set up by
+//          FPDF_SetImageCacheLimit() and how often it had to decode it.
+// Parameters:
+//          document    -   Handle to document, or NULL for the cache shared
+//                          by documents without one of their own.
+//          hits        -   Receives the number of images found.
+//          misses      -   Receives the number of images decoded.
+// Return value:
+//          TRUE on success, FALSE if |document| is invalid.
+DLLEXPORT FPDF_BOOL STDCALL FPDF_GetImageCacheStats(FPDF_DOCUMENT document,
+                                                    unsigned long* hits,
+                                                    unsigned long* misses);
+
 // Function: FPDF_LoadPage
 //          Load a page inside the document.
 // Parameters:
@@ -449,6 +570,44 @@ DLLEXPORT int STDCALL FPDF_GetPageCount(FPDF_DOCUMENT document);
 DLLEXPORT FPDF_PAGE STDCALL FPDF_LoadPage(FPDF_DOCUMENT document,
                                           int page_index);
 
+// Function: FPDF_LoadPageFromDisplayList
+//          Load a page inside the document, restoring its contents from a
+//          display list saved by FPDF_SavePageDisplayList() instead of
+//          parsing them.
+// Parameters:
+//          document    -   Handle to document. Returned by FPDF_LoadDocument
+//          page_index  -   Index number of the page. 0 for the first page.
+//          data        -   The display list saved for the page.
+//          size        -   The size of |data| in bytes.
+// Return value:
+//          A handle to the loaded page, or NULL if page load fails.
+// Comments:
+//          The page contents are parsed as by FPDF_LoadPage() if the display
+//          list is damaged, or was saved for other page contents or another
+//          revision of the file.
+DLLEXPORT FPDF_PAGE STDCALL FPDF_LoadPageFromDisplayList(FPDF_DOCUMENT document,
+                                                         int page_index,
+                                                         const void* data,
+                                                         unsigned long size);
+
+// Function: FPDF_SavePageDisplayList
+//          Save the parsed contents of a page as a display list, which
+//          FPDF_LoadPageFromDisplayList() can restore the page from later.
+// Parameters:
+//          page        -   Handle to the page. Returned by FPDF_LoadPage.
+//          buffer      -   A buffer for the display list. May be NULL.
+//          buflen      -   The length of |buffer| in bytes.
+// Return value:
+//          The size of the display list in bytes, or 0 if the page can't be
+//          saved. Nothing is copied if |buflen| is smaller than that size.
+// Comments:
+//          Display lists refer to fonts, images and other resources of the
+//          document, and can only be used with the same file. They must not
+//          be used after the document is modified.
+DLLEXPORT unsigned long STDCALL FPDF_SavePageDisplayList(FPDF_PAGE page,
+                                                         void* buffer,
+                                                         unsigned long buflen);
+
 // Function: FPDF_GetPageWidth
 //          Get page width.
 // Parameters:
@@ -576,6 +735,47 @@ DLLEXPORT void STDCALL FPDF_RenderPageBitmap(FPDF_BITMAP bitmap,
                                              int rotate,
                                              int flags);
 
+// Function: FPDF_RenderPageBitmapWithThreads
+//          Render contents of a page to a device independent bitmap, using
+//          several threads.
+// Parameters:
+//          bitmap       -   Handle to the device independent bitmap, as for
+//                           FPDF_RenderPageBitmap.
+//          page         -   Handle to the page. Returned by FPDF_LoadPage
+//          start_x      -   Left pixel position of the display area in
+//                           bitmap coordinates.
+//          start_y      -   Top pixel position of the display area in bitmap
+//                           coordinates.
+//          size_x       -   Horizontal size (in pixels) for displaying the
+//                           page.
+//          size_y       -   Vertical size (in pixels) for displaying the page.
+//          rotate       -   Page orientation, as for FPDF_RenderPageBitmap.
+//          flags        -   0 for normal display, or combination of flags
+//                           defined above.
+//          thread_count -   The most threads to render with, including the
+//                           calling thread.
+// Return value:
+//          The number of threads the page was rendered with, including the
+//          calling thread, or 0 if |bitmap| or |page| is invalid.
+// Comments:
+//          The bitmap is split into bands that are rendered at once, and the
+//          result is the same as FPDF_RenderPageBitmap(). The page is only
+//          rendered on several threads if its document was loaded with
+//          FPDF_LOAD_SHARED, which needs PDFium built with
+//          pdf_enable_shared_documents. Otherwise, or when |thread_count| is
+//          1 or less, this is the same as FPDF_RenderPageBitmap() and returns
+//          1. Pages with soft masks, blend modes or transparency groups are
+//          rendered on one thread too.
+DLLEXPORT int STDCALL FPDF_RenderPageBitmapWithThreads(FPDF_BITMAP bitmap,
+                                                       FPDF_PAGE page,
+                                                       int start_x,
+                                                       int start_y,
+                                                       int size_x,
+                                                       int size_y,
+                                                       int rotate,
+                                                       int flags,
+                                                       int thread_count);
+
 // Function: FPDF_ClosePage
 //          Close a loaded PDF page.
 // Parameters: